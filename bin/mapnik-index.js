@@ -2,28 +2,74 @@
 
 'use strict';
 
-var binary = require('@mapbox/node-pre-gyp'),
-    path = require('path'),
-    bindingPath = binary.find(path.resolve(__dirname, '..', 'package.json')),
-    program = path.join(path.dirname(bindingPath), 'bin', 'mapnik-index'),
-    spawn = require('child_process').spawn,
-    fs = require('fs');
-
-if (!fs.existsSync(program)) {
-  // assume it is not packaged but still on PATH
-  program = 'mapnik-index';
+var mapnik = require('../');
+
+var usage = 'usage: mapnik-index.js [options] <file>...';
+usage += '\n  -h, --help                print this message';
+usage += '\n  -v, --verbose             print the features indexed per file';
+usage += '\n  -d, --depth arg           max tree depth (default 8)';
+usage += '\n  -r, --ratio arg           split ratio (default 0.55)';
+usage += '\n  -s, --separator arg       csv columns separator';
+usage += '\n  -q, --quote arg           csv columns quote';
+usage += '\n  -H, --manual-headers arg  csv manual headers string';
+usage += '\n  --files arg               csv or GeoJSON files to index';
+
+var files = [];
+var options = {};
+var verbose = false;
+var args = process.argv.slice(2);
+
+for (var i = 0; i < args.length; ++i) {
+  var arg = args[i];
+  if (arg === '-h' || arg === '--help') {
+    console.log(usage);
+    process.exit(0);
+  } else if (arg === '-v' || arg === '--verbose') {
+    verbose = true;
+  } else if (arg === '-d' || arg === '--depth') {
+    options.depth = Number(args[++i]);
+  } else if (arg === '-r' || arg === '--ratio') {
+    options.ratio = Number(args[++i]);
+  } else if (arg === '-s' || arg === '--separator') {
+    options.separator = args[++i];
+  } else if (arg === '-q' || arg === '--quote') {
+    options.quote = args[++i];
+  } else if (arg === '-H' || arg === '--manual-headers') {
+    options.headers = args[++i];
+  } else if (arg === '--files') {
+    // kept for compatibility with mapnik-index, files may follow directly
+  } else if (arg[0] === '-') {
+    console.error('unknown option ' + arg + '\n' + usage);
+    process.exit(1);
+  } else {
+    files.push(arg);
+  }
+}
+
+if (!files.length) {
+  console.error(usage);
+  process.exit(1);
+}
+
+if (verbose) {
+  options.progress = function(result) {
+    console.log('(' + result.done + '/' + result.total + ') ' + result.file + ': ' + result.features + ' features');
+  };
 }
 
-var proc = spawn(program, process.argv.slice(2))
-      .on('error', function(err) {
-        if (err && err.code == 'ENOENT') {
-          throw new Error("mapnik-index not found at " + program);
-        }
-        throw err;
-      })
-      .on('exit', function(code) {
-        process.exit(code);
-      });
-
-proc.stdout.pipe(process.stdout);
-proc.stderr.pipe(process.stderr);
+mapnik.buildIndex(files, options, function(err, results) {
+  if (err) {
+    console.error(err.message);
+    process.exit(1);
+  }
+  var failed = 0;
+  results.forEach(function(result) {
+    if (result.error) {
+      console.error(result.file + ': ' + result.error);
+      ++failed;
+    } else if (!result.index) {
+      console.error(result.file + ': no features to index');
+    }
+  });
+  process.exit(failed ? 1 : 0);
+});
@@ -31,16 +31,20 @@ var meta = function(ds) {
     console.log('Description -->');
     console.log(ds.describe());
     console.log('extent: ' + ds.extent().toString());
-    var fs = ds.featureset();
-    var count = 0;
-    if (fs) {
-        var feat = fs.next();
-        while (feat) {
-            count++;
-            feat = fs.next();
+    ds.stats(function(err, stats) {
+        if (err) {
+            console.error(err.message);
+            process.exit(1);
         }
-    }
-    console.log(count,'features');
+        console.log(stats.count,'features');
+        console.log('geometry types:', stats.geometry_types);
+        console.log('fields -->');
+        Object.keys(stats.fields).forEach(function(name) {
+            var field = stats.fields[name];
+            console.log('  ' + name + ': min=' + field.min + ' max=' + field.max +
+                        ' nulls=' + field.nulls + ' distinct~' + field.distinct);
+        });
+    });
 };
 
 if (/.shp$/.test(obj)) {
@@ -2,28 +2,68 @@
 
 'use strict';
 
-var binary = require('@mapbox/node-pre-gyp'),
-    path = require('path'),
-    bindingPath = binary.find(path.resolve(__dirname, '..', 'package.json')),
-    shapeindex = path.join(path.dirname(bindingPath), 'bin', 'shapeindex'),
-    spawn = require('child_process').spawn,
-    fs = require('fs');
-
-if (!fs.existsSync(shapeindex)) {
-  // assume it is not packaged but still on PATH
-  shapeindex = 'shapeindex';
+var mapnik = require('../');
+
+var usage = 'usage: mapnik-shapeindex.js [options] <shape_file>...';
+usage += '\n  -h, --help         print this message';
+usage += '\n  -v, --verbose      print the features indexed per file';
+usage += '\n  --index-parts      index the parts of polygons and lines separately';
+usage += '\n  -d, --depth arg    max tree depth (default 8)';
+usage += '\n  -r, --ratio arg    split ratio (default 0.55)';
+usage += '\n  --shape_files arg  shape files to index';
+
+var files = [];
+var options = { type: 'shape' };
+var verbose = false;
+var args = process.argv.slice(2);
+
+for (var i = 0; i < args.length; ++i) {
+  var arg = args[i];
+  if (arg === '-h' || arg === '--help') {
+    console.log(usage);
+    process.exit(0);
+  } else if (arg === '-v' || arg === '--verbose') {
+    verbose = true;
+  } else if (arg === '--index-parts') {
+    options.index_parts = true;
+  } else if (arg === '-d' || arg === '--depth') {
+    options.depth = Number(args[++i]);
+  } else if (arg === '-r' || arg === '--ratio') {
+    options.ratio = Number(args[++i]);
+  } else if (arg === '--shape_files') {
+    // kept for compatibility with shapeindex, files may follow directly
+  } else if (arg[0] === '-') {
+    console.error('unknown option ' + arg + '\n' + usage);
+    process.exit(1);
+  } else {
+    files.push(arg);
+  }
+}
+
+if (!files.length) {
+  console.error(usage);
+  process.exit(1);
+}
+
+if (verbose) {
+  options.progress = function(result) {
+    console.log('(' + result.done + '/' + result.total + ') ' + result.file + ': ' + result.features + ' features');
+  };
 }
 
-var proc = spawn(shapeindex, process.argv.slice(2))
-      .on('error', function(err) {
-        if (err && err.code == 'ENOENT') {
-          throw new Error("shapeindex not found at " + shapeindex);
-        }
-        throw err;
-      })
-      .on('exit', function(code) {
-        process.exit(code);
-      });
-
-proc.stdout.pipe(process.stdout);
-proc.stderr.pipe(process.stderr);
+mapnik.buildIndex(files, options, function(err, results) {
+  if (err) {
+    console.error(err.message);
+    process.exit(1);
+  }
+  var failed = 0;
+  results.forEach(function(result) {
+    if (result.error) {
+      console.error(result.file + ': ' + result.error);
+      ++failed;
+    } else if (!result.index) {
+      console.error(result.file + ': no features to index');
+    }
+  });
+  process.exit(failed ? 1 : 0);
+});
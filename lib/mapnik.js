@@ -3,6 +3,7 @@
 var binary = require('@mapbox/node-pre-gyp');
 var exists = require('fs').existsSync || require('path').existsSync;
 var path = require('path');
+var stream = require('stream');
 var binding_path = binary.find(path.resolve(path.join(__dirname,'../package.json')));
 var settings_path = path.join(path.dirname(binding_path),'mapnik_settings.js');
 var settings = require(settings_path);
@@ -122,3 +123,153 @@ mapnik.Feature.prototype.toWKB = function() {
 mapnik.Feature.prototype.toWKT = function() {
     return this.geometry().toWKT();
 };
+
+/**
+ * Create a writable stream of GeoJSON FeatureCollection bytes that emits arrays
+ * of mapnik.Feature objects. Only one chunk is parsed at a time, and at most
+ * one partial feature is held back between chunks, so memory stays bounded.
+ *
+ * @memberof Feature
+ * @static
+ * @name fromJSONStream
+ * @param {Object} [options]
+ * @param {number} [options.max_feature_bytes=268435456] largest single feature accepted
+ * @returns {stream.Transform} stream in object mode emitting `Array<mapnik.Feature>` batches
+ * @example
+ * fs.createReadStream('big.geojson')
+ *   .pipe(mapnik.Feature.fromJSONStream())
+ *   .on('data', function(features) { ... });
+ */
+mapnik.Feature.fromJSONStream = function(options) {
+    options = options || {};
+    var max_feature_bytes = options.max_feature_bytes || 256 * 1024 * 1024;
+    var in_features = false;
+    var next_id = 1;
+    var done = false;
+    var pending = null;
+    return new stream.Transform({
+        readableObjectMode: true,
+        transform: function(chunk, encoding, callback) {
+            if (done) return callback();
+            var self = this;
+            var buffer = pending ? Buffer.concat([pending, chunk]) : chunk;
+            mapnik.Feature.fromJSONChunk(buffer, {in_features: in_features, first_id: next_id}, function(err, result) {
+                if (err) return callback(err);
+                in_features = result.in_features;
+                next_id = result.next_id;
+                done = result.done;
+                pending = (!done && result.consumed < buffer.length) ? buffer.slice(result.consumed) : null;
+                if (pending && pending.length > max_feature_bytes) {
+                    return callback(new Error('GeoJSON feature exceeds max_feature_bytes'));
+                }
+                if (result.features.length) self.push(result.features);
+                callback();
+            });
+        },
+        flush: function(callback) {
+            if (!done) return callback(new Error('unexpected end of GeoJSON FeatureCollection'));
+            callback();
+        }
+    });
+};
+
+/**
+ * In-memory datasources built directly from JS data.
+ *
+ * @name MemoryDatasource
+ * @memberof mapnik
+ * @property {Function} fromColumns alias of {@link Datasource.fromColumns}
+ */
+mapnik.MemoryDatasource = {
+    fromColumns: mapnik.Datasource.fromColumns
+};
+
+/**
+ * Wrap a datasource in a tile-cell feature cache, see {@link Datasource#withCache}.
+ *
+ * @name CachingDatasource
+ * @memberof mapnik
+ * @class
+ * @param {mapnik.Datasource} ds datasource to wrap
+ * @param {Object} [options] `{max_bytes, quantize_zoom}`
+ * @returns {mapnik.Datasource} caching datasource
+ * @example
+ * var cached = new mapnik.CachingDatasource(ds, {max_bytes: 64 * 1024 * 1024, quantize_zoom: 12});
+ */
+mapnik.CachingDatasource = function(ds, options) {
+    if (!(ds instanceof mapnik.Datasource)) {
+        throw new TypeError('first argument must be a mapnik.Datasource');
+    }
+    return ds.withCache(options);
+};
+
+if (mapnik.Grid) {
+    /**
+     * Decode a Buffer produced by `grid.encode({format: 'binary'})`.
+     *
+     * @memberof Grid
+     * @static
+     * @name decodeBinary
+     * @param {Buffer} buffer
+     * @returns {Object} `{width, height, keys, cells, data}` where `cells` is a
+     * Uint32Array of indexes into `keys`, row by row, and `data` maps every key
+     * with attributes to an object of them, like the `data` of a UTFGrid
+     */
+    mapnik.Grid.decodeBinary = function(buffer) {
+        var offset = 0;
+        function u32() {
+            var val = buffer.readUInt32LE(offset);
+            offset += 4;
+            return val;
+        }
+        function str() {
+            var len = u32();
+            var val = buffer.toString('utf8', offset, offset + len);
+            offset += len;
+            return val;
+        }
+        if (buffer.toString('ascii', 0, 4) !== 'UGB1') throw new Error('not a binary grid');
+        offset = 4;
+        var width = u32();
+        var height = u32();
+        var i, j;
+        var keys = new Array(u32());
+        for (i = 0; i < keys.length; ++i) keys[i] = str();
+        var cells = new Uint32Array(width * height);
+        var runs = u32();
+        var pos = 0;
+        for (i = 0; i < runs; ++i) {
+            var length = u32();
+            cells.fill(u32(), pos, pos + length);
+            pos += length;
+        }
+        var names = new Array(u32());
+        for (i = 0; i < names.length; ++i) names[i] = str();
+        var values = new Array(u32());
+        for (i = 0; i < values.length; ++i) {
+            var type = buffer[offset++];
+            if (type === 0) {
+                values[i] = null;
+            } else if (type === 1) {
+                values[i] = buffer[offset++] === 1;
+            } else if (type === 2 || type === 3) {
+                values[i] = buffer.readDoubleLE(offset);
+                offset += 8;
+            } else {
+                values[i] = str();
+            }
+        }
+        var data = {};
+        for (i = 0; i < keys.length; ++i) {
+            var pairs = u32();
+            if (pairs === 0) continue;
+            var feature = {};
+            for (j = 0; j < pairs; ++j) {
+                var name = names[u32()];
+                feature[name] = values[u32()];
+            }
+            data[keys[i]] = feature;
+        }
+        return { width: width, height: height, keys: keys, cells: cells, data: data };
+    };
+}
@@ -23,6 +23,8 @@
 #include "blend.hpp"
 #include "tint.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
 
 #include <sstream>
 #include <cstring>
@@ -289,9 +291,9 @@ static void Blend_Composite(int width_, int height_, std::uint32_t* target, BIma
 struct AsyncBlend;
 static void Blend_Encode(AsyncBlend* worker, mapnik::image_rgba8 const& image, bool alpha);
 
-struct AsyncBlend : Napi::AsyncWorker
+struct AsyncBlend : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncBlend(Images const& images, int quality, int width, int height,
                palette_ptr const& palette, unsigned matte, int compression,
                AlphaMode mode, BlendFormat format, bool reencode,
@@ -417,6 +419,7 @@ struct AsyncBlend : Napi::AsyncWorker
                 // actually decode pixels now
                 try
                 {
+                    tracing::scope trace(tracing::category_blend, "decode");
                     image_reader->read(0, 0, *im_ptr);
                 }
                 catch (std::exception const&)
@@ -458,13 +461,17 @@ struct AsyncBlend : Napi::AsyncWorker
         {
             target.set(matte_);
         }
-        for (auto image_ptr : images_)
         {
-            if (image_ptr && image_ptr->im_raw_ptr)
+            tracing::scope trace(tracing::category_blend, "composite");
+            for (auto image_ptr : images_)
             {
-                Blend_Composite(width_, height_, target.data(), &*image_ptr);
+                if (image_ptr && image_ptr->im_raw_ptr)
+                {
+                    Blend_Composite(width_, height_, target.data(), &*image_ptr);
+                }
             }
         }
+        tracing::scope trace(tracing::category_encode, "encode");
         Blend_Encode(this, target, alpha);
     }
 
@@ -598,7 +605,8 @@ static void Blend_Encode(AsyncBlend* worker, mapnik::image_rgba8 const& image, b
  * @param {Object} options can include width, height, `compression`,
  * `reencode`, palette, mode can be either `hextree` or `octree`, quality. JPEG & WebP quality
  * quality ranges from 0-100, PNG quality from 2-256. Compression varies by platform -
- * it references the internal zlib compression algorithm.
+ * it references the internal zlib compression algorithm. `priority` (`interactive`,
+ * `batch` or `background`) orders waiting async work, see {@link threadPool}.
  * @param {Function} callback called with (err, res), where a successful
  * result is a processed image as a Buffer
  * @example
@@ -623,6 +631,7 @@ Napi::Value blend(Napi::CallbackInfo const& info)
     AlphaMode mode = BLEND_MODE_HEXTREE;
     BlendFormat format = BLEND_FORMAT_PNG;
     bool reencode = false;
+    worker_priority priority = priority_interactive;
     Napi::Function callback;
 
     Napi::Object options;
@@ -786,6 +795,7 @@ Napi::Value blend(Napi::CallbackInfo const& info)
                 return env.Undefined();
             }
         }
+        if (!parse_priority(env, options, priority)) return env.Undefined();
 
         int min_compression = Z_NO_COMPRESSION;
         int max_compression = Z_BEST_COMPRESSION;
@@ -852,7 +862,7 @@ Napi::Value blend(Napi::CallbackInfo const& info)
         else if (buffer.IsObject())
         {
             Napi::Object obj = buffer.As<Napi::Object>();
-            if (obj.InstanceOf(Image::constructor.Value()))
+            if (obj.InstanceOf(Image::constructor(env).Value()))
             {
                 Image* im = Napi::ObjectWrap<Image>::Unwrap(obj);
 
@@ -878,7 +888,7 @@ Napi::Value blend(Napi::CallbackInfo const& info)
                     else if (buffer.IsObject())
                     {
                         Napi::Object possible_im = buffer.As<Napi::Object>();
-                        if (possible_im.InstanceOf(Image::constructor.Value()))
+                        if (possible_im.InstanceOf(Image::constructor(env).Value()))
                         {
                             Image* im = Napi::ObjectWrap<Image>::Unwrap(possible_im);
                             if (im->impl()->get_dtype() == mapnik::image_dtype_rgba8)
@@ -927,6 +937,7 @@ Napi::Value blend(Napi::CallbackInfo const& info)
         images.push_back(image);
     }
     auto* worker = new AsyncBlend(images, quality, width, height, palette, matte, compression, mode, format, reencode, callback);
+    worker->SetPriority(priority);
     worker->Queue();
     return env.Undefined();
 }
@@ -0,0 +1,317 @@
+#include "caching_datasource.hpp"
+#include "columnar_datasource.hpp"
+
+// mapnik
+#include <mapnik/featureset.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <tuple>
+#include <utility>
+
+namespace node_mapnik {
+
+namespace {
+
+// queries touching more cells than this go straight to the wrapped datasource
+constexpr std::size_t max_cells_per_query = 64;
+
+struct cached_featureset : mapnik::Featureset
+{
+    explicit cached_featureset(std::vector<mapnik::feature_ptr>&& features)
+        : features_(std::move(features)),
+          itr_(features_.begin()) {}
+
+    mapnik::feature_ptr next() override
+    {
+        if (itr_ != features_.end()) return *itr_++;
+        return mapnik::feature_ptr();
+    }
+
+  private:
+    std::vector<mapnik::feature_ptr> features_;
+    std::vector<mapnik::feature_ptr>::iterator itr_;
+};
+
+struct vertex_count
+{
+    std::size_t operator()(mapnik::geometry::geometry_empty const&) const { return 0; }
+    std::size_t operator()(mapnik::geometry::point<double> const&) const { return 1; }
+    std::size_t operator()(mapnik::geometry::line_string<double> const& line) const { return line.size(); }
+    std::size_t operator()(mapnik::geometry::polygon<double> const& poly) const
+    {
+        std::size_t count = 0;
+        for (auto const& ring : poly) count += ring.size();
+        return count;
+    }
+    std::size_t operator()(mapnik::geometry::geometry_collection<double> const& collection) const
+    {
+        std::size_t count = 0;
+        for (auto const& geom : collection) count += mapnik::util::apply_visitor(*this, geom);
+        return count;
+    }
+    template <typename Multi>
+    std::size_t operator()(Multi const& multi) const
+    {
+        std::size_t count = 0;
+        for (auto const& part : multi) count += (*this)(part);
+        return count;
+    }
+};
+
+// A rough estimate of the heap held by a feature, good enough to bound the cache
+std::size_t estimate_bytes(mapnik::feature_impl const& feature)
+{
+    std::size_t bytes = sizeof(mapnik::feature_impl);
+    bytes += mapnik::util::apply_visitor(vertex_count(), feature.get_geometry()) * sizeof(mapnik::geometry::point<double>);
+    for (auto const& val : feature.get_data())
+    {
+        bytes += sizeof(mapnik::value);
+        if (val.is<mapnik::value_unicode_string>())
+        {
+            bytes += static_cast<std::size_t>(val.get<mapnik::value_unicode_string>().length()) * sizeof(UChar);
+        }
+    }
+    return bytes;
+}
+
+void append_number(std::string& key, double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    key += buffer;
+    key += '\0';
+}
+
+// Everything in the query, but the bbox, that may change what the wrapped
+// datasource returns for a cell
+std::string query_key(mapnik::query const& q)
+{
+    std::string key;
+    std::vector<std::string> names(q.property_names().begin(), q.property_names().end());
+    std::sort(names.begin(), names.end());
+    for (auto const& name : names)
+    {
+        key += name;
+        key += '\0';
+    }
+    key += '\0';
+    append_number(key, std::get<0>(q.resolution()));
+    append_number(key, std::get<1>(q.resolution()));
+    append_number(key, q.scale_denominator());
+    append_number(key, q.get_filter_factor());
+    std::vector<std::pair<std::string, std::string>> variables;
+    for (auto const& variable : q.variables())
+    {
+        variables.emplace_back(variable.first, variable.second.to_string());
+    }
+    std::sort(variables.begin(), variables.end());
+    for (auto const& variable : variables)
+    {
+        key += variable.first;
+        key += '=';
+        key += variable.second;
+        key += '\0';
+    }
+    return key;
+}
+
+} // namespace
+
+caching_datasource::caching_datasource(mapnik::datasource_ptr const& ds, std::size_t max_bytes, unsigned quantize_zoom)
+    : mapnik::datasource(ds->params()),
+      ds_(ds),
+      columnar_(dynamic_cast<columnar_datasource const*>(ds.get())),
+      max_bytes_(max_bytes),
+      cells_per_side_(1u << std::min(quantize_zoom, 20u))
+{
+    grid_ = make_grid(columnar_ ? columnar_->version() : 0);
+}
+
+caching_datasource::grid_type caching_datasource::make_grid(std::uint64_t version) const
+{
+    mapnik::box2d<double> extent = ds_->envelope();
+    return grid_type{extent, extent.width() / cells_per_side_, extent.height() / cells_per_side_, version};
+}
+
+caching_datasource::grid_type caching_datasource::grid() const
+{
+    std::uint64_t version = columnar_ ? columnar_->version() : 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version != grid_.version)
+    {
+        // rows may have moved anywhere, and the extent with them
+        grid_ = make_grid(version);
+        cache_.clear();
+        lru_.clear();
+        stats_.bytes = 0;
+        stats_.cells = 0;
+    }
+    return grid_;
+}
+
+mapnik::datasource::datasource_t caching_datasource::type() const
+{
+    return ds_->type();
+}
+
+mapnik::box2d<double> caching_datasource::envelope() const
+{
+    return grid().extent;
+}
+
+boost::optional<mapnik::datasource_geometry_t> caching_datasource::get_geometry_type() const
+{
+    return ds_->get_geometry_type();
+}
+
+mapnik::layer_descriptor caching_datasource::get_descriptor() const
+{
+    return ds_->get_descriptor();
+}
+
+mapnik::featureset_ptr caching_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
+{
+    return ds_->features_at_point(pt, tol);
+}
+
+mapnik::featureset_ptr caching_datasource::features(mapnik::query const& q) const
+{
+    mapnik::box2d<double> const& bbox = q.get_bbox();
+    grid_type const grid = this->grid();
+    mapnik::box2d<double> const& extent = grid.extent;
+    if (ds_->type() != mapnik::datasource::Vector || !extent.valid() || grid.cell_width <= 0 || grid.cell_height <= 0 ||
+        !bbox.intersects(extent))
+    {
+        return ds_->features(q);
+    }
+    auto cell_index = [](double offset, double size, std::uint32_t cells) {
+        double index = std::floor(offset / size);
+        return static_cast<std::uint32_t>(std::min(std::max(index, 0.0), static_cast<double>(cells - 1)));
+    };
+    std::uint32_t x0 = cell_index(bbox.minx() - extent.minx(), grid.cell_width, cells_per_side_);
+    std::uint32_t x1 = cell_index(bbox.maxx() - extent.minx(), grid.cell_width, cells_per_side_);
+    std::uint32_t y0 = cell_index(bbox.miny() - extent.miny(), grid.cell_height, cells_per_side_);
+    std::uint32_t y1 = cell_index(bbox.maxy() - extent.miny(), grid.cell_height, cells_per_side_);
+    std::size_t cell_count = static_cast<std::size_t>(x1 - x0 + 1) * (y1 - y0 + 1);
+    if (cell_count > max_cells_per_query)
+    {
+        return ds_->features(q);
+    }
+
+    std::string key = query_key(q);
+    std::vector<mapnik::feature_ptr> result;
+    for (std::uint32_t y = y0; y <= y1; ++y)
+    {
+        for (std::uint32_t x = x0; x <= x1; ++x)
+        {
+            auto features = cell_features(grid, x, y, key, q);
+            for (auto const& feature : *features)
+            {
+                mapnik::box2d<double> envelope = feature->envelope();
+                if (!envelope.intersects(bbox)) continue;
+                if (cell_count > 1)
+                {
+                    // Features crossing cell borders are cached in every cell they
+                    // touch, and ids are not always unique, so each one is only
+                    // returned from the cell holding the center of its envelope,
+                    // or the queried cell nearest to it.
+                    mapnik::coord2d center = envelope.center();
+                    std::uint32_t cx = cell_index(center.x - extent.minx(), grid.cell_width, cells_per_side_);
+                    std::uint32_t cy = cell_index(center.y - extent.miny(), grid.cell_height, cells_per_side_);
+                    if (std::min(std::max(cx, x0), x1) != x || std::min(std::max(cy, y0), y1) != y) continue;
+                }
+                result.push_back(feature);
+            }
+        }
+    }
+    return std::make_shared<cached_featureset>(std::move(result));
+}
+
+std::shared_ptr<caching_datasource::feature_list const>
+caching_datasource::cell_features(grid_type const& grid, std::uint32_t x, std::uint32_t y,
+                                  std::string const& query_key, mapnik::query const& q) const
+{
+    // cells of an older grid never answer for this one
+    std::string key = query_key + std::to_string(grid.version) + ':' + std::to_string(x) + ',' + std::to_string(y);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto itr = cache_.find(key);
+        if (itr != cache_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, itr->second.lru);
+            ++stats_.hits;
+            return itr->second.features;
+        }
+        ++stats_.misses;
+    }
+
+    // Query without holding the lock: concurrent misses on the same cell may both
+    // hit the datasource, but renders of unrelated cells never wait on each other.
+    mapnik::box2d<double> const& extent = grid.extent;
+    mapnik::box2d<double> cell(extent.minx() + x * grid.cell_width, extent.miny() + y * grid.cell_height,
+                               extent.minx() + (x + 1) * grid.cell_width, extent.miny() + (y + 1) * grid.cell_height);
+    mapnik::query cell_query(cell, q.resolution(), q.scale_denominator());
+    cell_query.set_filter_factor(q.get_filter_factor());
+    cell_query.set_variables(q.variables());
+    for (auto const& name : q.property_names())
+    {
+        cell_query.add_property_name(name);
+    }
+    auto features = std::make_shared<feature_list>();
+    std::size_t bytes = key.size();
+    mapnik::featureset_ptr fs = ds_->features(cell_query);
+    if (fs && mapnik::is_valid(fs))
+    {
+        mapnik::feature_ptr feature;
+        while ((feature = fs->next()))
+        {
+            bytes += estimate_bytes(*feature);
+            features->push_back(feature);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the wrapped datasource may have been updated while the cell was queried
+    if (bytes > max_bytes_ || grid.version != grid_.version || cache_.count(key) > 0)
+    {
+        return features;
+    }
+    while (!lru_.empty() && stats_.bytes + bytes > max_bytes_)
+    {
+        auto victim = cache_.find(lru_.back());
+        stats_.bytes -= victim->second.bytes;
+        cache_.erase(victim);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    lru_.push_front(key);
+    cache_.emplace(key, cache_entry{lru_.begin(), features, bytes});
+    stats_.bytes += bytes;
+    stats_.cells = cache_.size();
+    return features;
+}
+
+caching_datasource::stats_type caching_datasource::stats() const
+{
+    grid();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_type current = stats_;
+    current.cells = cache_.size();
+    return current;
+}
+
+void caching_datasource::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+    lru_.clear();
+    stats_.bytes = 0;
+    stats_.cells = 0;
+}
+
+} // namespace node_mapnik
@@ -0,0 +1,85 @@
+#pragma once
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+
+// stl
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace node_mapnik {
+
+class columnar_datasource;
+
+// Wraps another datasource and caches its features per cell of a fixed grid,
+// keyed by cell and by the rest of the query (attributes, resolution, scale
+// denominator, filter factor and variables). Any bbox query is answered from the
+// cells it touches, so overlapping queries (neighbouring tiles, buffered extents)
+// only hit the wrapped datasource once per cell. Safe to share between threads.
+// A wrapped columnar datasource can be updated in place: the grid is then laid
+// out again over its new extent and every cached cell dropped.
+class caching_datasource : public mapnik::datasource
+{
+  public:
+    caching_datasource(mapnik::datasource_ptr const& ds, std::size_t max_bytes, unsigned quantize_zoom);
+    mapnik::datasource::datasource_t type() const override;
+    mapnik::featureset_ptr features(mapnik::query const& q) const override;
+    mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const override;
+    mapnik::box2d<double> envelope() const override;
+    boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const override;
+    mapnik::layer_descriptor get_descriptor() const override;
+
+    struct stats_type
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::size_t bytes = 0;
+        std::size_t cells = 0;
+    };
+    stats_type stats() const;
+    void clear();
+
+  private:
+    using feature_list = std::vector<mapnik::feature_ptr>;
+    struct cache_entry
+    {
+        std::list<std::string>::iterator lru;
+        std::shared_ptr<feature_list const> features;
+        std::size_t bytes;
+    };
+
+    struct grid_type
+    {
+        mapnik::box2d<double> extent;
+        double cell_width;
+        double cell_height;
+        std::uint64_t version; // of the wrapped columnar datasource
+    };
+
+    grid_type make_grid(std::uint64_t version) const;
+    // the current grid, emptying the cache first if the wrapped datasource changed
+    grid_type grid() const;
+    std::shared_ptr<feature_list const> cell_features(grid_type const& grid,
+                                                       std::uint32_t x, std::uint32_t y,
+                                                       std::string const& query_key,
+                                                       mapnik::query const& q) const;
+
+    mapnik::datasource_ptr ds_;
+    columnar_datasource const* columnar_; // ds_ when it can be updated in place
+    std::size_t max_bytes_;
+    std::uint32_t cells_per_side_;
+    mutable std::mutex mutex_;
+    mutable grid_type grid_;
+    mutable std::list<std::string> lru_; // most recently used at the front
+    mutable std::unordered_map<std::string, cache_entry> cache_;
+    mutable stats_type stats_;
+};
+
+} // namespace node_mapnik
@@ -0,0 +1,226 @@
+#include "columnar_datasource.hpp"
+
+// mapnik
+#include <mapnik/attribute_descriptor.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <cmath>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+
+namespace node_mapnik {
+
+namespace {
+
+struct rows_featureset : mapnik::Featureset
+{
+    explicit rows_featureset(std::vector<mapnik::feature_ptr>&& features)
+        : features_(std::move(features)),
+          itr_(features_.begin()) {}
+
+    mapnik::feature_ptr next() override
+    {
+        if (itr_ != features_.end()) return *itr_++;
+        return mapnik::feature_ptr();
+    }
+
+  private:
+    std::vector<mapnik::feature_ptr> features_;
+    std::vector<mapnik::feature_ptr>::iterator itr_;
+};
+
+struct attribute_type_visitor
+{
+    mapnik::eAttributeType operator()(mapnik::value_integer) const { return mapnik::Integer; }
+    mapnik::eAttributeType operator()(mapnik::value_double) const { return mapnik::Double; }
+    mapnik::eAttributeType operator()(mapnik::value_bool) const { return mapnik::Boolean; }
+    template <typename T>
+    mapnik::eAttributeType operator()(T const&) const { return mapnik::String; }
+};
+
+mapnik::parameters columnar_params()
+{
+    mapnik::parameters params;
+    params["type"] = std::string("columnar");
+    return params;
+}
+
+} // namespace
+
+columnar_datasource::columnar_datasource(std::vector<double>&& x,
+                                         std::vector<double>&& y,
+                                         std::vector<mapnik::value_integer>&& ids,
+                                         std::vector<attribute_column>&& columns)
+    : mapnik::datasource(columnar_params()),
+      x_(std::move(x)),
+      y_(std::move(y)),
+      ids_(std::move(ids)),
+      columns_(std::move(columns)),
+      desc_("columnar", "utf-8")
+{
+    std::vector<index_value> values;
+    values.reserve(x_.size());
+    for (std::size_t row = 0; row < x_.size(); ++row)
+    {
+        if (std::isfinite(x_[row]) && std::isfinite(y_[row]))
+        {
+            values.emplace_back(index_point(x_[row], y_[row]), static_cast<std::uint32_t>(row));
+        }
+    }
+    // the range constructor bulk loads (packs) the tree, much faster than inserting one by one
+    index_ = spatial_index(values.begin(), values.end());
+    for (auto const& column : columns_)
+    {
+        mapnik::eAttributeType type = mapnik::String;
+        for (auto const& val : column.values)
+        {
+            if (!val.is_null())
+            {
+                type = mapnik::util::apply_visitor(attribute_type_visitor(), val);
+                break;
+            }
+        }
+        desc_.add_descriptor(mapnik::attribute_descriptor(column.name, type));
+    }
+}
+
+mapnik::datasource::datasource_t columnar_datasource::type() const
+{
+    return mapnik::datasource::Vector;
+}
+
+std::size_t columnar_datasource::size() const
+{
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    return x_.size();
+}
+
+mapnik::box2d<double> columnar_datasource::envelope() const
+{
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    if (index_.empty()) return mapnik::box2d<double>();
+    index_box bounds = index_.bounds();
+    return mapnik::box2d<double>(bounds.min_corner().get<0>(), bounds.min_corner().get<1>(),
+                                 bounds.max_corner().get<0>(), bounds.max_corner().get<1>());
+}
+
+boost::optional<mapnik::datasource_geometry_t> columnar_datasource::get_geometry_type() const
+{
+    return mapnik::datasource_geometry_t::Point;
+}
+
+mapnik::layer_descriptor columnar_datasource::get_descriptor() const
+{
+    return desc_;
+}
+
+mapnik::featureset_ptr columnar_datasource::features(mapnik::query const& q) const
+{
+    auto const& property_names = q.property_names();
+    return query_rows(q.get_bbox(), std::vector<std::string>(property_names.begin(), property_names.end()));
+}
+
+mapnik::featureset_ptr columnar_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
+{
+    std::vector<std::string> names;
+    for (auto const& column : columns_)
+    {
+        names.push_back(column.name);
+    }
+    return query_rows(mapnik::box2d<double>(pt.x - tol, pt.y - tol, pt.x + tol, pt.y + tol), names);
+}
+
+mapnik::featureset_ptr columnar_datasource::query_rows(mapnik::box2d<double> const& bbox,
+                                                       std::vector<std::string> const& names) const
+{
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::vector<attribute_column const*> selected;
+    for (auto const& name : names)
+    {
+        for (auto const& column : columns_)
+        {
+            if (column.name == name)
+            {
+                ctx->push(name);
+                selected.push_back(&column);
+                break;
+            }
+        }
+    }
+    std::vector<mapnik::feature_ptr> features;
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    index_box box(index_point(bbox.minx(), bbox.miny()), index_point(bbox.maxx(), bbox.maxy()));
+    std::vector<index_value> hits;
+    index_.query(boost::geometry::index::intersects(box), std::back_inserter(hits));
+    features.reserve(hits.size());
+    for (auto const& hit : hits)
+    {
+        std::uint32_t row = hit.second;
+        mapnik::feature_ptr feature = mapnik::feature_factory::create(ctx, ids_[row]);
+        feature->set_geometry(mapnik::geometry::geometry<double>(mapnik::geometry::point<double>(x_[row], y_[row])));
+        for (auto const* column : selected)
+        {
+            feature->put(column->name, column->values[row]);
+        }
+        features.push_back(feature);
+    }
+    return std::make_shared<rows_featureset>(std::move(features));
+}
+
+void columnar_datasource::update(std::vector<std::uint32_t> const& rows,
+                                 std::vector<double> const& x,
+                                 std::vector<double> const& y,
+                                 std::vector<attribute_column> const& columns)
+{
+    std::vector<std::pair<attribute_column*, attribute_column const*>> targets;
+    for (auto const& update : columns)
+    {
+        attribute_column* target = nullptr;
+        for (auto& column : columns_)
+        {
+            if (column.name == update.name) target = &column;
+        }
+        if (!target) throw std::runtime_error("unknown column '" + update.name + "'");
+        targets.emplace_back(target, &update);
+    }
+    // validate everything first so a bad update never leaves the datasource half modified
+    for (auto row : rows)
+    {
+        if (row >= x_.size()) throw std::runtime_error("row " + std::to_string(row) + " is out of range");
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    for (std::size_t i = 0; i < rows.size(); ++i)
+    {
+        std::uint32_t row = rows[i];
+        if (!x.empty())
+        {
+            if (std::isfinite(x_[row]) && std::isfinite(y_[row]))
+            {
+                index_.remove(index_value(index_point(x_[row], y_[row]), row));
+            }
+            x_[row] = x[i];
+            y_[row] = y[i];
+            if (std::isfinite(x_[row]) && std::isfinite(y_[row]))
+            {
+                index_.insert(index_value(index_point(x_[row], y_[row]), row));
+            }
+        }
+        for (auto const& target : targets)
+        {
+            target.first->values[row] = target.second->values[i];
+        }
+    }
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+std::uint64_t columnar_datasource::version() const
+{
+    return version_.load(std::memory_order_acquire);
+}
+
+} // namespace node_mapnik
@@ -0,0 +1,75 @@
+#pragma once
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/value.hpp>
+
+// boost
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+// stl
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace node_mapnik {
+
+struct attribute_column
+{
+    std::string name;
+    std::vector<mapnik::value> values;
+};
+
+// A point datasource backed by columns instead of features. Features are only
+// materialized for rows a query hits, with just the requested attributes, and
+// rows can be updated in place without rebuilding the whole datasource.
+class columnar_datasource : public mapnik::datasource
+{
+  public:
+    columnar_datasource(std::vector<double>&& x,
+                        std::vector<double>&& y,
+                        std::vector<mapnik::value_integer>&& ids,
+                        std::vector<attribute_column>&& columns);
+    mapnik::datasource::datasource_t type() const override;
+    mapnik::featureset_ptr features(mapnik::query const& q) const override;
+    mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const override;
+    mapnik::box2d<double> envelope() const override;
+    boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const override;
+    mapnik::layer_descriptor get_descriptor() const override;
+    std::size_t size() const;
+    // Replaces position and attributes of `rows`. `x`, `y` and every column are indexed
+    // like `rows`; columns must already exist in the datasource.
+    void update(std::vector<std::uint32_t> const& rows,
+                std::vector<double> const& x,
+                std::vector<double> const& y,
+                std::vector<attribute_column> const& columns);
+    // Bumped by every update, so wrappers caching what queries returned can tell
+    // when it went stale.
+    std::uint64_t version() const;
+
+  private:
+    using index_point = boost::geometry::model::point<double, 2, boost::geometry::cs::cartesian>;
+    using index_box = boost::geometry::model::box<index_point>;
+    using index_value = std::pair<index_point, std::uint32_t>;
+    using spatial_index = boost::geometry::index::rtree<index_value, boost::geometry::index::rstar<16>>;
+
+    mapnik::featureset_ptr query_rows(mapnik::box2d<double> const& bbox, std::vector<std::string> const& names) const;
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<mapnik::value_integer> ids_;
+    std::vector<attribute_column> columns_;
+    spatial_index index_;
+    mapnik::layer_descriptor desc_;
+    // guards against updates from JS while render threads query
+    mutable std::shared_timed_mutex mutex_;
+    std::atomic<std::uint64_t> version_{0};
+};
+
+} // namespace node_mapnik
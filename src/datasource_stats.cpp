@@ -0,0 +1,278 @@
+#include "datasource_stats.hpp"
+#include "tracing.hpp"
+#include "worker_pool.hpp"
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/envelope.hpp>
+#include <mapnik/geometry/geometry_type.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+
+namespace node_mapnik {
+
+namespace {
+
+// splitmix64 finalizer, spreads every input bit over the whole hash
+inline std::uint64_t mix(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+struct value_hash
+{
+    std::uint64_t operator()(mapnik::value_null) const { return 0; }
+    std::uint64_t operator()(mapnik::value_bool val) const { return mix(val ? 0x1b : 0x2b); }
+    std::uint64_t operator()(mapnik::value_integer val) const { return mix(static_cast<std::uint64_t>(val)); }
+    std::uint64_t operator()(mapnik::value_double val) const
+    {
+        // 1 and 1.0 are the same value
+        if (val == std::trunc(val) && std::abs(val) < 9.2e18)
+        {
+            return (*this)(static_cast<mapnik::value_integer>(val));
+        }
+        std::uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        return mix(bits ^ 0x5bd1e9955bd1e995ULL);
+    }
+    std::uint64_t operator()(mapnik::value_unicode_string const& val) const
+    {
+        // FNV-1a over the UTF-16 code units
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        UChar const* data = val.getBuffer();
+        for (std::int32_t i = 0; i < val.length(); ++i)
+        {
+            hash = (hash ^ static_cast<std::uint64_t>(data[i])) * 0x100000001b3ULL;
+        }
+        return mix(hash);
+    }
+};
+
+struct field_collector
+{
+    explicit field_collector(field_stats& stats)
+        : stats_(stats) {}
+
+    void operator()(mapnik::value_null) const { ++stats_.nulls; }
+
+    void operator()(mapnik::value_bool val) const { stats_.distinct.add(value_hash()(val)); }
+
+    void operator()(mapnik::value_integer val) const
+    {
+        number(static_cast<double>(val));
+        stats_.distinct.add(value_hash()(val));
+    }
+
+    void operator()(mapnik::value_double val) const
+    {
+        if (std::isnan(val))
+        {
+            ++stats_.nulls;
+            return;
+        }
+        number(val);
+        stats_.distinct.add(value_hash()(val));
+    }
+
+    void operator()(mapnik::value_unicode_string const& val) const
+    {
+        if (stats_.strings++ == 0)
+        {
+            stats_.min_string = val;
+            stats_.max_string = val;
+        }
+        else if (val < stats_.min_string)
+        {
+            stats_.min_string = val;
+        }
+        else if (stats_.max_string < val)
+        {
+            stats_.max_string = val;
+        }
+        stats_.distinct.add(value_hash()(val));
+    }
+
+  private:
+    void number(double val) const
+    {
+        ++stats_.numbers;
+        stats_.min = std::min(stats_.min, val);
+        stats_.max = std::max(stats_.max, val);
+    }
+
+    field_stats& stats_;
+};
+
+datasource_stats aggregate(std::vector<mapnik::feature_ptr> const& features, std::vector<std::string> const& fields)
+{
+    datasource_stats stats;
+    stats.fields.resize(fields.size());
+    for (auto const& feature : features)
+    {
+        ++stats.count;
+        auto const& geom = feature->get_geometry();
+        std::size_t type = static_cast<std::size_t>(mapnik::geometry::geometry_type(geom));
+        if (type < stats.geometry_types.size()) ++stats.geometry_types[type];
+        mapnik::box2d<double> box = mapnik::geometry::envelope(geom);
+        if (box.valid())
+        {
+            if (stats.extent.valid())
+                stats.extent.expand_to_include(box);
+            else
+                stats.extent = box;
+        }
+        for (std::size_t i = 0; i < fields.size(); ++i)
+        {
+            mapnik::util::apply_visitor(field_collector(stats.fields[i]), feature->get(fields[i]));
+        }
+    }
+    return stats;
+}
+
+} // namespace
+
+void hyperloglog::add(std::uint64_t hash)
+{
+    std::size_t index = static_cast<std::size_t>(hash >> (64 - precision));
+    std::uint64_t rest = hash << precision;
+    std::uint8_t rank = 1;
+    while (rank <= 64 - precision && !(rest & 0x8000000000000000ULL))
+    {
+        ++rank;
+        rest <<= 1;
+    }
+    if (rank > registers_[index]) registers_[index] = rank;
+}
+
+void hyperloglog::merge(hyperloglog const& other)
+{
+    for (std::size_t i = 0; i < registers_.size(); ++i)
+    {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+double hyperloglog::estimate() const
+{
+    double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    std::size_t zeros = 0;
+    for (auto reg : registers_)
+    {
+        sum += std::ldexp(1.0, -static_cast<int>(reg));
+        if (reg == 0) ++zeros;
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // linear counting is more accurate while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return std::round(estimate);
+}
+
+void field_stats::merge(field_stats const& other)
+{
+    nulls += other.nulls;
+    numbers += other.numbers;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    if (other.strings > 0)
+    {
+        if (strings == 0 || other.min_string < min_string) min_string = other.min_string;
+        if (strings == 0 || max_string < other.max_string) max_string = other.max_string;
+        strings += other.strings;
+    }
+    distinct.merge(other.distinct);
+}
+
+void datasource_stats::merge(datasource_stats const& other)
+{
+    count += other.count;
+    if (other.extent.valid())
+    {
+        if (extent.valid())
+            extent.expand_to_include(other.extent);
+        else
+            extent = other.extent;
+    }
+    for (std::size_t i = 0; i < geometry_types.size(); ++i)
+    {
+        geometry_types[i] += other.geometry_types[i];
+    }
+    for (std::size_t i = 0; i < fields.size() && i < other.fields.size(); ++i)
+    {
+        fields[i].merge(other.fields[i]);
+    }
+}
+
+datasource_stats collect_stats(mapnik::datasource_ptr const& ds, std::vector<std::string> const& fields, std::size_t sample)
+{
+    static constexpr std::size_t batch_size = 4096;
+    tracing::scope trace(tracing::category_query, "stats");
+    datasource_stats stats;
+    stats.fields.resize(fields.size());
+    // only the fields asked for are read
+    mapnik::query q(ds->envelope());
+    for (auto const& name : fields)
+    {
+        q.add_property_name(name);
+    }
+    mapnik::featureset_ptr fs = ds->features(q);
+    if (!fs || !mapnik::is_valid(fs)) return stats;
+
+    task_group group;
+    std::size_t threads = group.threads();
+    std::deque<std::future<datasource_stats>> pending;
+    std::vector<mapnik::feature_ptr> batch;
+    batch.reserve(batch_size);
+    auto flush = [&]() {
+        auto features = std::make_shared<std::vector<mapnik::feature_ptr>>(std::move(batch));
+        batch = std::vector<mapnik::feature_ptr>();
+        batch.reserve(batch_size);
+        pending.push_back(group.run([features, &fields]() { return aggregate(*features, fields); }));
+        // bounds the features held in memory to a few batches per thread
+        if (pending.size() >= threads)
+        {
+            stats.merge(group.get(pending.front()));
+            pending.pop_front();
+        }
+    };
+    std::size_t read = 0;
+    mapnik::feature_ptr feature;
+    while ((feature = fs->next()))
+    {
+        if (sample > 0 && read == sample)
+        {
+            stats.sampled = true;
+            break;
+        }
+        ++read;
+        batch.push_back(std::move(feature));
+        if (batch.size() == batch_size) flush();
+    }
+    if (!batch.empty()) flush();
+    while (!pending.empty())
+    {
+        stats.merge(group.get(pending.front()));
+        pending.pop_front();
+    }
+    return stats;
+}
+
+} // namespace node_mapnik
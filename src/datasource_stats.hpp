@@ -0,0 +1,63 @@
+#pragma once
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/value.hpp>
+
+// stl
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace node_mapnik {
+
+// HyperLogLog distinct count estimate with 2^12 registers, about 1.6% standard error
+class hyperloglog
+{
+  public:
+    static constexpr unsigned precision = 12;
+    hyperloglog()
+        : registers_(std::size_t(1) << precision, 0) {}
+    void add(std::uint64_t hash);
+    void merge(hyperloglog const& other);
+    double estimate() const;
+
+  private:
+    std::vector<std::uint8_t> registers_;
+};
+
+struct field_stats
+{
+    std::uint64_t nulls = 0;
+    // numbers and strings keep their own range, numbers win when a field has both
+    std::uint64_t numbers = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    std::uint64_t strings = 0;
+    mapnik::value_unicode_string min_string;
+    mapnik::value_unicode_string max_string;
+    hyperloglog distinct;
+    void merge(field_stats const& other);
+};
+
+struct datasource_stats
+{
+    std::uint64_t count = 0;
+    // true when the scan stopped after `sample` features
+    bool sampled = false;
+    mapnik::box2d<double> extent;
+    // indexed by mapnik::geometry::geometry_types
+    std::array<std::uint64_t, 8> geometry_types{};
+    std::vector<field_stats> fields;
+    void merge(datasource_stats const& other);
+};
+
+// Scans every feature of `ds` (only the first `sample` when non zero) for the
+// statistics of `fields`, in the order given. One thread reads the datasource
+// while batches of features are aggregated on others.
+datasource_stats collect_stats(mapnik::datasource_ptr const& ds, std::vector<std::string> const& fields, std::size_t sample);
+
+} // namespace node_mapnik
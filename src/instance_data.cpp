@@ -0,0 +1,15 @@
+#include "instance_data.hpp"
+
+namespace node_mapnik {
+
+void init_instance_data(Napi::Env env)
+{
+    env.SetInstanceData(new instance_data);
+}
+
+instance_data& instance(Napi::Env env)
+{
+    return *env.GetInstanceData<instance_data>();
+}
+
+} // namespace node_mapnik
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <napi.h>
+#include "worker_pool.hpp"
+
+namespace node_mapnik {
+
+// State of the addon that belongs to one environment: the main thread and every
+// worker_thread that loads node-mapnik get their own class constructors and
+// async work scheduling. Everything mapnik keeps process wide (registered fonts
+// and input plugins, the marker and mapped memory caches) stays shared, so the
+// threads of a process use a single copy of it.
+struct instance_data
+{
+    Napi::FunctionReference cairo_surface;
+    Napi::FunctionReference color;
+    Napi::FunctionReference datasource;
+    Napi::FunctionReference expression;
+    Napi::FunctionReference feature;
+    Napi::FunctionReference featureset;
+    Napi::FunctionReference geometry;
+    Napi::FunctionReference grid;
+    Napi::FunctionReference grid_view;
+    Napi::FunctionReference image;
+    Napi::FunctionReference image_view;
+    Napi::FunctionReference layer;
+    Napi::FunctionReference logger;
+    Napi::FunctionReference map;
+    Napi::FunctionReference palette;
+    Napi::FunctionReference projection;
+    Napi::FunctionReference proj_transform;
+    Napi::FunctionReference vector_tile;
+    scheduler sched;
+};
+
+// Attaches a new instance_data to `env`, freed when the environment shuts down
+void init_instance_data(Napi::Env env);
+instance_data& instance(Napi::Env env);
+
+} // namespace node_mapnik
@@ -7,17 +7,124 @@
 
 #include "utils.hpp"
 #include "utf8.hpp"
+#include "lazy_grid_attributes.hpp"
 
 // stl
+#include <algorithm>
 #include <cmath>    // ceil
+#include <cstddef>
 #include <stdint.h> // for uint16_t
 
+#include <cstring>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
 
 namespace node_mapnik {
 
 typedef std::unique_ptr<char[]> grid_line_type;
 
+// First value in [begin, end) that differs from `val`, or `end`. Whole blocks are
+// checked with a branch free xor/or reduction the compiler turns into vector
+// instructions, so several 64 bit grid values are compared per instruction.
+template <typename V>
+inline V const* find_different(V const* begin, V const* end, V val)
+{
+    constexpr std::ptrdiff_t block = 16;
+    while (end - begin >= block)
+    {
+        V diff = 0;
+        for (std::ptrdiff_t i = 0; i < block; ++i)
+        {
+            diff |= begin[i] ^ val;
+        }
+        if (diff != 0) break;
+        begin += block;
+    }
+    while (begin != end && *begin == val)
+    {
+        ++begin;
+    }
+    return begin;
+}
+
+// One past the last value in [begin, end) that differs from `val`, or `begin`
+template <typename V>
+inline V const* rfind_different(V const* begin, V const* end, V val)
+{
+    constexpr std::ptrdiff_t block = 16;
+    while (end - begin >= block)
+    {
+        V diff = 0;
+        for (std::ptrdiff_t i = 1; i <= block; ++i)
+        {
+            diff |= end[-i] ^ val;
+        }
+        if (diff != 0) break;
+        end -= block;
+    }
+    while (end != begin && end[-1] == val)
+    {
+        --end;
+    }
+    return end;
+}
+
+// Whether every pixel has the value of the first one, which is stored in `pixel`
+template <typename T>
+static bool grid_is_solid(T const& grid_type, typename T::value_type& pixel)
+{
+    pixel = grid_type.get_row(0)[0];
+    for (unsigned y = 0; y < grid_type.height(); ++y)
+    {
+        typename T::value_type const* row = grid_type.get_row(y);
+        if (find_different(row, row + grid_type.width(), pixel) != row + grid_type.width()) return false;
+    }
+    return true;
+}
+
+struct painted_box
+{
+    unsigned x0 = 0;
+    unsigned y0 = 0;
+    unsigned x1 = 0;
+    unsigned y1 = 0;
+};
+
+// Smallest box holding every pixel not left as background, returns false when
+// nothing was painted. x1 and y1 are exclusive.
+template <typename T>
+static bool painted_bounds(T const& grid_type, painted_box& box)
+{
+    typename T::value_type const background = mapnik::grid::base_mask;
+    unsigned width = grid_type.width();
+    bool found = false;
+    for (unsigned y = 0; y < grid_type.height(); ++y)
+    {
+        typename T::value_type const* row = grid_type.get_row(y);
+        typename T::value_type const* first = find_different(row, row + width, background);
+        if (first == row + width) continue;
+        unsigned x0 = static_cast<unsigned>(first - row);
+        unsigned x1 = static_cast<unsigned>(rfind_different(first, row + width, background) - row);
+        if (!found)
+        {
+            box.x0 = x0;
+            box.x1 = x1;
+            box.y0 = y;
+            found = true;
+        }
+        else
+        {
+            box.x0 = std::min(box.x0, x0);
+            box.x1 = std::max(box.x1, x1);
+        }
+        box.y1 = y + 1;
+    }
+    return found;
+}
+
 template <typename T>
 static void grid2utf(T const& grid_type,
                      std::vector<grid_line_type>& lines,
@@ -34,6 +141,11 @@ static void grid2utf(T const& grid_type,
     // start counting at utf8 codepoint 32, aka space character
     node_mapnik::utf8_int32_t codepoint = 32;
 
+    // runs of one feature reuse the codepoint of the previous pixel
+    bool has_previous = false;
+    typename T::value_type previous_id = 0;
+    node_mapnik::utf8_int32_t previous_cp = 0;
+
     unsigned array_size = std::ceil(grid_type.width() / static_cast<float>(resolution));
     for (unsigned y = 0; y < grid_type.height(); y = y + resolution)
     {
@@ -43,8 +155,12 @@ static void grid2utf(T const& grid_type,
         typename T::value_type const* row = grid_type.get_row(y);
         for (unsigned x = 0; x < grid_type.width(); x = x + resolution)
         {
-            // todo - this lookup is expensive
             typename T::value_type feature_id = row[x];
+            if (has_previous && feature_id == previous_id)
+            {
+                p = node_mapnik::utf8catcodepoint(p, previous_cp, 4);
+                continue;
+            }
             feature_pos = feature_keys.find(feature_id);
             if (feature_pos != feature_keys.end())
             {
@@ -69,15 +185,17 @@ static void grid2utf(T const& grid_type,
                         key_order.push_back(val);
                     }
 
-                    node_mapnik::utf8_int32_t cp = codepoint;
-                    p = node_mapnik::utf8catcodepoint(p, cp, 4);
+                    previous_cp = codepoint;
+                    p = node_mapnik::utf8catcodepoint(p, previous_cp, 4);
                     ++codepoint;
                 }
                 else
                 {
-                    node_mapnik::utf8_int32_t cp = static_cast<node_mapnik::utf8_int32_t>(key_pos->second);
-                    p = node_mapnik::utf8catcodepoint(p, cp, 4);
+                    previous_cp = static_cast<node_mapnik::utf8_int32_t>(key_pos->second);
+                    p = node_mapnik::utf8catcodepoint(p, previous_cp, 4);
                 }
+                previous_id = feature_id;
+                has_previous = true;
             }
             // else, shouldn't get here...
         }
@@ -85,12 +203,52 @@ static void grid2utf(T const& grid_type,
     }
 }
 
+// `{x, y, width, height}` of the painted pixels, or null
+template <typename T>
+static Napi::Value painted_bounds_object(Napi::Env env, T const& grid_type)
+{
+    painted_box box;
+    if (!painted_bounds(grid_type, box)) return env.Null();
+    Napi::Object bounds = Napi::Object::New(env);
+    bounds.Set("x", Napi::Number::New(env, box.x0));
+    bounds.Set("y", Napi::Number::New(env, box.y0));
+    bounds.Set("width", Napi::Number::New(env, box.x1 - box.x0));
+    bounds.Set("height", Napi::Number::New(env, box.y1 - box.y0));
+    return bounds;
+}
+
+// Converts the grid fields of one feature to a JS object, returns false when
+// the feature has none of the requested attributes
+static inline bool feature_to_object(Napi::Env env, mapnik::feature_impl const& feature,
+                                     std::set<std::string> const& attributes, Napi::Object& feat)
+{
+    bool found = false;
+    for (std::string const& attr : attributes)
+    {
+        if (attr == "__id__")
+        {
+            (feat).Set(Napi::String::New(env, attr), Napi::Number::New(env, feature.id()));
+        }
+        else if (feature.has_key(attr))
+        {
+            found = true;
+            mapnik::feature_impl::value_type const& attr_val = feature.get(attr);
+            feat.Set(attr,
+                     mapnik::util::apply_visitor(node_mapnik::value_converter(env),
+                                                 attr_val));
+        }
+    }
+    return found;
+}
+
+// `g_features` is usually `grid_type.get_grid_features()`, see `grid_features` for
+// grids rendered with `lazy_fields`
 template <typename T>
 static void write_features(Napi::Env env, T const& grid_type,
+                           typename T::feature_type const& g_features,
                            Napi::Object& feature_data,
                            std::vector<typename T::lookup_type> const& key_order)
 {
-    typename T::feature_type const& g_features = grid_type.get_grid_features();
     if (g_features.size() <= 0)
     {
         return;
@@ -110,28 +268,222 @@ static void write_features(Napi::Env env, T const& grid_type,
             continue;
         }
 
-        bool found = false;
         Napi::Object feat = Napi::Object::New(env);
-        mapnik::feature_ptr feature = feat_itr->second;
+        if (feature_to_object(env, *feat_itr->second, attributes, feat))
+        {
+            feature_data.Set(feat_itr->first, feat);
+        }
+    }
+}
+
+// Like write_features, but every feature is converted once and the same JS object
+// is shared by all the encoded tiles that reference it
+template <typename T>
+static void write_features_cached(Napi::Env env, T const& grid_type,
+                                  typename T::feature_type const& g_features,
+                                  Napi::Object& feature_data,
+                                  std::vector<typename T::lookup_type> const& key_order,
+                                  std::map<std::string, Napi::Value>& cache)
+{
+    std::set<std::string> const& attributes = grid_type.get_fields();
+    for (std::string const& key_item : key_order)
+    {
+        if (key_item.empty())
+        {
+            continue;
+        }
+        auto cached = cache.find(key_item);
+        if (cached == cache.end())
+        {
+            Napi::Value value = env.Undefined();
+            auto feat_itr = g_features.find(key_item);
+            if (feat_itr != g_features.end())
+            {
+                Napi::Object feat = Napi::Object::New(env);
+                if (feature_to_object(env, *feat_itr->second, attributes, feat)) value = feat;
+            }
+            cached = cache.emplace(key_item, value).first;
+        }
+        if (!cached->second.IsUndefined())
+        {
+            feature_data.Set(key_item, cached->second);
+        }
+    }
+}
+
+
+// Compact binary alternative to grid2utf + write_features. All integers are
+// little-endian uint32, strings are a uint32 byte length followed by UTF-8:
+//
+//   "UGB1" width height
+//   key_count  key*                          grid keys, "" for the background
+//   run_count  (length key_index)*           row-major run-length encoded cells
+//   name_count name*                         interned attribute names
+//   value_count (type payload)*              interned attribute values, type is one byte:
+//                                            0 null, 1 bool (1 byte), 2 integer (float64),
+//                                            3 double (float64), 4 string
+//   key_count times: pair_count (name_index value_index)*   attributes of every key
+namespace detail {
+
+inline void put_u32(std::string& out, std::uint32_t val)
+{
+    char bytes[4] = {static_cast<char>(val & 0xff), static_cast<char>((val >> 8) & 0xff),
+                     static_cast<char>((val >> 16) & 0xff), static_cast<char>((val >> 24) & 0xff)};
+    out.append(bytes, 4);
+}
+
+inline void put_f64(std::string& out, double val)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    put_u32(out, static_cast<std::uint32_t>(bits & 0xffffffff));
+    put_u32(out, static_cast<std::uint32_t>(bits >> 32));
+}
+
+inline void put_string(std::string& out, std::string const& str)
+{
+    put_u32(out, static_cast<std::uint32_t>(str.size()));
+    out += str;
+}
+
+struct binary_value_writer
+{
+    explicit binary_value_writer(std::string& out)
+        : out_(out) {}
+    void operator()(mapnik::value_null const&) const { out_ += '\x00'; }
+    void operator()(mapnik::value_bool val) const
+    {
+        out_ += '\x01';
+        out_ += val ? '\x01' : '\x00';
+    }
+    void operator()(mapnik::value_integer val) const
+    {
+        out_ += '\x02';
+        put_f64(out_, static_cast<double>(val));
+    }
+    void operator()(mapnik::value_double val) const
+    {
+        out_ += '\x03';
+        put_f64(out_, val);
+    }
+    void operator()(mapnik::value_unicode_string const& val) const
+    {
+        out_ += '\x04';
+        std::string utf8;
+        val.toUTF8String(utf8);
+        put_string(out_, utf8);
+    }
+    std::string& out_;
+};
+
+} // namespace detail
+
+template <typename T>
+static void grid2binary(T const& grid_type,
+                        lazy_grid_layers_ptr const& lazy_layers,
+                        unsigned int resolution,
+                        bool add_features,
+                        std::string& out)
+{
+    typename T::feature_key_type const& feature_keys = grid_type.get_feature_keys();
+    std::unordered_map<typename T::value_type, std::uint32_t> key_index;
+    std::vector<typename T::lookup_type> key_order;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> runs;
+
+    unsigned width = static_cast<unsigned>(std::ceil(grid_type.width() / static_cast<float>(resolution)));
+    unsigned height = static_cast<unsigned>(std::ceil(grid_type.height() / static_cast<float>(resolution)));
+    for (unsigned y = 0; y < grid_type.height(); y = y + resolution)
+    {
+        typename T::value_type const* row = grid_type.get_row(y);
+        for (unsigned x = 0; x < grid_type.width(); x = x + resolution)
+        {
+            typename T::value_type feature_id = row[x];
+            auto idx = key_index.find(feature_id);
+            if (idx == key_index.end())
+            {
+                auto feature_pos = feature_keys.find(feature_id);
+                if (feature_id == mapnik::grid::base_mask || feature_pos == feature_keys.end())
+                    key_order.emplace_back("");
+                else
+                    key_order.push_back(feature_pos->second);
+                idx = key_index.emplace(feature_id, static_cast<std::uint32_t>(key_order.size() - 1)).first;
+            }
+            if (!runs.empty() && runs.back().second == idx->second)
+                ++runs.back().first;
+            else
+                runs.emplace_back(1, idx->second);
+        }
+    }
+
+    out.reserve(32 + runs.size() * 8);
+    out += "UGB1";
+    detail::put_u32(out, width);
+    detail::put_u32(out, height);
+    detail::put_u32(out, static_cast<std::uint32_t>(key_order.size()));
+    for (auto const& key : key_order)
+    {
+        detail::put_string(out, key);
+    }
+    detail::put_u32(out, static_cast<std::uint32_t>(runs.size()));
+    for (auto const& run : runs)
+    {
+        detail::put_u32(out, run.first);
+        detail::put_u32(out, run.second);
+    }
+
+    // attribute names and values are interned like vector tile keys and values,
+    // values by their encoded bytes so 1, 1.0 and "1" stay distinct
+    std::map<std::string, std::uint32_t> names;
+    std::string name_table;
+    std::map<std::string, std::uint32_t> values;
+    std::string value_table;
+    std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> key_attributes(key_order.size());
+    typename T::feature_type lazy_features;
+    typename T::feature_type const& g_features = add_features ? grid_features(grid_type, lazy_layers, key_order, lazy_features)
+                                                              : grid_type.get_grid_features();
+    std::set<std::string> const& attributes = grid_type.get_fields();
+    for (std::size_t k = 0; add_features && k < key_order.size(); ++k)
+    {
+        if (key_order[k].empty()) continue;
+        auto feat_itr = g_features.find(key_order[k]);
+        if (feat_itr == g_features.end()) continue;
+        mapnik::feature_impl const& feature = *feat_itr->second;
         for (std::string const& attr : attributes)
         {
+            std::string encoded;
+            detail::binary_value_writer writer(encoded);
             if (attr == "__id__")
+                writer(static_cast<mapnik::value_integer>(feature.id()));
+            else if (feature.has_key(attr))
+                mapnik::util::apply_visitor(writer, feature.get(attr));
+            else
+                continue;
+            auto name_itr = names.find(attr);
+            if (name_itr == names.end())
             {
-                (feat).Set(Napi::String::New(env, attr), Napi::Number::New(env, feature->id()));
+                name_itr = names.emplace(attr, static_cast<std::uint32_t>(names.size())).first;
+                detail::put_string(name_table, attr);
             }
-            else if (feature->has_key(attr))
+            auto value_itr = values.find(encoded);
+            if (value_itr == values.end())
             {
-                found = true;
-                mapnik::feature_impl::value_type const& attr_val = feature->get(attr);
-                feat.Set(attr,
-                         mapnik::util::apply_visitor(node_mapnik::value_converter(env),
-                                                     attr_val));
+                value_itr = values.emplace(encoded, static_cast<std::uint32_t>(values.size())).first;
+                value_table += encoded;
             }
+            key_attributes[k].emplace_back(name_itr->second, value_itr->second);
         }
-
-        if (found)
+    }
+    detail::put_u32(out, static_cast<std::uint32_t>(names.size()));
+    out += name_table;
+    detail::put_u32(out, static_cast<std::uint32_t>(values.size()));
+    out += value_table;
+    for (auto const& pairs : key_attributes)
+    {
+        detail::put_u32(out, static_cast<std::uint32_t>(pairs.size()));
+        for (auto const& pair : pairs)
         {
-            feature_data.Set(feat_itr->first, feat);
+            detail::put_u32(out, pair.first);
+            detail::put_u32(out, pair.second);
         }
     }
 }
@@ -0,0 +1,356 @@
+#include "lazy_datasource.hpp"
+#include "worker_pool.hpp"
+
+// mapnik
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/scale_denominator.hpp>
+#include <mapnik/util/fs.hpp>
+
+// boost
+#include <boost/optional.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+// stl
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace node_mapnik {
+
+lazy_datasource::lazy_datasource(mapnik::parameters const& params)
+    : mapnik::datasource(params) {}
+
+bool lazy_datasource::initialized() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<bool>(ds_);
+}
+
+mapnik::datasource_ptr lazy_datasource::get() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) std::rethrow_exception(error_);
+    if (!ds_)
+    {
+        try
+        {
+            ds_ = mapnik::datasource_cache::instance().create(params_);
+        }
+        catch (...)
+        {
+            error_ = std::current_exception();
+            throw;
+        }
+    }
+    return ds_;
+}
+
+mapnik::datasource::datasource_t lazy_datasource::type() const
+{
+    return get()->type();
+}
+
+mapnik::processor_context_ptr lazy_datasource::get_context(mapnik::feature_style_context_map& ctx) const
+{
+    return get()->get_context(ctx);
+}
+
+mapnik::featureset_ptr lazy_datasource::features_with_context(mapnik::query const& q, mapnik::processor_context_ptr ctx) const
+{
+    return get()->features_with_context(q, ctx);
+}
+
+mapnik::featureset_ptr lazy_datasource::features(mapnik::query const& q) const
+{
+    return get()->features(q);
+}
+
+mapnik::featureset_ptr lazy_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
+{
+    return get()->features_at_point(pt, tol);
+}
+
+mapnik::box2d<double> lazy_datasource::envelope() const
+{
+    return get()->envelope();
+}
+
+boost::optional<mapnik::datasource_geometry_t> lazy_datasource::get_geometry_type() const
+{
+    return get()->get_geometry_type();
+}
+
+mapnik::layer_descriptor lazy_datasource::get_descriptor() const
+{
+    return get()->get_descriptor();
+}
+
+namespace {
+
+using ptree = boost::property_tree::ptree;
+
+mapnik::parameters datasource_parameters(ptree const& node, std::map<std::string, mapnik::parameters> const& templates)
+{
+    mapnik::parameters params;
+    boost::optional<std::string> base = node.get_optional<std::string>("<xmlattr>.base");
+    if (base)
+    {
+        auto itr = templates.find(*base);
+        if (itr != templates.end()) params = itr->second;
+    }
+    for (auto const& child : node)
+    {
+        if (child.first == "Parameter")
+        {
+            params[child.second.get<std::string>("<xmlattr>.name")] = child.second.data();
+        }
+    }
+    return params;
+}
+
+// Layers of the map itself are made lazy: their parent is the Map or an Include
+// in it. Nested layers are children of a layer and keep their datasources.
+bool is_layer_parent(std::string const& name)
+{
+    return name == "Map" || name == "Include";
+}
+
+// Collects the datasource parameters of every layer of the map, in document order
+void collect_datasources(ptree const& parent,
+                         std::map<std::string, mapnik::parameters>& templates,
+                         std::vector<boost::optional<mapnik::parameters>>& layers)
+{
+    for (auto const& child : parent)
+    {
+        if (child.first == "Datasource")
+        {
+            boost::optional<std::string> name = child.second.get_optional<std::string>("<xmlattr>.name");
+            if (name) templates[*name] = datasource_parameters(child.second, templates);
+        }
+        else if (child.first == "Layer")
+        {
+            boost::optional<mapnik::parameters> params;
+            auto ds_node = child.second.get_child_optional("Datasource");
+            if (ds_node) params = datasource_parameters(*ds_node, templates);
+            layers.push_back(params);
+        }
+        else if (child.first == "Include")
+        {
+            collect_datasources(child.second, templates, layers);
+        }
+    }
+}
+
+// End of the tag starting at `pos`, skipping '>' in quoted attribute values
+std::size_t tag_end(std::string const& xml, std::size_t pos)
+{
+    char quote = '\0';
+    for (; pos < xml.size(); ++pos)
+    {
+        char c = xml[pos];
+        if (quote)
+        {
+            if (c == quote) quote = '\0';
+        }
+        else if (c == '"' || c == '\'')
+        {
+            quote = c;
+        }
+        else if (c == '>')
+        {
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+// Removes the Datasource elements of the layers collect_datasources collects
+// from the stylesheet text, so mapnik does not open them while parsing. The
+// rest of the document is kept byte for byte: a round trip through a property
+// tree would reorder mixed content such as the text and Format children of a
+// TextSymbolizer.
+std::string strip_layer_datasources(std::string const& xml)
+{
+    std::string out;
+    out.reserve(xml.size());
+    std::size_t copied = 0;
+    std::size_t ds_start = std::string::npos;
+    // names of the open elements, the innermost last
+    std::vector<std::string> open;
+    auto in_map_layer = [&open]() {
+        std::size_t depth = open.size();
+        return depth >= 2 && open[depth - 1] == "Layer" && is_layer_parent(open[depth - 2]);
+    };
+    std::size_t pos = 0;
+    while ((pos = xml.find('<', pos)) != std::string::npos)
+    {
+        if (xml.compare(pos, 4, "<!--") == 0)
+        {
+            pos = xml.find("-->", pos + 4);
+            if (pos == std::string::npos) break;
+            pos += 3;
+            continue;
+        }
+        if (xml.compare(pos, 9, "<![CDATA[") == 0)
+        {
+            pos = xml.find("]]>", pos + 9);
+            if (pos == std::string::npos) break;
+            pos += 3;
+            continue;
+        }
+        std::size_t end = tag_end(xml, pos);
+        if (end == std::string::npos) break;
+        bool closing = xml[pos + 1] == '/';
+        bool self_closing = xml[end - 1] == '/';
+        std::size_t name_start = closing ? pos + 2 : pos + 1;
+        std::size_t name_end = xml.find_first_of(" \t\r\n/>", name_start);
+        std::string name = xml.substr(name_start, name_end - name_start);
+        bool declaration = xml[pos + 1] == '?' || xml[pos + 1] == '!';
+        if (closing && !open.empty()) open.pop_back();
+        if (name == "Datasource" && !declaration)
+        {
+            if (!closing && in_map_layer())
+            {
+                if (self_closing)
+                {
+                    out.append(xml, copied, pos - copied);
+                    copied = end + 1;
+                }
+                else
+                {
+                    ds_start = pos;
+                }
+            }
+            else if (closing && ds_start != std::string::npos && in_map_layer())
+            {
+                out.append(xml, copied, ds_start - copied);
+                copied = end + 1;
+                ds_start = std::string::npos;
+            }
+        }
+        if (!closing && !self_closing && !declaration) open.push_back(name);
+        pos = end + 1;
+    }
+    out.append(xml, copied, std::string::npos);
+    return out;
+}
+
+std::string directory_of(std::string const& filename)
+{
+    auto pos = filename.find_last_of('/');
+    if (pos == std::string::npos) return ".";
+    if (pos == 0) return "/";
+    return filename.substr(0, pos);
+}
+
+void resolve_path(mapnik::parameters& params, std::string const& key, std::string const& base_dir)
+{
+    boost::optional<std::string> path = params.get<std::string>(key);
+    if (path && path->find("://") == std::string::npos && mapnik::util::is_relative(*path))
+    {
+        params[key] = mapnik::util::make_relative(*path, base_dir + "/");
+    }
+}
+
+} // namespace
+
+void load_map_lazy(mapnik::Map& map, std::string const& filename, bool strict, std::string const& base_path)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open stylesheet '" + filename + "'");
+    }
+    std::string xml((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // stylesheets relying on entities or XInclude need mapnik's libxml2 based loader
+    if (xml.find("<!ENTITY") != std::string::npos || xml.find("XInclude") != std::string::npos)
+    {
+        mapnik::load_map(map, filename, strict, base_path);
+        return;
+    }
+
+    ptree tree;
+    std::istringstream in(xml);
+    boost::property_tree::read_xml(in, tree);
+    auto map_node = tree.get_child_optional("Map");
+    if (!map_node)
+    {
+        // let mapnik report what is wrong with this stylesheet
+        mapnik::load_map(map, filename, strict, base_path);
+        return;
+    }
+    std::map<std::string, mapnik::parameters> templates;
+    std::vector<boost::optional<mapnik::parameters>> layer_params;
+    collect_datasources(*map_node, templates, layer_params);
+
+    std::string base_dir = base_path.empty() ? directory_of(filename) : base_path;
+    bool paths_from_xml = map_node->get<std::string>("<xmlattr>.paths-from-xml", "true") != "false";
+    std::size_t first_layer = map.layers().size();
+    mapnik::load_map_string(map, strip_layer_datasources(xml), strict, base_dir);
+
+    std::vector<mapnik::layer>& layers = map.layers();
+    if (layers.size() - first_layer != layer_params.size())
+    {
+        throw std::runtime_error("lazy_datasources: could not match datasources to the layers of '" + filename + "'");
+    }
+    for (std::size_t i = 0; i < layer_params.size(); ++i)
+    {
+        if (!layer_params[i]) continue;
+        mapnik::parameters params = *layer_params[i];
+        if (paths_from_xml)
+        {
+            // same precedence as mapnik: 'base' wins over 'file'
+            if (params.get<std::string>("base"))
+                resolve_path(params, "base", base_dir);
+            else
+                resolve_path(params, "file", base_dir);
+        }
+        layers[first_layer + i].set_datasource(std::make_shared<lazy_datasource>(params));
+    }
+}
+
+void initialize_lazy_datasources(mapnik::Map const& map, double scale_denominator, double scale_factor)
+{
+    if (scale_denominator <= 0.0)
+    {
+        mapnik::projection proj(map.srs(), true);
+        scale_denominator = mapnik::scale_denominator(map.scale(), proj.is_geographic());
+    }
+    scale_denominator *= scale_factor;
+    std::vector<lazy_datasource const*> pending;
+    for (auto const& layer : map.layers())
+    {
+        if (!layer.active() || !layer.visible(scale_denominator)) continue;
+        auto const* lazy = dynamic_cast<lazy_datasource const*>(layer.datasource().get());
+        if (lazy && !lazy->initialized()) pending.push_back(lazy);
+    }
+    // a single pending datasource is simply created by the renderer
+    if (pending.size() < 2) return;
+    std::size_t threads = std::min(task_threads(), pending.size());
+    parallel_for(threads, [&pending, threads](std::size_t t) {
+        for (std::size_t i = t; i < pending.size(); i += threads)
+        {
+            try
+            {
+                pending[i]->get();
+            }
+            catch (std::exception const&)
+            {
+                // the render calls get() again and reports the same error
+            }
+        }
+    });
+}
+
+} // namespace node_mapnik
@@ -0,0 +1,53 @@
+#pragma once
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/params.hpp>
+
+// stl
+#include <exception>
+#include <mutex>
+#include <string>
+
+namespace mapnik {
+class Map;
+}
+
+namespace node_mapnik {
+
+// Stands in for a layer datasource until something first needs it, then creates
+// the real datasource from the stored parameters and forwards every call to it.
+class lazy_datasource : public mapnik::datasource
+{
+  public:
+    explicit lazy_datasource(mapnik::parameters const& params);
+    mapnik::datasource::datasource_t type() const override;
+    mapnik::processor_context_ptr get_context(mapnik::feature_style_context_map& ctx) const override;
+    mapnik::featureset_ptr features_with_context(mapnik::query const& q, mapnik::processor_context_ptr ctx) const override;
+    mapnik::featureset_ptr features(mapnik::query const& q) const override;
+    mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const override;
+    mapnik::box2d<double> envelope() const override;
+    boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const override;
+    mapnik::layer_descriptor get_descriptor() const override;
+    bool initialized() const;
+    // Creates the wrapped datasource on first call. A failed creation throws, and
+    // every later call throws the same error rather than trying again.
+    mapnik::datasource_ptr get() const;
+
+  private:
+    mutable std::mutex mutex_;
+    mutable mapnik::datasource_ptr ds_;
+    mutable std::exception_ptr error_;
+};
+
+// Like mapnik::load_map, but layer datasources are lazy_datasource instances
+// instead of being opened while the stylesheet is parsed.
+void load_map_lazy(mapnik::Map& map, std::string const& filename, bool strict, std::string const& base_path);
+
+// Creates the pending lazy datasources of every layer visible at this scale
+// concurrently, so a first render does not open them one after the other. Off
+// the worker pool (sync renders) they would be created one at a time anyway,
+// so sync renders leave that to the renderer.
+void initialize_lazy_datasources(mapnik::Map const& map, double scale_denominator, double scale_factor);
+
+} // namespace node_mapnik
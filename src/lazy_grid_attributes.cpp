@@ -0,0 +1,149 @@
+#if defined(GRID_RENDERER)
+
+#include "lazy_grid_attributes.hpp"
+
+// mapnik
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/util/conversions.hpp>
+
+// stl
+#include <algorithm>
+
+namespace node_mapnik {
+
+lazy_grid_attributes::lazy_grid_attributes(mapnik::datasource_ptr const& ds,
+                                           mapnik::box2d<double> const& query_extent,
+                                           std::string const& key,
+                                           std::set<std::string> const& fields)
+    : ds_(ds),
+      query_extent_(query_extent),
+      key_(key),
+      ctx_(std::make_shared<mapnik::context_type>())
+{
+    for (auto const& name : fields)
+    {
+        if (name != "__id__") fields_.push_back(name);
+    }
+}
+
+std::string lazy_grid_attributes::lookup_key(mapnik::feature_impl const& feature) const
+{
+    // must match the lookup value mapnik's hit_grid computes for the feature
+    std::string lookup;
+    if (key_ == "__id__")
+    {
+        mapnik::util::to_string(lookup, feature.id());
+    }
+    else if (feature.has_key(key_))
+    {
+        lookup = feature.get(key_).to_string();
+    }
+    return lookup;
+}
+
+mapnik::value lazy_grid_attributes::intern(mapnik::value const& val)
+{
+    if (!val.is<mapnik::value_unicode_string>()) return val;
+    mapnik::value_unicode_string const& str = val.get<mapnik::value_unicode_string>();
+    auto itr = strings_.find(str);
+    if (itr == strings_.end())
+    {
+        itr = strings_.emplace(str, val).first;
+    }
+    return itr->second;
+}
+
+void lazy_grid_attributes::resolve(std::vector<std::string> const& keys, mapnik::grid::feature_type& features)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::set<std::string> wanted;
+    for (auto const& key : keys)
+    {
+        if (!key.empty() && requested_.insert(key).second) wanted.insert(key);
+    }
+    if (!wanted.empty() && ds_)
+    {
+        mapnik::query q(query_extent_);
+        for (auto const& name : fields_)
+        {
+            q.add_property_name(name);
+        }
+        if (key_ != "__id__") q.add_property_name(key_);
+        mapnik::featureset_ptr fs = ds_->features(q);
+        mapnik::feature_ptr feature;
+        while (fs && !wanted.empty() && (feature = fs->next()))
+        {
+            auto itr = wanted.find(lookup_key(*feature));
+            if (itr == wanted.end()) continue;
+            if (ctx_->size() == 0)
+            {
+                // like hit_grid, only fields the datasource actually has become attributes
+                for (auto const& name : fields_)
+                {
+                    if (feature->has_key(name)) ctx_->push(name);
+                }
+            }
+            mapnik::feature_ptr copy = mapnik::feature_factory::create(ctx_, feature->id());
+            for (auto const& name : fields_)
+            {
+                if (copy->has_key(name) && feature->has_key(name))
+                {
+                    copy->put(name, intern(feature->get(name)));
+                }
+            }
+            resolved_.emplace(*itr, copy);
+            wanted.erase(itr);
+        }
+    }
+    for (auto const& key : keys)
+    {
+        auto itr = resolved_.find(key);
+        if (itr != resolved_.end()) features.insert(*itr);
+    }
+}
+
+lazy_grid_layers_ptr with_lazy_layer(lazy_grid_layers_ptr const& layers,
+                                     std::string const& layer,
+                                     std::shared_ptr<lazy_grid_attributes> const& attributes)
+{
+    if (!attributes && (!layers || layers->count(layer) == 0)) return layers;
+    auto copy = layers ? std::make_shared<lazy_grid_layers>(*layers) : std::make_shared<lazy_grid_layers>();
+    if (attributes)
+        (*copy)[layer] = attributes;
+    else
+        copy->erase(layer);
+    if (copy->empty()) return nullptr;
+    return copy;
+}
+
+mapnik::grid::feature_type const& grid_features(mapnik::grid const& grid,
+                                                lazy_grid_layers_ptr const& layers,
+                                                std::vector<std::string> const& keys,
+                                                mapnik::grid::feature_type& storage)
+{
+    if (!layers) return grid.get_grid_features();
+    // a lazy layer only left the key in the grid's own features, so the layers
+    // are asked first and the grid's features fill in the other keys
+    std::vector<std::string> missing(keys);
+    for (auto const& layer : *layers)
+    {
+        if (missing.empty()) break;
+        layer.second->resolve(missing, storage);
+        missing.erase(std::remove_if(missing.begin(), missing.end(),
+                                     [&storage](std::string const& key) { return storage.count(key) > 0; }),
+                      missing.end());
+    }
+    mapnik::grid::feature_type const& own = grid.get_grid_features();
+    for (auto const& key : missing)
+    {
+        auto itr = own.find(key);
+        if (itr != own.end()) storage.insert(*itr);
+    }
+    return storage;
+}
+
+} // namespace node_mapnik
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#if defined(GRID_RENDERER)
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/grid/grid.hpp>
+#include <mapnik/value.hpp>
+
+// stl
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace node_mapnik {
+
+// Attributes of a grid rendered with `lazy_fields`. Rasterization then only reads
+// the grid key, so the grid keeps nothing but feature ids; attributes are fetched
+// from the layer datasource at encode time for the keys that survived `resolution`
+// sampling. All fetched features share one context for the field names and equal
+// string values share one buffer.
+class lazy_grid_attributes
+{
+  public:
+    lazy_grid_attributes(mapnik::datasource_ptr const& ds,
+                         mapnik::box2d<double> const& query_extent,
+                         std::string const& key,
+                         std::set<std::string> const& fields);
+    // Adds the features of `keys` to `features`. The datasource is only queried for
+    // keys no earlier call has asked for.
+    void resolve(std::vector<std::string> const& keys, mapnik::grid::feature_type& features);
+
+  private:
+    std::string lookup_key(mapnik::feature_impl const& feature) const;
+    mapnik::value intern(mapnik::value const& val);
+
+    mapnik::datasource_ptr ds_;
+    mapnik::box2d<double> query_extent_;
+    std::string key_;
+    std::vector<std::string> fields_;
+    mapnik::context_ptr ctx_;
+    std::mutex mutex_;
+    mapnik::grid::feature_type resolved_;
+    std::set<std::string> requested_;
+    std::map<mapnik::value_unicode_string, mapnik::value> strings_;
+};
+
+// The resolvers of the layers a grid was rendered with `lazy_fields`, by layer
+// name. Held by the Grid and GridView wrappers; a set is never modified once
+// shared, so an encoder keeps a consistent one while another render adds a layer.
+using lazy_grid_layers = std::map<std::string, std::shared_ptr<lazy_grid_attributes>>;
+using lazy_grid_layers_ptr = std::shared_ptr<lazy_grid_layers const>;
+
+// A copy of `layers` where `layer` resolves through `attributes`, or no longer
+// does when `attributes` is null
+lazy_grid_layers_ptr with_lazy_layer(lazy_grid_layers_ptr const& layers,
+                                     std::string const& layer,
+                                     std::shared_ptr<lazy_grid_attributes> const& attributes);
+
+// The features holding the attributes of `keys`: the grid's own, or for grids
+// with lazy layers the ones these layers fetch, collected in `storage`
+mapnik::grid::feature_type const& grid_features(mapnik::grid const& grid,
+                                                lazy_grid_layers_ptr const& layers,
+                                                std::vector<std::string> const& keys,
+                                                mapnik::grid::feature_type& storage);
+
+} // namespace node_mapnik
+
+#endif
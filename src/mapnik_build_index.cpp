@@ -0,0 +1,908 @@
+#include "mapnik_build_index.hpp"
+#include "worker_pool.hpp"
+
+// mapnik
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/geometry/envelope.hpp>
+#include <mapnik/json/extract_bounding_boxes_x3.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/quad_tree.hpp>
+#include <mapnik/wkt/wkt_factory.hpp>
+
+// stl
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace node_mapnik {
+
+namespace detail {
+
+enum index_type
+{
+    index_auto,
+    index_shape,
+    index_csv,
+    index_geojson
+};
+
+struct index_options
+{
+    index_type type = index_auto;
+    unsigned depth = 8;
+    double ratio = 0.55;
+    bool index_parts = false;
+    char separator = 0; // detected from the header line when 0
+    char quote = '"';
+    std::string headers;
+};
+
+struct index_result
+{
+    std::string file;
+    std::string index_file;
+    std::uint64_t features = 0;
+    std::string error;
+};
+
+// sent to the main thread every time a file is done
+struct index_progress
+{
+    std::size_t file = 0;
+};
+
+namespace {
+
+// Same layout as the items the shape plugin reads back from its index
+// (mapnik::detail::node, which is private to the plugin)
+struct shape_index_item
+{
+    shape_index_item() = default;
+    shape_index_item(int offset_, int start_, int end_, mapnik::box2d<double> const& box_)
+        : offset(offset_),
+          start(start_),
+          end(end_),
+          box(box_) {}
+    int offset = 0;
+    int start = 0;
+    int end = 0;
+    mapnik::box2d<double> box;
+};
+
+// position and size of a feature in a csv or GeoJSON file
+using range_index_item = std::pair<std::uint64_t, std::uint64_t>;
+
+enum shape_type
+{
+    shape_null = 0,
+    shape_point = 1,
+    shape_polyline = 3,
+    shape_polygon = 5,
+    shape_pointz = 11,
+    shape_polylinez = 13,
+    shape_polygonz = 15,
+    shape_pointm = 21,
+    shape_polylinem = 23,
+    shape_polygonm = 25
+};
+
+inline std::int32_t read_xdr_integer(char const* data)
+{
+    auto const* b = reinterpret_cast<unsigned char const*>(data);
+    return static_cast<std::int32_t>((std::uint32_t(b[0]) << 24) | (std::uint32_t(b[1]) << 16) |
+                                     (std::uint32_t(b[2]) << 8) | std::uint32_t(b[3]));
+}
+
+inline std::int32_t read_ndr_integer(char const* data)
+{
+    auto const* b = reinterpret_cast<unsigned char const*>(data);
+    return static_cast<std::int32_t>((std::uint32_t(b[3]) << 24) | (std::uint32_t(b[2]) << 16) |
+                                     (std::uint32_t(b[1]) << 8) | std::uint32_t(b[0]));
+}
+
+inline double read_double(char const* data)
+{
+    auto const* b = reinterpret_cast<unsigned char const*>(data);
+    std::uint64_t bits = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        bits = (bits << 8) | b[i];
+    }
+    double val;
+    std::memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+inline mapnik::box2d<double> read_envelope(char const* data)
+{
+    return mapnik::box2d<double>(read_double(data), read_double(data + 8),
+                                 read_double(data + 16), read_double(data + 24));
+}
+
+bool has_extension(std::string const& path, char const* ext)
+{
+    std::size_t len = std::strlen(ext);
+    if (path.size() < len) return false;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(path[path.size() - len + i])) != ext[i]) return false;
+    }
+    return true;
+}
+
+bool file_exists(std::string const& path)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    return file.good();
+}
+
+std::string read_file(std::string const& path)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) throw std::runtime_error("could not open '" + path + "'");
+    file.seekg(0, std::ios::end);
+    std::string data(static_cast<std::size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    if (!data.empty()) file.read(&data[0], static_cast<std::streamsize>(data.size()));
+    if (!file) throw std::runtime_error("could not read '" + path + "'");
+    return data;
+}
+
+template <typename T>
+void write_index(mapnik::quad_tree<T>& tree, std::string const& index_file)
+{
+    tree.trim();
+    std::string tmp = index_file + ".tmp";
+    bool ok = false;
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (out)
+        {
+            tree.write(out);
+            out.close();
+            ok = !out.fail();
+        }
+    }
+    // replace the index in one step so a datasource opened meanwhile never sees half of it
+    if (!ok || std::rename(tmp.c_str(), index_file.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("could not write index '" + index_file + "'");
+    }
+}
+
+// Same records and tree as mapnik's shapeindex: one item per shape (or per part
+// with `index_parts`) holding the byte offset of the record in the .shp
+std::uint64_t build_shape_index(std::string const& path, index_options const& options, std::string& index_file)
+{
+    std::string base = path;
+    if (has_extension(base, ".shp") || has_extension(base, ".shx") || has_extension(base, ".dbf"))
+    {
+        base = base.substr(0, base.size() - 4);
+    }
+    std::string shx = read_file(base + ".shx");
+    if (shx.size() < 100 || read_xdr_integer(shx.data()) != 9994)
+    {
+        throw std::runtime_error("'" + base + ".shx' is not a shape index file");
+    }
+    std::ifstream shp((base + ".shp").c_str(), std::ios::in | std::ios::binary);
+    if (!shp) throw std::runtime_error("could not open '" + base + ".shp'");
+
+    std::size_t file_length = std::min(static_cast<std::size_t>(read_xdr_integer(shx.data() + 24)) * 2, shx.size());
+    mapnik::box2d<double> extent = read_envelope(shx.data() + 36);
+    mapnik::quad_tree<shape_index_item> tree(extent, options.depth, options.ratio);
+    std::uint64_t count = 0;
+    if (read_ndr_integer(shx.data() + 32) != shape_null)
+    {
+        std::vector<char> record;
+        for (std::size_t pos = 100; pos + 8 <= file_length; pos += 8)
+        {
+            std::int32_t offset = read_xdr_integer(shx.data() + pos);
+            std::int32_t content_length = read_xdr_integer(shx.data() + pos + 4);
+            std::size_t content_bytes = static_cast<std::size_t>(std::max(content_length, 0)) * 2;
+            // record header, shape type and envelope (or point coordinates)
+            std::size_t head_bytes = 8 + std::min<std::size_t>(content_bytes, 36);
+            record.resize(head_bytes);
+            shp.seekg(static_cast<std::streamoff>(offset) * 2);
+            if (!shp.read(record.data(), static_cast<std::streamsize>(head_bytes)) ||
+                read_xdr_integer(record.data() + 4) != content_length)
+            {
+                throw std::runtime_error("'" + base + ".shp' does not match its .shx at record " +
+                                         std::to_string((pos - 100) / 8 + 1));
+            }
+            if (content_bytes < 4) continue;
+            int type = read_ndr_integer(record.data() + 8);
+            if (type == shape_null) continue;
+            if (type == shape_point || type == shape_pointm || type == shape_pointz)
+            {
+                if (content_bytes < 20) continue;
+                double x = read_double(record.data() + 12);
+                double y = read_double(record.data() + 20);
+                mapnik::box2d<double> item_ext(x, y, x, y);
+                tree.insert(shape_index_item(offset * 2, -1, 0, item_ext), item_ext);
+                ++count;
+                continue;
+            }
+            if (content_bytes < 36) continue;
+            bool parts = options.index_parts &&
+                         (type == shape_polygon || type == shape_polygonm || type == shape_polygonz ||
+                          type == shape_polyline || type == shape_polylinem || type == shape_polylinez);
+            if (!parts)
+            {
+                mapnik::box2d<double> item_ext = read_envelope(record.data() + 12);
+                if (item_ext.valid())
+                {
+                    tree.insert(shape_index_item(offset * 2, -1, 0, item_ext), item_ext);
+                    ++count;
+                }
+                continue;
+            }
+            record.resize(8 + content_bytes);
+            if (!shp.read(record.data() + head_bytes, static_cast<std::streamsize>(content_bytes + 8 - head_bytes)))
+            {
+                throw std::runtime_error("'" + base + ".shp' is truncated");
+            }
+            char const* content = record.data() + 8;
+            int num_parts = read_ndr_integer(content + 36);
+            int num_points = read_ndr_integer(content + 40);
+            std::size_t points_at = 44 + static_cast<std::size_t>(std::max(num_parts, 0)) * 4;
+            if (num_parts < 0 || num_points < 0 ||
+                points_at + static_cast<std::size_t>(num_points) * 16 > content_bytes)
+            {
+                throw std::runtime_error("'" + base + ".shp' has an invalid record at offset " +
+                                         std::to_string(offset * 2));
+            }
+            for (int k = 0; k < num_parts; ++k)
+            {
+                int start = read_ndr_integer(content + 44 + k * 4);
+                int end = (k == num_parts - 1) ? num_points : read_ndr_integer(content + 48 + k * 4);
+                start = std::max(0, std::min(start, num_points));
+                end = std::max(start, std::min(end, num_points));
+                mapnik::box2d<double> item_ext;
+                for (int j = start; j < end; ++j)
+                {
+                    double x = read_double(content + points_at + j * 16);
+                    double y = read_double(content + points_at + j * 16 + 8);
+                    if (j == start)
+                        item_ext.init(x, y, x, y);
+                    else
+                        item_ext.expand_to_include(x, y);
+                }
+                if (item_ext.valid())
+                {
+                    tree.insert(shape_index_item(offset * 2, start, end, item_ext), item_ext);
+                    ++count;
+                }
+            }
+        }
+    }
+    if (count > 0)
+    {
+        index_file = base + ".index";
+        write_index(tree, index_file);
+    }
+    return count;
+}
+
+template <typename Items>
+std::uint64_t write_range_index(Items const& items, index_options const& options,
+                                std::string const& path, std::string& index_file)
+{
+    mapnik::box2d<double> extent;
+    for (auto const& item : items)
+    {
+        if (!extent.valid())
+            extent = item.first;
+        else
+            extent.expand_to_include(item.first);
+    }
+    if (items.empty()) return 0;
+    mapnik::quad_tree<range_index_item> tree(extent, options.depth, options.ratio);
+    for (auto const& item : items)
+    {
+        tree.insert(item.second, item.first);
+    }
+    index_file = path + ".index";
+    write_index(tree, index_file);
+    return items.size();
+}
+
+// Same records as mapnik-index: the features of the top level collection,
+// with the bounding boxes the GeoJSON plugin uses for its own in-memory index
+std::uint64_t build_geojson_index(std::string const& path, index_options const& options, std::string& index_file)
+{
+    std::string json = read_file(path);
+    using boxes_type = std::vector<std::pair<mapnik::box2d<float>, range_index_item>>;
+    boxes_type boxes;
+    char const* start = json.data();
+    char const* end = start + json.size();
+    mapnik::json::extract_bounding_boxes(start, end, boxes);
+    std::vector<std::pair<mapnik::box2d<double>, range_index_item>> items;
+    items.reserve(boxes.size());
+    for (auto const& box : boxes)
+    {
+        if (!box.first.valid()) continue;
+        items.emplace_back(mapnik::box2d<double>(box.first.minx(), box.first.miny(),
+                                                 box.first.maxx(), box.first.maxy()),
+                           box.second);
+    }
+    return write_range_index(items, options, path, index_file);
+}
+
+// Finds the next record from `pos`: a line ends at \n, \r\n or \r outside of quotes
+bool next_csv_record(std::string const& data, std::size_t& pos, char quote, std::size_t& start, std::size_t& size)
+{
+    if (pos >= data.size()) return false;
+    start = pos;
+    bool quoted = false;
+    for (; pos < data.size(); ++pos)
+    {
+        char c = data[pos];
+        if (c == quote)
+        {
+            quoted = !quoted;
+        }
+        else if (!quoted && (c == '\n' || c == '\r'))
+        {
+            size = pos - start;
+            ++pos;
+            if (c == '\r' && pos < data.size() && data[pos] == '\n') ++pos;
+            return true;
+        }
+    }
+    size = pos - start;
+    return true;
+}
+
+std::vector<std::string> split_csv_record(char const* begin, char const* end, char separator, char quote)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (char const* itr = begin; itr != end; ++itr)
+    {
+        char c = *itr;
+        if (quoted)
+        {
+            if (c != quote)
+            {
+                field += c;
+            }
+            else if (itr + 1 != end && *(itr + 1) == quote)
+            {
+                field += quote;
+                ++itr;
+            }
+            else
+            {
+                quoted = false;
+            }
+        }
+        else if (c == quote)
+        {
+            quoted = true;
+        }
+        else if (c == separator)
+        {
+            fields.push_back(std::move(field));
+            field.clear();
+        }
+        else
+        {
+            field += c;
+        }
+    }
+    fields.push_back(std::move(field));
+    return fields;
+}
+
+// the most frequent of the separators the csv plugin detects
+char detect_separator(char const* begin, char const* end, char quote)
+{
+    char const candidates[] = {',', '\t', '|', ';'};
+    std::size_t counts[] = {0, 0, 0, 0};
+    bool quoted = false;
+    for (char const* itr = begin; itr != end; ++itr)
+    {
+        if (*itr == quote) quoted = !quoted;
+        if (quoted) continue;
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            if (*itr == candidates[k]) ++counts[k];
+        }
+    }
+    std::size_t best = 0;
+    for (std::size_t k = 1; k < 4; ++k)
+    {
+        if (counts[k] > counts[best]) best = k;
+    }
+    return candidates[best];
+}
+
+std::string trim(std::string const& str)
+{
+    std::size_t first = str.find_first_not_of(" \t");
+    if (first == std::string::npos) return std::string();
+    return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool parse_coordinate(std::string const& str, double& val)
+{
+    std::string text = trim(str);
+    if (text.empty()) return false;
+    char* end = nullptr;
+    val = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size();
+}
+
+// Same records as mapnik-index: every data line with a geometry, located with
+// the header names the csv plugin recognises
+std::uint64_t build_csv_index(std::string const& path, index_options const& options, std::string& index_file)
+{
+    std::string data = read_file(path);
+    std::size_t pos = 0;
+    if (data.compare(0, 3, "\xEF\xBB\xBF") == 0) pos = 3;
+
+    std::size_t start = 0;
+    std::size_t size = 0;
+    std::string header = options.headers;
+    if (header.empty())
+    {
+        while (header.empty() && next_csv_record(data, pos, options.quote, start, size))
+        {
+            header = trim(data.substr(start, size));
+        }
+        if (header.empty()) return 0;
+    }
+    char separator = options.separator ? options.separator
+                                       : detect_separator(header.data(), header.data() + header.size(), options.quote);
+
+    enum
+    {
+        geometry_none,
+        geometry_wkt,
+        geometry_geojson,
+        geometry_lonlat
+    } geometry = geometry_none;
+    std::size_t geometry_column = 0;
+    std::size_t lon_column = 0;
+    std::size_t lat_column = 0;
+    bool has_lon = false;
+    bool has_lat = false;
+    auto names = split_csv_record(header.data(), header.data() + header.size(), separator, options.quote);
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        std::string name = trim(names[i]);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (name == "wkt")
+        {
+            geometry = geometry_wkt;
+            geometry_column = i;
+        }
+        else if (name == "geojson")
+        {
+            geometry = geometry_geojson;
+            geometry_column = i;
+        }
+        else if (name == "x" || name == "lon" || name == "lng" || name == "long" || name == "longitude")
+        {
+            has_lon = true;
+            lon_column = i;
+        }
+        else if (name == "y" || name == "lat" || name == "latitude")
+        {
+            has_lat = true;
+            lat_column = i;
+        }
+    }
+    if (geometry == geometry_none && has_lon && has_lat) geometry = geometry_lonlat;
+    if (geometry == geometry_none)
+    {
+        throw std::runtime_error("could not detect a geometry column in '" + path +
+                                 "', expected a wkt, geojson or lon/lat header");
+    }
+
+    std::vector<std::pair<mapnik::box2d<double>, range_index_item>> items;
+    while (next_csv_record(data, pos, options.quote, start, size))
+    {
+        char const* begin = data.data() + start;
+        char const* end = begin + size;
+        if (std::all_of(begin, end, [](char c) { return c == ' ' || c == '\t'; })) continue;
+        auto fields = split_csv_record(begin, end, separator, options.quote);
+        mapnik::box2d<double> box;
+        if (geometry == geometry_lonlat)
+        {
+            double x = 0;
+            double y = 0;
+            if (lon_column < fields.size() && lat_column < fields.size() &&
+                parse_coordinate(fields[lon_column], x) && parse_coordinate(fields[lat_column], y))
+            {
+                box.init(x, y, x, y);
+            }
+        }
+        else if (geometry_column < fields.size())
+        {
+            mapnik::geometry::geometry<double> geom;
+            bool parsed = geometry == geometry_wkt ? mapnik::from_wkt(fields[geometry_column], geom)
+                                                   : mapnik::json::from_geojson(fields[geometry_column], geom);
+            if (parsed) box = mapnik::geometry::envelope(geom);
+        }
+        if (box.valid())
+        {
+            items.emplace_back(box, range_index_item(start, size));
+        }
+    }
+    return write_range_index(items, options, path, index_file);
+}
+
+} // namespace
+
+std::uint64_t build_file_index(std::string const& path, index_options const& options, std::string& index_file)
+{
+    index_type type = options.type;
+    if (type == index_auto)
+    {
+        if (has_extension(path, ".shp") || has_extension(path, ".shx") || has_extension(path, ".dbf"))
+            type = index_shape;
+        else if (has_extension(path, ".csv") || has_extension(path, ".tsv"))
+            type = index_csv;
+        else if (has_extension(path, ".json") || has_extension(path, ".geojson"))
+            type = index_geojson;
+        else if (file_exists(path + ".shx"))
+            type = index_shape;
+        else
+            throw std::runtime_error("could not detect the type of '" + path + "', pass the 'type' option");
+    }
+    switch (type)
+    {
+    case index_shape:
+        return build_shape_index(path, options, index_file);
+    case index_csv:
+        return build_csv_index(path, options, index_file);
+    default:
+        return build_geojson_index(path, options, index_file);
+    }
+}
+
+struct AsyncBuildIndex : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncBuildIndex(std::vector<std::string> const& files,
+                    index_options const& options,
+                    std::size_t threads,
+                    Napi::Function const& progress,
+                    Napi::Function const& callback)
+        : Base(callback),
+          options_(options),
+          threads_(threads),
+          report_progress_(!progress.IsEmpty())
+    {
+        for (auto const& file : files)
+        {
+            index_result result;
+            result.file = file;
+            results_.push_back(std::move(result));
+        }
+        if (report_progress_)
+        {
+            progress_ = Napi::ThreadSafeFunction::New(progress.Env(), progress, "mapnik.buildIndex", 0, 1);
+        }
+    }
+
+    void Execute() override
+    {
+        // every file has its own tree, so files are indexed in parallel and
+        // one bad file only fails its own result
+        std::size_t threads = std::min(threads_ > 0 ? threads_ : node_mapnik::task_threads(), results_.size());
+        node_mapnik::parallel_for(threads, [this, threads](std::size_t t) {
+            for (std::size_t i = t; i < results_.size(); i += threads)
+            {
+                index_result& result = results_[i];
+                try
+                {
+                    result.features = build_file_index(result.file, options_, result.index_file);
+                }
+                catch (std::exception const& ex)
+                {
+                    result.error = ex.what();
+                    result.index_file.clear();
+                }
+                if (report_progress_) send_progress(i);
+            }
+        });
+        // every progress call points back at this worker and runs before the callback
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        if (report_progress_) progress_.Release();
+        Base::OnWorkComplete(env, status);
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        if (!progress_error_.empty())
+        {
+            return {Napi::Error::New(env, progress_error_).Value()};
+        }
+        Napi::Array arr = Napi::Array::New(env, results_.size());
+        for (std::size_t i = 0; i < results_.size(); ++i)
+        {
+            arr.Set(static_cast<std::uint32_t>(i), result_object(env, results_[i]));
+        }
+        return {env.Null(), arr};
+    }
+
+  private:
+    void send_progress(std::size_t file)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++pending_;
+        }
+        auto* data = new index_progress;
+        data->file = file;
+        napi_status status = progress_.NonBlockingCall(data, [this](Napi::Env env, Napi::Function fn, index_progress* done) {
+            std::unique_ptr<index_progress> owned(done);
+            if (napi_env(env) != nullptr && !fn.IsEmpty()) on_progress(env, fn, owned->file);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --pending_;
+            }
+            cv_.notify_all();
+        });
+        if (status != napi_ok)
+        {
+            delete data;
+            std::lock_guard<std::mutex> lock(mutex_);
+            --pending_;
+        }
+    }
+
+    void on_progress(Napi::Env env, Napi::Function fn, std::size_t file)
+    {
+        ++done_;
+        if (!progress_error_.empty()) return;
+        Napi::Object obj = result_object(env, results_[file]);
+        obj.Set("done", Napi::Number::New(env, static_cast<double>(done_)));
+        obj.Set("total", Napi::Number::New(env, static_cast<double>(results_.size())));
+        try
+        {
+            fn.Call({obj});
+        }
+        catch (Napi::Error const& err)
+        {
+            progress_error_ = err.Message();
+        }
+        if (env.IsExceptionPending())
+        {
+            progress_error_ = env.GetAndClearPendingException().Message();
+        }
+    }
+
+    static Napi::Object result_object(Napi::Env env, index_result const& result)
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("file", result.file);
+        if (result.index_file.empty())
+            obj.Set("index", env.Null());
+        else
+            obj.Set("index", result.index_file);
+        obj.Set("features", Napi::Number::New(env, static_cast<double>(result.features)));
+        if (!result.error.empty()) obj.Set("error", result.error);
+        return obj;
+    }
+
+    index_options options_;
+    std::size_t threads_;
+    bool report_progress_;
+    Napi::ThreadSafeFunction progress_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::size_t pending_ = 0;
+    std::vector<index_result> results_;
+    std::size_t done_ = 0;
+    std::string progress_error_;
+};
+
+} // namespace detail
+
+/**
+ * **`mapnik.buildIndex`**
+ *
+ * Build the `.index` spatial index files of shapefiles, csv and GeoJSON files,
+ * the same files the `shapeindex` and `mapnik-index` programs write. Files are
+ * indexed in parallel on a worker thread, a file that cannot be indexed only
+ * sets the `error` of its own result.
+ *
+ * @name buildIndex
+ * @param {string|Array<string>} paths a file or an array of files
+ * @param {Object} [options]
+ * @param {string} [options.type] `shape`, `csv` or `geojson`, detected from the
+ * file extension by default
+ * @param {number} [options.depth=8] maximum depth of the tree
+ * @param {number} [options.ratio=0.55] split ratio of the tree
+ * @param {boolean} [options.index_parts=false] index the parts of polygons and
+ * lines of shapefiles separately
+ * @param {string} [options.separator] csv field separator, detected by default
+ * @param {string} [options.quote='"'] csv quote character
+ * @param {string} [options.headers] csv header line, for files without one
+ * @param {number} [options.threads] files indexed at once, by default as many as the
+ * threads of the pool set with `mapnik.setThreadPool`. Without a pool files are
+ * indexed one at a time.
+ * @param {Function} [options.progress] called with `{file, index, features, done, total}`
+ * every time a file is done
+ * @param {Function} callback called with (err, results), one `{file, index, features, error}`
+ * per file where `index` is the path of the index written, `null` if the file has no features
+ * @example
+ * mapnik.buildIndex(['roads.shp', 'points.csv'], {
+ *   progress: function(p) { console.log(p.done + '/' + p.total, p.file); }
+ * }, function(err, results) {
+ *   if (err) throw err;
+ * });
+ */
+Napi::Value build_index(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::vector<std::string> files;
+    if (info[0].IsString())
+    {
+        files.push_back(info[0].As<Napi::String>());
+    }
+    else if (info[0].IsArray())
+    {
+        Napi::Array arr = info[0].As<Napi::Array>();
+        for (std::uint32_t i = 0; i < arr.Length(); ++i)
+        {
+            Napi::Value file = arr.Get(i);
+            if (!file.IsString())
+            {
+                Napi::TypeError::New(env, "paths must be strings").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            files.push_back(file.As<Napi::String>());
+        }
+    }
+    else
+    {
+        Napi::TypeError::New(env, "first argument must be a path or an array of paths").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    detail::index_options options;
+    // 0: as many as the worker pool has threads
+    std::size_t threads = 0;
+    Napi::Function progress;
+    if (info.Length() > 2)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object opts = info[1].As<Napi::Object>();
+        if (opts.Has("type"))
+        {
+            Napi::Value type = opts.Get("type");
+            std::string type_str = type.IsString() ? type.As<Napi::String>().Utf8Value() : std::string();
+            if (type_str == "shape")
+                options.type = detail::index_shape;
+            else if (type_str == "csv")
+                options.type = detail::index_csv;
+            else if (type_str == "geojson")
+                options.type = detail::index_geojson;
+            else
+            {
+                Napi::TypeError::New(env, "'type' must be 'shape', 'csv' or 'geojson'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (opts.Has("depth"))
+        {
+            Napi::Value depth = opts.Get("depth");
+            if (!depth.IsNumber() || depth.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "'depth' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.depth = static_cast<unsigned>(depth.As<Napi::Number>().Int32Value());
+        }
+        if (opts.Has("ratio"))
+        {
+            Napi::Value ratio = opts.Get("ratio");
+            if (!ratio.IsNumber() || ratio.As<Napi::Number>().DoubleValue() <= 0 ||
+                ratio.As<Napi::Number>().DoubleValue() >= 1)
+            {
+                Napi::TypeError::New(env, "'ratio' must be a number between 0 and 1").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.ratio = ratio.As<Napi::Number>().DoubleValue();
+        }
+        if (opts.Has("index_parts"))
+        {
+            Napi::Value index_parts = opts.Get("index_parts");
+            if (!index_parts.IsBoolean())
+            {
+                Napi::TypeError::New(env, "'index_parts' must be a boolean").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.index_parts = index_parts.As<Napi::Boolean>();
+        }
+        if (opts.Has("separator"))
+        {
+            Napi::Value separator = opts.Get("separator");
+            std::string str = separator.IsString() ? separator.As<Napi::String>().Utf8Value() : std::string();
+            if (str.size() != 1)
+            {
+                Napi::TypeError::New(env, "'separator' must be a single character").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.separator = str[0];
+        }
+        if (opts.Has("quote"))
+        {
+            Napi::Value quote = opts.Get("quote");
+            std::string str = quote.IsString() ? quote.As<Napi::String>().Utf8Value() : std::string();
+            if (str.size() != 1)
+            {
+                Napi::TypeError::New(env, "'quote' must be a single character").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.quote = str[0];
+        }
+        if (opts.Has("headers"))
+        {
+            Napi::Value headers = opts.Get("headers");
+            if (!headers.IsString())
+            {
+                Napi::TypeError::New(env, "'headers' must be a string").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.headers = headers.As<Napi::String>();
+        }
+        if (opts.Has("threads"))
+        {
+            Napi::Value threads_val = opts.Get("threads");
+            if (!threads_val.IsNumber() || threads_val.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "'threads' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            threads = static_cast<std::size_t>(threads_val.As<Napi::Number>().Int32Value());
+        }
+        if (opts.Has("progress"))
+        {
+            Napi::Value progress_val = opts.Get("progress");
+            if (!progress_val.IsFunction())
+            {
+                Napi::TypeError::New(env, "'progress' must be a function").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            progress = progress_val.As<Napi::Function>();
+        }
+    }
+    auto* worker = new detail::AsyncBuildIndex(files, options, threads, progress, info[info.Length() - 1].As<Napi::Function>());
+    worker->Queue();
+    return env.Undefined();
+}
+
+} // namespace node_mapnik
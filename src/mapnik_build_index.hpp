@@ -0,0 +1,9 @@
+#pragma once
+
+#include <napi.h>
+
+namespace node_mapnik {
+
+Napi::Value build_index(Napi::CallbackInfo const& info);
+
+} // namespace node_mapnik
@@ -1,7 +1,228 @@
 #include "utils.hpp"
+#include "instance_data.hpp"
 #include "mapnik_cairo_surface.hpp"
+// cairo
+#if defined(HAVE_CAIRO)
+#if defined(CAIRO_HAS_PDF_SURFACE)
+#include <cairo-pdf.h>
+#endif
+#if defined(CAIRO_HAS_PS_SURFACE)
+#include <cairo-ps.h>
+#endif
+#if defined(CAIRO_HAS_SVG_SURFACE)
+#include <cairo-svg.h>
+#endif
+#endif
+// stl
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
-Napi::FunctionReference CairoSurface::constructor;
+namespace node_mapnik {
+
+namespace {
+
+// chunks handed to JS but not yet consumed before the render thread waits
+constexpr std::size_t max_pending_chunks = 4;
+
+std::string lowercase(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+    return str;
+}
+
+} // namespace
+
+surface_output::surface_output()
+    : buffer_(8192, '\0')
+{
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+}
+
+void surface_output::write_to_fd(int fd)
+{
+    fd_ = fd;
+}
+
+void surface_output::write_to_function(Napi::Function const& fn, std::size_t chunk_size)
+{
+    function_ = Napi::Persistent(fn);
+    chunk_size_ = chunk_size;
+}
+
+void surface_output::start(Napi::Env env)
+{
+    rendering_ = true;
+    error_.clear();
+    chunk_.clear();
+    pending_ = 0;
+    if (function_.IsEmpty() || tsfn_active_) return;
+    tsfn_ = Napi::ThreadSafeFunction::New(env, function_.Value(), "CairoSurface", 0, 1);
+    tsfn_active_ = true;
+}
+
+void surface_output::stop()
+{
+    rendering_ = false;
+    if (!tsfn_active_) return;
+    tsfn_.Release();
+    tsfn_active_ = false;
+}
+
+void surface_output::discard()
+{
+    std::string().swap(data_);
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+}
+
+std::string surface_output::release_data()
+{
+    sync_buffer();
+    std::string data;
+    data.swap(data_);
+    return data;
+}
+
+bool surface_output::finish()
+{
+    bool ok = sync_buffer();
+    if (ok && tsfn_active_ && !chunk_.empty()) ok = send_chunk();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_ == 0; });
+    return ok && error_.empty();
+}
+
+surface_output::int_type surface_output::overflow(int_type ch)
+{
+    if (!sync_buffer()) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int surface_output::sync()
+{
+    return sync_buffer() ? 0 : -1;
+}
+
+bool surface_output::sync_buffer()
+{
+    std::size_t size = static_cast<std::size_t>(pptr() - pbase());
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+    return size == 0 || write(&buffer_[0], size);
+}
+
+bool surface_output::write(char const* data, std::size_t size)
+{
+    if (fd_ >= 0)
+    {
+        while (size > 0)
+        {
+#if defined(_WIN32)
+            int written = ::_write(fd_, data, static_cast<unsigned>(size));
+#else
+            ssize_t written = ::write(fd_, data, size);
+#endif
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                fail(std::string("CairoSurface could not write to fd: ") + std::strerror(errno));
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+    if (tsfn_active_)
+    {
+        chunk_.append(data, size);
+        return chunk_.size() < chunk_size_ || send_chunk();
+    }
+    data_.append(data, size);
+    return true;
+}
+
+bool surface_output::send_chunk()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // only a few chunks may wait for JS, so memory stays flat however large the document
+    cv_.wait(lock, [this] { return pending_ < max_pending_chunks || !error_.empty(); });
+    if (!error_.empty()) return false;
+    ++pending_;
+    lock.unlock();
+
+    auto* chunk = new std::string(std::move(chunk_));
+    chunk_.clear();
+    napi_status status = tsfn_.NonBlockingCall(chunk, [this](Napi::Env env, Napi::Function fn, std::string* data) {
+        if (napi_env(env) != nullptr && !fn.IsEmpty())
+        {
+            std::string& str = *data;
+            Napi::Buffer<char> buffer = Napi::Buffer<char>::New(
+                env, &str[0], str.size(),
+                [](Napi::Env /*unused*/, char* /*unused*/, std::string* str_ptr) { delete str_ptr; },
+                data);
+            try
+            {
+                fn.Call({buffer});
+            }
+            catch (Napi::Error const& err)
+            {
+                fail(err.Message());
+            }
+            if (env.IsExceptionPending())
+            {
+                fail(env.GetAndClearPendingException().Message());
+            }
+        }
+        else
+        {
+            delete data;
+        }
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            --pending_;
+        }
+        cv_.notify_all();
+    });
+    if (status != napi_ok)
+    {
+        delete chunk;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            --pending_;
+        }
+        fail("CairoSurface could not hand output to JS");
+        return false;
+    }
+    return true;
+}
+
+void surface_output::fail(std::string const& message)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) error_ = message;
+    }
+    cv_.notify_all();
+}
+
+} // namespace node_mapnik
+
+Napi::FunctionReference& CairoSurface::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).cairo_surface;
+}
 
 Napi::Object CairoSurface::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -9,21 +230,45 @@ Napi::Object CairoSurface::Initialize(Napi::Env env, Napi::Object exports, napi_
     Napi::Function func = DefineClass(env, "CairoSurface", {
             InstanceMethod<&CairoSurface::width>("width", prop_attr),
             InstanceMethod<&CairoSurface::height>("height", prop_attr),
-            InstanceMethod<&CairoSurface::getData>("getData", prop_attr)
+            InstanceMethod<&CairoSurface::getData>("getData", prop_attr),
+            InstanceMethod<&CairoSurface::dispose>("dispose", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("CairoSurface", func);
     return exports;
 }
 
-// ctor
+/**
+ * **`mapnik.CairoSurface`**
+ *
+ * A surface that the cairo (or native svg) renderer writes an `svg`, `pdf`
+ * or `ps` document into. By default the document is kept in memory and read
+ * back with `getData()`; pass `fd` or `write` to stream it out as it is
+ * produced instead, so large print documents are never held in memory.
+ *
+ * @class CairoSurface
+ * @param {string} format `svg`, `pdf` or `ps`
+ * @param {number} width
+ * @param {number} height
+ * @param {Object} [options]
+ * @param {number} [options.fd] file descriptor the document is written to
+ * @param {Function} [options.write] called with a Buffer for every chunk of the document
+ * @param {number} [options.chunk_size=65536] bytes collected before calling `write`
+ * @example
+ * var out = fs.openSync('atlas.pdf', 'w');
+ * var surface = new mapnik.CairoSurface('pdf', 842, 595, {fd: out});
+ * map.render(surface, {}, function(err) {
+ *   fs.closeSync(out);
+ * });
+ */
 CairoSurface::CairoSurface(Napi::CallbackInfo const& info)
-    : Napi::ObjectWrap<CairoSurface>(info)
+    : Napi::ObjectWrap<CairoSurface>(info),
+      output_(std::make_shared<node_mapnik::surface_output>()),
+      stream_(output_.get())
 {
     Napi::Env env = info.Env();
-    if (info.Length() == 3)
+    if (info.Length() == 3 || info.Length() == 4)
     {
         if (!info[0].IsString())
         {
@@ -38,6 +283,51 @@ CairoSurface::CairoSurface(Napi::CallbackInfo const& info)
         }
         width_ = info[1].As<Napi::Number>().Int32Value();
         height_ = info[2].As<Napi::Number>().Int32Value();
+        if (info.Length() == 4)
+        {
+            if (!info[3].IsObject())
+            {
+                Napi::TypeError::New(env, "CairoSurface 'options' must be an object").ThrowAsJavaScriptException();
+                return;
+            }
+            Napi::Object options = info[3].As<Napi::Object>();
+            if (options.Has("fd") && options.Has("write"))
+            {
+                Napi::TypeError::New(env, "CairoSurface takes either 'fd' or 'write', not both").ThrowAsJavaScriptException();
+                return;
+            }
+            if (options.Has("fd"))
+            {
+                Napi::Value fd = options.Get("fd");
+                if (!fd.IsNumber() || fd.As<Napi::Number>().Int32Value() < 0)
+                {
+                    Napi::TypeError::New(env, "CairoSurface 'fd' must be a file descriptor").ThrowAsJavaScriptException();
+                    return;
+                }
+                output_->write_to_fd(fd.As<Napi::Number>().Int32Value());
+            }
+            if (options.Has("write"))
+            {
+                Napi::Value write = options.Get("write");
+                if (!write.IsFunction())
+                {
+                    Napi::TypeError::New(env, "CairoSurface 'write' must be a function").ThrowAsJavaScriptException();
+                    return;
+                }
+                std::size_t chunk_size = 65536;
+                if (options.Has("chunk_size"))
+                {
+                    Napi::Value chunk_size_val = options.Get("chunk_size");
+                    if (!chunk_size_val.IsNumber() || chunk_size_val.As<Napi::Number>().Int64Value() <= 0)
+                    {
+                        Napi::TypeError::New(env, "CairoSurface 'chunk_size' must be a positive integer").ThrowAsJavaScriptException();
+                        return;
+                    }
+                    chunk_size = static_cast<std::size_t>(chunk_size_val.As<Napi::Number>().Int64Value());
+                }
+                output_->write_to_function(write.As<Napi::Function>(), chunk_size);
+            }
+        }
     }
     else
     {
@@ -45,6 +335,53 @@ CairoSurface::CairoSurface(Napi::CallbackInfo const& info)
     }
 }
 
+void CairoSurface::report_external_memory(Napi::Env env)
+{
+    node_mapnik::report_external_memory(env, external_memory_, output_.get(), output_->data().size());
+}
+
+#if defined(HAVE_CAIRO)
+mapnik::cairo_surface_ptr CairoSurface::create_surface()
+{
+    return create_surface(static_cast<double>(width_), static_cast<double>(height_));
+}
+
+mapnik::cairo_surface_ptr CairoSurface::create_surface(double width, double height)
+{
+    std::string format = node_mapnik::lowercase(format_);
+    cairo_surface_t* surface = nullptr;
+#if defined(CAIRO_HAS_PDF_SURFACE)
+    if (format == "pdf")
+    {
+        surface = cairo_pdf_surface_create_for_stream(write_callback, output_.get(), width, height);
+    }
+#endif
+#if defined(CAIRO_HAS_PS_SURFACE)
+    if (format == "ps")
+    {
+        surface = cairo_ps_surface_create_for_stream(write_callback, output_.get(), width, height);
+    }
+#endif
+#if defined(CAIRO_HAS_SVG_SURFACE)
+    if (!surface && format != "pdf" && format != "ps")
+    {
+        surface = cairo_svg_surface_create_for_stream(write_callback, output_.get(), width, height);
+    }
+#endif
+    if (!surface)
+    {
+        throw std::runtime_error("CairoSurface format '" + format_ + "' is not supported by this cairo build");
+    }
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        std::string message = cairo_status_to_string(cairo_surface_status(surface));
+        cairo_surface_destroy(surface);
+        throw std::runtime_error("could not create cairo surface: " + message);
+    }
+    return mapnik::cairo_surface_ptr(surface, mapnik::cairo_surface_closer());
+}
+#endif
+
 Napi::Value CairoSurface::width(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
@@ -57,11 +394,62 @@ Napi::Value CairoSurface::height(Napi::CallbackInfo const& info)
     return Napi::Number::New(env, height_);
 }
 
+/**
+ * Get the document rendered into this surface: a string for `svg` and a
+ * Buffer for `pdf` and `ps`. Empty when the surface streams to `fd` or `write`.
+ * A `pdf` or `ps` document is handed over to the Buffer rather than copied,
+ * so the surface is empty afterwards.
+ *
+ * @name getData
+ * @memberof CairoSurface
+ * @instance
+ * @returns {string|Buffer}
+ * @throws {Error} while the surface is being rendered
+ */
 Napi::Value CairoSurface::getData(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
     Napi::EscapableHandleScope scope(env);
-    if (!data_.empty()) return scope.Escape(Napi::String::New(env, data_));
-    std::string str = stream_.str();
-    return scope.Escape(Napi::String::New(env, str));
+    if (output_->rendering())
+    {
+        Napi::Error::New(env, "CairoSurface is being rendered, read it once the render completed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string format = node_mapnik::lowercase(format_);
+    if (format == "pdf" || format == "ps")
+    {
+        auto* str = new std::string(output_->release_data());
+        report_external_memory(env);
+        auto buffer = Napi::Buffer<char>::New(
+            env,
+            str->empty() ? nullptr : &(*str)[0],
+            str->size(),
+            [](Napi::Env /*unused*/, char* /*unused*/, std::string* str_ptr) { delete str_ptr; },
+            str);
+        return scope.Escape(buffer);
+    }
+    output_->pubsync();
+    return scope.Escape(Napi::String::New(env, output_->data()));
+}
+
+/**
+ * Free the document kept in memory now rather than when the surface is
+ * garbage collected. `getData()` returns an empty document afterwards.
+ *
+ * @name dispose
+ * @memberof CairoSurface
+ * @instance
+ * @throws {Error} while the surface is being rendered
+ */
+Napi::Value CairoSurface::dispose(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (output_->rendering())
+    {
+        Napi::Error::New(env, "CairoSurface is being rendered, dispose it once the render completed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    output_->discard();
+    report_external_memory(env);
+    return env.Undefined();
 }
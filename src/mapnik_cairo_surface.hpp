@@ -2,14 +2,77 @@
 
 #include <napi.h>
 // stl
-#include <sstream>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
 // cairo
 #if defined(HAVE_CAIRO)
 #include <cairo.h>
+#include <mapnik/cairo/cairo_context.hpp>
 #else
 #define cairo_status_t int
 #endif
 
+namespace node_mapnik {
+
+class external_memory;
+
+// Receives the document a renderer writes into a CairoSurface. By default it is
+// kept in memory for getData(); it can instead be written to a file descriptor,
+// or handed to a JS function in chunks while the render thread produces it.
+class surface_output : public std::streambuf
+{
+  public:
+    surface_output();
+    void write_to_fd(int fd);
+    void write_to_function(Napi::Function const& fn, std::size_t chunk_size);
+    bool in_memory() const { return fd_ < 0 && function_.IsEmpty(); }
+    // Called on the main thread before and after every render into the surface
+    void start(Napi::Env env);
+    void stop();
+    // Called on the render thread once the document is complete: writes what is
+    // still buffered and waits until JS has received every chunk
+    bool finish();
+    std::string const& error() const { return error_; }
+    std::string const& data() const { return data_; }
+    // True between start() and stop()
+    bool rendering() const { return rendering_; }
+    // Frees the document kept in memory
+    void discard();
+    // Hands the document kept in memory over to the caller
+    std::string release_data();
+
+  protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+  private:
+    bool sync_buffer();
+    bool write(char const* data, std::size_t size);
+    bool send_chunk();
+    void fail(std::string const& message);
+
+    std::string buffer_;
+    std::string data_;
+    int fd_ = -1;
+    Napi::FunctionReference function_;
+    Napi::ThreadSafeFunction tsfn_;
+    bool tsfn_active_ = false;
+    std::size_t chunk_size_ = 65536;
+    std::string chunk_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::size_t pending_ = 0;
+    std::string error_;
+    bool rendering_ = false;
+};
+
+} // namespace node_mapnik
+
 class CairoSurface : public Napi::ObjectWrap<CairoSurface>
 {
   public:
@@ -19,8 +82,10 @@ class CairoSurface : public Napi::ObjectWrap<CairoSurface>
     explicit CairoSurface(Napi::CallbackInfo const& info);
     // methods
     Napi::Value getData(Napi::CallbackInfo const& info);
+    Napi::Value dispose(Napi::CallbackInfo const& info);
     Napi::Value width(Napi::CallbackInfo const& info);
     Napi::Value height(Napi::CallbackInfo const& info);
+    // `stream` is the surface_output of the CairoSurface being rendered
     static cairo_status_t write_callback(void* stream,
                                          const unsigned char* data,
                                          unsigned int length)
@@ -28,35 +93,53 @@ class CairoSurface : public Napi::ObjectWrap<CairoSurface>
 #if defined(HAVE_CAIRO)
         if (!stream)
         {
-            // Since the closure here is the passing of the std::stringstream "i_stream" of this
-            // class it is unlikely that this could ever be reached unless something was very wrong
-            // and went out of scope, aka it was improperly programmed. Therefore, it is not possible
-            // to reach this point with standard testing.
+            // The closure is the output of a CairoSurface kept alive for the whole
+            // render, so this can only be reached if something was improperly
+            // programmed. Therefore, it is not possible to reach this point with
+            // standard testing.
             // LCOV_EXCL_START
             return CAIRO_STATUS_WRITE_ERROR;
             // LCOV_EXCL_STOP
         }
-        std::stringstream* fin = reinterpret_cast<std::stringstream*>(stream);
-        *fin << std::string((const char*)data, (size_t)length);
+        auto* output = reinterpret_cast<node_mapnik::surface_output*>(stream);
+        std::streamsize size = static_cast<std::streamsize>(length);
+        if (output->sputn(reinterpret_cast<char const*>(data), size) != size)
+        {
+            return CAIRO_STATUS_WRITE_ERROR;
+        }
         return CAIRO_STATUS_SUCCESS;
 #else
         return CAIRO_STATUS_WRITE_ERROR;
 #endif
     }
+#if defined(HAVE_CAIRO)
+    // Creates a 'pdf', 'ps' or (for any other format) 'svg' cairo surface writing into output()
+    mapnik::cairo_surface_ptr create_surface();
+    // Same with another (first) page size than the surface's own
+    mapnik::cairo_surface_ptr create_surface(double width, double height);
+#endif
 
     inline unsigned width() const { return width_; }
     inline unsigned height() const { return height_; }
     inline std::string const& format() const { return format_; }
-    inline std::stringstream& stream() { return stream_; }
-    inline void flush() { data_ = stream_.str(); }
-    inline void set_data(std::string const& data) { data_ = data; }
-    inline std::string const& data() const { return data_; }
-    static Napi::FunctionReference constructor;
+    inline std::ostream& stream() { return stream_; }
+    inline node_mapnik::surface_output& output() { return *output_; }
+    // Shares the output of `other`, like a new Image wrapper shares the pixels
+    inline void share_output(CairoSurface const& other)
+    {
+        output_ = other.output_;
+        stream_.rdbuf(output_.get());
+    }
+    // Tells V8 how large the document kept in memory is now
+    void report_external_memory(Napi::Env env);
+    static Napi::FunctionReference& constructor(Napi::Env env);
 
   private:
     unsigned width_;
     unsigned height_;
     std::string format_;
-    std::stringstream stream_;
-    std::string data_;
+    std::shared_ptr<node_mapnik::surface_output> output_;
+    std::ostream stream_;
+    // share of the memory of the document reported to V8
+    std::shared_ptr<node_mapnik::external_memory> external_memory_;
 };
@@ -1,6 +1,10 @@
 #include "mapnik_color.hpp"
+#include "instance_data.hpp"
 
-Napi::FunctionReference Color::constructor;
+Napi::FunctionReference& Color::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).color;
+}
 
 Napi::Object Color::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -15,8 +19,7 @@ Napi::Object Color::Initialize(Napi::Env env, Napi::Object exports, napi_propert
             InstanceAccessor<&Color::premultiplied, &Color::premultiplied>("premultiplied", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Color", func);
     return exports;
 }
@@ -30,6 +30,6 @@ class Color : public Napi::ObjectWrap<Color>
     void premultiplied(Napi::CallbackInfo const& info, Napi::Value const& value);
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     mapnik::color color_;
 };
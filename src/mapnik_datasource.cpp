@@ -1,7 +1,14 @@
 #include "mapnik_datasource.hpp"
+#include "instance_data.hpp"
 #include "mapnik_featureset.hpp"
 #include "utils.hpp"
 #include "ds_emitter.hpp"
+#include "columnar_datasource.hpp"
+#include "caching_datasource.hpp"
+#include "datasource_stats.hpp"
+#include "mapnik_expression.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
 
 // mapnik
 #include <mapnik/attribute_descriptor.hpp> // for attribute_descriptor
@@ -11,12 +18,529 @@
 #include <mapnik/feature_layer_desc.hpp>   // for layer_descriptor
 #include <mapnik/params.hpp>               // for parameters
 #include <mapnik/query.hpp>                // for query
+#include <mapnik/unicode.hpp>              // for transcoder
+#include <mapnik/attribute_collector.hpp>  // for expression_attributes
+#include <mapnik/expression.hpp>           // for parse_expression
+#include <mapnik/expression_evaluator.hpp> // for evaluate
+#include <mapnik/util/geometry_to_wkb.hpp> // for to_wkb
 
 // stl
+#include <algorithm>
+#include <condition_variable>
 #include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 #include <vector>
 
-Napi::FunctionReference Datasource::constructor;
+namespace {
+
+bool parse_extent(Napi::Env env, Napi::Value const& extent_opt, mapnik::box2d<double>& extent)
+{
+    if (!extent_opt.IsArray() || extent_opt.As<Napi::Array>().Length() != 4)
+    {
+        Napi::TypeError::New(env, "extent value must be an array of [minx,miny,maxx,maxy]").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Array bbox = extent_opt.As<Napi::Array>();
+    Napi::Value minx = bbox.Get(0u);
+    Napi::Value miny = bbox.Get(1u);
+    Napi::Value maxx = bbox.Get(2u);
+    Napi::Value maxy = bbox.Get(3u);
+    if (!minx.IsNumber() || !miny.IsNumber() || !maxx.IsNumber() || !maxy.IsNumber())
+    {
+        Napi::Error::New(env, "max_extent [minx,miny,maxx,maxy] must be numbers").ThrowAsJavaScriptException();
+        return false;
+    }
+    extent = mapnik::box2d<double>(minx.As<Napi::Number>().DoubleValue(), miny.As<Napi::Number>().DoubleValue(),
+                                   maxx.As<Napi::Number>().DoubleValue(), maxy.As<Napi::Number>().DoubleValue());
+    return true;
+}
+
+// chunks handed to `on_chunk` but not yet consumed before the query waits
+constexpr std::size_t max_pending_chunks = 4;
+
+// One batch of query results, stored by column
+struct query_chunk
+{
+    std::vector<mapnik::value_integer> ids;
+    std::string wkb;
+    std::vector<std::uint32_t> offsets{0};
+    std::vector<std::vector<mapnik::value>> columns;
+};
+
+struct AsyncQuery : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncQuery(datasource_ptr const& ds,
+               mapnik::box2d<double> const& extent,
+               std::vector<std::string>&& fields,
+               mapnik::expression_ptr const& filter,
+               std::size_t limit,
+               std::size_t chunk_size,
+               bool geometry,
+               Napi::Function const& on_chunk,
+               Napi::Function const& callback)
+        : Base(callback),
+          ds_(ds),
+          extent_(extent),
+          fields_(std::move(fields)),
+          filter_(filter),
+          limit_(limit),
+          chunk_size_(chunk_size),
+          geometry_(geometry),
+          streaming_(!on_chunk.IsEmpty())
+    {
+        if (streaming_)
+        {
+            tsfn_ = Napi::ThreadSafeFunction::New(on_chunk.Env(), on_chunk, "Datasource.query", 0, 1);
+        }
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            // features are read lazily, the query lasts until the last one is
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_query, "query");
+            // only the requested fields and those the filter reads are pushed down to the datasource
+            std::set<std::string> names(fields_.begin(), fields_.end());
+            if (filter_)
+            {
+                mapnik::expression_attributes<std::set<std::string>> collect(names);
+                mapnik::util::apply_visitor(collect, *filter_);
+            }
+            mapnik::query q(extent_);
+            for (auto const& name : names)
+            {
+                q.add_property_name(name);
+            }
+            mapnik::featureset_ptr fs = ds_->features(q);
+            if (!fs || !mapnik::is_valid(fs)) return;
+            using evaluator = mapnik::evaluate<mapnik::feature_impl, mapnik::value, mapnik::attributes>;
+            mapnik::attributes vars;
+            mapnik::feature_ptr feature;
+            while (count_ < limit_ && (feature = fs->next()))
+            {
+                if (filter_ && !mapnik::util::apply_visitor(evaluator(*feature, vars), *filter_).to_bool())
+                {
+                    continue;
+                }
+                if (!chunks_.empty() && chunks_.back().ids.size() == chunk_size_ && streaming_)
+                {
+                    if (!send_chunk()) break;
+                }
+                if (chunks_.empty() || chunks_.back().ids.size() == chunk_size_)
+                {
+                    chunks_.emplace_back();
+                    chunks_.back().columns.resize(fields_.size());
+                }
+                query_chunk& chunk = chunks_.back();
+                chunk.ids.push_back(feature->id());
+                if (geometry_)
+                {
+                    mapnik::util::wkb_buffer_ptr wkb = mapnik::util::to_wkb(feature->get_geometry(), mapnik::wkbNDR);
+                    if (wkb) chunk.wkb.append(wkb->buffer(), wkb->size());
+                    if (chunk.wkb.size() > std::numeric_limits<std::uint32_t>::max())
+                    {
+                        throw std::runtime_error("geometry of a single chunk exceeds 4GB, use a smaller chunk_size");
+                    }
+                    chunk.offsets.push_back(static_cast<std::uint32_t>(chunk.wkb.size()));
+                }
+                for (std::size_t i = 0; i < fields_.size(); ++i)
+                {
+                    chunk.columns[i].push_back(feature->get(fields_[i]));
+                }
+                ++count_;
+            }
+            if (streaming_ && !chunks_.empty()) send_chunk();
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+        if (!streaming_) return;
+        // the chunks on their way to JS point back at this worker
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return pending_ == 0; });
+        if (!error_.empty()) SetError(error_);
+    }
+
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        if (streaming_) tsfn_.Release();
+        Base::OnWorkComplete(env, status);
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        Napi::Array chunks = Napi::Array::New(env, chunks_.size());
+        for (std::size_t c = 0; c < chunks_.size(); ++c)
+        {
+            chunks.Set(static_cast<std::uint32_t>(c), chunk_to_js(env, chunks_[c]));
+        }
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("count", Napi::Number::New(env, static_cast<double>(count_)));
+        result.Set("chunks", chunks);
+        return {env.Null(), result};
+    }
+
+  private:
+    // Hands the last chunk to `on_chunk` on the JS thread, waiting while too many
+    // are still on their way so memory stays bounded by a few chunks
+    bool send_chunk()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return pending_ < max_pending_chunks || !error_.empty(); });
+        if (!error_.empty()) return false;
+        ++pending_;
+        lock.unlock();
+
+        auto* chunk = new query_chunk(std::move(chunks_.back()));
+        chunks_.pop_back();
+        napi_status status = tsfn_.NonBlockingCall(chunk, [this](Napi::Env env, Napi::Function fn, query_chunk* data) {
+            std::unique_ptr<query_chunk> owned(data);
+            if (napi_env(env) != nullptr && !fn.IsEmpty())
+            {
+                try
+                {
+                    fn.Call({chunk_to_js(env, *owned)});
+                }
+                catch (Napi::Error const& err)
+                {
+                    fail(err.Message());
+                }
+                if (env.IsExceptionPending())
+                {
+                    fail(env.GetAndClearPendingException().Message());
+                }
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                --pending_;
+            }
+            cv_.notify_all();
+        });
+        if (status != napi_ok)
+        {
+            delete chunk;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                --pending_;
+            }
+            fail("could not hand query results to JS");
+            return false;
+        }
+        return true;
+    }
+
+    void fail(std::string const& message)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (error_.empty()) error_ = message;
+        }
+        cv_.notify_all();
+    }
+
+    Napi::Object chunk_to_js(Napi::Env env, query_chunk const& chunk) const
+    {
+        std::size_t size = chunk.ids.size();
+        Napi::Object obj = Napi::Object::New(env);
+        Napi::Float64Array ids = Napi::Float64Array::New(env, size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            ids[i] = static_cast<double>(chunk.ids[i]);
+        }
+        obj.Set("ids", ids);
+        if (geometry_)
+        {
+            Napi::Object geometry = Napi::Object::New(env);
+            geometry.Set("data", Napi::Buffer<char>::Copy(env, chunk.wkb.data(), chunk.wkb.size()));
+            Napi::Uint32Array offsets = Napi::Uint32Array::New(env, chunk.offsets.size());
+            std::copy(chunk.offsets.begin(), chunk.offsets.end(), offsets.Data());
+            geometry.Set("offsets", offsets);
+            obj.Set("geometry", geometry);
+        }
+        Napi::Object columns = Napi::Object::New(env);
+        for (std::size_t f = 0; f < fields_.size(); ++f)
+        {
+            columns.Set(fields_[f], column_to_js(env, chunk.columns[f]));
+        }
+        obj.Set("fields", columns);
+        return obj;
+    }
+
+    // Numeric columns become a Float64Array with NaN for nulls, anything else a plain Array
+    static Napi::Value column_to_js(Napi::Env env, std::vector<mapnik::value> const& values)
+    {
+        bool numeric = std::all_of(values.begin(), values.end(), [](mapnik::value const& val) {
+            return val.is<mapnik::value_integer>() || val.is<mapnik::value_double>() || val.is_null();
+        });
+        if (numeric)
+        {
+            Napi::Float64Array arr = Napi::Float64Array::New(env, values.size());
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                arr[i] = values[i].is_null() ? std::numeric_limits<double>::quiet_NaN() : values[i].to_double();
+            }
+            return arr;
+        }
+        Napi::Array arr = Napi::Array::New(env, values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            arr.Set(static_cast<std::uint32_t>(i), mapnik::util::apply_visitor(node_mapnik::value_converter(env), values[i]));
+        }
+        return arr;
+    }
+
+    datasource_ptr ds_;
+    mapnik::box2d<double> extent_;
+    std::vector<std::string> fields_;
+    mapnik::expression_ptr filter_;
+    std::size_t limit_;
+    std::size_t chunk_size_;
+    bool geometry_;
+    bool streaming_;
+    Napi::ThreadSafeFunction tsfn_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::size_t pending_ = 0;
+    std::string error_;
+    std::size_t count_ = 0;
+    std::vector<query_chunk> chunks_;
+};
+
+struct AsyncStats : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncStats(datasource_ptr const& ds,
+               std::vector<std::string>&& fields,
+               std::size_t sample,
+               Napi::Function const& callback)
+        : Base(callback),
+          ds_(ds),
+          fields_(std::move(fields)),
+          sample_(sample)
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            stats_ = node_mapnik::collect_stats(ds_, fields_, sample_);
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        static char const* geometry_type_names[] = {"Unknown", "Point", "LineString", "Polygon", "MultiPoint",
+                                                    "MultiLineString", "MultiPolygon", "GeometryCollection"};
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("count", Napi::Number::New(env, static_cast<double>(stats_.count)));
+        result.Set("sampled", Napi::Boolean::New(env, stats_.sampled));
+        if (stats_.extent.valid())
+        {
+            Napi::Array extent = Napi::Array::New(env, 4);
+            extent.Set(0u, Napi::Number::New(env, stats_.extent.minx()));
+            extent.Set(1u, Napi::Number::New(env, stats_.extent.miny()));
+            extent.Set(2u, Napi::Number::New(env, stats_.extent.maxx()));
+            extent.Set(3u, Napi::Number::New(env, stats_.extent.maxy()));
+            result.Set("extent", extent);
+        }
+        else
+        {
+            result.Set("extent", env.Null());
+        }
+        Napi::Object geometry_types = Napi::Object::New(env);
+        for (std::size_t i = 0; i < stats_.geometry_types.size(); ++i)
+        {
+            if (stats_.geometry_types[i] == 0) continue;
+            geometry_types.Set(geometry_type_names[i], Napi::Number::New(env, static_cast<double>(stats_.geometry_types[i])));
+        }
+        result.Set("geometry_types", geometry_types);
+        Napi::Object fields = Napi::Object::New(env);
+        for (std::size_t i = 0; i < fields_.size(); ++i)
+        {
+            node_mapnik::field_stats const& field = stats_.fields[i];
+            Napi::Object obj = Napi::Object::New(env);
+            obj.Set("nulls", Napi::Number::New(env, static_cast<double>(field.nulls)));
+            if (field.numbers > 0)
+            {
+                obj.Set("min", Napi::Number::New(env, field.min));
+                obj.Set("max", Napi::Number::New(env, field.max));
+            }
+            else if (field.strings > 0)
+            {
+                std::string min;
+                std::string max;
+                mapnik::to_utf8(field.min_string, min);
+                mapnik::to_utf8(field.max_string, max);
+                obj.Set("min", min);
+                obj.Set("max", max);
+            }
+            else
+            {
+                obj.Set("min", env.Null());
+                obj.Set("max", env.Null());
+            }
+            obj.Set("distinct", Napi::Number::New(env, field.distinct.estimate()));
+            fields.Set(fields_[i], obj);
+        }
+        result.Set("fields", fields);
+        return {env.Null(), result};
+    }
+
+  private:
+    datasource_ptr ds_;
+    std::vector<std::string> fields_;
+    std::size_t sample_;
+    node_mapnik::datasource_stats stats_;
+};
+
+// Converts a JS column (typed array or plain array) into mapnik values
+bool column_to_values(Napi::Env env, Napi::Value const& column, std::string const& name, std::vector<mapnik::value>& values)
+{
+    if (column.IsTypedArray())
+    {
+        Napi::TypedArray arr = column.As<Napi::TypedArray>();
+        std::size_t length = arr.ElementLength();
+        values.reserve(length);
+        switch (arr.TypedArrayType())
+        {
+        case napi_float64_array: {
+            double const* data = column.As<Napi::Float64Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(data[i]);
+            return true;
+        }
+        case napi_float32_array: {
+            float const* data = column.As<Napi::Float32Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_double>(data[i]));
+            return true;
+        }
+        case napi_int32_array: {
+            std::int32_t const* data = column.As<Napi::Int32Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        case napi_uint32_array: {
+            std::uint32_t const* data = column.As<Napi::Uint32Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        case napi_int16_array: {
+            std::int16_t const* data = column.As<Napi::Int16Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        case napi_uint16_array: {
+            std::uint16_t const* data = column.As<Napi::Uint16Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        case napi_int8_array: {
+            std::int8_t const* data = column.As<Napi::Int8Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        case napi_uint8_array:
+        case napi_uint8_clamped_array: {
+            std::uint8_t const* data = column.As<Napi::Uint8Array>().Data();
+            for (std::size_t i = 0; i < length; ++i) values.emplace_back(static_cast<mapnik::value_integer>(data[i]));
+            return true;
+        }
+        default:
+            break;
+        }
+    }
+    else if (column.IsArray())
+    {
+        Napi::Array arr = column.As<Napi::Array>();
+        std::uint32_t length = arr.Length();
+        mapnik::transcoder tr("utf8");
+        values.reserve(length);
+        for (std::uint32_t i = 0; i < length; ++i)
+        {
+            Napi::Value val = arr.Get(i);
+            if (val.IsBoolean())
+            {
+                values.emplace_back(static_cast<mapnik::value_bool>(val.As<Napi::Boolean>().Value()));
+            }
+            else if (val.IsString())
+            {
+                values.emplace_back(tr.transcode(val.As<Napi::String>().Utf8Value().c_str()));
+            }
+            else if (val.IsNumber())
+            {
+                double num = val.As<Napi::Number>().DoubleValue();
+                if (num == val.As<Napi::Number>().Int32Value())
+                    values.emplace_back(static_cast<mapnik::value_integer>(num));
+                else
+                    values.emplace_back(num);
+            }
+            else
+            {
+                values.emplace_back(mapnik::value_null());
+            }
+        }
+        return true;
+    }
+    Napi::TypeError::New(env, "column '" + name + "' must be a numeric typed array or an array").ThrowAsJavaScriptException();
+    return false;
+}
+
+bool float64_column(Napi::Env env, Napi::Object const& options, char const* name, std::vector<double>& out)
+{
+    Napi::Value val = options.Get(name);
+    if (!val.IsTypedArray() || val.As<Napi::TypedArray>().TypedArrayType() != napi_float64_array)
+    {
+        Napi::TypeError::New(env, std::string("'") + name + "' must be a Float64Array").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Float64Array arr = val.As<Napi::Float64Array>();
+    out.assign(arr.Data(), arr.Data() + arr.ElementLength());
+    return true;
+}
+
+bool props_to_columns(Napi::Env env, Napi::Object const& options, std::size_t size, std::vector<node_mapnik::attribute_column>& columns)
+{
+    if (!options.Has("props")) return true;
+    Napi::Value props_val = options.Get("props");
+    if (!props_val.IsObject())
+    {
+        Napi::TypeError::New(env, "'props' must be an object of columns").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Object props = props_val.As<Napi::Object>();
+    Napi::Array names = props.GetPropertyNames();
+    for (std::uint32_t i = 0; i < names.Length(); ++i)
+    {
+        node_mapnik::attribute_column column;
+        column.name = names.Get(i).As<Napi::String>();
+        if (!column_to_values(env, props.Get(column.name), column.name, column.values)) return false;
+        if (column.values.size() != size)
+        {
+            Napi::TypeError::New(env, "column '" + column.name + "' must have one value per row").ThrowAsJavaScriptException();
+            return false;
+        }
+        columns.push_back(std::move(column));
+    }
+    return true;
+}
+
+} // namespace
+
+Napi::FunctionReference& Datasource::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).datasource;
+}
 
 Napi::Object Datasource::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -25,13 +549,17 @@ Napi::Object Datasource::Initialize(Napi::Env env, Napi::Object exports, napi_pr
             InstanceMethod<&Datasource::parameters>("parameters", prop_attr),
             InstanceMethod<&Datasource::describe>("describe", prop_attr),
             InstanceMethod<&Datasource::featureset>("featureset", prop_attr),
+            InstanceMethod<&Datasource::query>("query", prop_attr),
+            InstanceMethod<&Datasource::stats>("stats", prop_attr),
             InstanceMethod<&Datasource::extent>("extent", prop_attr),
-            InstanceMethod<&Datasource::fields>("fields", prop_attr)
-
+            InstanceMethod<&Datasource::fields>("fields", prop_attr),
+            InstanceMethod<&Datasource::updateColumns>("updateColumns", prop_attr),
+            InstanceMethod<&Datasource::withCache>("withCache", prop_attr),
+            InstanceMethod<&Datasource::cacheStats>("cacheStats", prop_attr),
+            StaticMethod<&Datasource::fromColumns>("fromColumns", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Datasource", func);
     return exports;
 }
@@ -219,32 +747,9 @@ Napi::Value Datasource::featureset(Napi::CallbackInfo const& info)
             return env.Undefined();
         }
         Napi::Object options = info[0].As<Napi::Object>();
-        if (options.Has("extent"))
+        if (options.Has("extent") && !parse_extent(env, options.Get("extent"), extent))
         {
-            Napi::Value extent_opt = options.Get("extent");
-            if (!extent_opt.IsArray())
-            {
-                Napi::TypeError::New(env, "extent value must be an array of [minx,miny,maxx,maxy]").ThrowAsJavaScriptException();
-                return env.Undefined();
-            }
-            Napi::Array bbox = extent_opt.As<Napi::Array>();
-            auto len = bbox.Length();
-            if (!(len == 4))
-            {
-                Napi::TypeError::New(env, "extent value must be an array of [minx,miny,maxx,maxy]").ThrowAsJavaScriptException();
-                return env.Undefined();
-            }
-            Napi::Value minx = bbox.Get(0u);
-            Napi::Value miny = bbox.Get(1u);
-            Napi::Value maxx = bbox.Get(2u);
-            Napi::Value maxy = bbox.Get(3u);
-            if (!minx.IsNumber() || !miny.IsNumber() || !maxx.IsNumber() || !maxy.IsNumber())
-            {
-                Napi::Error::New(env, "max_extent [minx,miny,maxx,maxy] must be numbers").ThrowAsJavaScriptException();
-                return env.Null();
-            }
-            extent = mapnik::box2d<double>(minx.As<Napi::Number>().DoubleValue(), miny.As<Napi::Number>().DoubleValue(),
-                                           maxx.As<Napi::Number>().DoubleValue(), maxy.As<Napi::Number>().DoubleValue());
+            return env.Undefined();
         }
     }
 
@@ -274,12 +779,266 @@ Napi::Value Datasource::featureset(Napi::CallbackInfo const& info)
     if (fs && mapnik::is_valid(fs))
     {
         Napi::Value arg = Napi::External<mapnik::featureset_ptr>::New(env, &fs);
-        Napi::Object obj = Featureset::constructor.New({arg});
+        Napi::Object obj = Featureset::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     return env.Null(); // an empty Featureset
 }
 
+/**
+ * Query features asynchronously and get them back in columnar chunks. Only the
+ * listed fields (and those the filter reads) are requested from the datasource,
+ * and the filter is evaluated natively, off the main thread.
+ *
+ * @name query
+ * @memberof Datasource
+ * @instance
+ * @param {Object} [options]
+ * @param {Array<number>} [options.extent=[minx,miny,maxx,maxy]]
+ * @param {Array<string>} [options.fields=[]] attributes to return
+ * @param {mapnik.Expression|string} [options.filter] only return features matching this expression
+ * @param {number} [options.limit] stop after this many matching features
+ * @param {number} [options.chunk_size=4096] rows per chunk
+ * @param {boolean} [options.geometry=true] include WKB geometries
+ * @param {Function} [options.on_chunk] called with each chunk as soon as it is
+ * full instead of collecting them all; the query pauses while a few chunks wait
+ * for the main thread and stops with the error if `on_chunk` throws
+ * @param {Function} callback called with `(err, {count, chunks})`. Every chunk is
+ * `{ids: Float64Array, geometry: {data: Buffer, offsets: Uint32Array}, fields: {}}`;
+ * numeric fields are a Float64Array (NaN for null), others an Array. `chunks`
+ * is empty when `on_chunk` is given.
+ * @example
+ * ds.query({fields: ['NAME', 'POP2005'], filter: '[POP2005] > 1000000', limit: 100}, function(err, result) {
+ *   result.chunks.forEach(function(chunk) {
+ *     var names = chunk.fields.NAME; // Array<string>
+ *     var pop = chunk.fields.POP2005; // Float64Array
+ *   });
+ * });
+ */
+Napi::Value Datasource::query(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() == 0 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    mapnik::box2d<double> extent;
+    std::vector<std::string> fields;
+    mapnik::expression_ptr filter;
+    std::size_t limit = std::numeric_limits<std::size_t>::max();
+    std::size_t chunk_size = 4096;
+    bool geometry = true;
+    Napi::Function on_chunk;
+    try
+    {
+        extent = datasource_->envelope();
+    }
+    catch (std::exception const& ex)
+    {
+        // LCOV_EXCL_START
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+        // LCOV_EXCL_STOP
+    }
+    if (info.Length() > 1)
+    {
+        if (!info[0].IsObject())
+        {
+            Napi::TypeError::New(env, "optional first argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("extent") && !parse_extent(env, options.Get("extent"), extent))
+        {
+            return env.Undefined();
+        }
+        if (options.Has("fields"))
+        {
+            Napi::Value fields_opt = options.Get("fields");
+            if (!fields_opt.IsArray())
+            {
+                Napi::TypeError::New(env, "option 'fields' must be an array of strings").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            Napi::Array arr = fields_opt.As<Napi::Array>();
+            for (std::uint32_t i = 0; i < arr.Length(); ++i)
+            {
+                Napi::Value name = arr.Get(i);
+                if (!name.IsString())
+                {
+                    Napi::TypeError::New(env, "option 'fields' must be an array of strings").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                fields.push_back(name.As<Napi::String>());
+            }
+        }
+        if (options.Has("filter"))
+        {
+            Napi::Value filter_opt = options.Get("filter");
+            if (filter_opt.IsString())
+            {
+                try
+                {
+                    filter = mapnik::parse_expression(filter_opt.As<Napi::String>());
+                }
+                catch (std::exception const& ex)
+                {
+                    Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+            }
+            else if (filter_opt.IsObject() && filter_opt.As<Napi::Object>().InstanceOf(Expression::constructor(env).Value()))
+            {
+                filter = Napi::ObjectWrap<Expression>::Unwrap(filter_opt.As<Napi::Object>())->expression_;
+            }
+            else
+            {
+                Napi::TypeError::New(env, "option 'filter' must be a mapnik.Expression or a string").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (options.Has("limit"))
+        {
+            Napi::Value limit_opt = options.Get("limit");
+            if (!limit_opt.IsNumber() || limit_opt.As<Napi::Number>().Int64Value() < 0)
+            {
+                Napi::TypeError::New(env, "option 'limit' must be a non-negative integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            limit = static_cast<std::size_t>(limit_opt.As<Napi::Number>().Int64Value());
+        }
+        if (options.Has("chunk_size"))
+        {
+            Napi::Value chunk_opt = options.Get("chunk_size");
+            if (!chunk_opt.IsNumber() || chunk_opt.As<Napi::Number>().Int64Value() <= 0)
+            {
+                Napi::TypeError::New(env, "option 'chunk_size' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            chunk_size = static_cast<std::size_t>(chunk_opt.As<Napi::Number>().Int64Value());
+        }
+        if (options.Has("geometry"))
+        {
+            Napi::Value geometry_opt = options.Get("geometry");
+            if (!geometry_opt.IsBoolean())
+            {
+                Napi::TypeError::New(env, "option 'geometry' must be a boolean").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            geometry = geometry_opt.As<Napi::Boolean>();
+        }
+        if (options.Has("on_chunk"))
+        {
+            Napi::Value on_chunk_opt = options.Get("on_chunk");
+            if (!on_chunk_opt.IsFunction())
+            {
+                Napi::TypeError::New(env, "option 'on_chunk' must be a function").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            on_chunk = on_chunk_opt.As<Napi::Function>();
+        }
+    }
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    auto* worker = new AsyncQuery{datasource_, extent, std::move(fields), filter, limit, chunk_size, geometry, on_chunk, callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
+/**
+ * Scan the whole datasource natively for a summary of its features, a lot faster
+ * than counting them through {@link Datasource#featureset}.
+ *
+ * @name stats
+ * @memberof Datasource
+ * @instance
+ * @param {Object} [options]
+ * @param {Array<string>} [options.fields] attributes to summarize, all fields by default
+ * @param {number} [options.sample] only scan the first `sample` features
+ * @param {Function} callback called with `(err, stats)` where stats is
+ * `{count, sampled, extent, geometry_types, fields}`. `geometry_types` counts
+ * features by geometry type name, `fields` has `{nulls, min, max, distinct}` per
+ * field where `distinct` is a HyperLogLog estimate (about 1.6% error) and
+ * `min`/`max` are numbers, or strings for text fields.
+ * @example
+ * ds.stats({fields: ['NAME', 'POP2005']}, function(err, stats) {
+ *   console.log(stats.count, stats.geometry_types.Polygon, stats.fields.POP2005.max);
+ * });
+ */
+Napi::Value Datasource::stats(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() == 0 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::vector<std::string> fields;
+    bool has_fields = false;
+    std::size_t sample = 0;
+    if (info.Length() > 1)
+    {
+        if (!info[0].IsObject())
+        {
+            Napi::TypeError::New(env, "optional first argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("fields"))
+        {
+            Napi::Value fields_opt = options.Get("fields");
+            if (!fields_opt.IsArray())
+            {
+                Napi::TypeError::New(env, "option 'fields' must be an array of strings").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            Napi::Array arr = fields_opt.As<Napi::Array>();
+            for (std::uint32_t i = 0; i < arr.Length(); ++i)
+            {
+                Napi::Value name = arr.Get(i);
+                if (!name.IsString())
+                {
+                    Napi::TypeError::New(env, "option 'fields' must be an array of strings").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                fields.push_back(name.As<Napi::String>());
+            }
+            has_fields = true;
+        }
+        if (options.Has("sample"))
+        {
+            Napi::Value sample_opt = options.Get("sample");
+            if (!sample_opt.IsNumber() || sample_opt.As<Napi::Number>().Int64Value() <= 0)
+            {
+                Napi::TypeError::New(env, "option 'sample' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            sample = static_cast<std::size_t>(sample_opt.As<Napi::Number>().Int64Value());
+        }
+    }
+    if (!has_fields)
+    {
+        try
+        {
+            for (auto const& desc : datasource_->get_descriptor().get_descriptors())
+            {
+                fields.push_back(desc.get_name());
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            // LCOV_EXCL_START
+            Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+            return env.Undefined();
+            // LCOV_EXCL_STOP
+        }
+    }
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    auto* worker = new AsyncStats{datasource_, std::move(fields), sample, callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
 /**
  * Get only the fields metadata from a dataset.
  *
@@ -312,3 +1071,250 @@ Napi::Value Datasource::fields(Napi::CallbackInfo const& info)
     node_mapnik::get_fields(env, fields, datasource_);
     return scope.Escape(fields);
 }
+
+/**
+ * Create an in-memory point datasource from columns of data, without any text parsing.
+ * Rows are spatially indexed, and queries only materialize features for the rows
+ * they hit, with just the requested attributes.
+ * Also available as `mapnik.MemoryDatasource.fromColumns`.
+ *
+ * @name fromColumns
+ * @memberof Datasource
+ * @static
+ * @param {Object} columns
+ * @param {Float64Array} columns.x x coordinate of every row
+ * @param {Float64Array} columns.y y coordinate of every row
+ * @param {TypedArray|Array<number>} [columns.ids] feature ids, defaults to row index + 1
+ * @param {Object} [columns.props] attribute columns by name, each a numeric typed array
+ * or an array of strings, numbers and booleans
+ * @returns {mapnik.Datasource} datasource
+ * @example
+ * var ds = mapnik.MemoryDatasource.fromColumns({
+ *   x: new Float64Array([1, 2]),
+ *   y: new Float64Array([3, 4]),
+ *   props: { speed: new Float32Array([12.5, 80]), name: ['bus 1', 'bus 2'] }
+ * });
+ */
+Napi::Value Datasource::fromColumns(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    Napi::EscapableHandleScope scope(env);
+    if (info.Length() != 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "requires an object of columns: {x: Float64Array, y: Float64Array}").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    std::vector<double> x;
+    std::vector<double> y;
+    if (!float64_column(env, options, "x", x) || !float64_column(env, options, "y", y)) return env.Undefined();
+    if (x.size() != y.size())
+    {
+        Napi::TypeError::New(env, "'x' and 'y' must have the same length").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::vector<mapnik::value_integer> ids;
+    ids.reserve(x.size());
+    if (options.Has("ids"))
+    {
+        std::vector<mapnik::value> id_values;
+        if (!column_to_values(env, options.Get("ids"), "ids", id_values)) return env.Undefined();
+        if (id_values.size() != x.size())
+        {
+            Napi::TypeError::New(env, "'ids' must have one value per row").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        for (auto const& val : id_values) ids.push_back(val.to_int());
+    }
+    else
+    {
+        for (std::size_t i = 0; i < x.size(); ++i) ids.push_back(static_cast<mapnik::value_integer>(i + 1));
+    }
+    std::vector<node_mapnik::attribute_column> columns;
+    if (!props_to_columns(env, options, x.size(), columns)) return env.Undefined();
+    try
+    {
+        datasource_ptr ds = std::make_shared<node_mapnik::columnar_datasource>(std::move(x), std::move(y), std::move(ids), std::move(columns));
+        Napi::Value arg = Napi::External<datasource_ptr>::New(env, &ds);
+        Napi::Object obj = constructor(env).New({arg});
+        return scope.Escape(obj);
+    }
+    catch (std::exception const& ex)
+    {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+}
+
+/**
+ * Update rows of a datasource created with {@link Datasource.fromColumns} in place.
+ * The spatial index is updated for moved rows only.
+ *
+ * @name updateColumns
+ * @memberof Datasource
+ * @instance
+ * @param {Uint32Array|Array<number>} rows row indexes to update
+ * @param {Object} columns new values, indexed like `rows`
+ * @param {Float64Array} [columns.x] new x coordinates, requires `y`
+ * @param {Float64Array} [columns.y] new y coordinates, requires `x`
+ * @param {Object} [columns.props] new attribute values for existing columns
+ * @example
+ * ds.updateColumns(new Uint32Array([1]), {x: new Float64Array([5]), y: new Float64Array([6])});
+ */
+Napi::Value Datasource::updateColumns(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    auto* columnar = dynamic_cast<node_mapnik::columnar_datasource*>(datasource_.get());
+    if (!columnar)
+    {
+        Napi::Error::New(env, "updateColumns is only supported by datasources created with fromColumns").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (info.Length() != 2 || !info[1].IsObject())
+    {
+        Napi::TypeError::New(env, "requires two arguments: an array of row indexes and an object of columns").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::vector<mapnik::value> row_values;
+    if (!column_to_values(env, info[0], "rows", row_values)) return env.Undefined();
+    std::vector<std::uint32_t> rows;
+    rows.reserve(row_values.size());
+    for (auto const& val : row_values)
+    {
+        mapnik::value_integer row = val.to_int();
+        if (row < 0)
+        {
+            Napi::TypeError::New(env, "row indexes must not be negative").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        rows.push_back(static_cast<std::uint32_t>(row));
+    }
+    Napi::Object options = info[1].As<Napi::Object>();
+    std::vector<double> x;
+    std::vector<double> y;
+    if (options.Has("x") || options.Has("y"))
+    {
+        if (!float64_column(env, options, "x", x) || !float64_column(env, options, "y", y)) return env.Undefined();
+        if (x.size() != rows.size() || y.size() != rows.size())
+        {
+            Napi::TypeError::New(env, "'x' and 'y' must have one value per updated row").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+    std::vector<node_mapnik::attribute_column> columns;
+    if (!props_to_columns(env, options, rows.size(), columns)) return env.Undefined();
+    try
+    {
+        columnar->update(rows, x, y, columns);
+    }
+    catch (std::exception const& ex)
+    {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
+}
+
+/**
+ * Wrap this datasource in a feature cache shared by everything that uses the
+ * returned datasource, across Map clones and render threads. Features are cached
+ * per cell of a grid that splits the datasource extent into `2^quantize_zoom`
+ * cells on each side, and per set of requested attributes. Overlapping queries,
+ * like neighbouring or buffered tiles, then read each cell from the wrapped
+ * datasource only once. Also available as `new mapnik.CachingDatasource(ds, options)`.
+ *
+ * Queries touching more than 64 cells and raster datasources bypass the cache.
+ * Updating a wrapped {@link Datasource.fromColumns} datasource with
+ * {@link Datasource#updateColumns} empties the cache and lays the grid out again
+ * over the new extent on the next query.
+ *
+ * @name withCache
+ * @memberof Datasource
+ * @instance
+ * @param {Object} [options]
+ * @param {number} [options.max_bytes=67108864] approximate memory budget,
+ * least recently used cells are evicted first
+ * @param {number} [options.quantize_zoom=10] cell grid level, between 0 and 20
+ * @returns {mapnik.Datasource} caching datasource
+ * @example
+ * var ds = new mapnik.Datasource({type: 'shape', file: 'roads.shp'});
+ * layer.datasource = ds.withCache({max_bytes: 256 * 1024 * 1024, quantize_zoom: 12});
+ */
+Napi::Value Datasource::withCache(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    Napi::EscapableHandleScope scope(env);
+    std::int64_t max_bytes = 64 * 1024 * 1024;
+    std::int64_t quantize_zoom = 10;
+    if (info.Length() > 0)
+    {
+        if (!info[0].IsObject())
+        {
+            Napi::TypeError::New(env, "optional first argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("max_bytes"))
+        {
+            Napi::Value bytes_opt = options.Get("max_bytes");
+            if (!bytes_opt.IsNumber() || bytes_opt.As<Napi::Number>().Int64Value() < 0)
+            {
+                Napi::TypeError::New(env, "option 'max_bytes' must be a non-negative number").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            max_bytes = bytes_opt.As<Napi::Number>().Int64Value();
+        }
+        if (options.Has("quantize_zoom"))
+        {
+            Napi::Value zoom_opt = options.Get("quantize_zoom");
+            if (!zoom_opt.IsNumber() || zoom_opt.As<Napi::Number>().Int64Value() < 0 ||
+                zoom_opt.As<Napi::Number>().Int64Value() > 20)
+            {
+                Napi::TypeError::New(env, "option 'quantize_zoom' must be an integer between 0 and 20").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            quantize_zoom = zoom_opt.As<Napi::Number>().Int64Value();
+        }
+    }
+    try
+    {
+        datasource_ptr ds = std::make_shared<node_mapnik::caching_datasource>(
+            datasource_, static_cast<std::size_t>(max_bytes), static_cast<unsigned>(quantize_zoom));
+        Napi::Value arg = Napi::External<datasource_ptr>::New(env, &ds);
+        Napi::Object obj = constructor(env).New({arg});
+        return scope.Escape(obj);
+    }
+    catch (std::exception const& ex)
+    {
+        // LCOV_EXCL_START
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+        // LCOV_EXCL_STOP
+    }
+}
+
+/**
+ * Get usage counters of a datasource created with {@link Datasource#withCache}.
+ *
+ * @name cacheStats
+ * @memberof Datasource
+ * @instance
+ * @returns {Object} `{hits, misses, evictions, bytes, cells}`
+ */
+Napi::Value Datasource::cacheStats(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    auto* caching = dynamic_cast<node_mapnik::caching_datasource*>(datasource_.get());
+    if (!caching)
+    {
+        Napi::Error::New(env, "cacheStats is only supported by datasources created with withCache").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto stats = caching->stats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    result.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    result.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+    result.Set("bytes", Napi::Number::New(env, static_cast<double>(stats.bytes)));
+    result.Set("cells", Napi::Number::New(env, static_cast<double>(stats.cells)));
+    return result;
+}
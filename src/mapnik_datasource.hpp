@@ -22,11 +22,17 @@ class Datasource : public Napi::ObjectWrap<Datasource>
     Napi::Value parameters(Napi::CallbackInfo const& info);
     Napi::Value describe(Napi::CallbackInfo const& info);
     Napi::Value featureset(Napi::CallbackInfo const& info);
+    Napi::Value query(Napi::CallbackInfo const& info);
+    Napi::Value stats(Napi::CallbackInfo const& info);
     Napi::Value extent(Napi::CallbackInfo const& info);
     Napi::Value fields(Napi::CallbackInfo const& info);
+    Napi::Value updateColumns(Napi::CallbackInfo const& info);
+    static Napi::Value fromColumns(Napi::CallbackInfo const& info);
+    Napi::Value withCache(Napi::CallbackInfo const& info);
+    Napi::Value cacheStats(Napi::CallbackInfo const& info);
     inline datasource_ptr impl() { return datasource_; }
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     datasource_ptr datasource_;
 };
@@ -1,25 +1,159 @@
 #include "utils.hpp"
+#include "instance_data.hpp"
 #include "mapnik_expression.hpp"
 #include "mapnik_feature.hpp"
+#include "mapnik_featureset.hpp"
 #include "object_to_container.hpp"
+#include "worker_pool.hpp"
 
 // mapnik
 #include <mapnik/attribute.hpp>
 #include <mapnik/expression_string.hpp>
 #include <mapnik/expression_evaluator.hpp>
 
-Napi::FunctionReference Expression::constructor;
+// stl
+#include <algorithm>
+#include <future>
+
+namespace {
+
+enum evaluate_result_type : std::uint8_t
+{
+    evaluate_result_value = 0,
+    evaluate_result_boolean,
+    evaluate_result_number
+};
+
+void evaluate_range(mapnik::expr_node const& expr,
+                    mapnik::attributes const& vars,
+                    std::vector<mapnik::feature_ptr> const& features,
+                    std::vector<mapnik::value>& values,
+                    std::size_t start,
+                    std::size_t count)
+{
+    using evaluator = mapnik::evaluate<mapnik::feature_impl, mapnik::value, mapnik::attributes>;
+    for (std::size_t i = start; i < start + count; ++i)
+    {
+        values[i] = mapnik::util::apply_visitor(evaluator(*features[i], vars), expr);
+    }
+}
+
+struct AsyncEvaluateMany : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncEvaluateMany(mapnik::expression_ptr const& expr,
+                      std::vector<mapnik::feature_ptr>&& features,
+                      mapnik::featureset_ptr const& featureset,
+                      mapnik::attributes&& vars,
+                      evaluate_result_type type,
+                      Napi::Function const& callback)
+        : Base(callback),
+          expr_(expr),
+          features_(std::move(features)),
+          featureset_(featureset),
+          vars_(std::move(vars)),
+          type_(type)
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            if (featureset_)
+            {
+                mapnik::feature_ptr feature;
+                while ((feature = featureset_->next()))
+                {
+                    features_.push_back(feature);
+                }
+            }
+            values_.resize(features_.size());
+            // the expression tree is immutable, so chunks can be evaluated concurrently
+            node_mapnik::task_group group;
+            std::size_t threads = std::min(group.threads(), std::max<std::size_t>(1, features_.size() / min_features_per_thread));
+            std::size_t chunk = (features_.size() + threads - 1) / threads;
+            std::vector<std::future<void>> results;
+            for (std::size_t start = 0; start < features_.size(); start += chunk)
+            {
+                std::size_t count = std::min(chunk, features_.size() - start);
+                results.push_back(group.run([this, start, count]() {
+                    evaluate_range(*expr_, vars_, features_, values_, start, count);
+                }));
+            }
+            for (auto& result : results)
+            {
+                group.get(result);
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        std::size_t size = values_.size();
+        Napi::Float64Array ids = Napi::Float64Array::New(env, size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            ids[i] = static_cast<double>(features_[i]->id());
+        }
+        if (type_ == evaluate_result_boolean)
+        {
+            Napi::Uint8Array result = Napi::Uint8Array::New(env, size);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                result[i] = values_[i].to_bool() ? 1 : 0;
+            }
+            return {env.Null(), result, ids};
+        }
+        else if (type_ == evaluate_result_number)
+        {
+            Napi::Float64Array result = Napi::Float64Array::New(env, size);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                result[i] = values_[i].to_double();
+            }
+            return {env.Null(), result, ids};
+        }
+        Napi::Array result = Napi::Array::New(env, size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            result.Set(static_cast<std::uint32_t>(i), mapnik::util::apply_visitor(node_mapnik::value_converter(env), values_[i]));
+        }
+        return {env.Null(), result, ids};
+    }
+
+  private:
+    // below this many features per thread evaluating in parallel is not worth a thread
+    static constexpr std::size_t min_features_per_thread = 4096;
+    mapnik::expression_ptr expr_;
+    std::vector<mapnik::feature_ptr> features_;
+    mapnik::featureset_ptr featureset_;
+    mapnik::attributes vars_;
+    evaluate_result_type type_;
+    std::vector<mapnik::value> values_;
+};
+
+} // namespace
+
+Napi::FunctionReference& Expression::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).expression;
+}
 
 Napi::Object Expression::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
     // clang-format off
     Napi::Function func = DefineClass(env, "Expression", {
             InstanceMethod<&Expression::evaluate>("evaluate", prop_attr),
+            InstanceMethod<&Expression::evaluateMany>("evaluateMany", prop_attr),
             InstanceMethod<&Expression::toString>("toString", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Expression", func);
     return exports;
 }
@@ -70,7 +204,7 @@ Napi::Value Expression::evaluate(Napi::CallbackInfo const& info)
         return env.Undefined();
     }
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Feature::constructor.Value()))
+    if (!obj.InstanceOf(Feature::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "first argument is invalid, must be a mapnik.Feature").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -103,3 +237,107 @@ Napi::Value Expression::evaluate(Napi::CallbackInfo const& info)
     value val = util::apply_visitor(mapnik::evaluate<feature_impl, value, attributes>(*f->impl(), vars), *expression_);
     return scope.Escape(util::apply_visitor(node_mapnik::value_converter(env), val));
 }
+
+/**
+ * Evaluate this expression against many features at once, off the main thread.
+ * Variables are converted once for the whole batch and large batches are
+ * split across threads.
+ *
+ * @name evaluateMany
+ * @memberof Expression
+ * @instance
+ * @param {Array<mapnik.Feature>|mapnik.Featureset} features features to evaluate; a
+ * Featureset is consumed by this call, its `next()` returns `null` afterwards
+ * @param {Object} [options]
+ * @param {Object} [options.variables] values for `@variable` references
+ * @param {string} [options.type='value'] `boolean` returns a Uint8Array of 0/1,
+ * `number` returns a Float64Array, `value` returns an Array of JS values
+ * @param {Function} callback - `function(err, results, ids)` where `ids` is a
+ * Float64Array of the id of each evaluated feature
+ * @example
+ * var expr = new mapnik.Expression("[pop] > 1000000");
+ * expr.evaluateMany(features, {type: 'boolean'}, function(err, matches, ids) {
+ *   if (err) throw err;
+ * });
+ */
+Napi::Value Expression::evaluateMany(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::vector<mapnik::feature_ptr> features;
+    Featureset* featureset_obj = nullptr;
+    if (info[0].IsArray())
+    {
+        Napi::Array arr = info[0].As<Napi::Array>();
+        features.reserve(arr.Length());
+        for (std::uint32_t i = 0; i < arr.Length(); ++i)
+        {
+            Napi::Value val = arr.Get(i);
+            if (!val.IsObject() || !val.As<Napi::Object>().InstanceOf(Feature::constructor(env).Value()))
+            {
+                Napi::TypeError::New(env, "item at index " + std::to_string(i) + " is not a mapnik.Feature").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            features.push_back(Napi::ObjectWrap<Feature>::Unwrap(val.As<Napi::Object>())->impl());
+        }
+    }
+    else if (info[0].IsObject() && info[0].As<Napi::Object>().InstanceOf(Featureset::constructor(env).Value()))
+    {
+        featureset_obj = Napi::ObjectWrap<Featureset>::Unwrap(info[0].As<Napi::Object>());
+    }
+    else
+    {
+        Napi::TypeError::New(env, "first argument must be an array of mapnik.Feature or a mapnik.Featureset").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    mapnik::attributes vars;
+    evaluate_result_type type = evaluate_result_value;
+    if (info.Length() > 2)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("variables"))
+        {
+            Napi::Value bind_opt = options.Get("variables");
+            if (!bind_opt.IsObject())
+            {
+                Napi::TypeError::New(env, "optional arg 'variables' must be an object").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            object_to_container(vars, bind_opt.As<Napi::Object>());
+        }
+        if (options.Has("type"))
+        {
+            Napi::Value type_opt = options.Get("type");
+            std::string type_str = type_opt.IsString() ? type_opt.As<Napi::String>().Utf8Value() : "";
+            if (type_str == "value")
+                type = evaluate_result_value;
+            else if (type_str == "boolean")
+                type = evaluate_result_boolean;
+            else if (type_str == "number")
+                type = evaluate_result_number;
+            else
+            {
+                Napi::TypeError::New(env, "optional arg 'type' must be one of 'value', 'boolean' or 'number'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+    }
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    // the worker drains the featureset off the JS thread, so it takes it over and
+    // next() on the Featureset returns null from now on
+    mapnik::featureset_ptr featureset;
+    if (featureset_obj) featureset = std::move(featureset_obj->featureset_);
+    auto* worker = new AsyncEvaluateMany{expression_, std::move(features), featureset, std::move(vars), type, callback};
+    worker->Queue();
+    return env.Undefined();
+}
@@ -6,13 +6,16 @@
 
 class Expression : public Napi::ObjectWrap<Expression>
 {
+    friend class Datasource;
+
   public:
     static Napi::Object Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr);
     explicit Expression(Napi::CallbackInfo const& info);
     Napi::Value toString(Napi::CallbackInfo const& info);
     Napi::Value evaluate(Napi::CallbackInfo const& info);
+    Napi::Value evaluateMany(Napi::CallbackInfo const& info);
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     mapnik::expression_ptr expression_;
 };
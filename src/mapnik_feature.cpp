@@ -1,6 +1,9 @@
 #include "utils.hpp"
+#include "instance_data.hpp"
 #include "mapnik_feature.hpp"
 #include "mapnik_geometry.hpp"
+#include "mapnik_projection.hpp"
+#include "worker_pool.hpp"
 
 // mapnik
 #include <mapnik/version.hpp>
@@ -9,8 +12,379 @@
 #include <mapnik/json/feature_parser.hpp>
 #include <mapnik/value/types.hpp>
 #include <mapnik/util/feature_to_geojson.hpp>
+#include <mapnik/util/geometry_to_geojson.hpp>
+#include <mapnik/util/geometry_to_wkt.hpp>
+#include <mapnik/util/geometry_to_wkb.hpp>
+#include <mapnik/geometry/reprojection.hpp>
+#include <mapnik/proj_transform.hpp>
+// stl
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <limits>
 
-Napi::FunctionReference Feature::constructor;
+namespace {
+
+enum serialize_format : std::uint8_t
+{
+    serialize_geojson = 0,
+    serialize_wkb,
+    serialize_wkt
+};
+
+struct serialize_item
+{
+    mapnik::feature_ptr feature;
+    // mapnik.Geometry inputs only serialize the geometry, not the whole feature
+    bool geometry_only;
+};
+
+bool serialize_one(std::string& out,
+                   serialize_item const& item,
+                   serialize_format format,
+                   mapnik::proj_transform const* prj_trans)
+{
+    mapnik::feature_impl const& feature = *item.feature;
+    mapnik::geometry::geometry<double> projected;
+    mapnik::geometry::geometry<double> const* geom = &feature.get_geometry();
+    if (prj_trans)
+    {
+        unsigned int n_err = 0;
+        projected = mapnik::geometry::reproject_copy(*geom, *prj_trans, n_err);
+        if (n_err > 0) return false;
+        geom = &projected;
+    }
+    switch (format)
+    {
+    case serialize_wkb: {
+        mapnik::util::wkb_buffer_ptr wkb = mapnik::util::to_wkb(*geom, mapnik::wkbNDR);
+        // null geometries have no WKB representation and yield an empty entry
+        if (wkb) out.append(wkb->buffer(), wkb->size());
+        return true;
+    }
+    case serialize_wkt: {
+        std::string wkt;
+        if (!mapnik::util::to_wkt(wkt, *geom)) return false;
+        out += wkt;
+        return true;
+    }
+    default: {
+        std::string json;
+        if (item.geometry_only)
+        {
+            if (!mapnik::util::to_geojson(json, *geom)) return false;
+        }
+        else if (prj_trans)
+        {
+            mapnik::feature_impl feature_new(item.feature->context(), feature.id());
+            feature_new.set_data(feature.get_data());
+            feature_new.set_geometry(std::move(projected));
+            if (!mapnik::util::to_geojson(json, feature_new)) return false;
+        }
+        else if (!mapnik::util::to_geojson(json, feature))
+        {
+            return false;
+        }
+        out += json;
+        return true;
+    }
+    }
+}
+
+struct AsyncSerializeMany : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncSerializeMany(std::vector<serialize_item>&& items,
+                       serialize_format format,
+                       proj_ptr source,
+                       proj_ptr dest,
+                       Napi::Function const& callback)
+        : Base(callback),
+          items_(std::move(items)),
+          format_(format),
+          source_(source),
+          dest_(dest),
+          data_(std::make_unique<std::string>())
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            // a transform of our own: PJ objects must not be shared with the main thread
+            std::unique_ptr<mapnik::proj_transform> prj_trans;
+            if (source_ && dest_)
+            {
+                prj_trans = std::make_unique<mapnik::proj_transform>(*source_, *dest_);
+            }
+            offsets_.reserve(items_.size() + 1);
+            for (std::size_t i = 0; i < items_.size(); ++i)
+            {
+                offsets_.push_back(data_->size());
+                if (!serialize_one(*data_, items_[i], format_, prj_trans.get()))
+                {
+                    SetError("Failed to serialize feature at index " + std::to_string(i));
+                    return;
+                }
+            }
+            offsets_.push_back(data_->size());
+            if (data_->size() > std::numeric_limits<std::uint32_t>::max())
+            {
+                SetError("serialized output exceeds 4GB, split the input into smaller batches");
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        std::string& str = *data_;
+        auto buffer = Napi::Buffer<char>::New(
+            env,
+            str.empty() ? nullptr : &str[0],
+            str.size(),
+            [](Napi::Env env_, char* /*unused*/, std::string* str_ptr) {
+                if (str_ptr != nullptr)
+                {
+                    Napi::MemoryManagement::AdjustExternalMemory(env_, -static_cast<std::int64_t>(str_ptr->size()));
+                }
+                delete str_ptr;
+            },
+            data_.release());
+        Napi::MemoryManagement::AdjustExternalMemory(env, static_cast<std::int64_t>(str.size()));
+        Napi::Uint32Array offsets = Napi::Uint32Array::New(env, offsets_.size());
+        for (std::size_t i = 0; i < offsets_.size(); ++i)
+        {
+            offsets[i] = static_cast<std::uint32_t>(offsets_[i]);
+        }
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("data", buffer);
+        result.Set("offsets", offsets);
+        return {env.Null(), result};
+    }
+
+  private:
+    std::vector<serialize_item> items_;
+    serialize_format format_;
+    proj_ptr source_;
+    proj_ptr dest_;
+    std::unique_ptr<std::string> data_;
+    std::vector<std::size_t> offsets_;
+};
+
+struct feature_span
+{
+    std::size_t begin;
+    std::size_t end;
+};
+
+// Finds complete Feature objects inside the "features" array of a GeoJSON
+// FeatureCollection without parsing them. `in_features` and `done` carry the
+// scanner state between chunks; the returned offset is the number of bytes that
+// never need to be scanned again. Anything after it (a partial feature, or the
+// collection header while "features" has not been reached yet) must be passed
+// again, followed by the next chunk.
+std::size_t scan_features(char const* data, std::size_t size, bool& in_features, bool& done, std::vector<feature_span>& spans)
+{
+    std::size_t consumed = 0;
+    std::size_t depth = 0; // relative to the collection object, or to the features array once inside it
+    std::size_t string_start = 0;
+    std::size_t feature_start = 0;
+    bool in_string = false;
+    bool escape = false;
+    bool features_key = false;
+    bool expect_array = false;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        char c = data[i];
+        if (in_string)
+        {
+            if (escape)
+            {
+                escape = false;
+            }
+            else if (c == '\\')
+            {
+                escape = true;
+            }
+            else if (c == '"')
+            {
+                in_string = false;
+                if (!in_features && depth == 1)
+                {
+                    features_key = (i - string_start == 8 && std::memcmp(data + string_start, "features", 8) == 0);
+                }
+            }
+            continue;
+        }
+        if (expect_array && c != '[' && c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            expect_array = false;
+        }
+        switch (c)
+        {
+        case '"':
+            in_string = true;
+            string_start = i + 1;
+            break;
+        case ':':
+            expect_array = !in_features && depth == 1 && features_key;
+            break;
+        case '{':
+        case '[':
+            if (!in_features && expect_array)
+            {
+                in_features = true;
+                expect_array = false;
+                depth = 0;
+                consumed = i + 1;
+                break;
+            }
+            if (in_features && depth == 0)
+            {
+                if (c != '{') throw std::runtime_error("malformed GeoJSON: expected a Feature object in 'features'");
+                feature_start = i;
+            }
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (depth == 0)
+            {
+                if (in_features && c == ']')
+                {
+                    done = true;
+                    return i + 1;
+                }
+                throw std::runtime_error("malformed GeoJSON: unbalanced brackets");
+            }
+            --depth;
+            if (in_features && depth == 0)
+            {
+                spans.push_back({feature_start, i + 1});
+                consumed = i + 1;
+            }
+            else if (!in_features && depth == 0)
+            {
+                // the collection closed without a "features" member
+                done = true;
+                return i + 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return consumed;
+}
+
+bool parse_feature_spans(char const* data,
+                         feature_span const* spans,
+                         std::size_t count,
+                         std::size_t first,
+                         mapnik::value_integer first_id,
+                         std::vector<mapnik::feature_ptr>& features)
+{
+    // context_type is not thread safe, so every thread gets its own
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string json(data + spans[i].begin, spans[i].end - spans[i].begin);
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, first_id + static_cast<mapnik::value_integer>(first + i)));
+        if (!mapnik::json::from_geojson(json, *feature)) return false;
+        features[first + i] = feature;
+    }
+    return true;
+}
+
+struct AsyncFromJSONChunk : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncFromJSONChunk(Napi::Buffer<char> const& buffer, bool in_features, mapnik::value_integer first_id, Napi::Function const& callback)
+        : Base(callback),
+          buffer_ref_(Napi::Persistent(buffer)),
+          data_(buffer.Data()),
+          size_(buffer.Length()),
+          in_features_(in_features),
+          first_id_(first_id)
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            std::vector<feature_span> spans;
+            consumed_ = scan_features(data_, size_, in_features_, done_, spans);
+            features_.resize(spans.size());
+            node_mapnik::task_group group;
+            std::size_t threads = std::min(group.threads(), std::max<std::size_t>(1, spans.size() / min_features_per_thread));
+            std::size_t chunk = (spans.size() + threads - 1) / threads;
+            std::vector<std::future<bool>> results;
+            for (std::size_t start = 0; start < spans.size(); start += chunk)
+            {
+                std::size_t count = std::min(chunk, spans.size() - start);
+                results.push_back(group.run([this, &spans, start, count]() {
+                    return parse_feature_spans(data_, spans.data() + start, count, start, first_id_, features_);
+                }));
+            }
+            bool success = true;
+            for (auto& result : results)
+            {
+                if (!group.get(result)) success = false;
+            }
+            if (!success)
+            {
+                SetError("Failed to read GeoJSON");
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        Napi::Array features = Napi::Array::New(env, features_.size());
+        for (std::size_t i = 0; i < features_.size(); ++i)
+        {
+            Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &features_[i]);
+            features.Set(static_cast<std::uint32_t>(i), Feature::constructor(env).New({arg}));
+        }
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("features", features);
+        result.Set("consumed", Napi::Number::New(env, static_cast<double>(consumed_)));
+        result.Set("in_features", Napi::Boolean::New(env, in_features_));
+        result.Set("done", Napi::Boolean::New(env, done_));
+        result.Set("next_id", Napi::Number::New(env, static_cast<double>(first_id_ + static_cast<mapnik::value_integer>(features_.size()))));
+        return {env.Null(), result};
+    }
+
+  private:
+    // below this many features per thread parsing in parallel is not worth a thread
+    static constexpr std::size_t min_features_per_thread = 256;
+    Napi::Reference<Napi::Buffer<char>> buffer_ref_;
+    char const* data_;
+    std::size_t size_;
+    bool in_features_;
+    mapnik::value_integer first_id_;
+    bool done_ = false;
+    std::size_t consumed_ = 0;
+    std::vector<mapnik::feature_ptr> features_;
+};
+
+} // namespace
+
+Napi::FunctionReference& Feature::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).feature;
+}
 
 Napi::Object Feature::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -21,11 +395,12 @@ Napi::Object Feature::Initialize(Napi::Env env, Napi::Object exports, napi_prope
             InstanceMethod<&Feature::attributes>("attributes", prop_attr),
             InstanceMethod<&Feature::geometry>("geometry", prop_attr),
             InstanceMethod<&Feature::toJSON>("toJSON", prop_attr),
-            StaticMethod<&Feature::fromJSON>("fromJSON", prop_attr)
+            StaticMethod<&Feature::fromJSON>("fromJSON", prop_attr),
+            StaticMethod<&Feature::serializeMany>("serializeMany", prop_attr),
+            StaticMethod<&Feature::fromJSONChunk>("fromJSONChunk", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Feature", func);
     return exports;
 }
@@ -92,7 +467,7 @@ Napi::Value Feature::fromJSON(Napi::CallbackInfo const& info)
             return env.Undefined();
         }
         Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &feature);
-        Napi::Object obj = Feature::constructor.New({arg});
+        Napi::Object obj = Feature::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     catch (std::exception const& ex)
@@ -176,7 +551,7 @@ Napi::Value Feature::geometry(Napi::CallbackInfo const& info)
     Napi::Env env = info.Env();
     Napi::EscapableHandleScope scope(env);
     Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &feature_);
-    Napi::Object obj = Geometry::constructor.New({arg});
+    Napi::Object obj = Geometry::constructor(env).New({arg});
     return scope.Escape(obj);
 }
 
@@ -201,3 +576,183 @@ Napi::Value Feature::toJSON(Napi::CallbackInfo const& info)
     }
     return Napi::String::New(env, json);
 }
+
+/**
+ * Serialize many features or geometries into one contiguous buffer, off the main thread.
+ *
+ * Entry `i` of the result occupies `data.slice(offsets[i], offsets[i + 1])`.
+ * Features are written as GeoJSON Feature objects, geometries as GeoJSON
+ * geometry objects. With `wkb` and `wkt` only the geometry is written. Null
+ * geometries produce an empty WKB entry.
+ *
+ * @memberof Feature
+ * @static
+ * @name serializeMany
+ * @param {Array<mapnik.Feature|mapnik.Geometry>} features
+ * @param {Object} [options]
+ * @param {string} [options.format='geojson'] one of `geojson`, `wkb` or `wkt`
+ * @param {mapnik.ProjTransform} [options.transform] reproject every geometry before serializing
+ * @param {Function} callback - `function(err, result)` where result is `{data: Buffer, offsets: Uint32Array}`
+ * @example
+ * mapnik.Feature.serializeMany(features, {format: 'wkb'}, function(err, result) {
+ *   if (err) throw err;
+ *   var first = result.data.slice(result.offsets[0], result.offsets[1]);
+ * });
+ */
+Napi::Value Feature::serializeMany(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[0].IsArray())
+    {
+        Napi::TypeError::New(env, "first argument must be an array of mapnik.Feature or mapnik.Geometry objects").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Array features = info[0].As<Napi::Array>();
+    std::vector<serialize_item> items;
+    items.reserve(features.Length());
+    for (std::uint32_t i = 0; i < features.Length(); ++i)
+    {
+        Napi::Value val = features.Get(i);
+        if (val.IsObject())
+        {
+            Napi::Object obj = val.As<Napi::Object>();
+            if (obj.InstanceOf(Feature::constructor(env).Value()))
+            {
+                items.push_back({Napi::ObjectWrap<Feature>::Unwrap(obj)->impl(), false});
+                continue;
+            }
+            if (obj.InstanceOf(Geometry::constructor(env).Value()))
+            {
+                items.push_back({Napi::ObjectWrap<Geometry>::Unwrap(obj)->feature_, true});
+                continue;
+            }
+        }
+        Napi::TypeError::New(env, "item at index " + std::to_string(i) + " is not a mapnik.Feature or mapnik.Geometry").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    serialize_format format = serialize_geojson;
+    proj_ptr source;
+    proj_ptr dest;
+    if (info.Length() > 2)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("format"))
+        {
+            Napi::Value format_opt = options.Get("format");
+            if (!format_opt.IsString())
+            {
+                Napi::TypeError::New(env, "'format' must be a string").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            std::string format_str = format_opt.As<Napi::String>();
+            if (format_str == "geojson")
+                format = serialize_geojson;
+            else if (format_str == "wkb")
+                format = serialize_wkb;
+            else if (format_str == "wkt")
+                format = serialize_wkt;
+            else
+            {
+                Napi::TypeError::New(env, "'format' must be one of 'geojson', 'wkb' or 'wkt'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (options.Has("transform"))
+        {
+            Napi::Value transform_opt = options.Get("transform");
+            if (!transform_opt.IsObject() ||
+                !transform_opt.As<Napi::Object>().InstanceOf(ProjTransform::constructor(env).Value()))
+            {
+                Napi::TypeError::New(env, "'transform' must be a mapnik.ProjTransform").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            ProjTransform* tr = Napi::ObjectWrap<ProjTransform>::Unwrap(transform_opt.As<Napi::Object>());
+            source = tr->source();
+            dest = tr->dest();
+        }
+    }
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    auto* worker = new AsyncSerializeMany{std::move(items), format, source, dest, callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
+/**
+ * Parse the next chunk of a GeoJSON FeatureCollection into features, off the main thread.
+ * Feature boundaries are found with a quick scan first, then the features are
+ * parsed in parallel. This is the building block of {@link Feature.fromJSONStream}.
+ *
+ * The result carries the scanner state: pass `buffer.slice(result.consumed)`
+ * followed by the next chunk, `result.in_features` and `result.next_id` (as
+ * `first_id`) to the next call, so feature ids keep counting across chunks.
+ *
+ * @memberof Feature
+ * @static
+ * @name fromJSONChunk
+ * @param {Buffer} buffer GeoJSON bytes
+ * @param {Object} [options]
+ * @param {boolean} [options.in_features=false] whether `buffer` starts inside the `features` array
+ * @param {number} [options.first_id=1] id of the first feature in `buffer`
+ * @param {Function} callback - `function(err, result)` where result is
+ * `{features: Array<mapnik.Feature>, consumed: number, in_features: boolean, done: boolean, next_id: number}`
+ */
+Napi::Value Feature::fromJSONChunk(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[0].IsBuffer())
+    {
+        Napi::TypeError::New(env, "first argument must be a Buffer").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    bool in_features = false;
+    mapnik::value_integer first_id = 1;
+    if (info.Length() > 2)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("in_features"))
+        {
+            Napi::Value in_features_opt = options.Get("in_features");
+            if (!in_features_opt.IsBoolean())
+            {
+                Napi::TypeError::New(env, "'in_features' must be a Boolean").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            in_features = in_features_opt.As<Napi::Boolean>();
+        }
+        if (options.Has("first_id"))
+        {
+            Napi::Value first_id_opt = options.Get("first_id");
+            if (!first_id_opt.IsNumber())
+            {
+                Napi::TypeError::New(env, "'first_id' must be a number").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            first_id = first_id_opt.As<Napi::Number>().Int64Value();
+        }
+    }
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    auto* worker = new AsyncFromJSONChunk{info[0].As<Napi::Buffer<char>>(), in_features, first_id, callback};
+    worker->Queue();
+    return env.Undefined();
+}
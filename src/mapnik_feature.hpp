@@ -17,13 +17,15 @@ class Feature : public Napi::ObjectWrap<Feature>
     explicit Feature(Napi::CallbackInfo const& info);
     // methods
     static Napi::Value fromJSON(Napi::CallbackInfo const& info);
+    static Napi::Value serializeMany(Napi::CallbackInfo const& info);
+    static Napi::Value fromJSONChunk(Napi::CallbackInfo const& info);
     Napi::Value id(Napi::CallbackInfo const& info);
     Napi::Value extent(Napi::CallbackInfo const& info);
     Napi::Value attributes(Napi::CallbackInfo const& info);
     Napi::Value geometry(Napi::CallbackInfo const& info);
     Napi::Value toJSON(Napi::CallbackInfo const& info);
     inline mapnik::feature_ptr impl() const { return feature_; }
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
 
   private:
     mapnik::feature_ptr feature_;
@@ -1,7 +1,11 @@
 #include "mapnik_featureset.hpp"
+#include "instance_data.hpp"
 #include "mapnik_feature.hpp"
 
-Napi::FunctionReference Featureset::constructor;
+Napi::FunctionReference& Featureset::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).featureset;
+}
 
 Napi::Object Featureset::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -10,8 +14,7 @@ Napi::Object Featureset::Initialize(Napi::Env env, Napi::Object exports, napi_pr
             InstanceMethod<&Featureset::next>("next", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Featureset", func);
     return exports;
 }
@@ -74,7 +77,7 @@ Napi::Value Featureset::next(Napi::CallbackInfo const& info)
         if (feature)
         {
             Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &feature);
-            Napi::Object obj = Feature::constructor.New({arg});
+            Napi::Object obj = Feature::constructor(env).New({arg});
             return scope.Escape(obj);
         }
     }
@@ -11,6 +11,7 @@ struct AsyncQueryPoint;
 class Featureset : public Napi::ObjectWrap<Featureset>
 {
     friend class Datasource;
+    friend class Expression;
     friend struct detail::AsyncQueryPoint;
 
   public:
@@ -22,6 +23,6 @@ class Featureset : public Napi::ObjectWrap<Featureset>
     Napi::Value next(Napi::CallbackInfo const& info);
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     featureset_ptr featureset_;
 };
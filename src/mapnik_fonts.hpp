@@ -1,12 +1,254 @@
 #pragma once
+#include "worker_pool.hpp"
 
 // mapnik
 #include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/util/fs.hpp>
 // stl
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <vector>
+// posix
+#include <sys/stat.h>
 
 namespace node_mapnik {
 
+namespace detail {
+
+// One entry of the on-disk face index: a font file, the stat() values it was
+// probed with and the faces FreeType found in it (none for files without faces)
+struct font_file_entry
+{
+    std::int64_t mtime = 0;
+    std::int64_t size = 0;
+    std::vector<std::pair<std::string, int>> faces;
+};
+
+using font_index = std::map<std::string, font_file_entry>;
+
+// Index lines are tab separated: path, mtime, size, face index (-1 for none), face name
+static inline font_index read_font_index(std::string const& index_file)
+{
+    font_index index;
+    std::ifstream in(index_file.c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string path, mtime, size, face_index, face_name;
+        if (!std::getline(fields, path, '\t') || !std::getline(fields, mtime, '\t') ||
+            !std::getline(fields, size, '\t') || !std::getline(fields, face_index, '\t'))
+        {
+            continue;
+        }
+        std::getline(fields, face_name);
+        try
+        {
+            font_file_entry& entry = index[path];
+            entry.mtime = std::stoll(mtime);
+            entry.size = std::stoll(size);
+            int face = std::stoi(face_index);
+            if (face >= 0) entry.faces.emplace_back(face_name, face);
+        }
+        catch (std::exception const&)
+        {
+            // a corrupt line only means that file gets probed again
+            index.erase(path);
+        }
+    }
+    return index;
+}
+
+static inline void write_font_index(std::string const& index_file, font_index const& index)
+{
+    std::string tmp = index_file + ".tmp";
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc);
+        if (!out) throw std::runtime_error("could not write font index '" + index_file + "'");
+        for (auto const& kv : index)
+        {
+            if (kv.second.faces.empty())
+            {
+                out << kv.first << '\t' << kv.second.mtime << '\t' << kv.second.size << "\t-1\t\n";
+            }
+            for (auto const& face : kv.second.faces)
+            {
+                out << kv.first << '\t' << kv.second.mtime << '\t' << kv.second.size << '\t'
+                    << face.second << '\t' << face.first << '\n';
+            }
+        }
+    }
+    // replace the index in one step so a concurrent reader never sees half of it
+    if (std::rename(tmp.c_str(), index_file.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("could not write font index '" + index_file + "'");
+    }
+}
+
+// Same file selection as freetype_engine::register_fonts: font extensions only,
+// hidden files skipped
+static inline void list_font_files(std::string const& dir, bool recurse, std::vector<std::string>& files)
+{
+    if (!mapnik::util::exists(dir)) return;
+    if (!mapnik::util::is_directory(dir))
+    {
+        if (mapnik::freetype_engine::is_font_file(dir)) files.push_back(dir);
+        return;
+    }
+    for (auto const& file_name : mapnik::util::list_directory(dir))
+    {
+        std::string base_name = file_name.substr(file_name.find_last_of("/\\") + 1);
+        if (base_name.empty() || base_name[0] == '.') continue;
+        if (mapnik::util::is_directory(file_name))
+        {
+            if (recurse) list_font_files(file_name, recurse, files);
+        }
+        else if (mapnik::freetype_engine::is_font_file(file_name))
+        {
+            files.push_back(file_name);
+        }
+    }
+}
+
+// freetype_engine only hands out a const view of its face mapping, and guards
+// it with the mutex of mapnik's singleton base, which derived classes reach.
+// Faces are merged into it under that mutex, as register_font does.
+struct font_engine_access : mapnik::freetype_engine
+{
+#if defined(MAPNIK_THREADSAFE)
+    static std::mutex& mutex() { return mutex_; }
+#endif
+    static font_file_mapping_type& mapping()
+    {
+        return const_cast<font_file_mapping_type&>(get_mapping());
+    }
+};
+
+struct AsyncRegisterFonts : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncRegisterFonts(std::string const& path, bool recurse, std::string const& index_file, Napi::Function const& callback)
+        : Base(callback),
+          path_(path),
+          recurse_(recurse),
+          index_file_(index_file) {}
+
+    void Execute() override
+    {
+        try
+        {
+            std::vector<std::string> files;
+            list_font_files(path_, recurse_, files);
+            font_index index;
+            if (!index_file_.empty()) index = read_font_index(index_file_);
+            // only files that are new or changed since the index was written are probed
+            std::vector<std::pair<std::string, font_file_entry>> probe;
+            for (auto const& file : files)
+            {
+                struct stat st;
+                if (::stat(file.c_str(), &st) != 0) continue;
+                font_file_entry entry;
+                entry.mtime = static_cast<std::int64_t>(st.st_mtime);
+                entry.size = static_cast<std::int64_t>(st.st_size);
+                auto itr = index.find(file);
+                if (itr != index.end() && itr->second.mtime == entry.mtime && itr->second.size == entry.size)
+                {
+                    merge(file, itr->second);
+                    continue;
+                }
+                probe.emplace_back(file, std::move(entry));
+            }
+            std::size_t threads = std::min(task_threads(), probe.size());
+            parallel_for(threads, [&probe, threads](std::size_t t) {
+                // FT_Library handles are not thread safe, every task opens its own
+                mapnik::font_library library;
+                for (std::size_t i = t; i < probe.size(); i += threads)
+                {
+                    mapnik::freetype_engine::font_file_mapping_type mapping;
+                    mapnik::freetype_engine::register_font_impl(probe[i].first, library, mapping);
+                    for (auto const& kv : mapping)
+                    {
+                        probe[i].second.faces.emplace_back(kv.first, kv.second.first);
+                    }
+                }
+            });
+            for (auto& item : probe)
+            {
+                merge(item.first, item.second);
+                // paths the tab separated index cannot represent are simply probed every time
+                if (item.first.find_first_of("\t\n") == std::string::npos)
+                {
+                    index[item.first] = std::move(item.second);
+                }
+            }
+            if (!index_file_.empty() && !probe.empty()) write_font_index(index_file_, index);
+            if (!mapping_.empty())
+            {
+#if defined(MAPNIK_THREADSAFE)
+                std::lock_guard<std::mutex> lock(font_engine_access::mutex());
+#endif
+                auto& mapping = font_engine_access::mapping();
+                for (auto const& kv : mapping_)
+                {
+                    mapping.insert(kv);
+                }
+                found_ = true;
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        return {env.Null(), Napi::Boolean::New(env, found_)};
+    }
+
+  private:
+    // like register_font_impl, the first file found for a face name wins
+    void merge(std::string const& file, font_file_entry const& entry)
+    {
+        for (auto const& face : entry.faces)
+        {
+            mapping_.emplace(face.first, std::make_pair(face.second, file));
+        }
+    }
+
+    std::string path_;
+    bool recurse_;
+    std::string index_file_;
+    mapnik::freetype_engine::font_file_mapping_type mapping_;
+    bool found_ = false;
+};
+
+} // namespace detail
+
+/**
+ * Register fonts in a directory. Pass a callback to scan and probe font files
+ * off the main thread, in parallel on the pool set with `mapnik.setThreadPool`;
+ * with `index_file`, the faces found are stored on disk keyed by file path,
+ * mtime and size, and later calls register the indexed faces directly and only
+ * probe files that are new or changed.
+ *
+ * @name registerFonts
+ * @memberof mapnik
+ * @static
+ * @param {string} path directory or font file
+ * @param {Object} [options]
+ * @param {boolean} [options.recurse=false]
+ * @param {string} [options.index_file] face index to read and update, async only
+ * @param {Function} [callback] called with `(err, found)`
+ * @returns {boolean|undefined} whether new fonts were found, when called without callback
+ * @example
+ * mapnik.registerFonts('/usr/share/fonts', {recurse: true, index_file: '/tmp/fonts.idx'}, function(err, found) {});
+ */
 static inline Napi::Value register_fonts(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
@@ -17,6 +259,45 @@ static inline Napi::Value register_fonts(Napi::CallbackInfo const& info)
             Napi::TypeError::New(env, "first argument must be a path to a directory of fonts").ThrowAsJavaScriptException();
             return env.Undefined();
         }
+        if (info[info.Length() - 1].IsFunction())
+        {
+            bool recurse = false;
+            std::string index_file;
+            if (info.Length() > 2)
+            {
+                if (!info[1].IsObject())
+                {
+                    Napi::TypeError::New(env, "second argument is optional, but if provided must be an object, eg. { recurse: true }")
+                        .ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                Napi::Object options = info[1].As<Napi::Object>();
+                if (options.Has("recurse"))
+                {
+                    Napi::Value recurse_opt = options.Get("recurse");
+                    if (!recurse_opt.IsBoolean())
+                    {
+                        Napi::TypeError::New(env, "'recurse' must be a Boolean").ThrowAsJavaScriptException();
+                        return env.Undefined();
+                    }
+                    recurse = recurse_opt.As<Napi::Boolean>();
+                }
+                if (options.Has("index_file"))
+                {
+                    Napi::Value index_opt = options.Get("index_file");
+                    if (!index_opt.IsString())
+                    {
+                        Napi::TypeError::New(env, "'index_file' must be a string").ThrowAsJavaScriptException();
+                        return env.Undefined();
+                    }
+                    index_file = index_opt.As<Napi::String>();
+                }
+            }
+            std::string path = info[0].As<Napi::String>();
+            auto* worker = new detail::AsyncRegisterFonts(path, recurse, index_file, info[info.Length() - 1].As<Napi::Function>());
+            worker->Queue();
+            return env.Undefined();
+        }
         bool found = false;
         // option hash
         if (info.Length() >= 2)
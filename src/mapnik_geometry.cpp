@@ -1,6 +1,8 @@
 #include "utils.hpp"
+#include "instance_data.hpp"
 #include "mapnik_geometry.hpp"
 #include "mapnik_projection.hpp"
+#include "worker_pool.hpp"
 
 #include <mapnik/datasource.hpp>
 #include <mapnik/geometry/reprojection.hpp>
@@ -20,9 +22,9 @@ bool to_geojson_projected(std::string& json,
     return mapnik::util::to_geojson(json, projected_geom);
 }
 
-struct AsyncToJSON : Napi::AsyncWorker
+struct AsyncToJSON : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncToJSON(Geometry* geom, ProjTransform* tr, Napi::Function const& callback)
         : Base(callback),
           geom_(geom),
@@ -78,7 +80,10 @@ struct AsyncToJSON : Napi::AsyncWorker
 
 } // namespace
 
-Napi::FunctionReference Geometry::constructor;
+Napi::FunctionReference& Geometry::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).geometry;
+}
 
 Napi::Object Geometry::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -100,8 +105,7 @@ Napi::Object Geometry::Initialize(Napi::Env env, Napi::Object exports, napi_prop
             StaticValue("GeometryCollection", Napi::Number::New(env, mapnik::geometry::geometry_types::GeometryCollection), napi_enumerable)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Geometry", func);
     return exports;
 }
@@ -195,7 +199,7 @@ Napi::Value Geometry::toJSONSync(Napi::CallbackInfo const& info)
                 return env.Undefined();
             }
             Napi::Object obj = bound_opt.As<Napi::Object>();
-            if (!obj.InstanceOf(ProjTransform::constructor.Value()))
+            if (!obj.InstanceOf(ProjTransform::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.ProjTransform expected as first arg").ThrowAsJavaScriptException();
                 return env.Undefined();
@@ -256,7 +260,7 @@ Napi::Value Geometry::toJSON(Napi::CallbackInfo const& info)
             }
 
             Napi::Object obj = bound_opt.As<Napi::Object>();
-            if (!obj.InstanceOf(ProjTransform::constructor.Value()))
+            if (!obj.InstanceOf(ProjTransform::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.ProjTransform expected as first arg").ThrowAsJavaScriptException();
                 return env.Undefined();
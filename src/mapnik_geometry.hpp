@@ -27,6 +27,6 @@ class Geometry : public Napi::ObjectWrap<Geometry>
     }
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     mapnik::feature_ptr feature_;
 };
@@ -2,22 +2,60 @@
 
 // mapnik
 #include <mapnik/version.hpp>
+#include <mapnik/grid/grid_view.hpp>
 
 #include "mapnik_grid.hpp"
+#include "instance_data.hpp"
 #include "mapnik_grid_view.hpp"
 #include "js_grid_utils.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
 
 // std
+#include <algorithm>
 #include <exception>
 
 namespace detail {
 
+// Hands the encoded bytes to a Buffer without copying them
+Napi::Value binary_grid_buffer(Napi::Env env, std::unique_ptr<std::string> data)
+{
+    std::string& str = *data;
+    auto buffer = Napi::Buffer<char>::New(
+        env,
+        str.empty() ? nullptr : &str[0],
+        str.size(),
+        [](Napi::Env env_, char* /*unused*/, std::string* str_ptr) {
+            if (str_ptr != nullptr)
+            {
+                Napi::MemoryManagement::AdjustExternalMemory(env_, -static_cast<std::int64_t>(str_ptr->size()));
+            }
+            delete str_ptr;
+        },
+        data.release());
+    Napi::MemoryManagement::AdjustExternalMemory(env, static_cast<std::int64_t>(str.size()));
+    return buffer;
+}
+
+bool parse_grid_format(Napi::Env env, Napi::Object const& options, bool& binary)
+{
+    if (!options.Has("format")) return true;
+    Napi::Value format_opt = options.Get("format");
+    std::string format = format_opt.IsString() ? format_opt.As<Napi::String>().Utf8Value() : "";
+    if (format != "utf" && format != "binary")
+    {
+        Napi::TypeError::New(env, "'format' must be 'utf' or 'binary'").ThrowAsJavaScriptException();
+        return false;
+    }
+    binary = (format == "binary");
+    return true;
+}
+
 // AsyncWorker
 
-struct AsyncGridClear : Napi::AsyncWorker
+struct AsyncGridClear : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncGridClear(grid_ptr const& grid, Napi::Function const& callback)
         : Base(callback),
           grid_(grid)
@@ -34,7 +72,7 @@ struct AsyncGridClear : Napi::AsyncWorker
         if (grid_)
         {
             Napi::Value arg = Napi::External<grid_ptr>::New(env, &grid_);
-            Napi::Object obj = Grid::constructor.New({arg});
+            Napi::Object obj = Grid::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -42,25 +80,39 @@ struct AsyncGridClear : Napi::AsyncWorker
     grid_ptr grid_;
 };
 
-struct AsyncGridEncode : Napi::AsyncWorker
+struct AsyncGridEncode : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     // ctor
-    AsyncGridEncode(grid_ptr grid, unsigned resolution, bool add_features, Napi::Function const& callback)
+    AsyncGridEncode(grid_ptr grid, node_mapnik::lazy_grid_layers_ptr const& lazy_layers,
+                    unsigned resolution, bool add_features, bool binary, Napi::Function const& callback)
         : Base(callback),
           grid_(grid),
+          lazy_layers_(lazy_layers),
           resolution_(resolution),
-          add_features_(add_features)
+          add_features_(add_features),
+          binary_(binary)
     {
     }
     void Execute() override
     {
         try
         {
+            if (binary_)
+            {
+                // attributes are written here too, no JS objects are needed for this format
+                node_mapnik::grid2binary<mapnik::grid>(*grid_, lazy_layers_, resolution_, add_features_, *data_);
+                return;
+            }
             node_mapnik::grid2utf<mapnik::grid>(*grid_,
                                                 lines_,
                                                 key_order_,
                                                 resolution_);
+            if (add_features_)
+            {
+                // may query the datasource for grids rendered with `lazy_fields`
+                features_ = &node_mapnik::grid_features(*grid_, lazy_layers_, key_order_, lazy_features_);
+            }
         }
         catch (std::exception const& ex)
         {
@@ -69,6 +121,10 @@ struct AsyncGridEncode : Napi::AsyncWorker
     }
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
+        if (binary_)
+        {
+            return {env.Null(), binary_grid_buffer(env, std::move(data_))};
+        }
         // convert key order to proper javascript array
         Napi::Array keys_a = Napi::Array::New(env, key_order_.size());
         std::vector<std::string>::iterator it;
@@ -84,6 +140,7 @@ struct AsyncGridEncode : Napi::AsyncWorker
         if (add_features_)
         {
             node_mapnik::write_features<mapnik::grid>(env, grid_type,
+                                                      *features_,
                                                       feature_data,
                                                       key_order_);
         }
@@ -104,15 +161,129 @@ struct AsyncGridEncode : Napi::AsyncWorker
 
   private:
     grid_ptr grid_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
     std::vector<node_mapnik::grid_line_type> lines_;
     unsigned int resolution_;
     bool add_features_;
+    bool binary_;
+    std::unique_ptr<std::string> data_ = std::make_unique<std::string>();
     std::vector<mapnik::grid::lookup_type> key_order_;
+    mapnik::grid::feature_type lazy_features_;
+    mapnik::grid::feature_type const* features_ = nullptr;
+};
+
+struct encoded_subtile
+{
+    std::vector<node_mapnik::grid_line_type> lines;
+    std::vector<mapnik::grid::lookup_type> key_order;
+};
+
+struct AsyncGridEncodeTiles : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncGridEncodeTiles(grid_ptr grid, node_mapnik::lazy_grid_layers_ptr const& lazy_layers,
+                         unsigned cols, unsigned rows, unsigned resolution,
+                         bool add_features, Napi::Function const& callback)
+        : Base(callback),
+          grid_(grid),
+          lazy_layers_(lazy_layers),
+          cols_(cols),
+          rows_(rows),
+          resolution_(resolution),
+          add_features_(add_features)
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            tiles_.resize(cols_ * rows_);
+            std::size_t threads = std::min(node_mapnik::task_threads(), tiles_.size());
+            node_mapnik::parallel_for(threads, [this, threads](std::size_t t) {
+                for (std::size_t i = t; i < tiles_.size(); i += threads)
+                {
+                    encode_subtile(i);
+                }
+            });
+            if (add_features_)
+            {
+                std::vector<mapnik::grid::lookup_type> keys;
+                for (auto const& tile : tiles_)
+                {
+                    keys.insert(keys.end(), tile.key_order.begin(), tile.key_order.end());
+                }
+                features_ = &node_mapnik::grid_features(*grid_, lazy_layers_, keys, lazy_features_);
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        // features are converted once and shared by every subtile that shows them
+        std::map<std::string, Napi::Value> feature_cache;
+        Napi::Array result = Napi::Array::New(env, tiles_.size());
+        for (std::size_t t = 0; t < tiles_.size(); ++t)
+        {
+            encoded_subtile const& tile = tiles_[t];
+            Napi::Array keys_a = Napi::Array::New(env, tile.key_order.size());
+            for (std::size_t i = 0; i < tile.key_order.size(); ++i)
+            {
+                keys_a.Set(i, tile.key_order[i]);
+            }
+            Napi::Object feature_data = Napi::Object::New(env);
+            if (add_features_)
+            {
+                node_mapnik::write_features_cached<mapnik::grid>(env, *grid_, *features_, feature_data,
+                                                                 tile.key_order, feature_cache);
+            }
+            Napi::Array grid_array = Napi::Array::New(env, tile.lines.size());
+            for (std::size_t j = 0; j < tile.lines.size(); ++j)
+            {
+                grid_array.Set(j, Napi::String::New(env, tile.lines[j].get()));
+            }
+            Napi::Object json = Napi::Object::New(env);
+            json.Set("grid", grid_array);
+            json.Set("keys", keys_a);
+            json.Set("data", feature_data);
+            result.Set(t, json);
+        }
+        return {env.Null(), result};
+    }
+
+  private:
+    void encode_subtile(std::size_t index)
+    {
+        unsigned width = grid_->width() / cols_;
+        unsigned height = grid_->height() / rows_;
+        unsigned x = static_cast<unsigned>(index % cols_) * width;
+        unsigned y = static_cast<unsigned>(index / cols_) * height;
+        mapnik::grid_view view = grid_->get_view(x, y, width, height);
+        node_mapnik::grid2utf<mapnik::grid_view>(view, tiles_[index].lines,
+                                                 tiles_[index].key_order, resolution_);
+    }
+
+    grid_ptr grid_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
+    unsigned cols_;
+    unsigned rows_;
+    unsigned resolution_;
+    bool add_features_;
+    std::vector<encoded_subtile> tiles_;
+    mapnik::grid::feature_type lazy_features_;
+    mapnik::grid::feature_type const* features_ = nullptr;
 };
 
 } // namespace detail
 
-Napi::FunctionReference Grid::constructor;
+Napi::FunctionReference& Grid::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).grid;
+}
 
 Napi::Object Grid::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -121,19 +292,21 @@ Napi::Object Grid::Initialize(Napi::Env env, Napi::Object exports, napi_property
             InstanceAccessor<&Grid::key, &Grid::key>("key", prop_attr),
             InstanceMethod<&Grid::encodeSync>("encodeSync", prop_attr),
             InstanceMethod<&Grid::encode>("encode", prop_attr),
+            InstanceMethod<&Grid::encodeTiles>("encodeTiles", prop_attr),
             InstanceMethod<&Grid::clearSync>("clearSync", prop_attr),
             InstanceMethod<&Grid::clear>("clear", prop_attr),
             InstanceMethod<&Grid::painted>("painted", prop_attr),
+            InstanceMethod<&Grid::paintedBounds>("paintedBounds", prop_attr),
             InstanceMethod<&Grid::fields>("fields", prop_attr),
             InstanceMethod<&Grid::addField>("addField", prop_attr),
             InstanceMethod<&Grid::view>("view", prop_attr),
             InstanceMethod<&Grid::width>("width", prop_attr),
             InstanceMethod<&Grid::height>("height", prop_attr),
+            InstanceMethod<&Grid::dispose>("dispose", prop_attr),
             StaticValue("base_mask", Napi::Number::New(env, mapnik::grid::base_mask))
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Grid", func);
     return exports;
 }
@@ -159,6 +332,7 @@ Grid::Grid(Napi::CallbackInfo const& info)
     {
         auto ext = info[0].As<Napi::External<grid_ptr>>();
         if (ext) grid_ = *ext.Data();
+        report_external_memory_(env);
         return;
     }
     if (info.Length() >= 2)
@@ -197,6 +371,7 @@ Grid::Grid(Napi::CallbackInfo const& info)
         grid_ = std::make_shared<mapnik::grid>(info[0].As<Napi::Number>().Int32Value(),
                                                info[1].As<Napi::Number>().Int32Value(),
                                                key);
+        report_external_memory_(env);
     }
     else
     {
@@ -208,6 +383,7 @@ Napi::Value Grid::clearSync(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
     grid_->clear();
+    lazy_layers_.reset();
     return env.Undefined();
 }
 
@@ -226,6 +402,7 @@ Napi::Value Grid::clear(Napi::CallbackInfo const& info)
         Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
         return env.Undefined();
     }
+    lazy_layers_.reset();
     auto* worker = new detail::AsyncGridClear{grid_, callback_val.As<Napi::Function>()};
     worker->Queue();
     return env.Undefined();
@@ -236,6 +413,46 @@ Napi::Value Grid::painted(Napi::CallbackInfo const& info)
     return Napi::Boolean::New(info.Env(), grid_->painted());
 }
 
+/**
+ * Get the smallest box holding every pixel that is not background. Rows are
+ * scanned several pixels at a time, so this is cheap even for large grids.
+ *
+ * @name paintedBounds
+ * @memberof Grid
+ * @instance
+ * @returns {Object|null} `{x, y, width, height}` in pixels, or `null` when
+ * nothing was painted
+ * @example
+ * var bounds = grid.paintedBounds();
+ * if (bounds) console.log(bounds.x, bounds.y, bounds.width, bounds.height);
+ */
+Napi::Value Grid::paintedBounds(Napi::CallbackInfo const& info)
+{
+    return node_mapnik::painted_bounds_object(info.Env(), *grid_);
+}
+
+void Grid::report_external_memory_(Napi::Env env)
+{
+    node_mapnik::report_external_memory(env, external_memory_, grid_.get(), grid_ ? grid_->data().size() : 0);
+}
+
+/**
+ * Free the pixels and features of this grid now rather than when it is garbage
+ * collected. The grid is empty (0 by 0) afterwards.
+ *
+ * @memberof Grid
+ * @instance
+ * @name dispose
+ */
+Napi::Value Grid::dispose(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    grid_ = std::make_shared<mapnik::grid>(0, 0, grid_ ? grid_->get_key() : std::string("__id__"));
+    lazy_layers_.reset();
+    report_external_memory_(env);
+    return env.Undefined();
+}
+
 /**
  * Get this grid's width
  * @memberof Grid
@@ -351,7 +568,8 @@ Napi::Value Grid::view(Napi::CallbackInfo const& info)
     Napi::Number w = info[2].As<Napi::Number>();
     Napi::Number h = info[3].As<Napi::Number>();
     Napi::Value grid_obj = Napi::External<grid_ptr>::New(env, &grid_);
-    Napi::Object obj = GridView::constructor.New({grid_obj, x, y, w, h});
+    Napi::Object obj = GridView::constructor(env).New({grid_obj, x, y, w, h});
+    Napi::ObjectWrap<GridView>::Unwrap(obj)->lazy_layers_ = lazy_layers_;
     return scope.Escape(obj);
 }
 
@@ -361,7 +579,8 @@ Napi::Value Grid::view(Napi::CallbackInfo const& info)
  * @instance
  * @name encodeSync
  * @param {Object} [options={ resolution: 4, features: false }]
- * @returns {Object} an encoded field with `grid`, `keys`, and `data` members.
+ * @param {string} [options.format='utf'] `'binary'` returns a single Buffer, see {@link Grid#encode}
+ * @returns {Object|Buffer} an encoded field with `grid`, `keys`, and `data` members.
  */
 
 Napi::Value Grid::encodeSync(Napi::CallbackInfo const& info)
@@ -372,6 +591,7 @@ Napi::Value Grid::encodeSync(Napi::CallbackInfo const& info)
     // defaults
     unsigned int resolution = 4;
     bool add_features = true;
+    bool binary = false;
 
     // options hash
     if (info.Length() >= 1)
@@ -412,10 +632,18 @@ Napi::Value Grid::encodeSync(Napi::CallbackInfo const& info)
 
             add_features = bind_opt.As<Napi::Boolean>();
         }
+
+        if (!detail::parse_grid_format(env, options, binary)) return env.Undefined();
     }
 
     try
     {
+        if (binary)
+        {
+            auto data = std::make_unique<std::string>();
+            node_mapnik::grid2binary<mapnik::grid>(*grid_, lazy_layers_, resolution, add_features, *data);
+            return scope.Escape(detail::binary_grid_buffer(env, std::move(data)));
+        }
 
         std::vector<node_mapnik::grid_line_type> lines;
         std::vector<mapnik::grid::lookup_type> key_order;
@@ -434,7 +662,9 @@ Napi::Value Grid::encodeSync(Napi::CallbackInfo const& info)
         Napi::Object feature_data = Napi::Object::New(env);
         if (add_features)
         {
+            mapnik::grid::feature_type lazy_features;
             node_mapnik::write_features<mapnik::grid>(env, *grid_,
+                                                      node_mapnik::grid_features(*grid_, lazy_layers_, key_order, lazy_features),
                                                       feature_data,
                                                       key_order);
         }
@@ -463,12 +693,33 @@ Napi::Value Grid::encodeSync(Napi::CallbackInfo const& info)
     }
 }
 
+/**
+ * Encode this grid asynchronously. By default the result is a UTFGrid object
+ * with `grid`, `keys`, and `data` members.
+ *
+ * With `format: 'binary'` the result is a single Buffer: the cells as runs of
+ * indexes into the key table, plus interned attribute names and values
+ * (see `grid2binary` in js_grid_utils.hpp for the layout). It is much smaller
+ * than the JSON form and is decoded by {@link Grid.decodeBinary}.
+ *
+ * @memberof Grid
+ * @instance
+ * @name encode
+ * @param {Object} [options={ resolution: 4, features: true }]
+ * @param {string} [options.format='utf'] `'utf'` or `'binary'`
+ * @param {Function} callback
+ * @example
+ * grid.encode({format: 'binary', resolution: 4}, function(err, buffer) {
+ *   var decoded = mapnik.Grid.decodeBinary(buffer);
+ * });
+ */
 Napi::Value Grid::encode(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
     // defaults
     unsigned int resolution = 4;
     bool add_features = true;
+    bool binary = false;
 
     // options hash
     if (info.Length() >= 1)
@@ -509,6 +760,8 @@ Napi::Value Grid::encode(Napi::CallbackInfo const& info)
 
             add_features = bind_opt.As<Napi::Boolean>();
         }
+
+        if (!detail::parse_grid_format(env, options, binary)) return env.Undefined();
     }
 
     // ensure callback is a function
@@ -519,7 +772,94 @@ Napi::Value Grid::encode(Napi::CallbackInfo const& info)
     }
     Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
 
-    auto* worker = new detail::AsyncGridEncode{grid_, resolution, add_features, callback};
+    auto* worker = new detail::AsyncGridEncode{grid_, lazy_layers_, resolution, add_features, binary, callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
+/**
+ * Slice this grid into `cols` x `rows` subtiles and encode all of them in one
+ * job, for grids rendered as a metatile. Subtiles are encoded in parallel, and
+ * each feature's attributes are converted once and shared by every subtile that
+ * references it.
+ *
+ * @memberof Grid
+ * @instance
+ * @name encodeTiles
+ * @param {Object} options
+ * @param {number} options.cols number of subtile columns, must divide the grid width
+ * @param {number} options.rows number of subtile rows, must divide the grid height
+ * @param {number} [options.resolution=4]
+ * @param {boolean} [options.features=true]
+ * @param {Function} callback called with `(err, tiles)`, an array of encoded subtiles
+ * with `grid`, `keys`, and `data` members, in row-major order
+ * @example
+ * // a 2048x2048 grid rendered for an 8x8 metatile of 256px tiles
+ * grid.encodeTiles({cols: 8, rows: 8, resolution: 4}, function(err, tiles) {
+ *   var top_left = tiles[0];
+ *   var below_it = tiles[8];
+ * });
+ */
+Napi::Value Grid::encodeTiles(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "first argument must be an options object, eg {cols: 8, rows: 8}").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    unsigned resolution = 4;
+    bool add_features = true;
+    std::int64_t cols = 0;
+    std::int64_t rows = 0;
+    Napi::Value cols_opt = options.Get("cols");
+    Napi::Value rows_opt = options.Get("rows");
+    if (!cols_opt.IsNumber() || !rows_opt.IsNumber())
+    {
+        Napi::TypeError::New(env, "'cols' and 'rows' must be integers").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    cols = cols_opt.As<Napi::Number>().Int64Value();
+    rows = rows_opt.As<Napi::Number>().Int64Value();
+    if (cols <= 0 || rows <= 0 || grid_->width() % cols != 0 || grid_->height() % rows != 0)
+    {
+        Napi::TypeError::New(env, "'cols' and 'rows' must evenly divide the grid width and height").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (options.Has("resolution"))
+    {
+        Napi::Value bind_opt = options.Get("resolution");
+        if (!bind_opt.IsNumber())
+        {
+            Napi::TypeError::New(env, "'resolution' must be an Integer").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        resolution = bind_opt.As<Napi::Number>().Int32Value();
+        if (resolution == 0)
+        {
+            Napi::TypeError::New(env, "'resolution' can not be zero").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+    if (options.Has("features"))
+    {
+        Napi::Value bind_opt = options.Get("features");
+        if (!bind_opt.IsBoolean())
+        {
+            Napi::TypeError::New(env, "'features' must be an Boolean").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        add_features = bind_opt.As<Napi::Boolean>();
+    }
+    Napi::Function callback = info[1].As<Napi::Function>();
+    auto* worker = new detail::AsyncGridEncodeTiles{grid_, lazy_layers_, static_cast<unsigned>(cols), static_cast<unsigned>(rows),
+                                                    resolution, add_features, callback};
     worker->Queue();
     return env.Undefined();
 }
@@ -5,11 +5,16 @@
 #include <napi.h>
 // mapnik
 #include <mapnik/grid/grid.hpp>
+#include "lazy_grid_attributes.hpp"
 // stl
 #include <memory>
 
 using grid_ptr = std::shared_ptr<mapnik::grid>;
 
+namespace node_mapnik {
+class external_memory;
+}
+
 class Grid : public Napi::ObjectWrap<Grid>
 {
   public:
@@ -18,23 +23,33 @@ class Grid : public Napi::ObjectWrap<Grid>
     // ctor
     explicit Grid(Napi::CallbackInfo const& info);
     // methods
+    Napi::Value dispose(Napi::CallbackInfo const& info);
     Napi::Value encodeSync(Napi::CallbackInfo const& info);
     Napi::Value encode(Napi::CallbackInfo const& info);
+    Napi::Value encodeTiles(Napi::CallbackInfo const& info);
     Napi::Value addField(Napi::CallbackInfo const& info);
     Napi::Value fields(Napi::CallbackInfo const& info);
     Napi::Value view(Napi::CallbackInfo const& info);
     Napi::Value width(Napi::CallbackInfo const& info);
     Napi::Value height(Napi::CallbackInfo const& info);
     Napi::Value painted(Napi::CallbackInfo const& info);
+    Napi::Value paintedBounds(Napi::CallbackInfo const& info);
     Napi::Value clearSync(Napi::CallbackInfo const& info);
     Napi::Value clear(Napi::CallbackInfo const& info);
     Napi::Value key(Napi::CallbackInfo const& info);
     void key(Napi::CallbackInfo const& info, const Napi::Value& value);
     inline grid_ptr impl() const { return grid_; }
-    static Napi::FunctionReference constructor;
+    // resolvers of the layers rendered into this grid with `lazy_fields`
+    inline node_mapnik::lazy_grid_layers_ptr lazy_layers() const { return lazy_layers_; }
+    inline void set_lazy_layers(node_mapnik::lazy_grid_layers_ptr const& layers) { lazy_layers_ = layers; }
+    static Napi::FunctionReference& constructor(Napi::Env env);
 
   private:
+    void report_external_memory_(Napi::Env env);
     grid_ptr grid_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
+    // share of the memory of the grid reported to V8
+    std::shared_ptr<node_mapnik::external_memory> external_memory_;
 };
 
 #endif
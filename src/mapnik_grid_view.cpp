@@ -5,15 +5,17 @@
 #include <mapnik/grid/grid_view.hpp> // for grid_view, hit_grid_view, etc
 
 #include "mapnik_grid_view.hpp"
+#include "instance_data.hpp"
 #include "mapnik_grid.hpp"
 #include "js_grid_utils.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
-struct AsyncIsSolid : Napi::AsyncWorker
+struct AsyncIsSolid : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncIsSolid(grid_view_ptr const& grid_view, Napi::Function const& callback)
         : Base(callback),
           grid_view_(grid_view)
@@ -24,20 +26,7 @@ struct AsyncIsSolid : Napi::AsyncWorker
     {
         if (grid_view_ && grid_view_->width() > 0 && grid_view_->height() > 0)
         {
-            mapnik::grid_view::value_type first_pixel = grid_view_->get_row(0)[0];
-            pixel_ = first_pixel;
-            for (unsigned y = 0; y < grid_view_->height(); ++y)
-            {
-                mapnik::grid_view::value_type const* row = grid_view_->get_row(y);
-                for (unsigned x = 0; x < grid_view_->width(); ++x)
-                {
-                    if (first_pixel != row[x])
-                    {
-                        solid_ = false;
-                        return;
-                    }
-                }
-            }
+            solid_ = node_mapnik::grid_is_solid(*grid_view_, pixel_);
         }
         else
         {
@@ -58,13 +47,16 @@ struct AsyncIsSolid : Napi::AsyncWorker
     grid_view_ptr grid_view_;
 };
 
-struct AsyncGridViewEncode : Napi::AsyncWorker
+struct AsyncGridViewEncode : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     // ctor
-    AsyncGridViewEncode(grid_view_ptr grid_view, unsigned resolution, bool add_features, Napi::Function const& callback)
+    AsyncGridViewEncode(grid_ptr grid, grid_view_ptr grid_view, node_mapnik::lazy_grid_layers_ptr const& lazy_layers,
+                        unsigned resolution, bool add_features, Napi::Function const& callback)
         : Base(callback),
+          grid_(grid),
           grid_view_(grid_view),
+          lazy_layers_(lazy_layers),
           resolution_(resolution),
           add_features_(add_features)
     {
@@ -77,6 +69,11 @@ struct AsyncGridViewEncode : Napi::AsyncWorker
                                                      lines_,
                                                      key_order_,
                                                      resolution_);
+            if (add_features_)
+            {
+                // may query the datasource for grids rendered with `lazy_fields`
+                features_ = &node_mapnik::grid_features(*grid_, lazy_layers_, key_order_, lazy_features_);
+            }
         }
         catch (std::exception const& ex)
         {
@@ -100,6 +97,7 @@ struct AsyncGridViewEncode : Napi::AsyncWorker
         if (add_features_)
         {
             node_mapnik::write_features<mapnik::grid_view>(env, grid_view_type,
+                                                           *features_,
                                                            feature_data,
                                                            key_order_);
         }
@@ -119,16 +117,23 @@ struct AsyncGridViewEncode : Napi::AsyncWorker
     }
 
   private:
+    grid_ptr grid_;
     grid_view_ptr grid_view_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
     std::vector<node_mapnik::grid_line_type> lines_;
     unsigned int resolution_;
     bool add_features_;
     std::vector<mapnik::grid::lookup_type> key_order_;
+    mapnik::grid::feature_type lazy_features_;
+    mapnik::grid::feature_type const* features_ = nullptr;
 };
 
 } // namespace
 
-Napi::FunctionReference GridView::constructor;
+Napi::FunctionReference& GridView::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).grid_view;
+}
 
 Napi::Object GridView::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -141,11 +146,11 @@ Napi::Object GridView::Initialize(Napi::Env env, Napi::Object exports, napi_prop
             InstanceMethod<&GridView::height>("height", prop_attr),
             InstanceMethod<&GridView::isSolid>("isSolid", prop_attr),
             InstanceMethod<&GridView::isSolidSync>("isSolidSync", prop_attr),
+            InstanceMethod<&GridView::paintedBounds>("paintedBounds", prop_attr),
             InstanceMethod<&GridView::getPixel>("getPixel", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("GridView", func);
     return exports;
 }
@@ -223,22 +228,26 @@ Napi::Value GridView::isSolidSync(Napi::CallbackInfo const& info)
     Napi::EscapableHandleScope scope(env);
     if (grid_view_->width() > 0 && grid_view_->height() > 0)
     {
-        mapnik::grid_view::value_type first_pixel = grid_view_->get_row(0)[0];
-        for (std::size_t y = 0; y < grid_view_->height(); ++y)
-        {
-            mapnik::grid_view::value_type const* row = grid_view_->get_row(y);
-            for (std::size_t x = 0; x < grid_view_->width(); ++x)
-            {
-                if (first_pixel != row[x])
-                {
-                    return scope.Escape(Napi::Boolean::New(env, false));
-                }
-            }
-        }
+        mapnik::grid_view::value_type pixel;
+        return scope.Escape(Napi::Boolean::New(env, node_mapnik::grid_is_solid(*grid_view_, pixel)));
     }
     return scope.Escape(Napi::Boolean::New(env, true));
 }
 
+/**
+ * Get the smallest box holding every pixel of this view that is not background
+ *
+ * @name paintedBounds
+ * @memberof GridView
+ * @instance
+ * @returns {Object|null} `{x, y, width, height}` relative to the view, or
+ * `null` when nothing was painted in it
+ */
+Napi::Value GridView::paintedBounds(Napi::CallbackInfo const& info)
+{
+    return node_mapnik::painted_bounds_object(info.Env(), *grid_view_);
+}
+
 Napi::Value GridView::getPixel(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
@@ -348,7 +357,9 @@ Napi::Value GridView::encodeSync(Napi::CallbackInfo const& info)
         Napi::Object feature_data = Napi::Object::New(env);
         if (add_features)
         {
+            mapnik::grid::feature_type lazy_features;
             node_mapnik::write_features<mapnik::grid_view>(env, grid_type,
+                                                           node_mapnik::grid_features(*grid_, lazy_layers_, key_order, lazy_features),
                                                            feature_data,
                                                            key_order);
         }
@@ -447,7 +458,7 @@ Napi::Value GridView::encode(Napi::CallbackInfo const& info)
     }
     Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
 
-    auto* worker = new AsyncGridViewEncode{grid_view_, resolution, add_features, callback};
+    auto* worker = new AsyncGridViewEncode{grid_, grid_view_, lazy_layers_, resolution, add_features, callback};
     worker->Queue();
     return env.Undefined();
 }
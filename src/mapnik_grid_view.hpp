@@ -30,13 +30,15 @@ class GridView : public Napi::ObjectWrap<GridView>
     Napi::Value height(Napi::CallbackInfo const& info);
     Napi::Value isSolid(Napi::CallbackInfo const& info);
     Napi::Value isSolidSync(Napi::CallbackInfo const& info);
+    Napi::Value paintedBounds(Napi::CallbackInfo const& info);
     Napi::Value getPixel(Napi::CallbackInfo const& info);
     inline grid_view_ptr impl() const { return grid_view_; }
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     grid_view_ptr grid_view_;
     grid_ptr grid_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
 };
 
 #endif
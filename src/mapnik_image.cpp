@@ -4,17 +4,23 @@
 #include <mapnik/image_any.hpp>  // for image_any
 #include <mapnik/image_util.hpp> // for save_to_string, guess_type, etc
 #include "mapnik_image.hpp"
+#include "instance_data.hpp"
 #include "mapnik_image_view.hpp"
 #include "mapnik_palette.hpp"
 #include "mapnik_color.hpp"
 #include "pixel_utils.hpp"
+#include "utils.hpp"
 
 // std
 #include <exception>
 #include <sstream> // for basic_ostringstream, etc
 #include <cstdlib>
+#include <utility>
 
-Napi::FunctionReference Image::constructor;
+Napi::FunctionReference& Image::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).image;
+}
 
 Napi::Object Image::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -55,6 +61,7 @@ Napi::Object Image::Initialize(Napi::Env env, Napi::Object exports, napi_propert
             InstanceMethod<&Image::filter>("filter", prop_attr),
             InstanceMethod<&Image::composite>("composite", prop_attr),
             InstanceMethod<&Image::view>("view", prop_attr),
+            InstanceMethod<&Image::dispose>("dispose", prop_attr),
             StaticMethod<&Image::openSync>("openSync", prop_attr),
             StaticMethod<&Image::open>("open", prop_attr),
             StaticMethod<&Image::fromBufferSync>("fromBufferSync", prop_attr),
@@ -66,8 +73,7 @@ Napi::Object Image::Initialize(Napi::Env env, Napi::Object exports, napi_propert
             StaticMethod<&Image::fromSVGBytes>("fromSVGBytes", prop_attr)
         });
     // clang-format off
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Image", func);
     return exports;
 }
@@ -103,6 +109,7 @@ Image::Image(Napi::CallbackInfo const& info)
     {
         auto ext = info[0].As<Napi::External<image_ptr>>();
         if (ext) image_ = *ext.Data();
+        report_external_memory_(env);
         return;
     }
 
@@ -116,6 +123,10 @@ Image::Image(Napi::CallbackInfo const& info)
         mapnik::image_rgba8 im_wrapper(width, height, buf.Data(), premultiplied, painted);
         image_ = std::make_shared<mapnik::image_any>(im_wrapper);
         buf_ref_ = Napi::Persistent(buf);
+        // pixels wrapping a Buffer are already accounted for by V8, also when
+        // other wrappers share them
+        external_memory_ = node_mapnik::share_external_memory(env, image_.get());
+        external_memory_->set_js_owned();
         return;
     }
     if (info.Length() >= 2)
@@ -206,6 +217,7 @@ Image::Image(Napi::CallbackInfo const& info)
             int width = info[0].As<Napi::Number>().Int32Value();
             int height = info[1].As<Napi::Number>().Int32Value();
             image_ = std::make_shared<mapnik::image_any>(width, height, type, initialize, premultiplied, painted);
+            report_external_memory_(env);
         }
         catch (std::exception const& ex)
         {
@@ -218,6 +230,34 @@ Image::Image(Napi::CallbackInfo const& info)
     }
 }
 
+void Image::report_external_memory_(Napi::Env env)
+{
+    node_mapnik::report_external_memory(env, external_memory_, image_.get(), image_ ? image_->size() : 0);
+}
+
+/**
+ * Free the pixels of this image now rather than when it is garbage collected.
+ * The image is empty afterwards. Pixels still used by other objects, such as
+ * Buffers returned by `buffer()`, are freed once those are garbage collected.
+ *
+ * @name dispose
+ * @instance
+ * @memberof Image
+ * @example
+ * var im = new mapnik.Image(4096, 4096);
+ * // ... encode it
+ * im.dispose();
+ * console.log(im.width()); // 0
+ */
+Napi::Value Image::dispose(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    image_ = std::make_shared<mapnik::image_any>();
+    buf_ref_.Reset();
+    report_external_memory_(env);
+    return env.Undefined();
+}
+
 /**
  * Determine the image type
  *
@@ -321,7 +361,7 @@ Napi::Value Image::getPixel(Napi::CallbackInfo const& info)
             Napi::EscapableHandleScope scope(env);
             mapnik::color col = mapnik::get_pixel<mapnik::color>(*image_, x, y);
             Napi::Value arg = Napi::External<mapnik::color>::New(env, &col);
-            Napi::Object obj = Color::constructor.New({arg});
+            Napi::Object obj = Color::constructor(env).New({arg});
             return scope.Escape(obj);
         }
         else
@@ -372,7 +412,7 @@ void Image::setPixel(Napi::CallbackInfo const& info)
     else if (info[2].IsObject())
     {
         Napi::Object obj = info[2].As<Napi::Object>();
-        if (!obj.InstanceOf(Color::constructor.Value()))
+        if (!obj.InstanceOf(Color::constructor(env).Value()))
         {
             Napi::TypeError::New(env, "A numeric or color value is expected as third arg").ThrowAsJavaScriptException();
         }
@@ -439,7 +479,7 @@ Napi::Value Image::compare(Napi::CallbackInfo const& info)
         return env.Undefined();
     }
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Image::constructor.Value()))
+    if (!obj.InstanceOf(Image::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Image expected as first arg").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -525,7 +565,7 @@ Napi::Value Image::setGrayScaleToAlpha(Napi::CallbackInfo const& info)
     }
 
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Color::constructor.Value()))
+    if (!obj.InstanceOf(Color::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Color expected as first arg").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -658,9 +698,9 @@ Napi::Value Image::view(Napi::CallbackInfo const& info)
     Napi::Value image_obj = Napi::External<image_ptr>::New(env, &image_);
     if (buf_ref_.IsEmpty())
     {
-        return scope.Escape(ImageView::constructor.New({image_obj, x, y, w, h}));
+        return scope.Escape(ImageView::constructor(env).New({image_obj, x, y, w, h}));
     }
-    Napi::Object obj = ImageView::constructor.New({image_obj, x, y, w, h, buf_ref_.Value()});
+    Napi::Object obj = ImageView::constructor(env).New({image_obj, x, y, w, h, buf_ref_.Value()});
     return scope.Escape(obj);
 }
 
@@ -749,6 +789,16 @@ Napi::Value Image::buffer(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
     Napi::EscapableHandleScope scope(env);
-    if (image_) return scope.Escape(Napi::Buffer<unsigned char>::New(env, image_->bytes(), image_->size()));
+    if (image_)
+    {
+        // the Buffer keeps the pixels, and their share of the reported
+        // memory, alive also once the image is disposed
+        using holder = std::pair<image_ptr, std::shared_ptr<node_mapnik::external_memory>>;
+        auto buffer = Napi::Buffer<unsigned char>::New(
+            env, image_->bytes(), image_->size(),
+            [](Napi::Env, unsigned char*, holder* pixels) { delete pixels; },
+            new holder(image_, external_memory_));
+        return scope.Escape(buffer);
+    }
     return info.Env().Null();
 }
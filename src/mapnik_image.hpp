@@ -8,6 +8,10 @@ struct image_any;
 enum image_dtype : std::uint8_t;
 } // namespace mapnik
 
+namespace node_mapnik {
+class external_memory;
+}
+
 using image_ptr = std::shared_ptr<mapnik::image_any>;
 
 class Image : public Napi::ObjectWrap<Image>
@@ -19,6 +23,7 @@ class Image : public Napi::ObjectWrap<Image>
     explicit Image(Napi::CallbackInfo const& info);
     // methods
     Napi::Value getType(Napi::CallbackInfo const& info);
+    Napi::Value dispose(Napi::CallbackInfo const& info);
 
     Napi::Value getPixel(Napi::CallbackInfo const& info);
     void setPixel(Napi::CallbackInfo const& info);
@@ -70,11 +75,14 @@ class Image : public Napi::ObjectWrap<Image>
     Napi::Value offset(Napi::CallbackInfo const& info);
     void offset(Napi::CallbackInfo const& info, Napi::Value const& value);
     inline image_ptr impl() const { return image_; }
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
 
   private:
     static void encode_common_args_(Napi::CallbackInfo const& info, std::string& format, palette_ptr& palette);
     static Napi::Value from_svg_sync_impl(Napi::CallbackInfo const& info, bool from_file);
+    void report_external_memory_(Napi::Env env);
     image_ptr image_;
     Napi::Reference<Napi::Buffer<unsigned char>> buf_ref_;
+    // share of the memory of the pixels reported to V8
+    std::shared_ptr<node_mapnik::external_memory> external_memory_;
 };
@@ -4,12 +4,13 @@
 #include <mapnik/image_filter.hpp> // filter_visitor
 #include <mapnik/image_compositing.hpp>
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
-struct AsyncComposite : Napi::AsyncWorker
+struct AsyncComposite : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncComposite(image_ptr const& src, image_ptr const& dst,
                    mapnik::composite_mode_e mode,
                    int dx, int dy, float opacity,
@@ -51,7 +52,7 @@ struct AsyncComposite : Napi::AsyncWorker
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
         Napi::Value arg = Napi::External<image_ptr>::New(env, &dst_);
-        Napi::Object obj = Image::constructor.New({arg});
+        Napi::Object obj = Image::constructor(env).New({arg});
         return {env.Undefined(), napi_value(obj)};
     }
 
@@ -114,7 +115,7 @@ Napi::Value Image::composite(Napi::CallbackInfo const& info)
     }
 
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Image::constructor.Value()))
+    if (!obj.InstanceOf(Image::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Image expected as first arg").ThrowAsJavaScriptException();
         return env.Undefined();
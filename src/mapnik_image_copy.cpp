@@ -3,12 +3,13 @@
 #include <mapnik/image_copy.hpp>
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
-struct AsyncCopy : Napi::AsyncWorker
+struct AsyncCopy : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncCopy(image_ptr const& image, double offset, double scaling, mapnik::image_dtype type, Napi::Function const& callback)
         : Base(callback),
           image_in_(image),
@@ -36,7 +37,7 @@ struct AsyncCopy : Napi::AsyncWorker
         if (image_out_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_out_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Undefined(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -264,7 +265,7 @@ Napi::Value Image::copySync(Napi::CallbackInfo const& info)
         image_ptr image_out = std::make_shared<mapnik::image_any>(
             mapnik::image_copy(*image_, type, offset, scaling));
         Napi::Value arg = Napi::External<image_ptr>::New(env, &image_out);
-        Napi::Object obj = Image::constructor.New({arg});
+        Napi::Object obj = Image::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     catch (std::exception const& ex)
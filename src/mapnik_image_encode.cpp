@@ -6,6 +6,8 @@
 #include <mapnik/image_copy.hpp>
 #include "mapnik_image.hpp"
 #include "mapnik_palette.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
 
 void Image::encode_common_args_(Napi::CallbackInfo const& info, std::string& format, palette_ptr& palette)
 {
@@ -40,7 +42,7 @@ void Image::encode_common_args_(Napi::CallbackInfo const& info, std::string& for
 
             Napi::Object obj = palette_opt.As<Napi::Object>();
 
-            if (!obj.InstanceOf(Palette::constructor.Value()))
+            if (!obj.InstanceOf(Palette::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.Palette expected as second arg").ThrowAsJavaScriptException();
                 return;
@@ -52,9 +54,9 @@ void Image::encode_common_args_(Napi::CallbackInfo const& info, std::string& for
 
 namespace {
 
-struct AsyncEncode : Napi::AsyncWorker
+struct AsyncEncode : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     // ctor
     AsyncEncode(Image* obj, image_ptr image, palette_ptr palette, std::string const& format, Napi::Function const& callback)
         : Base(callback),
@@ -77,6 +79,7 @@ struct AsyncEncode : Napi::AsyncWorker
     {
         try
         {
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_encode, "encode", format_.c_str());
             if (palette_)
                 result_ = std::make_unique<std::string>(save_to_string(*image_, format_, *palette_));
             else
@@ -181,6 +184,8 @@ Napi::Value Image::encodeSync(Napi::CallbackInfo const& info)
  * @param {string} [format=png] image format
  * @param {Object} [options]
  * @param {mapnik.Palette} [options.palette] - mapnik.Palette object
+ * @param {string} [options.priority='interactive'] `interactive`, `batch` or `background`,
+ * the order waiting async work starts in, see {@link threadPool}
  * @param {Function} callback - `function(err, encoded)`
  * @returns {Buffer} encoded image data
  * @instance
@@ -216,10 +221,16 @@ Napi::Value Image::encode(Napi::CallbackInfo const& info)
         return env.Undefined();
     }
     Napi::Function callback = callback_val.As<Napi::Function>();
+    node_mapnik::worker_priority priority = node_mapnik::priority_interactive;
+    if (info.Length() > 2 && info[1].IsObject())
+    {
+        if (!node_mapnik::parse_priority(env, info[1].As<Napi::Object>(), priority)) return env.Undefined();
+    }
     // Increment reference count here to ensure 'Image' object is not GC'ed during async op.
     // `Unref()` is called on completion in `OnWorkComplete`
     this->Ref();
     auto* worker = new AsyncEncode{this, image_, palette, format, callback};
+    worker->SetPriority(priority);
     worker->Queue();
     return env.Undefined();
 }
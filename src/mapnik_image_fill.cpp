@@ -1,5 +1,6 @@
 #include "mapnik_image.hpp"
 #include "mapnik_color.hpp"
+#include "worker_pool.hpp"
 #include <mapnik/image.hpp>      // for image types
 #include <mapnik/image_any.hpp>  // for image_any
 #include <mapnik/image_util.hpp> // for save_to_string, guess_type, etc
@@ -8,9 +9,9 @@ namespace detail {
 
 // AsyncWorker
 template <typename T>
-struct AsyncFill : Napi::AsyncWorker
+struct AsyncFill : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncFill(image_ptr const& image, T const& val, Napi::Function const& callback)
         : Base(callback),
           image_(image),
@@ -26,7 +27,7 @@ struct AsyncFill : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -70,7 +71,7 @@ Napi::Value Image::fillSync(Napi::CallbackInfo const& info)
         else if (info[0].IsObject())
         {
             Napi::Object obj = info[0].As<Napi::Object>();
-            if (!obj.InstanceOf(Color::constructor.Value()))
+            if (!obj.InstanceOf(Color::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "A numeric or color value is expected").ThrowAsJavaScriptException();
             }
@@ -140,7 +141,7 @@ Napi::Value Image::fill(Napi::CallbackInfo const& info)
     else if (info[0].IsObject())
     {
         Napi::Object obj = info[0].As<Napi::Object>();
-        if (!obj.InstanceOf(Color::constructor.Value()))
+        if (!obj.InstanceOf(Color::constructor(env).Value()))
         {
             Napi::TypeError::New(env, "A numeric or color value is expected").ThrowAsJavaScriptException();
             return env.Undefined();
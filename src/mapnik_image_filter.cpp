@@ -4,14 +4,15 @@
 #include <mapnik/image_filter.hpp> // filter_visitor
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
 // AsyncWorker
 
-struct AsyncFilter : Napi::AsyncWorker
+struct AsyncFilter : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncFilter(image_ptr const& image, std::string const& filter, Napi::Function const& callback)
         : Base(callback),
           image_(image),
@@ -37,7 +38,7 @@ struct AsyncFilter : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
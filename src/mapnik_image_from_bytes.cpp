@@ -4,12 +4,13 @@
 #include <mapnik/image_reader.hpp> // for get_image_reader, etc
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 #include <sstream>
 namespace detail {
 
-struct AsyncFromBytes : Napi::AsyncWorker
+struct AsyncFromBytes : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncFromBytes(Napi::Buffer<char> const& buffer, std::size_t max_size, bool premultiply, Napi::Function const& callback)
         : Base(callback),
           buffer_ref{Napi::Persistent(buffer)},
@@ -52,7 +53,7 @@ struct AsyncFromBytes : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -112,7 +113,7 @@ Napi::Value Image::fromBytesSync(Napi::CallbackInfo const& info)
                 mapnik::set_premultiplied_alpha(*imagep, true);
             }
             Napi::Value arg = Napi::External<image_ptr>::New(env, &imagep);
-            Napi::Object obj = constructor.New({arg});
+            Napi::Object obj = constructor(env).New({arg});
             return scope.Escape(obj);
         }
         // The only way this is ever reached is if the reader factory in
@@ -335,7 +336,7 @@ Napi::Value Image::fromBufferSync(Napi::CallbackInfo const& info)
 
     try
     {
-        Napi::Object image_obj = constructor.New({obj,
+        Napi::Object image_obj = constructor(env).New({obj,
                                                   Napi::Number::New(env, width),
                                                   Napi::Number::New(env, height),
                                                   Napi::Boolean::New(env, premultiplied),
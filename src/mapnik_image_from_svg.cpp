@@ -17,11 +17,12 @@
 #include "agg_rasterizer_scanline_aa.h"
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
-struct AsyncFromSVG : Napi::AsyncWorker
+struct AsyncFromSVG : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncFromSVG(std::string const& filename, double scale, std::size_t max_size,
                  bool strict, Napi::Function const& callback)
         : Base(callback),
@@ -124,7 +125,7 @@ struct AsyncFromSVG : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -138,9 +139,9 @@ struct AsyncFromSVG : Napi::AsyncWorker
     image_ptr image_;
 };
 
-struct AsyncFromSVGBytes : Napi::AsyncWorker
+struct AsyncFromSVGBytes : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncFromSVGBytes(Napi::Buffer<char> const& buffer, double scale, std::size_t max_size,
                       bool strict, Napi::Function const& callback)
         : Base(callback),
@@ -243,7 +244,7 @@ struct AsyncFromSVGBytes : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -429,7 +430,7 @@ Napi::Value Image::from_svg_sync_impl(Napi::CallbackInfo const& info, bool from_
 
         image_ptr imagep = std::make_shared<mapnik::image_any>(im);
         Napi::Value arg = Napi::External<image_ptr>::New(env, &imagep);
-        Napi::Object obj = Image::constructor.New({arg});
+        Napi::Object obj = Image::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     catch (std::exception const& ex)
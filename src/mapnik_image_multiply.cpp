@@ -3,14 +3,15 @@
 #include <mapnik/image_util.hpp> // for save_to_string, guess_type, etc
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
 // AsyncWorker
 template <bool pre = true>
-struct AsyncMultiply : Napi::AsyncWorker
+struct AsyncMultiply : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncMultiply(image_ptr const& image, Napi::Function const& callback)
         : Base(callback),
           image_(image)
@@ -30,7 +31,7 @@ struct AsyncMultiply : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -5,12 +5,13 @@
 #include <mapnik/image_util.hpp>   // for save_to_string, guess_type, etc
 //
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
-struct AsyncOpen : Napi::AsyncWorker
+struct AsyncOpen : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncOpen(std::string const& filename, Napi::Function const& callback)
         : Base(callback),
           filename_(filename) {}
@@ -46,7 +47,7 @@ struct AsyncOpen : Napi::AsyncWorker
         if (image_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -99,7 +100,7 @@ Napi::Value Image::openSync(Napi::CallbackInfo const& info)
                     mapnik::set_premultiplied_alpha(*imagep, true);
                 }
                 Napi::Value arg = Napi::External<image_ptr>::New(env, &imagep);
-                Napi::Object obj = constructor.New({arg});
+                Napi::Object obj = constructor(env).New({arg});
                 return scope.Escape(obj);
             }
         }
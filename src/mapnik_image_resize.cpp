@@ -2,6 +2,7 @@
 #include <mapnik/image_util.hpp>    // NOLINT for save_to_string, guess_type, etc
 #include <mapnik/image_scaling.hpp> // NOLINT
 #include "mapnik_image.hpp"         // NOLINT
+#include "worker_pool.hpp"
 
 namespace {
 
@@ -112,9 +113,9 @@ struct resize_visitor
 } // namespace
 
 namespace detail {
-struct AsyncResize : Napi::AsyncWorker
+struct AsyncResize : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncResize(image_ptr const& image, mapnik::scaling_method_e scaling_method,
                 std::size_t width, std::size_t height,
                 double offset_x, double offset_y, double offset_width, double offset_height,
@@ -177,7 +178,7 @@ struct AsyncResize : Napi::AsyncWorker
         if (image_out_)
         {
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image_out_);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -593,7 +594,7 @@ Napi::Value Image::resizeSync(Napi::CallbackInfo const& info)
                              corrected_offset_y);
         mapnik::util::apply_visitor(visit, *image_out);
         Napi::Value arg = Napi::External<image_ptr>::New(env, &image_out);
-        Napi::Object obj = Image::constructor.New({arg});
+        Napi::Object obj = Image::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     catch (std::exception const& ex)
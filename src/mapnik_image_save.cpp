@@ -5,11 +5,12 @@
 #include <mapnik/image_util.hpp> // for save_to_string, guess_type, etc
 
 #include "mapnik_image.hpp"
+#include "worker_pool.hpp"
 
 namespace {
-struct AsyncSave : Napi::AsyncWorker
+struct AsyncSave : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     // ctor
     AsyncSave(image_ptr const& image, std::string const& filename, std::string const& format, Napi::Function const& callback)
         : Base(callback),
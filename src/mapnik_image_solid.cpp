@@ -5,12 +5,13 @@
 
 #include "mapnik_image.hpp"
 #include "pixel_utils.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
-struct AsyncIsSolid : Napi::AsyncWorker
+struct AsyncIsSolid : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncIsSolid(image_ptr const& image, Napi::Function const& callback)
         : Base(callback),
           image_(image)
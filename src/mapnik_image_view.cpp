@@ -5,16 +5,18 @@
 #include <mapnik/image_util.hpp>
 
 #include "mapnik_image.hpp"
+#include "instance_data.hpp"
 #include "mapnik_image_view.hpp"
 #include "mapnik_color.hpp"
 #include "mapnik_palette.hpp"
 #include "pixel_utils.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
-struct AsyncIsSolid : Napi::AsyncWorker
+struct AsyncIsSolid : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncIsSolid(image_view_ptr const& image_view, Napi::Function const& callback)
         : Base(callback),
           image_view_(image_view)
@@ -45,7 +47,10 @@ struct AsyncIsSolid : Napi::AsyncWorker
 };
 } // namespace
 
-Napi::FunctionReference ImageView::constructor;
+Napi::FunctionReference& ImageView::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).image_view;
+}
 
 Napi::Object ImageView::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -61,8 +66,7 @@ Napi::Object ImageView::Initialize(Napi::Env env, Napi::Object exports, napi_pro
             InstanceMethod<&ImageView::getPixel>("getPixel", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("ImageView", func);
     return exports;
 }
@@ -197,7 +201,7 @@ Napi::Value ImageView::getPixel(Napi::CallbackInfo const& info)
             Napi::EscapableHandleScope scope(env);
             mapnik::color col = mapnik::get_pixel<mapnik::color>(*image_view_, x, y);
             Napi::Value arg = Napi::External<mapnik::color>::New(env, &col);
-            Napi::Object obj = Color::constructor.New({arg});
+            Napi::Object obj = Color::constructor(env).New({arg});
             return scope.Escape(obj);
         }
         else
@@ -252,7 +256,7 @@ void ImageView::encode_common_args_(Napi::CallbackInfo const& info, std::string&
 
             Napi::Object obj = palette_opt.As<Napi::Object>();
 
-            if (!obj.InstanceOf(Palette::constructor.Value()))
+            if (!obj.InstanceOf(Palette::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.Palette expected as second arg").ThrowAsJavaScriptException();
                 return;
@@ -264,9 +268,9 @@ void ImageView::encode_common_args_(Napi::CallbackInfo const& info, std::string&
 
 namespace {
 
-struct AsyncEncode : Napi::AsyncWorker
+struct AsyncEncode : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     // ctor
     AsyncEncode(ImageView* obj, image_view_ptr image_view, palette_ptr palette, std::string const& format, Napi::Function const& callback)
         : Base(callback),
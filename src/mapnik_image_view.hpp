@@ -34,7 +34,7 @@ class ImageView : public Napi::ObjectWrap<ImageView>
 
   private:
     static void encode_common_args_(Napi::CallbackInfo const& info, std::string& format, palette_ptr& palette);
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     image_view_ptr image_view_;
     image_ptr image_;
     Napi::Reference<Napi::Buffer<unsigned char>> buf_ref_;
@@ -1,4 +1,5 @@
 #include "mapnik_layer.hpp"
+#include "instance_data.hpp"
 #include "mapnik_datasource.hpp"
 #include "utils.hpp"
 // mapnik
@@ -9,7 +10,10 @@
 // stl
 #include <limits>
 
-Napi::FunctionReference Layer::constructor;
+Napi::FunctionReference& Layer::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).layer;
+}
 
 Napi::Object Layer::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -27,8 +31,7 @@ Napi::Object Layer::Initialize(Napi::Env env, Napi::Object exports, napi_propert
             InstanceAccessor<&Layer::clear_label_cache, &Layer::clear_label_cache>("clear_label_cache", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Layer", func);
     return exports;
 }
@@ -146,7 +149,7 @@ Napi::Value Layer::datasource(Napi::CallbackInfo const& info)
     if (ds)
     {
         Napi::Value arg = Napi::External<mapnik::datasource_ptr>::New(env, &ds);
-        Napi::Object obj = Datasource::constructor.New({arg});
+        Napi::Object obj = Datasource::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     return env.Null();
@@ -163,7 +166,7 @@ void Layer::datasource(Napi::CallbackInfo const& info, Napi::Value const& value)
     else
     {
         Napi::Object obj = value.As<Napi::Object>();
-        if (!obj.InstanceOf(Datasource::constructor.Value()))
+        if (!obj.InstanceOf(Datasource::constructor(env).Value()))
         {
             Napi::TypeError::New(env, "mapnik.Datasource instance expected").ThrowAsJavaScriptException();
         }
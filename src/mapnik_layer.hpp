@@ -43,6 +43,6 @@ class Layer : public Napi::ObjectWrap<Layer>
     inline layer_ptr impl() const { return layer_; }
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     layer_ptr layer_;
 };
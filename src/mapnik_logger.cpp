@@ -1,8 +1,248 @@
 //#include "utils.hpp"
 #include "mapnik_logger.hpp"
+#include "instance_data.hpp"
 #include <mapnik/debug.hpp>
 
-Napi::FunctionReference Logger::constructor;
+// stl
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Bounded multi-producer, single-consumer queue of log records. Every cell carries
+// a sequence number that tells producers and the consumer whose turn it is, so
+// render threads only contend on one compare-and-swap.
+class log_ring
+{
+  public:
+    explicit log_ring(std::size_t size)
+    {
+        std::size_t capacity = 1;
+        while (capacity < size)
+            capacity <<= 1;
+        cells_.reset(new cell[capacity]);
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        mask_ = capacity - 1;
+    }
+
+    void push(std::string&& record)
+    {
+        std::size_t pos = enqueue_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell& c = cells_[pos & mask_];
+            std::size_t seq = c.seq.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.record = std::move(record);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // full, the consumer is behind
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            else
+            {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+        dirty.store(true, std::memory_order_release);
+    }
+
+    // JS thread only
+    bool pop(std::string& record)
+    {
+        cell& c = cells_[dequeue_ & mask_];
+        if (c.seq.load(std::memory_order_acquire) != dequeue_ + 1) return false;
+        record = std::move(c.record);
+        c.record.clear();
+        c.seq.store(dequeue_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_;
+        return true;
+    }
+
+    std::atomic<std::size_t> dropped{0};
+    // records were pushed or dropped since the last delivery was scheduled
+    std::atomic<bool> dirty{false};
+    // a delivery to JS is on its way
+    std::atomic<bool> scheduled{false};
+
+  private:
+    struct cell
+    {
+        std::atomic<std::size_t> seq;
+        std::string record;
+    };
+    std::unique_ptr<cell[]> cells_;
+    std::size_t mask_ = 0;
+    std::atomic<std::size_t> enqueue_{0};
+    std::size_t dequeue_ = 0;
+};
+
+// Takes the place of the std::clog buffer mapnik logs to. Lines go to the ring of
+// the sink when one is set, straight to the console otherwise. Each thread builds
+// its own line, so writing a record never takes a lock or a syscall.
+class sink_buffer : public std::streambuf
+{
+  public:
+    explicit sink_buffer(std::streambuf* console)
+        : console_(console) {}
+
+    std::atomic<log_ring*> ring{nullptr};
+
+  protected:
+    int_type overflow(int_type ch) override
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        char c = traits_type::to_char_type(ch);
+        return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+    }
+
+    std::streamsize xsputn(char const* s, std::streamsize n) override
+    {
+        log_ring* target = ring.load(std::memory_order_acquire);
+        if (!target) return console_->sputn(s, n);
+        thread_local std::string line;
+        for (std::streamsize i = 0; i < n; ++i)
+        {
+            if (s[i] == '\n')
+            {
+                target->push(std::move(line));
+                line = std::string();
+            }
+            else
+            {
+                line += s[i];
+            }
+        }
+        return n;
+    }
+
+    int sync() override
+    {
+        if (!ring.load(std::memory_order_acquire)) return console_->pubsync();
+        return 0;
+    }
+
+  private:
+    std::streambuf* console_;
+};
+
+sink_buffer& clog_buffer()
+{
+    // installed once and never removed: a thread may be writing to std::clog at
+    // any time, so the buffer lives as long as the process
+    static sink_buffer* buffer = [] {
+        auto* buf = new sink_buffer(std::clog.rdbuf());
+        std::clog.rdbuf(buf);
+        return buf;
+    }();
+    return *buffer;
+}
+
+void deliver(Napi::Env env, Napi::Function fn, log_ring* ring)
+{
+    ring->scheduled.store(false, std::memory_order_release);
+    Napi::Array records = Napi::Array::New(env);
+    std::string record;
+    std::uint32_t count = 0;
+    while (ring->pop(record))
+    {
+        records.Set(count++, Napi::String::New(env, record));
+    }
+    std::size_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (count == 0 && dropped == 0) return;
+    fn.Call({records, Napi::Number::New(env, static_cast<double>(dropped))});
+}
+
+// The function set with Logger.setSink and the thread that hands it the records
+// every `batch` milliseconds
+struct log_sink
+{
+    napi_env env;
+    log_ring* ring;
+    Napi::ThreadSafeFunction tsfn;
+    std::chrono::milliseconds batch;
+    std::thread flusher;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void flush()
+    {
+        if (!ring->dirty.load(std::memory_order_acquire)) return;
+        if (ring->scheduled.exchange(true, std::memory_order_acq_rel)) return;
+        ring->dirty.store(false, std::memory_order_release);
+        log_ring* r = ring;
+        if (tsfn.NonBlockingCall([r](Napi::Env env, Napi::Function fn) { deliver(env, fn, r); }) != napi_ok)
+        {
+            r->scheduled.store(false, std::memory_order_release);
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!cv.wait_for(lock, batch, [this] { return stopping; }))
+        {
+            flush();
+        }
+    }
+};
+
+// the sink is process wide, worker_threads may set it too
+std::mutex sink_mutex;
+std::unique_ptr<log_sink> active_sink;
+// a thread can still be pushing to the ring of a replaced sink, they are kept
+std::vector<std::unique_ptr<log_ring>> rings;
+
+void remove_sink(bool deliver_rest)
+{
+    if (!active_sink) return;
+    clog_buffer().ring.store(nullptr, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(active_sink->mutex);
+        active_sink->stopping = true;
+    }
+    active_sink->cv.notify_all();
+    active_sink->flusher.join();
+    if (deliver_rest) active_sink->flush();
+    active_sink->tsfn.Release();
+    active_sink.reset();
+}
+
+void sink_env_cleanup(void*)
+{
+    // the environment that set the sink shuts down
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    remove_sink(false);
+}
+
+} // namespace
+
+Napi::FunctionReference& Logger::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).logger;
+}
 
 Napi::Object Logger::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -10,6 +250,7 @@ Napi::Object Logger::Initialize(Napi::Env env, Napi::Object exports, napi_proper
     Napi::Function func = DefineClass(env, "Logger", {
             StaticMethod<&Logger::get_severity>("getSeverity", prop_attr),
             StaticMethod<&Logger::set_severity>("setSeverity", prop_attr),
+            StaticMethod<&Logger::set_sink>("setSink", prop_attr),
             StaticValue("NONE", Napi::Number::New(env, mapnik::logger::severity_type::none), napi_enumerable),
             StaticValue("ERROR", Napi::Number::New(env, mapnik::logger::severity_type::error), napi_enumerable),
             StaticValue("DEBUG", Napi::Number::New(env, mapnik::logger::severity_type::debug), napi_enumerable),
@@ -23,8 +264,7 @@ Napi::Object Logger::Initialize(Napi::Env env, Napi::Object exports, napi_proper
     // DEFAULT_LOG_SEVERITY
     // RENDERING_STATS
     // DEBUG
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Logger", func);
     return exports;
 }
@@ -86,3 +326,94 @@ Napi::Value Logger::set_severity(Napi::CallbackInfo const& info)
     mapnik::logger::instance().set_severity(static_cast<mapnik::logger::severity_type>(severity));
     return env.Undefined();
 }
+
+/**
+ * Send the log records of mapnik to a function instead of stderr. Records are
+ * queued in a ring buffer without blocking the threads that log and handed to
+ * `fn` in batches on the JS thread, so warnings can stay enabled under load.
+ * Records logged while the buffer is full are dropped and counted. Only the
+ * thread that set the sink can replace it; `setSink(null)` delivers what is
+ * queued and goes back to stderr.
+ *
+ * @name setSink
+ * @memberof Logger
+ * @static
+ * @param {Function|null} fn - called with `(records, dropped)`: an array of log
+ * lines and the number of records dropped since the previous call
+ * @param {Object} [options]
+ * @param {number} [options.buffer_size=1024] records queued at most
+ * @param {number} [options.batch_ms=100] how often queued records are delivered
+ * @example
+ * mapnik.Logger.setSeverity(mapnik.Logger.WARN);
+ * mapnik.Logger.setSink(function(records, dropped) {
+ *   records.forEach(function(line) { log.warn(line); });
+ *   if (dropped) log.warn(dropped + ' mapnik log records dropped');
+ * }, { batch_ms: 500 });
+ */
+Napi::Value Logger::set_sink(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !(info[0].IsFunction() || info[0].IsNull()))
+    {
+        Napi::TypeError::New(env, "first argument must be a function or null").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::size_t buffer_size = 1024;
+    std::int32_t batch_ms = 100;
+    if (info.Length() > 1)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("buffer_size"))
+        {
+            Napi::Value size = options.Get("buffer_size");
+            if (!size.IsNumber() || size.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "option 'buffer_size' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            buffer_size = static_cast<std::size_t>(size.As<Napi::Number>().Int32Value());
+        }
+        if (options.Has("batch_ms"))
+        {
+            Napi::Value batch = options.Get("batch_ms");
+            if (!batch.IsNumber() || batch.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "option 'batch_ms' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            batch_ms = batch.As<Napi::Number>().Int32Value();
+        }
+    }
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    if (active_sink)
+    {
+        if (active_sink->env != static_cast<napi_env>(env))
+        {
+            Napi::Error::New(env, "the log sink was set by another thread").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        napi_remove_env_cleanup_hook(env, sink_env_cleanup, nullptr);
+        remove_sink(true);
+    }
+    if (info[0].IsNull()) return env.Undefined();
+
+    rings.emplace_back(new log_ring(buffer_size));
+    active_sink.reset(new log_sink);
+    active_sink->env = env;
+    active_sink->ring = rings.back().get();
+    active_sink->batch = std::chrono::milliseconds(batch_ms);
+    active_sink->tsfn = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "mapnik.Logger", 0, 1);
+    // logging must not keep the process alive
+    active_sink->tsfn.Unref(env);
+    // registered after the threadsafe function so it runs before that is closed
+    napi_add_env_cleanup_hook(env, sink_env_cleanup, nullptr);
+    log_sink* sink = active_sink.get();
+    sink->flusher = std::thread([sink] { sink->run(); });
+    clog_buffer().ring.store(sink->ring, std::memory_order_release);
+    return env.Undefined();
+}
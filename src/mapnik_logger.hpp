@@ -18,7 +18,8 @@ class Logger : public Napi::ObjectWrap<Logger>
     // Are these the only methods available in logger?
     static Napi::Value get_severity(Napi::CallbackInfo const& info);
     static Napi::Value set_severity(Napi::CallbackInfo const& info);
+    static Napi::Value set_sink(Napi::CallbackInfo const& info);
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
 };
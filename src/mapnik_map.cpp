@@ -1,4 +1,5 @@
 #include "mapnik_map.hpp"
+#include "instance_data.hpp"
 #include "utils.hpp"
 #include "mapnik_color.hpp"   // for Color, Color::constructor
 #include "mapnik_image.hpp"   // for Image, Image::constructor
@@ -11,7 +12,10 @@
 // stl
 #include <sstream> // for basic_ostringstream, etc
 
-Napi::FunctionReference Map::constructor;
+Napi::FunctionReference& Map::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).map;
+}
 
 Napi::Object Map::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -36,6 +40,8 @@ Napi::Object Map::Initialize(Napi::Env env, Napi::Object exports, napi_property_
             InstanceMethod<&Map::renderSync>("renderSync", prop_attr),
             InstanceMethod<&Map::renderFile>("renderFile", prop_attr),
             InstanceMethod<&Map::renderFileSync>("renderFileSync", prop_attr),
+            InstanceMethod<&Map::renderAtlas>("renderAtlas", prop_attr),
+            InstanceMethod<&Map::warmCache>("warmCache", prop_attr),
             InstanceMethod<&Map::zoomAll>("zoomAll", prop_attr),
             InstanceMethod<&Map::zoomToBox>("zoomToBox", prop_attr),
             InstanceMethod<&Map::scale>("scale", prop_attr),
@@ -69,8 +75,7 @@ Napi::Object Map::Initialize(Napi::Env env, Napi::Object exports, napi_property_
     func.Set("ASPECT_ADJUST_CANVAS_HEIGHT", Napi::Number::New(env, mapnik::Map::ADJUST_CANVAS_HEIGHT));
     func.Set("ASPECT_RESPECT", Napi::Number::New(env, mapnik::Map::RESPECT));
 
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Map", func);
     return exports;
 }
@@ -353,7 +358,7 @@ Napi::Value Map::background(Napi::CallbackInfo const& info)
     if (col)
     {
         Napi::Value arg = Napi::External<mapnik::color>::New(env, &(*col));
-        Napi::Object obj = Color::constructor.New({arg});
+        Napi::Object obj = Color::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     return env.Undefined();
@@ -370,7 +375,7 @@ void Map::background(Napi::CallbackInfo const& info, Napi::Value const& value)
     }
     Napi::Object obj = value.As<Napi::Object>();
 
-    if (!obj.InstanceOf(Color::constructor.Value()))
+    if (!obj.InstanceOf(Color::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "Must provide an integer height").ThrowAsJavaScriptException();
         return;
@@ -607,7 +612,7 @@ Napi::Value Map::layers(Napi::CallbackInfo const& info)
     {
         auto layer = std::make_shared<mapnik::layer>(layers[index]);
         Napi::Value arg = Napi::External<layer_ptr>::New(env, &layer);
-        Napi::Object obj = Layer::constructor.New({arg});
+        Napi::Object obj = Layer::constructor(env).New({arg});
         arr.Set(index, obj);
     }
     return scope.Escape(arr);
@@ -632,7 +637,7 @@ Napi::Value Map::add_layer(Napi::CallbackInfo const& info)
     }
 
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Layer::constructor.Value()))
+    if (!obj.InstanceOf(Layer::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Layer expected").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -709,7 +714,7 @@ Napi::Value Map::get_layer(Napi::CallbackInfo const& info)
         {
             auto layer = std::make_shared<mapnik::layer>(layers[index]);
             Napi::Value arg = Napi::External<layer_ptr>::New(env, &layer);
-            Napi::Object obj = Layer::constructor.New({arg});
+            Napi::Object obj = Layer::constructor(env).New({arg});
             return scope.Escape(obj);
         }
         else
@@ -728,7 +733,7 @@ Napi::Value Map::get_layer(Napi::CallbackInfo const& info)
             {
                 auto layer = std::make_shared<mapnik::layer>(layers[index]);
                 Napi::Value arg = Napi::External<layer_ptr>::New(env, &layer);
-                Napi::Object obj = Layer::constructor.New({arg});
+                Napi::Object obj = Layer::constructor(env).New({arg});
                 return scope.Escape(obj);
             }
             ++index;
@@ -802,7 +807,7 @@ Napi::Value Map::clone(Napi::CallbackInfo const& info)
     {
         auto map = std::make_shared<mapnik::Map>(*map_);
         Napi::Value arg = Napi::External<map_ptr>::New(env, &map);
-        Napi::Object obj = Map::constructor.New({arg});
+        Napi::Object obj = Map::constructor(env).New({arg});
         return scope.Escape(obj);
     }
     catch (...)
@@ -41,6 +41,8 @@ class Map : public Napi::ObjectWrap<Map>
     // async rendering
     Napi::Value render(Napi::CallbackInfo const& info);
     Napi::Value renderFile(Napi::CallbackInfo const& info);
+    Napi::Value renderAtlas(Napi::CallbackInfo const& info);
+    Napi::Value warmCache(Napi::CallbackInfo const& info);
     // sync rendering
     Napi::Value renderSync(Napi::CallbackInfo const& info);
     Napi::Value renderFileSync(Napi::CallbackInfo const& info);
@@ -86,7 +88,7 @@ class Map : public Napi::ObjectWrap<Map>
 
   private:
     Napi::Value query_point_impl(Napi::CallbackInfo const& info, bool geo_coords);
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     map_ptr map_;
     std::atomic<int> not_in_use_{1};
 };
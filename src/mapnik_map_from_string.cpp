@@ -1,13 +1,14 @@
 #include "mapnik_map.hpp"
+#include "worker_pool.hpp"
 
 #include <mapnik/load_map.hpp> // for load_map, load_map_string
 #include <mapnik/map.hpp>      // for Map, etc
 
 namespace detail {
 
-struct AsyncMapFromString : Napi::AsyncWorker
+struct AsyncMapFromString : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncMapFromString(map_ptr const& map, std::string const& stylesheet,
                        std::string const& base_path, bool strict, Napi::Function const& callback)
         : Base(callback),
@@ -33,7 +34,7 @@ struct AsyncMapFromString : Napi::AsyncWorker
         if (map_)
         {
             Napi::Value arg = Napi::External<map_ptr>::New(env, &map_);
-            Napi::Object obj = Map::constructor.New({arg});
+            Napi::Object obj = Map::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
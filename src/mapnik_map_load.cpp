@@ -1,26 +1,33 @@
 #include "mapnik_map.hpp"
+#include "lazy_datasource.hpp"
+#include "worker_pool.hpp"
 
 #include <mapnik/load_map.hpp> // for load_map, load_map_string
 #include <mapnik/map.hpp>      // for Map, etc
 
 namespace detail {
 
-struct AsyncMapLoad : Napi::AsyncWorker
+struct AsyncMapLoad : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncMapLoad(map_ptr const& map, std::string const& stylesheet,
-                 std::string const& base_path, bool strict, Napi::Function const& callback)
+                 std::string const& base_path, bool strict, bool lazy_datasources,
+                 Napi::Function const& callback)
         : Base(callback),
           map_(map),
           stylesheet_(stylesheet),
           base_path_(base_path),
-          strict_(strict) {}
+          strict_(strict),
+          lazy_datasources_(lazy_datasources) {}
 
     void Execute() override
     {
         try
         {
-            mapnik::load_map(*map_, stylesheet_, strict_, base_path_);
+            if (lazy_datasources_)
+                node_mapnik::load_map_lazy(*map_, stylesheet_, strict_, base_path_);
+            else
+                mapnik::load_map(*map_, stylesheet_, strict_, base_path_);
         }
         catch (std::exception const& ex)
         {
@@ -33,7 +40,7 @@ struct AsyncMapLoad : Napi::AsyncWorker
         if (map_)
         {
             Napi::Value arg = Napi::External<map_ptr>::New(env, &map_);
-            Napi::Object obj = Map::constructor.New({arg});
+            Napi::Object obj = Map::constructor(env).New({arg});
             return {env.Null(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -44,6 +51,7 @@ struct AsyncMapLoad : Napi::AsyncWorker
     std::string stylesheet_;
     std::string base_path_;
     bool strict_;
+    bool lazy_datasources_;
 };
 
 } // namespace detail
@@ -57,6 +65,15 @@ struct AsyncMapLoad : Napi::AsyncWorker
  * @name load
  * @param {string} stylesheet path
  * @param {Object} [options={}]
+ * @param {boolean} [options.strict=false]
+ * @param {string} [options.base] base path for relative paths in the stylesheet
+ * @param {boolean} [options.lazy_datasources=false] do not open layer datasources
+ * while loading: each one is created when a render or query first touches its layer,
+ * and async renders create all pending datasources of visible layers concurrently
+ * on the pool set with `mapnik.setThreadPool`. Sync renders create them one after
+ * the other as they reach each layer. Datasource errors are then reported by the
+ * render instead of the load, every time the layer is used. Only the layers of the
+ * map are lazy, nested layers open their datasources while loading.
  * @param {Function} callback
  */
 
@@ -118,8 +135,21 @@ Napi::Value Map::load(Napi::CallbackInfo const& info)
         base_path = base_val.As<Napi::String>();
     }
 
+    bool lazy_datasources = false;
+    if (options.Has("lazy_datasources"))
+    {
+        Napi::Value lazy_val = options.Get("lazy_datasources");
+        if (!lazy_val.IsBoolean())
+        {
+            Napi::TypeError::New(env, "'lazy_datasources' must be a Boolean").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        lazy_datasources = lazy_val.As<Napi::Boolean>();
+    }
+
     auto* worker = new detail::AsyncMapLoad(map_, info[0].As<Napi::String>(),
-                                            base_path, strict, callback_val.As<Napi::Function>());
+                                            base_path, strict, lazy_datasources,
+                                            callback_val.As<Napi::Function>());
     worker->Queue();
     return env.Undefined();
 }
@@ -133,6 +163,7 @@ Napi::Value Map::load(Napi::CallbackInfo const& info)
  * @name loadSync
  * @param {string} stylesheet path
  * @param {Object} [options={}]
+ * @param {boolean} [options.lazy_datasources=false] see {@link Map#load}
  * @example
  * map.loadSync('./style.xml');
  */
@@ -148,6 +179,7 @@ Napi::Value Map::loadSync(Napi::CallbackInfo const& info)
 
     std::string stylesheet = info[0].As<Napi::String>();
     bool strict = false;
+    bool lazy_datasources = false;
     std::string base_path;
 
     if (info.Length() > 2)
@@ -186,11 +218,25 @@ Napi::Value Map::loadSync(Napi::CallbackInfo const& info)
             }
             base_path = base_val.As<Napi::String>();
         }
+
+        if (options.Has("lazy_datasources"))
+        {
+            Napi::Value lazy_val = options.Get("lazy_datasources");
+            if (!lazy_val.IsBoolean())
+            {
+                Napi::TypeError::New(env, "'lazy_datasources' must be a Boolean").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            lazy_datasources = lazy_val.As<Napi::Boolean>();
+        }
     }
 
     try
     {
-        mapnik::load_map(*map_, stylesheet, strict, base_path);
+        if (lazy_datasources)
+            node_mapnik::load_map_lazy(*map_, stylesheet, strict, base_path);
+        else
+            mapnik::load_map(*map_, stylesheet, strict, base_path);
     }
     catch (std::exception const& ex)
     {
@@ -1,13 +1,14 @@
 #include "mapnik_map.hpp"
 #include "mapnik_featureset.hpp"
+#include "worker_pool.hpp"
 #include <mapnik/map.hpp>
 #include <mapnik/layer.hpp>
 
 namespace detail {
 
-struct AsyncQueryPoint : Napi::AsyncWorker
+struct AsyncQueryPoint : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncQueryPoint(map_ptr const& map, double x, double y, int layer_idx, bool geo_coords, Napi::Function const& callback)
         : Base(callback),
           map_(map),
@@ -76,7 +77,7 @@ struct AsyncQueryPoint : Napi::AsyncWorker
                 Napi::Object obj = Napi::Object::New(env);
                 obj.Set("layer", Napi::String::New(env, it->first));
                 Napi::Value arg = Napi::External<mapnik::featureset_ptr>::New(env, &it->second);
-                obj.Set("featureset", Featureset::constructor.New({arg}));
+                obj.Set("featureset", Featureset::constructor(env).New({arg}));
                 arr.Set(idx, obj);
                 ++idx;
             }
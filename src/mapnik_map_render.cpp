@@ -4,6 +4,7 @@
 #include "object_to_container.hpp"
 // mapnik-vector-tile
 #include "vector_tile_processor.hpp"
+#include "lazy_datasource.hpp"
 // mapnik
 #include <mapnik/map.hpp>
 #include <mapnik/layer.hpp>
@@ -17,12 +18,20 @@
 #include <mapnik/image_util.hpp> // for save_to_file, guess_type, etc
 #include <mapnik/image_scaling.hpp>
 #if defined(HAVE_CAIRO)
+#include "mapnik_cairo_surface.hpp"
 #include <mapnik/cairo_io.hpp>
+#include <mapnik/cairo/cairo_renderer.hpp>
 #endif
 #if defined(GRID_RENDERER)
 #include "mapnik_grid.hpp"
+#include "lazy_grid_attributes.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
+#include "resource_cache.hpp"
 #include <mapnik/grid/grid.hpp>          // for hit_grid, grid
 #include <mapnik/grid/grid_renderer.hpp> // for grid_renderer
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
 #endif
 
 namespace detail {
@@ -46,6 +55,7 @@ struct agg_renderer_visitor
     void operator()(mapnik::image_rgba8& pixmap)
     {
         mapnik::agg_renderer<mapnik::image_rgba8> ren(m_, req_, vars_, pixmap, scale_factor_, offset_x_, offset_y_);
+        node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render agg");
         ren.apply(scale_denominator_);
     }
 
@@ -65,9 +75,9 @@ struct agg_renderer_visitor
     double scale_denominator_;
 };
 
-struct AsyncRender : Napi::AsyncWorker
+struct AsyncRender : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncRender(Map* map_obj, Napi::Function const& callback)
         : Base(callback),
           map_obj_(map_obj) {}
@@ -110,6 +120,8 @@ struct AsyncRenderImage : AsyncRender
         try
         {
             map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            node_mapnik::initialize_lazy_datasources(*map, scale_denominator_, scale_factor_);
             mapnik::request request(map->width(), map->height(), map->get_current_extent());
             request.set_buffer_size(buffer_size_);
             agg_renderer_visitor visit(*map,
@@ -130,7 +142,7 @@ struct AsyncRenderImage : AsyncRender
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
         Napi::Value arg = Napi::External<image_ptr>::New(env, &image_);
-        Napi::Object obj = Image::constructor.New({arg});
+        Napi::Object obj = Image::constructor(env).New({arg});
         return {env.Null(), napi_value(obj)};
     }
 
@@ -146,18 +158,20 @@ struct AsyncRenderImage : AsyncRender
 
 struct AsyncRenderGrid : AsyncRender
 {
-    AsyncRenderGrid(Map* map_obj, grid_ptr const& grid,
+    AsyncRenderGrid(Map* map_obj, Grid* grid_obj,
                     double scale_factor, double scale_denominator,
                     unsigned offset_x, unsigned offset_y,
-                    std::size_t layer_idx,
+                    std::size_t layer_idx, bool lazy_fields,
                     Napi::Function const& callback)
         : AsyncRender(map_obj, callback),
-          grid_(grid),
+          grid_obj_(grid_obj),
+          grid_(grid_obj->impl()),
           scale_factor_(scale_factor),
           scale_denominator_(scale_denominator),
           offset_x_(offset_x),
           offset_y_(offset_y),
-          layer_idx_(layer_idx) {}
+          layer_idx_(layer_idx),
+          lazy_fields_(lazy_fields) {}
 
     ~AsyncRenderGrid() {}
     void Execute() override
@@ -165,6 +179,9 @@ struct AsyncRenderGrid : AsyncRender
         try
         {
             map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            // no initialize_lazy_datasources: a grid renders a single layer, whose
+            // lazy datasource has nothing to be opened concurrently with
             std::vector<mapnik::layer> const& layers = map->layers();
             // copy property names
             std::set<std::string> attributes = grid_->get_fields();
@@ -182,13 +199,34 @@ struct AsyncRenderGrid : AsyncRender
             {
                 attributes.insert(join_field);
             }
+            mapnik::layer const& layer = layers[layer_idx_];
+            layer_name_ = layer.name();
+            if (lazy_fields_ && layer.datasource())
+            {
+                // rasterize with the key alone, attributes are fetched when encoding
+                mapnik::projection map_proj(map->srs(), true);
+                mapnik::projection layer_proj(layer.srs(), true);
+                mapnik::proj_transform tr(map_proj, layer_proj);
+                mapnik::box2d<double> query_extent = map->get_buffered_extent();
+                if (!tr.forward(query_extent, 20))
+                {
+                    query_extent = layer.datasource()->envelope();
+                }
+                lazy_attributes_ = std::make_shared<node_mapnik::lazy_grid_attributes>(layer.datasource(),
+                                                                                      query_extent,
+                                                                                      join_field,
+                                                                                      grid_->get_fields());
+                attributes.clear();
+                if (known_id_key != join_field) attributes.insert(join_field);
+            }
             mapnik::grid_renderer<mapnik::grid> ren(*map,
                                                     *grid_,
                                                     scale_factor_,
                                                     offset_x_,
                                                     offset_y_);
-            mapnik::layer const& layer = layers[layer_idx_];
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render grid");
             ren.apply(layer, attributes, scale_denominator_);
+            rendered_ = true;
         }
         catch (std::exception const& ex)
         {
@@ -196,22 +234,125 @@ struct AsyncRenderGrid : AsyncRender
         }
     }
 
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        // on the JS thread, so renders of other layers into this grid that
+        // completed meanwhile are kept; a layer rendered with all its fields no
+        // longer needs a resolver
+        if (rendered_)
+        {
+            grid_obj_->set_lazy_layers(node_mapnik::with_lazy_layer(grid_obj_->lazy_layers(), layer_name_, lazy_attributes_));
+        }
+        lazy_layers_ = grid_obj_->lazy_layers();
+        grid_obj_->Unref();
+        AsyncRender::OnWorkComplete(env, status);
+    }
+
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
         Napi::Value arg = Napi::External<grid_ptr>::New(env, &grid_);
-        Napi::Object obj = Grid::constructor.New({arg});
+        Napi::Object obj = Grid::constructor(env).New({arg});
+        Napi::ObjectWrap<Grid>::Unwrap(obj)->set_lazy_layers(lazy_layers_);
         return {env.Null(), napi_value(obj)};
     }
 
   private:
+    Grid* grid_obj_;
     grid_ptr grid_;
+    std::string layer_name_;
+    std::shared_ptr<node_mapnik::lazy_grid_attributes> lazy_attributes_;
+    node_mapnik::lazy_grid_layers_ptr lazy_layers_;
+    bool rendered_ = false;
     double scale_factor_;
     double scale_denominator_;
     unsigned offset_x_;
     unsigned offset_y_;
     std::size_t layer_idx_;
+    bool lazy_fields_;
 };
 
+#if defined(HAVE_CAIRO)
+struct AsyncRenderSurface : AsyncRender
+{
+    AsyncRenderSurface(Map* map_obj, CairoSurface* surface,
+                       double scale_factor, double scale_denominator,
+                       int buffer_size, unsigned offset_x, unsigned offset_y,
+                       mapnik::attributes const& variables,
+                       Napi::Function const& callback)
+        : AsyncRender(map_obj, callback),
+          surface_(surface),
+          scale_factor_(scale_factor),
+          scale_denominator_(scale_denominator),
+          buffer_size_(buffer_size),
+          offset_x_(offset_x),
+          offset_y_(offset_y),
+          variables_(variables) {}
+
+    void Execute() override
+    {
+        try
+        {
+            map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            node_mapnik::initialize_lazy_datasources(*map, scale_denominator_, scale_factor_);
+            mapnik::request request(map->width(), map->height(), map->get_current_extent());
+            request.set_buffer_size(buffer_size_);
+            {
+                // cairo writes the rest of the document when surface and context are destroyed
+                mapnik::cairo_surface_ptr surface = surface_->create_surface();
+                mapnik::cairo_ptr context = mapnik::create_context(surface);
+                mapnik::cairo_renderer<mapnik::cairo_ptr> ren(*map,
+                                                              request,
+                                                              variables_,
+                                                              context,
+                                                              scale_factor_,
+                                                              offset_x_,
+                                                              offset_y_);
+                node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render cairo");
+                ren.apply(scale_denominator_);
+            }
+            if (!surface_->output().finish())
+            {
+                SetError(surface_->output().error());
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        surface_->output().stop();
+        surface_->report_external_memory(env);
+        surface_->Unref();
+        AsyncRender::OnWorkComplete(env, status);
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        Napi::Value format = Napi::String::New(env, surface_->format());
+        Napi::Value width = Napi::Number::New(env, surface_->width());
+        Napi::Value height = Napi::Number::New(env, surface_->height());
+        Napi::Object obj = CairoSurface::constructor(env).New({format, width, height});
+        CairoSurface* result = Napi::ObjectWrap<CairoSurface>::Unwrap(obj);
+        result->share_output(*surface_);
+        result->report_external_memory(env);
+        return {env.Null(), napi_value(obj)};
+    }
+
+  private:
+    CairoSurface* surface_;
+    double scale_factor_;
+    double scale_denominator_;
+    int buffer_size_;
+    unsigned offset_x_;
+    unsigned offset_y_;
+    mapnik::attributes variables_;
+};
+#endif
+
 struct AsyncRenderFile : AsyncRender
 {
     AsyncRenderFile(Map* map_obj, std::string const& output_filename,
@@ -235,6 +376,8 @@ struct AsyncRenderFile : AsyncRender
         try
         {
             map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            node_mapnik::initialize_lazy_datasources(*map, scale_denominator_, scale_factor_);
             if (use_cairo_)
             {
 #if defined(HAVE_CAIRO)
@@ -256,7 +399,11 @@ struct AsyncRenderFile : AsyncRender
                                                               variables_,
                                                               im,
                                                               scale_factor_);
-                ren.apply(scale_denominator_);
+                {
+                    node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render agg");
+                    ren.apply(scale_denominator_);
+                }
+                node_mapnik::tracing::scope trace(node_mapnik::tracing::category_encode, "encode");
                 if (palette_.get())
                 {
                     mapnik::save_to_file(im, output_filename_, *palette_);
@@ -332,6 +479,8 @@ struct AsyncRenderVectorTile : AsyncRender
         try
         {
             map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            node_mapnik::initialize_lazy_datasources(*map, scale_denominator_, scale_factor_);
             mapnik::vector_tile_impl::processor ren(*map, variables_);
             ren.set_simplify_distance(simplify_distance_);
             ren.set_multi_polygon_union(multi_polygon_union_);
@@ -354,7 +503,7 @@ struct AsyncRenderVectorTile : AsyncRender
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
         Napi::Value arg = Napi::External<mapnik::vector_tile_impl::merc_tile_ptr>::New(env, &tile_);
-        Napi::Object obj = VectorTile::constructor.New({arg});
+        Napi::Object obj = VectorTile::constructor(env).New({arg});
         return {env.Undefined(), napi_value(obj)};
     }
 
@@ -379,7 +528,9 @@ struct AsyncRenderVectorTile : AsyncRender
 } // namespace detail
 
 /**
- * Renders a mapnik object (image tile, grid, vector tile) by passing in a renderable mapnik object.
+ * Renders a mapnik object (image tile, grid, vector tile, cairo surface) by passing in a renderable mapnik object.
+ * Rendering into a {@link CairoSurface} runs on the worker pool; a surface created with `fd` or
+ * `write` receives the document while it is rendered instead of holding it in memory.
  *
  * @instance
  * @name render
@@ -391,6 +542,8 @@ struct AsyncRenderVectorTile : AsyncRender
  * @param {Number} [options.scale_denominator=0.0]
  * @param {Number} [options.offset_x=0] pixel offset along the x-axis
  * @param {Number} [options.offset_y=0] pixel offset along the y-axis
+ * @param {String} [options.priority='interactive'] `interactive`, `batch` or `background`,
+ * the order waiting async work starts in, see {@link threadPool}
  * @param {String} [options.image_scaling] must be a valid scaling method (used when rendering a vector tile)
  * @param {String} [options.image_format] must be a string and valid image format (used when rendering a vector tile)
  * @param {Number} [options.area_threshold] used to discard small polygons by setting a minimum size (used when rendering a vector tile)
@@ -416,6 +569,12 @@ struct AsyncRenderVectorTile : AsyncRender
  * @param {Boolean} [options.process_all_rings] if `true`, don't assume winding order and ring order of
  * polygons are correct according to the [`2.0` Mapbox Vector Tile specification](https://github.com/mapbox/vector-tile-spec)
  * (used when rendering a vector tile)
+ * @param {String|Number} [options.layer] layer name or index (required when rendering a grid)
+ * @param {Array<String>} [options.fields] feature attributes to store in the grid (used when rendering a grid)
+ * @param {Boolean} [options.lazy_fields=false] rasterize the grid with feature keys only
+ * and fetch `fields` from the layer datasource when the grid is encoded, only for the
+ * features that survive the encoding `resolution`. Needs feature ids (or the grid key)
+ * to be stable between datasource queries. (used when rendering a grid)
  * @returns {mapnik.Map} rendered image tile
  *
  * @example
@@ -475,6 +634,7 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
         double scale_denominator = 0.0;
         unsigned offset_x = 0;
         unsigned offset_y = 0;
+        node_mapnik::worker_priority priority = node_mapnik::priority_interactive;
 
         Napi::Object options = Napi::Object::New(env);
         if (info.Length() > 2)
@@ -541,11 +701,12 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
                 }
                 offset_y = offset_y_val.As<Napi::Number>().Uint32Value();
             }
+            if (!node_mapnik::parse_priority(env, options, priority)) return env.Undefined();
         }
 
         Napi::Object obj = info[0].As<Napi::Object>();
 
-        if (obj.InstanceOf(Image::constructor.Value()))
+        if (obj.InstanceOf(Image::constructor(env).Value()))
         {
             image_ptr image = Napi::ObjectWrap<Image>::Unwrap(obj)->impl();
             mapnik::attributes variables;
@@ -575,13 +736,15 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
                                                         offset_y,
                                                         variables,
                                                         callback};
+            worker->SetPriority(priority);
             worker->Queue();
             return env.Undefined();
         }
 #if defined(GRID_RENDERER)
-        else if (obj.InstanceOf(Grid::constructor.Value()))
+        else if (obj.InstanceOf(Grid::constructor(env).Value()))
         {
-            grid_ptr grid = Napi::ObjectWrap<Grid>::Unwrap(obj)->impl();
+            Grid* grid_obj = Napi::ObjectWrap<Grid>::Unwrap(obj);
+            grid_ptr grid = grid_obj->impl();
             std::size_t layer_idx = 0;
 
             // grid requires special options for now
@@ -666,6 +829,17 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
                     }
                 }
             }
+            bool lazy_fields = false;
+            if (options.Has("lazy_fields"))
+            {
+                Napi::Value param_val = options.Get("lazy_fields");
+                if (!param_val.IsBoolean())
+                {
+                    Napi::TypeError::New(env, "option 'lazy_fields' must be a boolean").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                lazy_fields = param_val.As<Napi::Boolean>();
+            }
             if (!acquire())
             {
                 Napi::TypeError::New(env, "render: Map currently in use by another thread. Consider using a map pool.").ThrowAsJavaScriptException();
@@ -673,20 +847,66 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
             }
             Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
             this->Ref();
+            grid_obj->Ref();
             auto* worker = new detail::AsyncRenderGrid{this,
-                                                       grid,
+                                                       grid_obj,
                                                        scale_factor,
                                                        scale_denominator,
                                                        offset_x,
                                                        offset_y,
                                                        layer_idx,
+                                                       lazy_fields,
                                                        callback};
+            worker->SetPriority(priority);
+            worker->Queue();
+            return env.Undefined();
+        }
+#endif
+#if defined(HAVE_CAIRO)
+        else if (obj.InstanceOf(CairoSurface::constructor(env).Value()))
+        {
+            CairoSurface* surface = Napi::ObjectWrap<CairoSurface>::Unwrap(obj);
+            mapnik::attributes variables;
+            if (options.Has("variables"))
+            {
+                Napi::Value variables_val = options.Get("variables");
+                if (!variables_val.IsObject())
+                {
+                    Napi::TypeError::New(env, "optional arg 'variables' must be an object").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                object_to_container(variables, variables_val.As<Napi::Object>());
+            }
+            if (surface->output().rendering())
+            {
+                Napi::Error::New(env, "CairoSurface is being rendered, render into it once the render completed").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            if (!acquire())
+            {
+                Napi::TypeError::New(env, "render: Map currently in use by another thread. Consider using a map pool.").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+            surface->output().start(env);
+            surface->Ref();
+            this->Ref();
+            auto* worker = new detail::AsyncRenderSurface{this,
+                                                          surface,
+                                                          scale_factor,
+                                                          scale_denominator,
+                                                          buffer_size,
+                                                          offset_x,
+                                                          offset_y,
+                                                          variables,
+                                                          callback};
+            worker->SetPriority(priority);
             worker->Queue();
             return env.Undefined();
         }
 #endif
         // VT
-        else if (obj.InstanceOf(VectorTile::constructor.Value()))
+        else if (obj.InstanceOf(VectorTile::constructor(env).Value()))
         {
             mapnik::scaling_method_e scaling_method = mapnik::SCALING_BILINEAR;
             std::string image_format = "webp";
@@ -867,6 +1087,8 @@ Napi::Value Map::render(Napi::CallbackInfo const& info)
                     threading_mode,
                     variables,
                     callback};
+                worker->SetPriority(priority);
+                vt->track_async(worker);
                 worker->Queue();
             }
         }
@@ -927,7 +1149,7 @@ Napi::Value Map::renderSync(Napi::CallbackInfo const& info)
 
             Napi::Object obj = palette_opt.As<Napi::Object>();
 
-            if (!obj.InstanceOf(Palette::constructor.Value()))
+            if (!obj.InstanceOf(Palette::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.Palette expected as second arg").ThrowAsJavaScriptException();
                 return env.Undefined();
@@ -985,8 +1207,11 @@ Napi::Value Map::renderSync(Napi::CallbackInfo const& info)
                                                       mapnik::attributes(),
                                                       im,
                                                       scale_factor);
-        ren.apply(scale_denominator);
-
+        {
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render agg");
+            ren.apply(scale_denominator);
+        }
+        node_mapnik::tracing::scope trace(node_mapnik::tracing::category_encode, "encode");
         if (palette.get())
         {
             s = save_to_string(im, format, *palette);
@@ -1059,7 +1284,7 @@ Napi::Value Map::renderFile(Napi::CallbackInfo const& info)
 
             Napi::Object obj = palette_opt.As<Napi::Object>();
 
-            if (!obj.InstanceOf(Palette::constructor.Value()))
+            if (!obj.InstanceOf(Palette::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.Palette expected as second arg").ThrowAsJavaScriptException();
                 return env.Undefined();
@@ -1223,7 +1448,7 @@ Napi::Value Map::renderFileSync(Napi::CallbackInfo const& info)
 
             Napi::Object obj = palette_opt.As<Napi::Object>();
 
-            if (!obj.InstanceOf(Palette::constructor.Value()))
+            if (!obj.InstanceOf(Palette::constructor(env).Value()))
             {
                 Napi::TypeError::New(env, "mapnik.Palette expected as second arg").ThrowAsJavaScriptException();
                 return env.Undefined();
@@ -1310,8 +1535,11 @@ Napi::Value Map::renderFileSync(Napi::CallbackInfo const& info)
                                                           im,
                                                           scale_factor);
 
-            ren.apply(scale_denominator);
-
+            {
+                node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render agg");
+                ren.apply(scale_denominator);
+            }
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_encode, "encode");
             if (palette.get())
             {
                 mapnik::save_to_file(im, output_filename, *palette);
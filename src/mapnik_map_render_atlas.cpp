@@ -0,0 +1,387 @@
+#include "mapnik_map.hpp"
+#include "mapnik_cairo_surface.hpp"
+#include "object_to_container.hpp"
+#include "lazy_datasource.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
+#include "resource_cache.hpp"
+// mapnik
+#include <mapnik/map.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#if defined(HAVE_CAIRO)
+#include <mapnik/cairo/cairo_renderer.hpp>
+#if defined(CAIRO_HAS_PDF_SURFACE)
+#include <cairo-pdf.h>
+#endif
+#if defined(CAIRO_HAS_PS_SURFACE)
+#include <cairo-ps.h>
+#endif
+#endif
+// stl
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+namespace detail {
+
+struct atlas_page
+{
+    mapnik::box2d<double> extent;
+    unsigned width;
+    unsigned height;
+    double scale_factor = 1.0;
+    double scale_denominator = 0.0;
+};
+
+#if defined(HAVE_CAIRO)
+struct AsyncRenderAtlas : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncRenderAtlas(Map* map_obj, Napi::Object const& surface_obj,
+                     std::vector<atlas_page>&& pages, std::string const& format,
+                     std::size_t threads, int buffer_size,
+                     mapnik::attributes const& variables,
+                     Napi::Function const& callback)
+        : Base(callback),
+          map_obj_(map_obj),
+          surface_ref_(Napi::Persistent(surface_obj)),
+          surface_(Napi::ObjectWrap<CairoSurface>::Unwrap(surface_obj)),
+          pages_(std::move(pages)),
+          format_(format),
+          threads_(threads),
+          buffer_size_(buffer_size),
+          variables_(variables) {}
+
+    void Execute() override
+    {
+        try
+        {
+            map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            node_mapnik::initialize_lazy_datasources(*map, pages_.front().scale_denominator, pages_.front().scale_factor);
+            {
+                mapnik::cairo_surface_ptr target = surface_->create_surface(pages_.front().width, pages_.front().height);
+                mapnik::cairo_ptr context = mapnik::create_context(target);
+                // pages are recorded concurrently, a bounded window of them in flight so
+                // memory stays bounded, and replayed in order into the single document
+                // stream as soon as each is recorded. Fonts are subset once for the whole
+                // document.
+                node_mapnik::task_group group;
+                // no more pages recorded at once than there are threads to record them
+                std::size_t threads = std::min(group.threads(), pages_.size());
+                if (threads_ > 0) threads = std::min(threads, threads_);
+                std::deque<std::future<mapnik::cairo_surface_ptr>> recorded;
+                std::size_t next = 0;
+                auto record_next = [&]() {
+                    std::size_t i = next++;
+                    recorded.push_back(group.run([this, &map, i]() { return record_page(*map, pages_[i]); }));
+                };
+                while (next < threads) record_next();
+                for (std::size_t i = 0; i < pages_.size(); ++i)
+                {
+                    mapnik::cairo_surface_ptr page = group.get(recorded.front());
+                    recorded.pop_front();
+                    // refill the window before replaying so a thread is never left idle
+                    if (next < pages_.size()) record_next();
+                    set_page_size(target.get(), pages_[i].width, pages_[i].height);
+                    cairo_set_source_surface(context.get(), page.get(), 0, 0);
+                    cairo_paint(context.get());
+                    cairo_show_page(context.get());
+                }
+                if (cairo_status(context.get()) != CAIRO_STATUS_SUCCESS)
+                {
+                    throw std::runtime_error(cairo_status_to_string(cairo_status(context.get())));
+                }
+            }
+            if (!surface_->output().finish())
+            {
+                SetError(surface_->output().error());
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        surface_->output().stop();
+        surface_->report_external_memory(env);
+        map_obj_->release();
+        map_obj_->Unref();
+        Base::OnWorkComplete(env, status);
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        return {env.Null(), surface_ref_.Value()};
+    }
+
+  private:
+    mapnik::cairo_surface_ptr record_page(mapnik::Map const& map, atlas_page const& page) const
+    {
+        mapnik::Map page_map(map);
+        page_map.resize(page.width, page.height);
+        page_map.zoom_to_box(page.extent);
+        mapnik::request request(page.width, page.height, page_map.get_current_extent());
+        request.set_buffer_size(buffer_size_);
+        cairo_rectangle_t bounds = {0, 0, static_cast<double>(page.width), static_cast<double>(page.height)};
+        mapnik::cairo_surface_ptr surface(cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &bounds),
+                                          mapnik::cairo_surface_closer());
+        mapnik::cairo_ptr context = mapnik::create_context(surface);
+        mapnik::cairo_renderer<mapnik::cairo_ptr> ren(page_map,
+                                                      request,
+                                                      variables_,
+                                                      context,
+                                                      page.scale_factor);
+        node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render cairo");
+        ren.apply(page.scale_denominator);
+        return surface;
+    }
+
+    void set_page_size(cairo_surface_t* surface, double width, double height) const
+    {
+#if defined(CAIRO_HAS_PDF_SURFACE)
+        if (format_ == "pdf") cairo_pdf_surface_set_size(surface, width, height);
+#endif
+#if defined(CAIRO_HAS_PS_SURFACE)
+        if (format_ == "ps") cairo_ps_surface_set_size(surface, width, height);
+#endif
+    }
+
+    Map* map_obj_;
+    Napi::ObjectReference surface_ref_;
+    CairoSurface* surface_;
+    std::vector<atlas_page> pages_;
+    std::string format_;
+    std::size_t threads_;
+    int buffer_size_;
+    mapnik::attributes variables_;
+};
+#endif
+
+bool parse_atlas_page(Napi::Env env, Napi::Value const& value, atlas_page& page)
+{
+    if (!value.IsObject())
+    {
+        Napi::TypeError::New(env, "every page must be an object").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Object obj = value.As<Napi::Object>();
+    Napi::Value extent = obj.Get("extent");
+    if (!extent.IsArray() || extent.As<Napi::Array>().Length() != 4)
+    {
+        Napi::TypeError::New(env, "page 'extent' must be an array of [minx,miny,maxx,maxy]").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Array a = extent.As<Napi::Array>();
+    double coords[4];
+    for (std::uint32_t i = 0; i < 4; ++i)
+    {
+        Napi::Value coord = a.Get(i);
+        if (!coord.IsNumber())
+        {
+            Napi::TypeError::New(env, "page 'extent' must be an array of [minx,miny,maxx,maxy]").ThrowAsJavaScriptException();
+            return false;
+        }
+        coords[i] = coord.As<Napi::Number>().DoubleValue();
+    }
+    page.extent.init(coords[0], coords[1], coords[2], coords[3]);
+    Napi::Value width = obj.Get("width");
+    Napi::Value height = obj.Get("height");
+    if (!width.IsNumber() || !height.IsNumber() ||
+        width.As<Napi::Number>().Int32Value() <= 0 || height.As<Napi::Number>().Int32Value() <= 0)
+    {
+        Napi::TypeError::New(env, "page 'width' and 'height' must be positive integers").ThrowAsJavaScriptException();
+        return false;
+    }
+    page.width = width.As<Napi::Number>().Uint32Value();
+    page.height = height.As<Napi::Number>().Uint32Value();
+    if (obj.Has("scale"))
+    {
+        Napi::Value scale = obj.Get("scale");
+        if (!scale.IsNumber())
+        {
+            Napi::TypeError::New(env, "page 'scale' must be a number").ThrowAsJavaScriptException();
+            return false;
+        }
+        page.scale_factor = scale.As<Napi::Number>().DoubleValue();
+    }
+    if (obj.Has("scale_denominator"))
+    {
+        Napi::Value scale_denominator = obj.Get("scale_denominator");
+        if (!scale_denominator.IsNumber())
+        {
+            Napi::TypeError::New(env, "page 'scale_denominator' must be a number").ThrowAsJavaScriptException();
+            return false;
+        }
+        page.scale_denominator = scale_denominator.As<Napi::Number>().DoubleValue();
+    }
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * Render many pages of this map into one multi-page `pdf` or `ps` document in
+ * a single native job. Pages are rendered concurrently on separate recording
+ * surfaces and written to the document in order, so fonts are embedded once and
+ * the style and datasources are shared by every page.
+ *
+ * @name renderAtlas
+ * @memberof Map
+ * @instance
+ * @param {Array<Object>} pages every page has an `extent` ([minx,miny,maxx,maxy]
+ * in the map srs), a `width` and `height` in points, and optionally a `scale`
+ * factor and `scale_denominator`
+ * @param {Object} [options]
+ * @param {string} [options.format='pdf'] `pdf` or `ps`
+ * @param {mapnik.CairoSurface} [options.surface] surface to write the document
+ * into, for example one streaming to a file descriptor. One is created when omitted.
+ * @param {number} [options.threads] pages rendered concurrently, at most (and by
+ * default) the threads of the pool set with `mapnik.setThreadPool`. Without a pool
+ * pages are rendered one at a time.
+ * @param {number} [options.buffer_size=0]
+ * @param {Object} [options.variables]
+ * @param {Function} callback called with `(err, surface)`
+ * @example
+ * var fd = fs.openSync('atlas.pdf', 'w');
+ * var surface = new mapnik.CairoSurface('pdf', 595, 842, {fd: fd});
+ * map.renderAtlas(pages, {surface: surface}, function(err) {
+ *   fs.closeSync(fd);
+ * });
+ */
+Napi::Value Map::renderAtlas(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+#if defined(HAVE_CAIRO)
+    if (!info[0].IsArray() || info[0].As<Napi::Array>().Length() == 0)
+    {
+        Napi::TypeError::New(env, "first argument must be a non-empty array of pages").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Array pages_array = info[0].As<Napi::Array>();
+    std::vector<detail::atlas_page> pages(pages_array.Length());
+    for (std::uint32_t i = 0; i < pages_array.Length(); ++i)
+    {
+        if (!detail::parse_atlas_page(env, pages_array.Get(i), pages[i])) return env.Undefined();
+    }
+
+    std::string format = "pdf";
+    // 0: as many as the worker pool has threads
+    std::size_t threads = 0;
+    int buffer_size = 0;
+    mapnik::attributes variables;
+    Napi::Object surface_obj;
+    if (info.Length() > 2)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("format"))
+        {
+            Napi::Value format_val = options.Get("format");
+            format = format_val.IsString() ? format_val.As<Napi::String>().Utf8Value() : "";
+            if (format != "pdf" && format != "ps")
+            {
+                Napi::TypeError::New(env, "'format' must be 'pdf' or 'ps'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (options.Has("surface"))
+        {
+            Napi::Value surface_val = options.Get("surface");
+            if (!surface_val.IsObject() || !surface_val.As<Napi::Object>().InstanceOf(CairoSurface::constructor(env).Value()))
+            {
+                Napi::TypeError::New(env, "'surface' must be a CairoSurface").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            surface_obj = surface_val.As<Napi::Object>();
+            std::string surface_format = Napi::ObjectWrap<CairoSurface>::Unwrap(surface_obj)->format();
+            std::transform(surface_format.begin(), surface_format.end(), surface_format.begin(), ::tolower);
+            if (surface_format != format)
+            {
+                Napi::TypeError::New(env, "'surface' format must match the atlas 'format'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (options.Has("threads"))
+        {
+            Napi::Value threads_val = options.Get("threads");
+            if (!threads_val.IsNumber() || threads_val.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "'threads' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            threads = threads_val.As<Napi::Number>().Uint32Value();
+        }
+        if (options.Has("buffer_size"))
+        {
+            Napi::Value buffer_size_val = options.Get("buffer_size");
+            if (!buffer_size_val.IsNumber())
+            {
+                Napi::TypeError::New(env, "optional arg 'buffer_size' must be a number").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            buffer_size = buffer_size_val.As<Napi::Number>().Int32Value();
+        }
+        if (options.Has("variables"))
+        {
+            Napi::Value variables_val = options.Get("variables");
+            if (!variables_val.IsObject())
+            {
+                Napi::TypeError::New(env, "optional arg 'variables' must be an object").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            object_to_container(variables, variables_val.As<Napi::Object>());
+        }
+    }
+    if (surface_obj.IsEmpty())
+    {
+        surface_obj = CairoSurface::constructor(env).New({Napi::String::New(env, format),
+                                                     Napi::Number::New(env, pages.front().width),
+                                                     Napi::Number::New(env, pages.front().height)});
+    }
+    node_mapnik::surface_output& output = Napi::ObjectWrap<CairoSurface>::Unwrap(surface_obj)->output();
+    if (output.rendering())
+    {
+        Napi::Error::New(env, "CairoSurface is being rendered, render into it once the render completed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!acquire())
+    {
+        Napi::TypeError::New(env, "renderAtlas: Map currently in use by another thread. Consider using a map pool.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    output.start(env);
+    this->Ref();
+    auto* worker = new detail::AsyncRenderAtlas{this,
+                                                surface_obj,
+                                                std::move(pages),
+                                                format,
+                                                threads,
+                                                buffer_size,
+                                                variables,
+                                                info[info.Length() - 1].As<Napi::Function>()};
+    worker->Queue();
+    return env.Undefined();
+#else
+    Napi::Error::New(env, "renderAtlas requires mapnik built with cairo support").ThrowAsJavaScriptException();
+    return env.Undefined();
+#endif
+}
@@ -0,0 +1,89 @@
+#include "mapnik_map.hpp"
+#include "resource_cache.hpp"
+#include "worker_pool.hpp"
+// mapnik
+#include <mapnik/map.hpp>
+// stl
+#include <exception>
+#include <utility>
+
+namespace detail {
+
+struct AsyncWarmCache : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    AsyncWarmCache(Map* map_obj, Napi::Function const& callback)
+        : Base(callback),
+          map_obj_(map_obj) {}
+
+    void Execute() override
+    {
+        try
+        {
+            map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map, true);
+            found_ = resources.release();
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    void OnWorkComplete(Napi::Env env, napi_status status) override
+    {
+        map_obj_->release();
+        map_obj_->Unref();
+        Base::OnWorkComplete(env, status);
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("markers", Napi::Number::New(env, static_cast<double>(found_.first)));
+        result.Set("mapped_memory", Napi::Number::New(env, static_cast<double>(found_.second)));
+        return {env.Null(), result};
+    }
+
+  private:
+    Map* map_obj_;
+    std::pair<std::size_t, std::size_t> found_;
+};
+
+} // namespace detail
+
+/**
+ * Load the marker images and svgs this map references, and the shapefiles it
+ * memory maps, into mapnik's caches before the first render needs them, for
+ * example after `mapnik.clearCache()`. Markers whose path depends on feature
+ * attributes are only known while rendering and are not loaded.
+ *
+ * @name warmCache
+ * @memberof Map
+ * @instance
+ * @param {Function} callback called with `(err, loaded)` where `loaded` is
+ * `{markers, mapped_memory}`, the number of cached entries the map uses
+ * @example
+ * map.warmCache(function(err, loaded) {
+ *   if (err) throw err;
+ *   console.log(loaded.markers); // 12
+ * });
+ */
+Napi::Value Map::warmCache(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "requires a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!acquire())
+    {
+        Napi::TypeError::New(env, "warmCache: Map currently in use by another thread. Consider using a map pool.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    this->Ref();
+    auto* worker = new detail::AsyncWarmCache{this, info[0].As<Napi::Function>()};
+    worker->Queue();
+    return env.Undefined();
+}
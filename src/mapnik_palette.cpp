@@ -1,11 +1,15 @@
 #include "mapnik_palette.hpp"
+#include "instance_data.hpp"
 #include <mapnik/version.hpp>
 // stl
 #include <vector>
 #include <iomanip>
 #include <sstream>
 
-Napi::FunctionReference Palette::constructor;
+Napi::FunctionReference& Palette::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).palette;
+}
 
 Napi::Object Palette::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -15,8 +19,7 @@ Napi::Object Palette::Initialize(Napi::Env env, Napi::Object exports, napi_prope
             InstanceMethod<&Palette::toString>("toString", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Palette", func);
     return exports;
 }
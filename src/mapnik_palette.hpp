@@ -23,6 +23,6 @@ class Palette : public Napi::ObjectWrap<Palette>
     inline palette_ptr palette() { return palette_; }
 
   private:
-    static Napi::FunctionReference constructor;
+    static Napi::FunctionReference& constructor(Napi::Env env);
     palette_ptr palette_;
 };
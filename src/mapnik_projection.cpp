@@ -1,23 +1,198 @@
 #include "mapnik_projection.hpp"
+#include "instance_data.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
 
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/projection.hpp>
 #include <sstream>
+#include <stdexcept>
+#include <functional>
+#include <future>
+#include <vector>
+#include <algorithm>
 
-Napi::FunctionReference Projection::constructor;
+namespace {
+
+// below this many points per thread spinning up extra transforms costs more than it saves
+constexpr std::size_t min_points_per_thread = 16384;
+
+struct coords_args
+{
+    Napi::Float64Array coords;
+    std::size_t stride = 2;
+    bool in_place = true;
+};
+
+// parses `(Float64Array coords, [options])` shared by all `*Many` methods
+bool parse_coords_args(Napi::CallbackInfo const& info, std::size_t num_args, coords_args& args)
+{
+    Napi::Env env = info.Env();
+    if (num_args < 1 || !info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array)
+    {
+        Napi::TypeError::New(env, "first argument must be a Float64Array of interleaved coordinates").ThrowAsJavaScriptException();
+        return false;
+    }
+    args.coords = info[0].As<Napi::Float64Array>();
+    if (num_args > 1)
+    {
+        if (!info[1].IsObject())
+        {
+            Napi::TypeError::New(env, "optional second argument must be an options object").ThrowAsJavaScriptException();
+            return false;
+        }
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("stride"))
+        {
+            Napi::Value stride_opt = options.Get("stride");
+            if (!stride_opt.IsNumber() || stride_opt.As<Napi::Number>().Int64Value() < 2)
+            {
+                Napi::TypeError::New(env, "'stride' must be an integer >= 2").ThrowAsJavaScriptException();
+                return false;
+            }
+            args.stride = static_cast<std::size_t>(stride_opt.As<Napi::Number>().Int64Value());
+        }
+        if (options.Has("inPlace"))
+        {
+            Napi::Value in_place_opt = options.Get("inPlace");
+            if (!in_place_opt.IsBoolean())
+            {
+                Napi::TypeError::New(env, "'inPlace' must be a Boolean").ThrowAsJavaScriptException();
+                return false;
+            }
+            args.in_place = in_place_opt.As<Napi::Boolean>();
+        }
+    }
+    if (args.coords.ElementLength() % args.stride != 0)
+    {
+        Napi::Error::New(env, "Float64Array length must be a multiple of 'stride'").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (!args.in_place)
+    {
+        Napi::Float64Array copy = Napi::Float64Array::New(env, args.coords.ElementLength());
+        std::copy_n(args.coords.Data(), args.coords.ElementLength(), copy.Data());
+        args.coords = copy;
+    }
+    return true;
+}
+
+// Projects `count` points starting at `data` in place. `base` is the start of the
+// whole buffer, so a point that cannot be projected fails with its index in it.
+void project_points(mapnik::projection const& proj, double const* base, double* data,
+                    std::size_t count, std::size_t stride, bool forward)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double* p = data + i * stride;
+        bool success = forward ? proj.forward(p[0], p[1]) : proj.inverse(p[0], p[1]);
+        if (!success)
+        {
+            std::ostringstream s;
+            s << "Failed to " << (forward ? "forward" : "inverse") << " project the point at index "
+              << static_cast<std::size_t>(p - base) / stride;
+            throw std::runtime_error(s.str());
+        }
+    }
+}
+
+// Splits `count` interleaved points into contiguous chunks and runs `fn(data, count)` on each,
+// one chunk per thread of the worker pool. `fn` must construct its own PROJ state: PJ objects
+// are not safe to share between threads.
+template <typename ChunkFn>
+bool transform_chunked(double* data, std::size_t count, std::size_t stride, ChunkFn const& fn)
+{
+    node_mapnik::task_group group;
+    std::size_t threads = std::min(group.threads(), std::max<std::size_t>(1, count / min_points_per_thread));
+    if (threads <= 1)
+    {
+        return fn(data, count);
+    }
+    std::size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::future<bool>> results;
+    results.reserve(threads);
+    for (std::size_t start = 0; start < count; start += chunk)
+    {
+        double* chunk_data = data + start * stride;
+        std::size_t size = std::min(chunk, count - start);
+        results.push_back(group.run([&fn, chunk_data, size]() { return fn(chunk_data, size); }));
+    }
+    bool success = true;
+    for (auto& result : results)
+    {
+        // wait for all chunks, even after a failure, so no task outlives the buffer
+        if (!group.get(result)) success = false;
+    }
+    return success;
+}
+
+struct AsyncTransformMany : node_mapnik::AsyncWorker
+{
+    using Base = node_mapnik::AsyncWorker;
+    using transform_fn = std::function<bool(double*, std::size_t)>;
+    AsyncTransformMany(Napi::Float64Array const& coords, std::size_t stride,
+                       transform_fn fn, std::string const& error_msg, Napi::Function const& callback)
+        : Base(callback),
+          coords_ref_(Napi::Persistent(coords)),
+          data_(coords.Data()),
+          count_(coords.ElementLength() / stride),
+          stride_(stride),
+          fn_(std::move(fn)),
+          error_msg_(error_msg)
+    {
+    }
+
+    void Execute() override
+    {
+        try
+        {
+            if (!transform_chunked(data_, count_, stride_, fn_))
+            {
+                SetError(error_msg_);
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            SetError(ex.what());
+        }
+    }
+
+    std::vector<napi_value> GetResult(Napi::Env env) override
+    {
+        return {env.Null(), coords_ref_.Value()};
+    }
+
+  private:
+    Napi::Reference<Napi::Float64Array> coords_ref_;
+    double* data_;
+    std::size_t count_;
+    std::size_t stride_;
+    transform_fn fn_;
+    std::string error_msg_;
+};
+
+} // namespace
+
+Napi::FunctionReference& Projection::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).projection;
+}
 
 Napi::Object Projection::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
     // clang-format off
     Napi::Function func = DefineClass(env, "Projection", {
             InstanceMethod<&Projection::forward>("forward", prop_attr),
-            InstanceMethod<&Projection::inverse>("inverse", prop_attr)
+            InstanceMethod<&Projection::inverse>("inverse", prop_attr),
+            InstanceMethod<&Projection::forwardMany>("forwardMany", prop_attr),
+            InstanceMethod<&Projection::forwardManySync>("forwardManySync", prop_attr),
+            InstanceMethod<&Projection::inverseMany>("inverseMany", prop_attr),
+            InstanceMethod<&Projection::inverseManySync>("inverseManySync", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("Projection", func);
     return exports;
 }
@@ -71,6 +246,8 @@ Projection::Projection(Napi::CallbackInfo const& info)
     try
     {
         projection_ = std::make_shared<mapnik::projection>(info[0].As<Napi::String>(), lazy);
+        auto well_known = projection_->well_known();
+        is_merc_ = well_known && *well_known == mapnik::WEB_MERC;
     }
     catch (std::exception const& ex)
     {
@@ -228,18 +405,173 @@ Napi::Value Projection::inverse(Napi::CallbackInfo const& info)
     }
 }
 
-Napi::FunctionReference ProjTransform::constructor;
+Napi::Value Projection::transform_many_sync_(Napi::CallbackInfo const& info, bool forward)
+{
+    Napi::Env env = info.Env();
+    Napi::EscapableHandleScope scope(env);
+    coords_args args;
+    if (!parse_coords_args(info, info.Length(), args)) return env.Undefined();
+    try
+    {
+        double* data = args.coords.Data();
+        std::size_t count = args.coords.ElementLength() / args.stride;
+        if (is_merc_)
+        {
+            if (forward)
+                node_mapnik::lonlat_to_merc(data, count, args.stride);
+            else
+                node_mapnik::merc_to_lonlat(data, count, args.stride);
+            return scope.Escape(args.coords);
+        }
+        project_points(*projection_, data, data, count, args.stride, forward);
+    }
+    catch (std::exception const& ex)
+    {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    return scope.Escape(args.coords);
+}
+
+Napi::Value Projection::transform_many_(Napi::CallbackInfo const& info, bool forward)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    coords_args args;
+    if (!parse_coords_args(info, info.Length() - 1, args)) return env.Undefined();
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    proj_ptr proj = projection_;
+    std::size_t stride = args.stride;
+    if (is_merc_)
+    {
+        auto fn = [stride, forward](double* data, std::size_t count) {
+            if (forward)
+                node_mapnik::lonlat_to_merc(data, count, stride);
+            else
+                node_mapnik::merc_to_lonlat(data, count, stride);
+            return true;
+        };
+        auto* worker = new AsyncTransformMany{args.coords, stride, fn, "Failed to transform coordinates", callback};
+        worker->Queue();
+        return env.Undefined();
+    }
+    double const* base = args.coords.Data();
+    auto fn = [proj, base, stride, forward](double* data, std::size_t count) {
+        // each thread gets its own copy: mapnik::projection wraps a non-thread-safe PJ object
+        mapnik::projection local(*proj);
+        project_points(local, base, data, count, stride, forward);
+        return true;
+    };
+    auto* worker = new AsyncTransformMany{args.coords, stride, fn, "Failed to transform coordinates", callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
+/**
+ * Project a buffer of interleaved positions from WGS84 space into this projection (synchronous).
+ * A position that cannot be projected fails the call with its index, the positions
+ * before it may already be projected.
+ *
+ * @name forwardManySync
+ * @memberof Projection
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position, extra values (e.g. z) are left untouched
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @returns {Float64Array} projected coordinates
+ * @throws {Error} with the index of the first position that cannot be projected
+ * @example
+ * var merc = new mapnik.Projection('epsg:3857');
+ * var coords = new Float64Array([-122.33517, 47.63752, -122.2435, 47.67764]);
+ * merc.forwardManySync(coords);
+ */
+Napi::Value Projection::forwardManySync(Napi::CallbackInfo const& info)
+{
+    return transform_many_sync_(info, true);
+}
+
+/**
+ * Project a buffer of interleaved positions from WGS84 space into this projection.
+ * The work is split into chunks across threads off the main event loop. A position
+ * that cannot be projected fails the call with the index of the first one.
+ *
+ * @name forwardMany
+ * @memberof Projection
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @param {Function} callback - `function(err, coords)`
+ * @example
+ * merc.forwardMany(coords, {stride: 3}, function(err, projected) {
+ *   if (err) throw err;
+ * });
+ */
+Napi::Value Projection::forwardMany(Napi::CallbackInfo const& info)
+{
+    return transform_many_(info, true);
+}
+
+/**
+ * Unproject a buffer of interleaved positions from this projection to WGS84 space (synchronous).
+ * A position that cannot be unprojected fails the call with its index.
+ *
+ * @name inverseManySync
+ * @memberof Projection
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @returns {Float64Array} unprojected coordinates
+ */
+Napi::Value Projection::inverseManySync(Napi::CallbackInfo const& info)
+{
+    return transform_many_sync_(info, false);
+}
+
+/**
+ * Unproject a buffer of interleaved positions from this projection to WGS84 space.
+ * A position that cannot be unprojected fails the call with the index of the first one.
+ *
+ * @name inverseMany
+ * @memberof Projection
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @param {Function} callback - `function(err, coords)`
+ */
+Napi::Value Projection::inverseMany(Napi::CallbackInfo const& info)
+{
+    return transform_many_(info, false);
+}
+
+Napi::FunctionReference& ProjTransform::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).proj_transform;
+}
 
 Napi::Object ProjTransform::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
     // clang-format off
     Napi::Function func = DefineClass(env, "ProjTransform", {
             InstanceMethod<&ProjTransform::forward>("forward", prop_attr),
-            InstanceMethod<&ProjTransform::backward>("backward", prop_attr)
+            InstanceMethod<&ProjTransform::backward>("backward", prop_attr),
+            InstanceMethod<&ProjTransform::forwardMany>("forwardMany", prop_attr),
+            InstanceMethod<&ProjTransform::forwardManySync>("forwardManySync", prop_attr),
+            InstanceMethod<&ProjTransform::backwardMany>("backwardMany", prop_attr),
+            InstanceMethod<&ProjTransform::backwardManySync>("backwardManySync", prop_attr)
          });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("ProjTransform", func);
     return exports;
 }
@@ -258,7 +590,7 @@ ProjTransform::ProjTransform(Napi::CallbackInfo const& info)
 
     Napi::Object src_obj = info[0].As<Napi::Object>();
 
-    if (!src_obj.InstanceOf(Projection::constructor.Value()))
+    if (!src_obj.InstanceOf(Projection::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Projection expected for first argument")
             .ThrowAsJavaScriptException();
@@ -266,7 +598,7 @@ ProjTransform::ProjTransform(Napi::CallbackInfo const& info)
     }
 
     Napi::Object dst_obj = info[1].As<Napi::Object>();
-    if (!dst_obj.InstanceOf(Projection::constructor.Value()))
+    if (!dst_obj.InstanceOf(Projection::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Projection expected for second argument").ThrowAsJavaScriptException();
         return;
@@ -277,6 +609,9 @@ ProjTransform::ProjTransform(Napi::CallbackInfo const& info)
     try
     {
         proj_transform_ = std::make_shared<mapnik::proj_transform>(*p1->projection_, *p2->projection_);
+        source_ = p1->projection_;
+        dest_ = p2->projection_;
+        merc_pair_ = node_mapnik::detect_merc_pair(*source_, *dest_);
     }
     catch (std::exception const& ex)
     {
@@ -423,3 +758,147 @@ Napi::Value ProjTransform::backward(Napi::CallbackInfo const& info)
         }
     }
 }
+
+Napi::Value ProjTransform::transform_many_sync_(Napi::CallbackInfo const& info, bool forward)
+{
+    Napi::Env env = info.Env();
+    Napi::EscapableHandleScope scope(env);
+    coords_args args;
+    if (!parse_coords_args(info, info.Length(), args)) return env.Undefined();
+    double* data = args.coords.Data();
+    std::size_t count = args.coords.ElementLength() / args.stride;
+    if (merc_pair_ != node_mapnik::merc_pair::none)
+    {
+        if (forward == (merc_pair_ == node_mapnik::merc_pair::lonlat_to_merc))
+            node_mapnik::lonlat_to_merc(data, count, args.stride);
+        else
+            node_mapnik::merc_to_lonlat(data, count, args.stride);
+        return scope.Escape(args.coords);
+    }
+    bool success = forward ? proj_transform_->forward(data, data + 1, nullptr, count, args.stride)
+                           : proj_transform_->backward(data, data + 1, nullptr, count, args.stride);
+    if (!success)
+    {
+        std::ostringstream s;
+        s << "Failed to " << (forward ? "forward" : "back") << " project coordinates "
+          << proj_transform_->definition();
+        Napi::Error::New(env, s.str()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    return scope.Escape(args.coords);
+}
+
+Napi::Value ProjTransform::transform_many_(Napi::CallbackInfo const& info, bool forward)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[info.Length() - 1].IsFunction())
+    {
+        Napi::TypeError::New(env, "last argument must be a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    coords_args args;
+    if (!parse_coords_args(info, info.Length() - 1, args)) return env.Undefined();
+    Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+    proj_ptr source = source_;
+    proj_ptr dest = dest_;
+    std::size_t stride = args.stride;
+    if (merc_pair_ != node_mapnik::merc_pair::none)
+    {
+        bool to_merc = forward == (merc_pair_ == node_mapnik::merc_pair::lonlat_to_merc);
+        auto fn = [stride, to_merc](double* data, std::size_t count) {
+            if (to_merc)
+                node_mapnik::lonlat_to_merc(data, count, stride);
+            else
+                node_mapnik::merc_to_lonlat(data, count, stride);
+            return true;
+        };
+        auto* worker = new AsyncTransformMany{args.coords, stride, fn, "Failed to transform coordinates", callback};
+        worker->Queue();
+        return env.Undefined();
+    }
+    auto fn = [source, dest, stride, forward](double* data, std::size_t count) {
+        // PJ transforms are not thread safe so every chunk builds its own
+        mapnik::proj_transform tr(*source, *dest);
+        return forward ? tr.forward(data, data + 1, nullptr, count, stride)
+                       : tr.backward(data, data + 1, nullptr, count, stride);
+    };
+    std::ostringstream s;
+    s << "Failed to " << (forward ? "forward" : "back") << " project coordinates "
+      << proj_transform_->definition();
+    auto* worker = new AsyncTransformMany{args.coords, stride, fn, s.str(), callback};
+    worker->Queue();
+    return env.Undefined();
+}
+
+/**
+ * Transform a buffer of interleaved positions from the source to the destination projection (synchronous).
+ * Uses mapnik's batched transform path: one call for the whole buffer.
+ *
+ * @name forwardManySync
+ * @memberof ProjTransform
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position, extra values (e.g. z) are left untouched
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @returns {Float64Array} transformed coordinates
+ * @example
+ * var trans = new mapnik.ProjTransform(new mapnik.Projection('epsg:4326'), new mapnik.Projection('epsg:3857'));
+ * var merc = trans.forwardManySync(new Float64Array([-122.33517, 47.63752]), {inPlace: false});
+ */
+Napi::Value ProjTransform::forwardManySync(Napi::CallbackInfo const& info)
+{
+    return transform_many_sync_(info, true);
+}
+
+/**
+ * Transform a buffer of interleaved positions from the source to the destination projection.
+ * Large buffers are split into chunks that are transformed concurrently.
+ *
+ * @name forwardMany
+ * @memberof ProjTransform
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @param {Function} callback - `function(err, coords)`
+ */
+Napi::Value ProjTransform::forwardMany(Napi::CallbackInfo const& info)
+{
+    return transform_many_(info, true);
+}
+
+/**
+ * Transform a buffer of interleaved positions from the destination back to the source projection (synchronous).
+ *
+ * @name backwardManySync
+ * @memberof ProjTransform
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @returns {Float64Array} transformed coordinates
+ */
+Napi::Value ProjTransform::backwardManySync(Napi::CallbackInfo const& info)
+{
+    return transform_many_sync_(info, false);
+}
+
+/**
+ * Transform a buffer of interleaved positions from the destination back to the source projection.
+ *
+ * @name backwardMany
+ * @memberof ProjTransform
+ * @instance
+ * @param {Float64Array} coords interleaved coordinates as [x0, y0, x1, y1, ...]
+ * @param {Object} [options]
+ * @param {number} [options.stride=2] number of values per position
+ * @param {boolean} [options.inPlace=true] when false the input is copied and left unmodified
+ * @param {Function} callback - `function(err, coords)`
+ */
+Napi::Value ProjTransform::backwardMany(Napi::CallbackInfo const& info)
+{
+    return transform_many_(info, false);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <napi.h>
+#include "spherical_mercator.hpp"
 // stl
 #include <string>
 #include <memory>
@@ -26,10 +27,17 @@ class Projection : public Napi::ObjectWrap<Projection>
     // methods
     Napi::Value inverse(Napi::CallbackInfo const& info);
     Napi::Value forward(Napi::CallbackInfo const& info);
+    Napi::Value inverseMany(Napi::CallbackInfo const& info);
+    Napi::Value inverseManySync(Napi::CallbackInfo const& info);
+    Napi::Value forwardMany(Napi::CallbackInfo const& info);
+    Napi::Value forwardManySync(Napi::CallbackInfo const& info);
 
   private:
-    static Napi::FunctionReference constructor;
+    Napi::Value transform_many_sync_(Napi::CallbackInfo const& info, bool forward);
+    Napi::Value transform_many_(Napi::CallbackInfo const& info, bool forward);
+    static Napi::FunctionReference& constructor(Napi::Env env);
     proj_ptr projection_;
+    bool is_merc_ = false;
 };
 
 using proj_tr_ptr = std::shared_ptr<mapnik::proj_transform>;
@@ -37,6 +45,7 @@ using proj_tr_ptr = std::shared_ptr<mapnik::proj_transform>;
 class ProjTransform : public Napi::ObjectWrap<ProjTransform>
 {
     friend class Geometry;
+    friend class Feature;
 
   public:
     // initializer
@@ -46,9 +55,21 @@ class ProjTransform : public Napi::ObjectWrap<ProjTransform>
     // methods
     Napi::Value forward(Napi::CallbackInfo const& info);
     Napi::Value backward(Napi::CallbackInfo const& info);
+    Napi::Value forwardMany(Napi::CallbackInfo const& info);
+    Napi::Value forwardManySync(Napi::CallbackInfo const& info);
+    Napi::Value backwardMany(Napi::CallbackInfo const& info);
+    Napi::Value backwardManySync(Napi::CallbackInfo const& info);
     inline proj_tr_ptr impl() { return proj_transform_; }
+    inline proj_ptr source() const { return source_; }
+    inline proj_ptr dest() const { return dest_; }
 
   private:
-    static Napi::FunctionReference constructor;
+    Napi::Value transform_many_sync_(Napi::CallbackInfo const& info, bool forward);
+    Napi::Value transform_many_(Napi::CallbackInfo const& info, bool forward);
+    static Napi::FunctionReference& constructor(Napi::Env env);
     proj_tr_ptr proj_transform_;
+    // source and destination are kept alive for per-thread transforms
+    proj_ptr source_;
+    proj_ptr dest_;
+    node_mapnik::merc_pair merc_pair_ = node_mapnik::merc_pair::none;
 };
@@ -1,4 +1,6 @@
 #include "utils.hpp"
+#include "instance_data.hpp"
+#include "worker_pool.hpp"
 #include "mapnik_map.hpp"
 #include "mapnik_image.hpp"
 #if defined(GRID_RENDERER)
@@ -38,7 +40,10 @@
 #include <exception> // for exception
 #include <vector>    // for vector
 
-Napi::FunctionReference VectorTile::constructor;
+Napi::FunctionReference& VectorTile::constructor(Napi::Env env)
+{
+    return node_mapnik::instance(env).vector_tile;
+}
 
 Napi::Object VectorTile::Initialize(Napi::Env env, Napi::Object exports, napi_property_attributes prop_attr)
 {
@@ -84,12 +89,12 @@ Napi::Object VectorTile::Initialize(Napi::Env env, Napi::Object exports, napi_pr
             InstanceMethod<&VectorTile::clear>("clear", prop_attr),
             InstanceMethod<&VectorTile::clearSync>("clearSync", prop_attr),
             InstanceMethod<&VectorTile::empty>("empty", prop_attr),
+            InstanceMethod<&VectorTile::dispose>("dispose", prop_attr),
             // static methods
             StaticMethod<&VectorTile::info>("info", prop_attr)
         });
     // clang-format on
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+    constructor(env) = Napi::Persistent(func);
     exports.Set("VectorTile", func);
     return exports;
 }
@@ -124,6 +129,7 @@ VectorTile::VectorTile(Napi::CallbackInfo const& info)
     {
         auto ext = info[0].As<Napi::External<mapnik::vector_tile_impl::merc_tile_ptr>>();
         if (ext) tile_ = *ext.Data();
+        report_external_memory(env);
         return;
     }
 
@@ -207,6 +213,46 @@ VectorTile::VectorTile(Napi::CallbackInfo const& info)
     tile_ = std::make_shared<mapnik::vector_tile_impl::merc_tile>(x, y, z, tile_size, buffer_size);
 }
 
+void VectorTile::report_external_memory(Napi::Env env)
+{
+    node_mapnik::report_external_memory(env, external_memory_, tile_.get(), tile_ ? tile_->size() : 0);
+}
+
+void VectorTile::track_async(node_mapnik::AsyncWorker* worker)
+{
+    Ref();
+    worker->OnComplete([this](Napi::Env env) {
+        report_external_memory(env);
+        Unref();
+    });
+}
+
+/**
+ * Free the encoded data of this vector tile now rather than when it is garbage
+ * collected. The tile keeps its coordinates and is empty afterwards; async work
+ * still running on the old data completes on its own copy.
+ *
+ * @memberof VectorTile
+ * @instance
+ * @name dispose
+ * @example
+ * vt.getData(function(err, data) {
+ *   vt.dispose();
+ *   // send data
+ * });
+ */
+Napi::Value VectorTile::dispose(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (tile_)
+    {
+        tile_ = std::make_shared<mapnik::vector_tile_impl::merc_tile>(tile_->x(), tile_->y(), tile_->z(),
+                                                                      tile_->tile_size(), tile_->buffer_size());
+    }
+    report_external_memory(env);
+    return env.Undefined();
+}
+
 /**
  * Get the extent of this vector tile
  *
@@ -342,7 +388,7 @@ Napi::Value VectorTile::layer(Napi::CallbackInfo const& info)
         }
     }
     Napi::Value arg = Napi::External<mapnik::vector_tile_impl::merc_tile_ptr>::New(env, &new_tile);
-    Napi::Object obj = VectorTile::constructor.New({arg});
+    Napi::Object obj = VectorTile::constructor(env).New({arg});
     return scope.Escape(obj);
 }
 
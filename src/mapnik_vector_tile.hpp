@@ -43,6 +43,10 @@ struct queryMany_result
 namespace detail {
 struct AsyncRenderVectorTile;
 }
+namespace node_mapnik {
+class AsyncWorker;
+class external_memory;
+}
 
 class VectorTile : public Napi::ObjectWrap<VectorTile>
 {
@@ -52,6 +56,7 @@ class VectorTile : public Napi::ObjectWrap<VectorTile>
     // ctor
     explicit VectorTile(Napi::CallbackInfo const& info);
     // methods
+    Napi::Value dispose(Napi::CallbackInfo const& info);
     Napi::Value getData(Napi::CallbackInfo const& info);
     Napi::Value getDataSync(Napi::CallbackInfo const& info);
     Napi::Value render(Napi::CallbackInfo const& info);
@@ -102,8 +107,15 @@ class VectorTile : public Napi::ObjectWrap<VectorTile>
     Napi::Value get_buffer_size(Napi::CallbackInfo const& info);
     void set_buffer_size(Napi::CallbackInfo const& info, const Napi::Value& value);
     inline mapnik::vector_tile_impl::merc_tile_ptr impl() const { return tile_; }
-    static Napi::FunctionReference constructor;
+    // Tells V8 how large the encoded tile is now
+    void report_external_memory(Napi::Env env);
+    // Keeps this wrapper alive until `worker` changed the tile, and reports
+    // the new size before its callback runs
+    void track_async(node_mapnik::AsyncWorker* worker);
+    static Napi::FunctionReference& constructor(Napi::Env env);
 
   private:
     mapnik::vector_tile_impl::merc_tile_ptr tile_;
+    // share of the memory of the tile reported to V8
+    std::shared_ptr<node_mapnik::external_memory> external_memory_;
 };
@@ -1,11 +1,12 @@
 #include "mapnik_vector_tile.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
-struct AsyncClear : Napi::AsyncWorker
+struct AsyncClear : node_mapnik::AsyncWorker
 {
     AsyncClear(mapnik::vector_tile_impl::merc_tile_ptr const& tile, Napi::Function const& callback)
-        : Napi::AsyncWorker(callback),
+        : node_mapnik::AsyncWorker(callback),
           tile_(tile) {}
 
     void Execute() override
@@ -41,6 +42,7 @@ Napi::Value VectorTile::clearSync(Napi::CallbackInfo const& info)
 {
     Napi::Env env = info.Env();
     tile_->clear();
+    report_external_memory(env);
     return env.Undefined();
 }
 
@@ -74,6 +76,7 @@ Napi::Value VectorTile::clear(Napi::CallbackInfo const& info)
         return env.Undefined();
     }
     auto* worker = new AsyncClear(tile_, callback.As<Napi::Function>());
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
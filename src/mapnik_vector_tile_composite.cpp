@@ -1,6 +1,7 @@
 #include "mapnik_vector_tile.hpp"
 // mapnik-vector-tile
 #include "vector_tile_composite.hpp"
+#include "worker_pool.hpp"
 
 using tile_type = mapnik::vector_tile_impl::merc_tile_ptr;
 
@@ -342,7 +343,7 @@ Napi::Value VectorTile::compositeSync(Napi::CallbackInfo const& info)
             return env.Undefined();
         }
         Napi::Object tile_obj = val.As<Napi::Object>();
-        if (!tile_obj.InstanceOf(VectorTile::constructor.Value()))
+        if (!tile_obj.InstanceOf(VectorTile::constructor(env).Value()))
         {
             Napi::TypeError::New(env, "must provide an array of VectorTile objects").ThrowAsJavaScriptException();
             return env.Undefined();
@@ -372,16 +373,14 @@ Napi::Value VectorTile::compositeSync(Napi::CallbackInfo const& info)
     catch (std::exception const& ex)
     {
         Napi::TypeError::New(env, ex.what()).ThrowAsJavaScriptException();
-
-        return env.Undefined();
     }
-
+    report_external_memory(env);
     return env.Undefined();
 }
 
 namespace {
 
-struct AsyncCompositeVectorTile : Napi::AsyncWorker
+struct AsyncCompositeVectorTile : node_mapnik::AsyncWorker
 {
     AsyncCompositeVectorTile(tile_type const& tile,
                              std::vector<tile_type> const& vtiles,
@@ -401,7 +400,7 @@ struct AsyncCompositeVectorTile : Napi::AsyncWorker
                              mapnik::scaling_method_e scaling_method,
                              std::launch threading_mode,
                              Napi::Function const& callback)
-        : Napi::AsyncWorker(callback),
+        : node_mapnik::AsyncWorker(callback),
           tile_(tile),
           vtiles_(vtiles),
           scale_factor_(scale_factor),
@@ -452,7 +451,7 @@ struct AsyncCompositeVectorTile : Napi::AsyncWorker
     std::vector<napi_value> GetResult(Napi::Env env) override
     {
         Napi::Value arg = Napi::External<mapnik::vector_tile_impl::merc_tile_ptr>::New(env, &tile_);
-        Napi::Object obj = VectorTile::constructor.New({arg});
+        Napi::Object obj = VectorTile::constructor(env).New({arg});
         return {env.Undefined(), napi_value(obj)};
     }
 
@@ -513,6 +512,8 @@ struct AsyncCompositeVectorTile : Napi::AsyncWorker
  * @param {string} [options.scaling_method=bilinear] - can be any
  * of the <mapnik.imageScaling> methods
  * @param {string} [options.threading_mode=deferred]
+ * @param {string} [options.priority='interactive'] `interactive`, `batch` or `background`,
+ * the order waiting async work starts in, see {@link threadPool}
  * @param {Function} callback - `function(err)`
  * @example
  * var vt1 = new mapnik.VectorTile(0,0,0);
@@ -576,6 +577,7 @@ Napi::Value VectorTile::composite(Napi::CallbackInfo const& info)
     mapnik::scaling_method_e scaling_method = mapnik::SCALING_BILINEAR;
     std::launch threading_mode = std::launch::deferred;
     std::string merc_srs("epsg:3857");
+    node_mapnik::worker_priority priority = node_mapnik::priority_interactive;
 
     if (info.Length() > 2)
     {
@@ -797,6 +799,7 @@ Napi::Value VectorTile::composite(Napi::CallbackInfo const& info)
             }
             image_format = param_val.As<Napi::String>();
         }
+        if (!node_mapnik::parse_priority(env, options, priority)) return env.Undefined();
     }
 
     Napi::Value callback = info[info.Length() - 1];
@@ -810,7 +813,7 @@ Napi::Value VectorTile::composite(Napi::CallbackInfo const& info)
             return env.Undefined();
         }
         Napi::Object tile_obj = val.As<Napi::Object>();
-        if (!tile_obj.InstanceOf(VectorTile::constructor.Value()))
+        if (!tile_obj.InstanceOf(VectorTile::constructor(env).Value()))
         {
             Napi::TypeError::New(env, "must provide an array of VectorTile objects").ThrowAsJavaScriptException();
             return env.Undefined();
@@ -836,6 +839,8 @@ Napi::Value VectorTile::composite(Napi::CallbackInfo const& info)
                                                 scaling_method,
                                                 threading_mode,
                                                 callback.As<Napi::Function>()};
+    worker->SetPriority(priority);
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
@@ -1,11 +1,13 @@
 #include "mapnik_vector_tile.hpp"
 #include "vector_tile_load_tile.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
 
 namespace {
 
-struct AsyncSetData : Napi::AsyncWorker
+struct AsyncSetData : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncSetData(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                  Napi::Buffer<char> const& buffer,
                  bool validate,
@@ -50,9 +52,9 @@ struct AsyncSetData : Napi::AsyncWorker
     bool upgrade_;
 };
 
-struct AsyncGetData : Napi::AsyncWorker
+struct AsyncGetData : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncGetData(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                  bool compress,
                  bool release,
@@ -75,6 +77,7 @@ struct AsyncGetData : Napi::AsyncWorker
             // compress if requested
             if (compress_)
             {
+                node_mapnik::tracing::scope trace(node_mapnik::tracing::category_compress, "compress");
                 data_ = std::make_unique<std::string>();
                 mapnik::vector_tile_impl::zlib_compress(tile_->data(), tile_->size(), *data_, true, level_, strategy_);
             }
@@ -149,9 +152,9 @@ struct AsyncGetData : Napi::AsyncWorker
     std::unique_ptr<std::string> data_;
 };
 
-struct AsyncAddData : Napi::AsyncWorker
+struct AsyncAddData : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncAddData(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                  Napi::Buffer<char> const& buffer,
                  bool validate,
@@ -276,6 +279,7 @@ Napi::Value VectorTile::setDataSync(Napi::CallbackInfo const& info)
     {
         Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
     }
+    report_external_memory(env);
     return env.Undefined();
 }
 
@@ -354,6 +358,7 @@ Napi::Value VectorTile::setData(Napi::CallbackInfo const& info)
     }
     Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
     auto* worker = new AsyncSetData(tile_, obj.As<Napi::Buffer<char>>(), validate, upgrade, callback);
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
@@ -499,6 +504,7 @@ Napi::Value VectorTile::getDataSync(Napi::CallbackInfo const& info)
                 if (release)
                 {
                     std::unique_ptr<std::string> ptr = tile_->release_buffer();
+                    report_external_memory(env);
                     std::string& data = *ptr;
                     auto buffer = Napi::Buffer<char>::New(
                         Env(),
@@ -528,6 +534,7 @@ Napi::Value VectorTile::getDataSync(Napi::CallbackInfo const& info)
                 {
                     // To keep the same behaviour as a non compression release, we want to clear the VT buffer
                     tile_->clear();
+                    report_external_memory(env);
                 }
 
                 std::string& data = *compressed;
@@ -586,6 +593,8 @@ typedef struct
  * @param {boolean} [options.release=false] releases VT buffer
  * @param {int} [options.level=0] a number `0` (no compression) to `9` (best compression)
  * @param {string} options.strategy must be `FILTERED`, `HUFFMAN_ONLY`, `RLE`, `FIXED`, `DEFAULT`
+ * @param {string} [options.priority='interactive'] `interactive`, `batch` or `background`,
+ * the order waiting async work starts in, see {@link threadPool}
  * @param {Function} callback
  * @example
  * vt.getData({
@@ -697,8 +706,12 @@ Napi::Value VectorTile::getData(Napi::CallbackInfo const& info)
             }
         }
     }
+    node_mapnik::worker_priority priority = node_mapnik::priority_interactive;
+    if (!node_mapnik::parse_priority(env, options, priority)) return env.Undefined();
 
     auto* worker = new AsyncGetData(tile_, compress, release, level, strategy, callback.As<Napi::Function>());
+    worker->SetPriority(priority);
+    if (release) track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
@@ -783,9 +796,8 @@ Napi::Value VectorTile::addDataSync(Napi::CallbackInfo const& info)
     catch (std::exception const& ex)
     {
         Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
-
-        return env.Undefined();
     }
+    report_external_memory(env);
     return env.Undefined();
 }
 
@@ -865,6 +877,7 @@ Napi::Value VectorTile::addData(Napi::CallbackInfo const& info)
     }
     Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
     auto* worker = new AsyncAddData(tile_, obj.As<Napi::Buffer<char>>(), validate, upgrade, callback);
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
@@ -16,6 +16,7 @@
 // mapnik-vector-tile
 #include "vector_tile_processor.hpp"
 #include "vector_tile_load_tile.hpp"
+#include "worker_pool.hpp"
 
 /**
  * Add a {@link Image} as a tile layer (synchronous)
@@ -59,7 +60,7 @@ Napi::Value VectorTile::addImageSync(Napi::CallbackInfo const& info)
 
     std::string layer_name = info[1].As<Napi::String>();
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Image::constructor.Value()))
+    if (!obj.InstanceOf(Image::constructor(env).Value()))
     {
         Napi::Error::New(env, "first argument must be an Image object").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -136,6 +137,7 @@ Napi::Value VectorTile::addImageSync(Napi::CallbackInfo const& info)
         ren.set_scaling_method(scaling_method);
         ren.set_image_format(image_format);
         ren.update_tile(*tile_);
+        report_external_memory(env);
         return scope.Escape(Napi::Boolean::New(env, true));
     }
     catch (std::exception const& ex)
@@ -147,7 +149,7 @@ Napi::Value VectorTile::addImageSync(Napi::CallbackInfo const& info)
 
 namespace {
 
-struct AsyncAddImage : Napi::AsyncWorker
+struct AsyncAddImage : node_mapnik::AsyncWorker
 {
     AsyncAddImage(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                   image_ptr const& image,
@@ -155,7 +157,7 @@ struct AsyncAddImage : Napi::AsyncWorker
                   std::string const& image_format,
                   mapnik::scaling_method_e scaling_method,
                   Napi::Function const& callback)
-        : Napi::AsyncWorker(callback),
+        : node_mapnik::AsyncWorker(callback),
           tile_(tile),
           image_(image),
           layer_name_(layer_name),
@@ -254,7 +256,7 @@ Napi::Value VectorTile::addImage(Napi::CallbackInfo const& info)
     }
     std::string layer_name = info[1].As<Napi::String>();
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Image::constructor.Value()))
+    if (!obj.InstanceOf(Image::constructor(env).Value()))
     {
         Napi::Error::New(env, "first argument must be an Image object").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -311,6 +313,7 @@ Napi::Value VectorTile::addImage(Napi::CallbackInfo const& info)
     }
     auto* worker = new AsyncAddImage{tile_, im->impl(), layer_name, image_format,
                                      scaling_method, callback.As<Napi::Function>()};
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
@@ -361,6 +364,7 @@ Napi::Value VectorTile::addImageBufferSync(Napi::CallbackInfo const& info)
     try
     {
         add_image_buffer_as_tile_layer(*tile_, layer_name, obj.As<Napi::Buffer<char>>().Data(), buffer_size);
+        report_external_memory(env);
     }
     catch (std::exception const& ex)
     {
@@ -391,13 +395,13 @@ typedef struct
 
 namespace {
 
-struct AsyncAddImageBuffer : Napi::AsyncWorker
+struct AsyncAddImageBuffer : node_mapnik::AsyncWorker
 {
     AsyncAddImageBuffer(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                         Napi::Buffer<char> const& buffer,
                         std::string const& layer_name,
                         Napi::Function const& callback)
-        : Napi::AsyncWorker(callback),
+        : node_mapnik::AsyncWorker(callback),
           tile_(tile),
           buffer_ref{Napi::Persistent(buffer)},
           data_{buffer.Data()},
@@ -481,6 +485,7 @@ Napi::Value VectorTile::addImageBuffer(Napi::CallbackInfo const& info)
     }
 
     auto* worker = new AsyncAddImageBuffer{tile_, obj.As<Napi::Buffer<char>>(), layer_name, callback.As<Napi::Function>()};
+    track_async(worker);
     worker->Queue();
     return env.Undefined();
 }
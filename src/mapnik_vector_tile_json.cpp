@@ -16,6 +16,8 @@
 #include "vector_tile_geometry_decoder.hpp"
 #include "vector_tile_load_tile.hpp"
 #include "object_to_container.hpp"
+#include "spherical_mercator.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
@@ -319,9 +321,7 @@ bool layer_to_geojson(protozero::pbf_reader const& layer,
                       unsigned z)
 {
     mapnik::vector_tile_impl::tile_datasource_pbf ds(layer, x, y, z);
-    mapnik::projection wgs84("epsg:4326", true);
-    mapnik::projection merc("epsg:3857", true);
-    mapnik::proj_transform prj_trans(merc, wgs84);
+    mapnik::proj_transform const& prj_trans = node_mapnik::merc_to_wgs84_transform();
     // This mega box ensures we capture all features, including those
     // outside the tile extent. Geometries outside the tile extent are
     // likely when the vtile was created by clipping to a buffered extent
@@ -481,9 +481,9 @@ bool write_geojson_layer_name(std::string& result,
     return false;
 }
 
-struct AsyncToGeoJSON : Napi::AsyncWorker
+struct AsyncToGeoJSON : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncToGeoJSON(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                    geojson_write_type type, int layer_idx, std::string const& layer_name,
                    Napi::Function const& callback)
@@ -1111,6 +1111,7 @@ Napi::Value VectorTile::addGeoJSON(Napi::CallbackInfo const& info)
         ren.set_fill_type(fill_type);
         ren.set_process_all_rings(process_all_rings);
         ren.update_tile(*tile_);
+        report_external_memory(env);
         return Napi::Boolean::New(env, true);
     }
     catch (std::exception const& ex)
@@ -10,7 +10,9 @@
 // mapnik-vector-tile
 #include "mapnik_vector_tile.hpp"
 #include "vector_tile_projection.hpp"
+#include "spherical_mercator.hpp"
 #include "vector_tile_datasource_pbf.hpp"
+#include "worker_pool.hpp"
 
 namespace detail {
 
@@ -175,9 +177,7 @@ std::vector<query_result> _query(mapnik::vector_tile_impl::merc_tile_ptr const&
         return arr;
     }
 
-    mapnik::projection wgs84("epsg:4326", true);
-    mapnik::projection merc("epsg:3857", true);
-    mapnik::proj_transform tr(wgs84, merc);
+    mapnik::proj_transform const& tr = node_mapnik::wgs84_to_merc_transform();
     double x = lon;
     double y = lat;
     double z = 0;
@@ -281,7 +281,7 @@ Napi::Array _queryResultToV8(Napi::Env env, std::vector<query_result>& result)
     for (auto& item : result)
     {
         Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &item.feature);
-        Napi::Object feat_obj = Feature::constructor.New({arg});
+        Napi::Object feat_obj = Feature::constructor(env).New({arg});
         feat_obj.Set("layer", item.layer);
         feat_obj.Set("distance", Napi::Number::New(env, item.distance));
         feat_obj.Set("x_hit", Napi::Number::New(env, item.x_hit));
@@ -291,9 +291,9 @@ Napi::Array _queryResultToV8(Napi::Env env, std::vector<query_result>& result)
     return arr;
 }
 
-struct AsyncQuery : Napi::AsyncWorker
+struct AsyncQuery : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncQuery(mapnik::vector_tile_impl::merc_tile_ptr const& tile, double lon, double lat, double tolerance,
                std::string layer_name, Napi::Function const& callback)
         : Base(callback),
@@ -345,7 +345,7 @@ Napi::Object _queryManyResultToV8(Napi::Env env, queryMany_result& result)
     for (auto& item : result.features)
     {
         Napi::Value arg = Napi::External<mapnik::feature_ptr>::New(env, &item.second.feature);
-        Napi::Object feat_obj = Feature::constructor.New({arg});
+        Napi::Object feat_obj = Feature::constructor(env).New({arg});
         feat_obj.Set("layer", item.second.layer);
         features.Set(item.first, feat_obj);
     }
@@ -385,9 +385,7 @@ void _queryMany(queryMany_result& result,
 
     // Reproject query => mercator points
     mapnik::box2d<double> bbox;
-    mapnik::projection wgs84("epsg:4326", true);
-    mapnik::projection merc("epsg:3857", true);
-    mapnik::proj_transform tr(wgs84, merc);
+    mapnik::proj_transform const& tr = node_mapnik::wgs84_to_merc_transform();
     std::vector<mapnik::coord2d> points;
     points.reserve(query.size());
     for (std::size_t p = 0; p < query.size(); ++p)
@@ -492,9 +490,9 @@ void _queryMany(queryMany_result& result,
     result.features = std::move(features);
 }
 
-struct AsyncQueryMany : Napi::AsyncWorker
+struct AsyncQueryMany : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncQueryMany(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                    std::vector<query_lonlat> const& query, double tolerance,
                    std::string layer_name, std::vector<std::string> const& fields, Napi::Function const& callback)
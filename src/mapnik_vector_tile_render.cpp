@@ -32,6 +32,9 @@
 #include "vector_tile_geometry_decoder.hpp"
 #include "vector_tile_load_tile.hpp"
 #include "object_to_container.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
+#include "resource_cache.hpp"
 
 namespace {
 
@@ -88,37 +91,40 @@ void process_layers(Renderer& ren,
         if (lyr.visible(scale_denom))
         {
             protozero::pbf_reader layer_msg;
-            if (tile->layer_reader(lyr.name(), layer_msg))
+            std::shared_ptr<mapnik::vector_tile_impl::tile_datasource_pbf> ds;
             {
-                mapnik::layer lyr_copy(lyr);
-                lyr_copy.set_srs(map_srs);
-                std::shared_ptr<mapnik::vector_tile_impl::tile_datasource_pbf> ds = std::make_shared<
-                    mapnik::vector_tile_impl::tile_datasource_pbf>(
+                node_mapnik::tracing::scope trace(node_mapnik::tracing::category_decode, "decode layer", lyr.name().c_str());
+                if (!tile->layer_reader(lyr.name(), layer_msg)) continue;
+                ds = std::make_shared<mapnik::vector_tile_impl::tile_datasource_pbf>(
                     layer_msg,
                     tile->x(),
                     tile->y(),
                     tile->z());
-                ds->set_envelope(m_req.get_buffered_extent());
-                lyr_copy.set_datasource(ds);
-                std::set<std::string> names;
-                ren.apply_to_layer(lyr_copy,
-                                   ren,
-                                   map_proj,
-                                   m_req.scale(),
-                                   scale_denom,
-                                   m_req.width(),
-                                   m_req.height(),
-                                   m_req.extent(),
-                                   m_req.buffer_size(),
-                                   names);
             }
+            mapnik::layer lyr_copy(lyr);
+            lyr_copy.set_srs(map_srs);
+            ds->set_envelope(m_req.get_buffered_extent());
+            lyr_copy.set_datasource(ds);
+            std::set<std::string> names;
+            // features are decoded from the pbf as they are rendered
+            node_mapnik::tracing::scope trace(node_mapnik::tracing::category_render, "render layer", lyr.name().c_str());
+            ren.apply_to_layer(lyr_copy,
+                               ren,
+                               map_proj,
+                               m_req.scale(),
+                               scale_denom,
+                               m_req.width(),
+                               m_req.height(),
+                               m_req.extent(),
+                               m_req.buffer_size(),
+                               names);
         }
     }
 }
 
-struct AsyncRenderTile : Napi::AsyncWorker
+struct AsyncRenderTile : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncRenderTile(Map* map_obj,
                     mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                     surface_type const& surface,
@@ -159,6 +165,9 @@ struct AsyncRenderTile : Napi::AsyncWorker
         try
         {
             map_ptr map = map_obj_->impl();
+            node_mapnik::cached_resources resources(*map);
+            // no initialize_lazy_datasources: every layer is rendered from the
+            // tile, the datasources of the map are never opened
             mapnik::box2d<double> map_extent;
             if (zxy_override_)
             {
@@ -246,21 +255,18 @@ struct AsyncRenderTile : Napi::AsyncWorker
                 if (use_cairo_)
                 {
 #if defined(HAVE_CAIRO)
-                    mapnik::cairo_surface_ptr surface;
-                    // TODO - support any surface type
-                    surface = mapnik::cairo_surface_ptr(cairo_svg_surface_create_for_stream(
-                                                            (cairo_write_func_t)c->write_callback,
-                                                            (void*)(&c->stream()),
-                                                            static_cast<double>(c->width()),
-                                                            static_cast<double>(c->height())),
-                                                        mapnik::cairo_surface_closer());
-                    mapnik::cairo_ptr c_context = mapnik::create_context(surface);
-                    mapnik::cairo_renderer<mapnik::cairo_ptr> ren(*map, m_req,
-                                                                  variables_,
-                                                                  c_context, scale_factor_);
-                    ren.start_map_processing(*map);
-                    process_layers(ren, m_req, map_proj, layers, scale_denom, map->srs(), tile_);
-                    ren.end_map_processing(*map);
+                    {
+                        // the document is complete once surface and context are destroyed
+                        mapnik::cairo_surface_ptr surface = c->create_surface();
+                        mapnik::cairo_ptr c_context = mapnik::create_context(surface);
+                        mapnik::cairo_renderer<mapnik::cairo_ptr> ren(*map, m_req,
+                                                                      variables_,
+                                                                      c_context, scale_factor_);
+                        ren.start_map_processing(*map);
+                        process_layers(ren, m_req, map_proj, layers, scale_denom, map->srs(), tile_);
+                        ren.end_map_processing(*map);
+                    }
+                    if (!c->output().finish()) SetError(c->output().error());
 #else
                     SetError("no support for rendering svg with cairo backend");
 #endif
@@ -276,6 +282,7 @@ struct AsyncRenderTile : Napi::AsyncWorker
                     ren.start_map_processing(*map);
                     process_layers(ren, m_req, map_proj, layers, scale_denom, map->srs(), tile_);
                     ren.end_map_processing(*map);
+                    if (!c->output().finish()) SetError(c->output().error());
 #else
                     SetError("no support for rendering svg with native svg backend (-DSVG_RENDERER)");
 #endif
@@ -315,6 +322,12 @@ struct AsyncRenderTile : Napi::AsyncWorker
             map_obj_->release();
             map_obj_->Unref();
         }
+        if (surface_.is<CairoSurface*>())
+        {
+            CairoSurface* surface = mapnik::util::get<CairoSurface*>(surface_);
+            surface->output().stop();
+            surface->report_external_memory(env);
+        }
         mapnik::util::apply_visitor(deref_visitor(), surface_);
         Base::OnWorkComplete(env, status);
     }
@@ -325,7 +338,7 @@ struct AsyncRenderTile : Napi::AsyncWorker
         {
             image_ptr image = mapnik::util::get<Image*>(surface_)->impl();
             Napi::Value arg = Napi::External<image_ptr>::New(env, &image);
-            Napi::Object obj = Image::constructor.New({arg});
+            Napi::Object obj = Image::constructor(env).New({arg});
             return {env.Undefined(), napi_value(obj)};
         }
 #if defined(GRID_RENDERER)
@@ -333,20 +346,20 @@ struct AsyncRenderTile : Napi::AsyncWorker
         {
             grid_ptr grid = mapnik::util::get<Grid*>(surface_)->impl();
             Napi::Value arg = Napi::External<grid_ptr>::New(env, &grid);
-            Napi::Object obj = Grid::constructor.New({arg});
+            Napi::Object obj = Grid::constructor(env).New({arg});
             return {env.Undefined(), napi_value(obj)};
         }
 #endif
         else if (surface_.is<CairoSurface*>())
         {
             CairoSurface* c = mapnik::util::get<CairoSurface*>(surface_);
-            c->flush();
             Napi::Value width = Napi::Number::New(env, c->width());
             Napi::Value height = Napi::Number::New(env, c->height());
             Napi::Value format = Napi::String::New(env, c->format());
-            Napi::Object obj = CairoSurface::constructor.New({format, width, height});
+            Napi::Object obj = CairoSurface::constructor(env).New({format, width, height});
             CairoSurface* new_c = Napi::ObjectWrap<CairoSurface>::Unwrap(obj);
-            new_c->set_data(c->data());
+            new_c->share_output(*c);
+            new_c->report_external_memory(env);
             return {env.Undefined(), napi_value(obj)};
         }
         return Base::GetResult(env);
@@ -401,6 +414,8 @@ struct AsyncRenderTile : Napi::AsyncWorker
  * @param {string|number} [options.layer] option required for grid rendering
  * and must be either a layer name (string) or layer index (integer)
  * @param {Array<string>} [options.fields] must be an array of strings
+ * @param {string} [options.priority='interactive'] `interactive`, `batch` or `background`,
+ * the order waiting async work starts in, see {@link threadPool}
  * @param {Function} callback
  * @example
  * var vt = new mapnik.VectorTile(0,0,0);
@@ -425,7 +440,7 @@ Napi::Value VectorTile::render(Napi::CallbackInfo const& info)
     }
 
     Napi::Object obj = info[0].As<Napi::Object>();
-    if (!obj.InstanceOf(Map::constructor.Value()))
+    if (!obj.InstanceOf(Map::constructor(env).Value()))
     {
         Napi::TypeError::New(env, "mapnik.Map expected as first arg").ThrowAsJavaScriptException();
         return env.Undefined();
@@ -571,19 +586,22 @@ Napi::Value VectorTile::render(Napi::CallbackInfo const& info)
         }
     }
 
+    node_mapnik::worker_priority priority = node_mapnik::priority_interactive;
+    if (!node_mapnik::parse_priority(env, options, priority)) return env.Undefined();
+
     unsigned layer_idx = 0;
     unsigned width = 0;
     unsigned height = 0;
     surface_type surface;
     bool use_cairo = false;
-    if (im_obj.InstanceOf(Image::constructor.Value()))
+    if (im_obj.InstanceOf(Image::constructor(env).Value()))
     {
         Image* im = Napi::ObjectWrap<Image>::Unwrap(im_obj);
         width = im->impl()->width();
         height = im->impl()->height();
         surface = im;
     }
-    else if (im_obj.InstanceOf(CairoSurface::constructor.Value()))
+    else if (im_obj.InstanceOf(CairoSurface::constructor(env).Value()))
     {
         CairoSurface* c = Napi::ObjectWrap<CairoSurface>::Unwrap(im_obj);
         width = c->width();
@@ -614,7 +632,7 @@ Napi::Value VectorTile::render(Napi::CallbackInfo const& info)
         }
     }
 #if defined(GRID_RENDERER)
-    else if (im_obj.InstanceOf(Grid::constructor.Value()))
+    else if (im_obj.InstanceOf(Grid::constructor(env).Value()))
     {
         Grid* g = Napi::ObjectWrap<Grid>::Unwrap(im_obj);
         width = g->impl()->width();
@@ -711,6 +729,16 @@ Napi::Value VectorTile::render(Napi::CallbackInfo const& info)
         Napi::TypeError::New(env, "renderable mapnik object expected as second arg").ThrowAsJavaScriptException();
         return env.Undefined();
     }
+    if (surface.is<CairoSurface*>())
+    {
+        node_mapnik::surface_output& output = mapnik::util::get<CairoSurface*>(surface)->output();
+        if (output.rendering())
+        {
+            Napi::Error::New(env, "CairoSurface is being rendered, render into it once the render completed").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        output.start(env);
+    }
     mapnik::util::apply_visitor(ref_visitor(), surface);
     m->Ref();
     auto* worker = new AsyncRenderTile{m,
@@ -726,6 +754,7 @@ Napi::Value VectorTile::render(Napi::CallbackInfo const& info)
                                        use_cairo,
                                        zxy_override,
                                        callback.As<Napi::Function>()};
+    worker->SetPriority(priority);
     worker->Queue();
     return env.Undefined();
 }
@@ -22,6 +22,8 @@
 #include "vector_tile_geometry_decoder.hpp"
 #include "vector_tile_load_tile.hpp"
 #include "object_to_container.hpp"
+#include "spherical_mercator.hpp"
+#include "worker_pool.hpp"
 
 namespace {
 
@@ -371,9 +373,7 @@ void layer_not_valid(protozero::pbf_reader& layer_msg,
             {
                 if (lat_lon)
                 {
-                    mapnik::projection wgs84("epsg:4326", true);
-                    mapnik::projection merc("epsg:3857", true);
-                    mapnik::proj_transform prj_trans(merc, wgs84);
+                    mapnik::proj_transform const& prj_trans = node_mapnik::merc_to_wgs84_transform();
                     unsigned int n_err = 0;
                     mapnik::util::apply_visitor(
                         visitor_geom_valid(errors, feature, ds.get_name(), split_multi_features),
@@ -524,9 +524,9 @@ Napi::Array make_not_valid_array(Napi::Env env, std::vector<not_valid_feature>&
     return array;
 }
 
-struct AsyncGeometrySimple : Napi::AsyncWorker
+struct AsyncGeometrySimple : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncGeometrySimple(mapnik::vector_tile_impl::merc_tile_ptr const& tile, Napi::Function const& callback)
         : Base(callback),
           tile_(tile) {}
@@ -556,9 +556,9 @@ struct AsyncGeometrySimple : Napi::AsyncWorker
     std::vector<not_simple_feature> result_;
 };
 
-struct AsyncGeometryValid : Napi::AsyncWorker
+struct AsyncGeometryValid : node_mapnik::AsyncWorker
 {
-    using Base = Napi::AsyncWorker;
+    using Base = node_mapnik::AsyncWorker;
     AsyncGeometryValid(mapnik::vector_tile_impl::merc_tile_ptr const& tile,
                        bool split_multi_features, bool lat_lon, bool web_merc,
                        Napi::Function const& callback)
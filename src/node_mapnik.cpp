@@ -25,6 +25,11 @@
 #include "mapnik_grid_view.hpp"
 #endif
 #include "mapnik_expression.hpp"
+#include "mapnik_build_index.hpp"
+#include "worker_pool.hpp"
+#include "tracing.hpp"
+#include "resource_cache.hpp"
+#include "instance_data.hpp"
 #include "blend.hpp"
 
 // mapnik
@@ -65,6 +70,7 @@ static Napi::Value clearCache(Napi::CallbackInfo const& info)
     mapnik::marker_cache::instance().clear();
     mapnik::mapped_memory_cache::instance().clear();
 #endif
+    node_mapnik::clear_cached_resources();
     return env.Undefined();
 }
 } // namespace node_mapnik
@@ -333,6 +339,9 @@ void init_threading_mode_types(Napi::Env env, Napi::Object exports)
 
 Napi::Object init(Napi::Env env, Napi::Object exports)
 {
+    // called once per environment (main thread or worker_thread), so nothing
+    // tied to `env` may live in statics
+    init_instance_data(env);
     // methods
     exports.Set("registerDatasource", Napi::Function::New(env, node_mapnik::register_datasource));
     exports.Set("register_datasource", Napi::Function::New(env, node_mapnik::register_datasource));
@@ -345,6 +354,15 @@ Napi::Object init(Napi::Env env, Napi::Object exports)
     exports.Set("fontFiles", Napi::Function::New(env, node_mapnik::available_font_files));
     exports.Set("memoryFonts", Napi::Function::New(env, node_mapnik::memory_fonts));
     exports.Set("clearCache", Napi::Function::New(env, node_mapnik::clearCache));
+    exports.Set("configureCache", Napi::Function::New(env, node_mapnik::configure_cache));
+    exports.Set("cacheStats", Napi::Function::New(env, node_mapnik::cache_stats));
+    exports.Set("buildIndex", Napi::Function::New(env, node_mapnik::build_index));
+    exports.Set("setThreadPool", Napi::Function::New(env, node_mapnik::set_thread_pool));
+    exports.Set("threadPool", Napi::Function::New(env, node_mapnik::thread_pool_info));
+    Napi::Object tracing = Napi::Object::New(env);
+    tracing.Set("start", Napi::Function::New(env, node_mapnik::tracing::start));
+    tracing.Set("stop", Napi::Function::New(env, node_mapnik::tracing::stop));
+    exports.Set("tracing", tracing);
     exports.Set("blend", Napi::Function::New(env, node_mapnik::blend));
     exports.Set("rgb2hsl", Napi::Function::New(env, node_mapnik::rgb2hsl));
     exports.Set("hsl2rgb", Napi::Function::New(env, node_mapnik::hsl2rgb));
@@ -0,0 +1,407 @@
+#include "resource_cache.hpp"
+
+// mapnik
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/symbolizer_keys.hpp>
+#include <mapnik/path_expression.hpp>
+#include <mapnik/marker.hpp>
+#include <mapnik/marker_cache.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+
+namespace node_mapnik {
+
+bool resource_lru::touch(std::string const& key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return true;
+}
+
+void resource_lru::insert(std::string const& key, std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.misses;
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        // loaded by two renders at once
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    entries_.emplace_front(key, bytes);
+    index_.emplace(key, entries_.begin());
+    stats_.bytes += bytes;
+}
+
+bool resource_lru::trim(std::vector<std::string>& kept)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    kept.clear();
+    if (stats_.max_bytes == 0 || stats_.bytes <= stats_.max_bytes) return false;
+    std::size_t target = low_water();
+    while (!entries_.empty() && stats_.bytes > target)
+    {
+        stats_.bytes -= entries_.back().second;
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+    kept.reserve(entries_.size());
+    for (auto const& item : entries_)
+    {
+        kept.push_back(item.first);
+    }
+    return true;
+}
+
+void resource_lru::set_max_bytes(std::size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.max_bytes = max_bytes;
+}
+
+void resource_lru::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    stats_.bytes = 0;
+}
+
+resource_lru::stats resource_lru::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats result = stats_;
+    result.entries = entries_.size();
+    return result;
+}
+
+namespace {
+
+resource_lru marker_lru;
+resource_lru mapped_memory_lru;
+std::atomic<bool> configured{false};
+// one thread at a time clears a mapnik cache and reloads what is kept
+std::mutex trim_mutex;
+
+std::size_t file_size(std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return 0;
+    std::streamoff size = file.tellg();
+    return size > 0 ? static_cast<std::size_t>(size) : 0;
+}
+
+struct collect_files
+{
+    explicit collect_files(std::set<std::string>& files)
+        : files_(files) {}
+
+    template <typename Symbolizer>
+    void operator()(Symbolizer const& sym) const
+    {
+        auto it = sym.properties.find(mapnik::keys::file);
+        if (it == sym.properties.end() || !it->second.template is<mapnik::path_expression_ptr>()) return;
+        auto const& expr = it->second.template get<mapnik::path_expression_ptr>();
+        if (!expr) return;
+        std::string path;
+        for (auto const& part : *expr)
+        {
+            // paths built from feature attributes are only known while rendering
+            if (!part.template is<std::string>()) return;
+            path += part.template get<std::string>();
+        }
+        if (!path.empty()) files_.insert(path);
+    }
+
+  private:
+    std::set<std::string>& files_;
+};
+
+struct marker_bytes
+{
+    std::size_t operator()(mapnik::marker_rgba8 const& marker) const { return marker.get_data().size(); }
+    template <typename T>
+    std::size_t operator()(T const&) const
+    {
+        return 0;
+    }
+};
+
+std::set<std::string> marker_files(mapnik::Map const& map)
+{
+    std::set<std::string> files;
+    collect_files collect(files);
+    for (auto const& style : map.styles())
+    {
+        for (auto const& rule : style.second.get_rules())
+        {
+            for (auto const& sym : rule.get_symbolizers())
+            {
+                mapnik::util::apply_visitor(collect, sym);
+            }
+        }
+    }
+    if (map.background_image()) files.insert(*map.background_image());
+    // the builtin shapes and inline svgs are never cleared from the cache
+    mapnik::marker_cache& cache = mapnik::marker_cache::instance();
+    for (auto it = files.begin(); it != files.end();)
+    {
+        it = cache.is_uri(*it) ? files.erase(it) : std::next(it);
+    }
+    return files;
+}
+
+std::size_t load_marker(std::string const& path)
+{
+    std::shared_ptr<mapnik::marker const> marker = mapnik::marker_cache::instance().find(path, true);
+    if (!marker) return 0;
+    std::size_t bytes = mapnik::util::apply_visitor(marker_bytes(), *marker);
+    // svg markers are kept as parsed paths, about the size of the file
+    return bytes > 0 ? bytes : std::max<std::size_t>(1, file_size(path));
+}
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+std::set<std::string> mapped_files(mapnik::Map const& map)
+{
+    std::set<std::string> files;
+    for (auto const& layer : map.layers())
+    {
+        auto ds = layer.datasource();
+        if (!ds) continue;
+        mapnik::parameters const& params = ds->params();
+        // the shape plugin is the one that maps its files
+        boost::optional<std::string> type = params.get<std::string>("type");
+        boost::optional<std::string> file = params.get<std::string>("file");
+        if (!type || *type != "shape" || !file) continue;
+        boost::optional<std::string> base = params.get<std::string>("base");
+        std::string stem = base ? *base + "/" + *file : *file;
+        if (stem.size() > 4)
+        {
+            std::string ext = stem.substr(stem.size() - 4);
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (ext == ".shp") stem.erase(stem.size() - 4);
+        }
+        for (char const* ext : {".shp", ".shx", ".dbf", ".index"})
+        {
+            files.insert(stem + ext);
+        }
+    }
+    return files;
+}
+
+std::size_t load_mapped_file(std::string const& path)
+{
+    auto region = mapnik::mapped_memory_cache::instance().find(path, true);
+    if (!region || !*region) return 0;
+    return (*region)->get_size();
+}
+#endif
+
+} // namespace
+
+cached_resources::cached_resources(mapnik::Map const& map, bool force)
+{
+    if (!force && !configured.load(std::memory_order_relaxed)) return;
+    active_ = true;
+    for (auto const& path : marker_files(map))
+    {
+        if (marker_lru.touch(path)) ++found_.first;
+        else markers_.push_back(path);
+    }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    for (auto const& path : mapped_files(map))
+    {
+        if (mapped_memory_lru.touch(path)) ++found_.second;
+        else mapped_files_.push_back(path);
+    }
+#endif
+}
+
+cached_resources::~cached_resources()
+{
+    try
+    {
+        release();
+    }
+    catch (...)
+    {
+        // the render's own result matters more than the cache bookkeeping
+    }
+}
+
+std::pair<std::size_t, std::size_t> cached_resources::release()
+{
+    if (!active_) return found_;
+    active_ = false;
+    // the render decoded and cached what it drew, this only measures it
+    for (auto const& path : markers_)
+    {
+        std::size_t bytes = load_marker(path);
+        if (bytes == 0) continue;
+        marker_lru.insert(path, bytes);
+        ++found_.first;
+    }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    for (auto const& path : mapped_files_)
+    {
+        std::size_t bytes = load_mapped_file(path);
+        if (bytes == 0) continue;
+        mapped_memory_lru.insert(path, bytes);
+        ++found_.second;
+    }
+#endif
+
+    // mapnik can only drop a whole cache: it is cleared and the entries
+    // that are kept are loaded again. Markers the renders loaded from paths
+    // built from feature attributes are not recorded and go with the clear.
+    std::lock_guard<std::mutex> lock(trim_mutex);
+    std::vector<std::string> kept;
+    if (marker_lru.trim(kept))
+    {
+        mapnik::marker_cache::instance().clear();
+        for (auto const& path : kept)
+        {
+            mapnik::marker_cache::instance().find(path, true);
+        }
+    }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    if (mapped_memory_lru.trim(kept))
+    {
+        mapnik::mapped_memory_cache::instance().clear();
+        for (auto const& path : kept)
+        {
+            mapnik::mapped_memory_cache::instance().find(path, true);
+        }
+    }
+#endif
+    return found_;
+}
+
+void clear_cached_resources()
+{
+    marker_lru.clear();
+    mapped_memory_lru.clear();
+}
+
+namespace {
+
+bool parse_budget(Napi::Env env, Napi::Object const& options, char const* name, resource_lru& lru)
+{
+    if (!options.Has(name)) return true;
+    Napi::Value budget = options.Get(name);
+    if (!budget.IsObject())
+    {
+        Napi::TypeError::New(env, std::string("option '") + name + "' must be an object").ThrowAsJavaScriptException();
+        return false;
+    }
+    Napi::Object budget_obj = budget.As<Napi::Object>();
+    std::size_t max_bytes = 0;
+    if (budget_obj.Has("max_bytes"))
+    {
+        Napi::Value max_bytes_val = budget_obj.Get("max_bytes");
+        if (!max_bytes_val.IsNumber() || max_bytes_val.As<Napi::Number>().DoubleValue() < 0)
+        {
+            Napi::TypeError::New(env, std::string("option '") + name + ".max_bytes' must be a non-negative number").ThrowAsJavaScriptException();
+            return false;
+        }
+        max_bytes = static_cast<std::size_t>(max_bytes_val.As<Napi::Number>().Int64Value());
+    }
+    lru.set_max_bytes(max_bytes);
+    return true;
+}
+
+Napi::Object stats_object(Napi::Env env, resource_lru::stats const& stats)
+{
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    obj.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+    obj.Set("entries", Napi::Number::New(env, static_cast<double>(stats.entries)));
+    obj.Set("bytes", Napi::Number::New(env, static_cast<double>(stats.bytes)));
+    obj.Set("max_bytes", Napi::Number::New(env, static_cast<double>(stats.max_bytes)));
+    return obj;
+}
+
+} // namespace
+
+/**
+ * **`mapnik.configureCache`**
+ *
+ * Bound the caches mapnik keeps for the whole process: decoded marker images
+ * and svgs, and the memory mapped files of shapefiles. Once configured, every
+ * async render records the markers and files its map references and, once it
+ * is done, the ones it loaded. A cache that outgrew `max_bytes` then drops its
+ * least recently used entries until it is back under 80% of `max_bytes`, so
+ * renders do not trim on every call. mapnik can only clear a cache as a whole,
+ * so a trim clears it and loads the entries that are kept again.
+ *
+ * @name configureCache
+ * @param {Object} options
+ * @param {Object} [options.markers] `{max_bytes}` for the marker cache
+ * @param {Object} [options.mapped_memory] `{max_bytes}` for the mapped memory cache
+ * A `max_bytes` of 0 (the default) records usage without evicting; setting both
+ * back to 0 stops the recording altogether.
+ * @example
+ * mapnik.configureCache({ markers: { max_bytes: 64 << 20 }, mapped_memory: { max_bytes: 1 << 30 } });
+ */
+Napi::Value configure_cache(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "first argument must be an options object, eg. { markers: { max_bytes: 1048576 } }").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (!parse_budget(env, options, "markers", marker_lru) ||
+        !parse_budget(env, options, "mapped_memory", mapped_memory_lru))
+    {
+        return env.Undefined();
+    }
+    // with no budget left there is nothing to enforce, renders stop recording
+    configured = marker_lru.get_stats().max_bytes > 0 || mapped_memory_lru.get_stats().max_bytes > 0;
+    return env.Undefined();
+}
+
+/**
+ * **`mapnik.cacheStats`**
+ *
+ * Describe the marker and mapped memory caches bounded with {@link configureCache}.
+ * Hits and misses count the cached resources renders and {@link Map#warmCache}
+ * looked up.
+ *
+ * @name cacheStats
+ * @returns {Object} `{markers, mapped_memory}`, each with `hits`, `misses`,
+ * `evictions`, `entries`, `bytes` and `max_bytes`
+ */
+Napi::Value cache_stats(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("markers", stats_object(env, marker_lru.get_stats()));
+    result.Set("mapped_memory", stats_object(env, mapped_memory_lru.get_stats()));
+    return result;
+}
+
+} // namespace node_mapnik
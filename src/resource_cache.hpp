@@ -0,0 +1,88 @@
+#pragma once
+
+#include <napi.h>
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapnik {
+class Map;
+}
+
+namespace node_mapnik {
+
+// Least recently used order and sizes of the entries of one of mapnik's global
+// caches. mapnik keeps every entry until the cache is cleared and does not
+// expose its contents, so node-mapnik records the entries the maps it renders
+// use and brings the cache back to `max_bytes` when they outgrow it.
+class resource_lru
+{
+  public:
+    struct stats
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+        std::size_t max_bytes = 0;
+    };
+
+    // Makes `key` the most recently used entry (a hit), false when unknown
+    bool touch(std::string const& key);
+    // Records `key` as loaded into the cache (a miss)
+    void insert(std::string const& key, std::size_t bytes);
+    // Once the entries outgrow max_bytes, drops the least recently used ones
+    // until the rest fits in low_water() so that the next few renders do not
+    // trim again, false when nothing had to go. `kept` gets the rest, most
+    // recently used first. A max_bytes of 0 never evicts.
+    bool trim(std::vector<std::string>& kept);
+    void set_max_bytes(std::size_t max_bytes);
+    void clear();
+    stats get_stats() const;
+
+  private:
+    std::size_t low_water() const { return stats_.max_bytes - stats_.max_bytes / 5; }
+    using entry = std::pair<std::string, std::size_t>;
+    mutable std::mutex mutex_;
+    std::list<entry> entries_; // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> index_;
+    stats stats_;
+};
+
+// Keeps the caches within the budgets set with mapnik.configureCache around
+// one render of `map`. It records the cached markers and memory mapped files
+// the map references as used when created, and once the render is done (or
+// release() is called) records those the render loaded, loading any it did not
+// need, and trims the caches. Renders only track resources once a budget was
+// set, `force` does it regardless.
+class cached_resources
+{
+  public:
+    explicit cached_resources(mapnik::Map const& map, bool force = false);
+    ~cached_resources();
+    cached_resources(cached_resources const&) = delete;
+    cached_resources& operator=(cached_resources const&) = delete;
+    // Returns the number of markers and of mapped files found
+    std::pair<std::size_t, std::size_t> release();
+
+  private:
+    bool active_ = false;
+    std::pair<std::size_t, std::size_t> found_{0, 0};
+    // not cached when the render started
+    std::vector<std::string> markers_;
+    std::vector<std::string> mapped_files_;
+};
+// Forgets the recorded entries, for mapnik.clearCache
+void clear_cached_resources();
+
+Napi::Value configure_cache(Napi::CallbackInfo const& info);
+Napi::Value cache_stats(Napi::CallbackInfo const& info);
+
+} // namespace node_mapnik
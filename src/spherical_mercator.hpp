@@ -0,0 +1,97 @@
+#pragma once
+
+// mapnik
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace node_mapnik {
+
+// Process-wide lon/lat and spherical mercator projections. They are created
+// deferred, so no PROJ object backs them and sharing them between threads is safe:
+// mapnik resolves this pair analytically without touching PROJ.
+inline mapnik::projection const& wgs84_projection()
+{
+    static mapnik::projection const proj("epsg:4326", true);
+    return proj;
+}
+
+inline mapnik::projection const& merc_projection()
+{
+    static mapnik::projection const proj("epsg:3857", true);
+    return proj;
+}
+
+inline mapnik::proj_transform const& wgs84_to_merc_transform()
+{
+    static mapnik::proj_transform const tr(wgs84_projection(), merc_projection());
+    return tr;
+}
+
+inline mapnik::proj_transform const& merc_to_wgs84_transform()
+{
+    static mapnik::proj_transform const tr(merc_projection(), wgs84_projection());
+    return tr;
+}
+
+namespace detail {
+
+constexpr double merc_earth_radius = 6378137.0;
+constexpr double merc_max_latitude = 85.0511287798066;
+constexpr double merc_deg_to_rad = M_PI / 180.0;
+constexpr double merc_rad_to_deg = 180.0 / M_PI;
+
+} // namespace detail
+
+enum class merc_pair : std::uint8_t
+{
+    none = 0,
+    lonlat_to_merc,
+    merc_to_lonlat
+};
+
+// Detects whether source -> dest is the lon/lat <-> spherical mercator pair
+inline merc_pair detect_merc_pair(mapnik::projection const& source, mapnik::projection const& dest)
+{
+    auto src = source.well_known();
+    auto dst = dest.well_known();
+    if (!src || !dst) return merc_pair::none;
+    if (*src == mapnik::WGS_84 && *dst == mapnik::WEB_MERC) return merc_pair::lonlat_to_merc;
+    if (*src == mapnik::WEB_MERC && *dst == mapnik::WGS_84) return merc_pair::merc_to_lonlat;
+    return merc_pair::none;
+}
+
+// Same math and clamping as mapnik's lonlat2merc, applied to `count` interleaved
+// positions in place without going through proj_transform one point at a time.
+inline void lonlat_to_merc(double* coords, std::size_t count, std::size_t stride)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double* p = coords + i * stride;
+        double lon = std::min(std::max(p[0], -180.0), 180.0);
+        double lat = std::min(std::max(p[1], -detail::merc_max_latitude), detail::merc_max_latitude);
+        p[0] = detail::merc_earth_radius * lon * detail::merc_deg_to_rad;
+        p[1] = detail::merc_earth_radius * std::log(std::tan((90.0 + lat) * detail::merc_deg_to_rad * 0.5));
+    }
+}
+
+// Same math and clamping as mapnik's merc2lonlat
+inline void merc_to_lonlat(double* coords, std::size_t count, std::size_t stride)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double* p = coords + i * stride;
+        double lon = p[0] / detail::merc_earth_radius * detail::merc_rad_to_deg;
+        double lat = (2.0 * std::atan(std::exp(p[1] / detail::merc_earth_radius)) - M_PI_2) * detail::merc_rad_to_deg;
+        p[0] = std::min(std::max(lon, -180.0), 180.0);
+        p[1] = std::min(std::max(lat, -detail::merc_max_latitude), detail::merc_max_latitude);
+    }
+}
+
+} // namespace node_mapnik
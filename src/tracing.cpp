@@ -0,0 +1,365 @@
+#include "tracing.hpp"
+
+// stl
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __GNUG__
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace node_mapnik {
+namespace tracing {
+
+std::atomic<std::uint32_t> enabled_categories{0};
+
+namespace {
+
+struct category_name
+{
+    category cat;
+    char const* name;
+};
+
+category_name const category_names[] = {{category_worker, "worker"},
+                                        {category_decode, "decode"},
+                                        {category_query, "query"},
+                                        {category_render, "render"},
+                                        {category_encode, "encode"},
+                                        {category_compress, "compress"},
+                                        {category_blend, "blend"}};
+
+std::uint32_t const all_categories = 0x7f;
+
+struct event
+{
+    char const* name;
+    std::int64_t ts;  // ns since the trace started
+    std::int64_t dur; // ns
+    std::uint32_t cat;
+    bool type_name;
+    char detail[39];
+};
+
+// The events of one thread. Only that thread writes, a slot first and then the
+// head, so the JS thread can read a consistent copy without a lock; slots the
+// writer wrapped around onto while they were read are dropped. The buffer is
+// only reset or reallocated under the registry lock.
+struct thread_buffer
+{
+    std::uint32_t tid = 0;
+    std::atomic<std::uint64_t> trace{0}; // trace the events belong to
+    std::atomic<std::uint64_t> head{0};  // events written in that trace
+    std::atomic<bool> exited{false};
+    std::unique_ptr<event[]> events;
+    std::size_t capacity = 0;
+};
+
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<thread_buffer>> registry;
+std::uint32_t next_tid = 1;
+
+// bumped by every start, buffers written in an older trace are stale
+std::atomic<std::uint64_t> current_trace{0};
+std::atomic<std::int64_t> origin_ns{0};
+std::atomic<std::size_t> buffer_events{16384};
+
+std::int64_t to_ns(std::chrono::steady_clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// Registers the buffer of a thread on its first event and flags it when the
+// thread exits, so the next trace drops it.
+struct thread_slot
+{
+    std::shared_ptr<thread_buffer> buffer;
+
+    thread_buffer& get()
+    {
+        if (!buffer)
+        {
+            buffer = std::make_shared<thread_buffer>();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            buffer->tid = next_tid++;
+            registry.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    ~thread_slot()
+    {
+        if (buffer) buffer->exited = true;
+    }
+};
+
+thread_local thread_slot this_thread;
+
+void record(event const& ev)
+{
+    thread_buffer& buf = this_thread.get();
+    std::uint64_t trace = current_trace.load(std::memory_order_acquire);
+    if (buf.trace.load(std::memory_order_relaxed) != trace)
+    {
+        // first event of this thread in a new trace, under the lock so that a
+        // stop in another environment never reads a buffer being replaced
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        std::size_t capacity = buffer_events.load(std::memory_order_relaxed);
+        if (buf.capacity != capacity)
+        {
+            buf.events.reset(new event[capacity]);
+            buf.capacity = capacity;
+        }
+        buf.head.store(0, std::memory_order_relaxed);
+        buf.trace.store(trace, std::memory_order_release);
+    }
+    std::uint64_t head = buf.head.load(std::memory_order_relaxed);
+    buf.events[head % buf.capacity] = ev;
+    buf.head.store(head + 1, std::memory_order_release);
+}
+
+void append_escaped(std::string& out, char const* str)
+{
+    for (; *str; ++str)
+    {
+        unsigned char c = static_cast<unsigned char>(*str);
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += static_cast<char>(c);
+        }
+    }
+}
+
+std::string event_name(event const& ev)
+{
+    if (!ev.type_name) return ev.name;
+    std::string name = ev.name;
+#ifdef __GNUG__
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(ev.name, nullptr, nullptr, &status);
+    if (status == 0 && demangled) name = demangled;
+    std::free(demangled);
+#endif
+    // the workers mostly live in anonymous namespaces
+    std::string const anonymous = "(anonymous namespace)::";
+    std::string::size_type pos;
+    while ((pos = name.find(anonymous)) != std::string::npos)
+    {
+        name.erase(pos, anonymous.size());
+    }
+    return name;
+}
+
+char const* event_category(std::uint32_t cat)
+{
+    for (auto const& entry : category_names)
+    {
+        if (entry.cat == cat) return entry.name;
+    }
+    return "mapnik";
+}
+
+} // namespace
+
+scope::scope(category cat, char const* name, char const* detail, bool type_name)
+    : name_(name),
+      detail_(detail),
+      cat_(cat),
+      active_(enabled(cat)),
+      type_name_(type_name)
+{
+    if (active_) start_ = std::chrono::steady_clock::now();
+}
+
+scope::~scope()
+{
+    if (!active_) return;
+    std::int64_t start = to_ns(start_) - origin_ns.load(std::memory_order_relaxed);
+    // started before the current trace did
+    if (start < 0) return;
+    event ev;
+    ev.name = name_;
+    ev.ts = start;
+    ev.dur = to_ns(std::chrono::steady_clock::now()) - to_ns(start_);
+    ev.cat = cat_;
+    ev.type_name = type_name_;
+    ev.detail[0] = '\0';
+    if (detail_)
+    {
+        std::strncpy(ev.detail, detail_, sizeof(ev.detail) - 1);
+        ev.detail[sizeof(ev.detail) - 1] = '\0';
+    }
+    record(ev);
+}
+
+/**
+ * **`mapnik.tracing.start`**
+ *
+ * Start recording what the native code of node-mapnik does, in every thread:
+ * the async work of each call and its phases (vector tile decoding, datasource
+ * queries, rendering, encoding, compression and compositing in {@link blend}).
+ * Each thread keeps its latest `buffer_size` events, older ones are overwritten.
+ * Tracing is process wide; starting again discards the events recorded so far.
+ *
+ * @name tracing.start
+ * @param {Object} [options]
+ * @param {Array<string>} [options.categories] what to record among `worker`,
+ * `decode`, `query`, `render`, `encode`, `compress` and `blend`, all by default
+ * @param {number} [options.buffer_size=16384] events kept per thread
+ * @example
+ * mapnik.tracing.start({ categories: ['worker', 'render'] });
+ */
+Napi::Value start(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    std::uint32_t categories = all_categories;
+    std::size_t events = buffer_events.load();
+    if (info.Length() > 0)
+    {
+        if (!info[0].IsObject())
+        {
+            Napi::TypeError::New(env, "optional argument must be an options object").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("categories"))
+        {
+            Napi::Value cats = options.Get("categories");
+            if (!cats.IsArray())
+            {
+                Napi::TypeError::New(env, "option 'categories' must be an array of strings").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            Napi::Array array = cats.As<Napi::Array>();
+            categories = 0;
+            for (std::uint32_t i = 0; i < array.Length(); ++i)
+            {
+                Napi::Value item = array.Get(i);
+                std::string name = item.IsString() ? item.As<Napi::String>().Utf8Value() : std::string();
+                auto it = std::find_if(std::begin(category_names), std::end(category_names),
+                                       [&name](category_name const& entry) { return name == entry.name; });
+                if (it == std::end(category_names))
+                {
+                    Napi::TypeError::New(env, "unknown tracing category '" + name + "'").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                categories |= it->cat;
+            }
+        }
+        if (options.Has("buffer_size"))
+        {
+            Napi::Value size = options.Get("buffer_size");
+            if (!size.IsNumber() || size.As<Napi::Number>().Int32Value() <= 0)
+            {
+                Napi::TypeError::New(env, "option 'buffer_size' must be a positive integer").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            events = static_cast<std::size_t>(size.As<Napi::Number>().Int32Value());
+        }
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.erase(std::remove_if(registry.begin(), registry.end(),
+                                  [](std::shared_ptr<thread_buffer> const& buf) { return buf->exited.load(); }),
+                   registry.end());
+    buffer_events = events;
+    origin_ns = to_ns(std::chrono::steady_clock::now());
+    current_trace.fetch_add(1, std::memory_order_release);
+    enabled_categories = categories;
+    return env.Undefined();
+}
+
+/**
+ * **`mapnik.tracing.stop`**
+ *
+ * Stop recording and return the events recorded since {@link tracing.start} in
+ * the Chrome trace event format, to load in Perfetto or `chrome://tracing`.
+ *
+ * @name tracing.stop
+ * @returns {string} JSON with a `traceEvents` array of complete (`"X"`) events,
+ * one track per thread
+ * @example
+ * var fs = require('fs');
+ * fs.writeFileSync('trace.json', mapnik.tracing.stop());
+ */
+Napi::Value stop(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    enabled_categories = 0;
+    long pid = static_cast<long>(getpid());
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char field[128];
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::uint64_t trace = current_trace.load(std::memory_order_acquire);
+    for (auto const& buf : registry)
+    {
+        if (buf->trace.load(std::memory_order_acquire) != trace) continue;
+        std::uint64_t head = buf->head.load(std::memory_order_acquire);
+        std::uint64_t begin = head > buf->capacity ? head - buf->capacity : 0;
+        std::vector<event> events;
+        events.reserve(static_cast<std::size_t>(head - begin));
+        for (std::uint64_t i = begin; i < head; ++i)
+        {
+            events.push_back(buf->events[i % buf->capacity]);
+        }
+        // the thread may have kept writing over the oldest slots meanwhile, and
+        // may be writing the slot of event `now` (the one of `now - capacity`)
+        std::uint64_t now = buf->head.load(std::memory_order_acquire) + 1;
+        std::uint64_t overwritten = now > buf->capacity ? now - buf->capacity : 0;
+        std::size_t skip = static_cast<std::size_t>(overwritten > begin ? std::min(overwritten - begin, head - begin) : 0);
+        if (skip == events.size()) continue;
+
+        std::snprintf(field, sizeof(field),
+                      "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":\"mapnik thread %u\"}}",
+                      first ? "" : ",", pid, buf->tid, buf->tid);
+        out += field;
+        first = false;
+        for (std::size_t i = skip; i < events.size(); ++i)
+        {
+            event const& ev = events[i];
+            out += ",{\"ph\":\"X\",\"name\":\"";
+            append_escaped(out, event_name(ev).c_str());
+            out += "\",\"cat\":\"";
+            out += event_category(ev.cat);
+            std::snprintf(field, sizeof(field), "\",\"pid\":%ld,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                          pid, buf->tid, static_cast<double>(ev.ts) / 1000.0, static_cast<double>(ev.dur) / 1000.0);
+            out += field;
+            if (ev.detail[0] != '\0')
+            {
+                out += ",\"args\":{\"detail\":\"";
+                append_escaped(out, ev.detail);
+                out += "\"}";
+            }
+            out += '}';
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return Napi::String::New(env, out);
+}
+
+} // namespace tracing
+} // namespace node_mapnik
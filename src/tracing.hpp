@@ -0,0 +1,55 @@
+#pragma once
+
+#include <napi.h>
+// stl
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace node_mapnik {
+namespace tracing {
+
+// What a trace event records, selected with mapnik.tracing.start({categories})
+enum category : std::uint32_t
+{
+    category_worker = 1 << 0,   // Execute() of every async worker
+    category_decode = 1 << 1,   // vector tile layer decoding
+    category_query = 1 << 2,    // datasource queries
+    category_render = 1 << 3,   // rasterization
+    category_encode = 1 << 4,   // image encoding
+    category_compress = 1 << 5, // vector tile compression
+    category_blend = 1 << 6     // decoding and compositing in mapnik.blend
+};
+
+extern std::atomic<std::uint32_t> enabled_categories;
+
+inline bool enabled(category cat)
+{
+    return (enabled_categories.load(std::memory_order_relaxed) & cat) != 0;
+}
+
+// Records a complete event of `name` from construction to destruction on the
+// calling thread, when `cat` is being traced. `name` must outlive the trace, a
+// string literal or a typeid name; `detail` (a layer name...) is copied.
+class scope
+{
+  public:
+    scope(category cat, char const* name, char const* detail = nullptr, bool type_name = false);
+    ~scope();
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+
+  private:
+    char const* name_;
+    char const* detail_;
+    category cat_;
+    bool active_;
+    bool type_name_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+Napi::Value start(Napi::CallbackInfo const& info);
+Napi::Value stop(Napi::CallbackInfo const& info);
+
+} // namespace tracing
+} // namespace node_mapnik
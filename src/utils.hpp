@@ -3,8 +3,11 @@
 #include <napi.h>
 
 // stl
-#include <string>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 // core types
 #include <mapnik/unicode.hpp>
@@ -59,6 +62,103 @@ struct value_converter
     Napi::Env env_;
 };
 
+class external_memory;
+
+namespace detail {
+
+struct external_memory_registry
+{
+    std::mutex mutex;
+    std::unordered_map<void const*, std::weak_ptr<external_memory>> trackers;
+};
+
+inline external_memory_registry& external_memories()
+{
+    static external_memory_registry registry;
+    return registry;
+}
+
+} // namespace detail
+
+// The native memory of one allocation (pixels, encoded data, a document) as
+// reported to V8. Every wrapper of the allocation shares the same tracker, see
+// share_external_memory, so the bytes are counted once and given back when the
+// last wrapper lets go of the allocation.
+class external_memory
+{
+  public:
+    external_memory(napi_env env, void const* allocation)
+        : env_(env),
+          allocation_(allocation) {}
+
+    ~external_memory()
+    {
+        if (reported_ != 0) Napi::MemoryManagement::AdjustExternalMemory(Napi::Env(env_), -reported_);
+        auto& registry = detail::external_memories();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto itr = registry.trackers.find(allocation_);
+        if (itr != registry.trackers.end() && itr->second.expired()) registry.trackers.erase(itr);
+    }
+
+    external_memory(external_memory const&) = delete;
+    external_memory& operator=(external_memory const&) = delete;
+
+    void const* allocation() const { return allocation_; }
+
+    // Reports `bytes` as the size of the allocation now, only the difference
+    // to what was reported so far is sent
+    void update(std::size_t bytes)
+    {
+        if (js_owned_) bytes = 0;
+        std::int64_t delta = static_cast<std::int64_t>(bytes) - reported_;
+        if (delta != 0) Napi::MemoryManagement::AdjustExternalMemory(Napi::Env(env_), delta);
+        reported_ = static_cast<std::int64_t>(bytes);
+    }
+
+    // The memory belongs to a JS Buffer, which V8 already counts
+    void set_js_owned()
+    {
+        js_owned_ = true;
+        update(0);
+    }
+
+  private:
+    napi_env env_;
+    void const* allocation_;
+    std::int64_t reported_ = 0;
+    bool js_owned_ = false;
+};
+
+// The tracker of `allocation`, created on first use
+inline std::shared_ptr<external_memory> share_external_memory(napi_env env, void const* allocation)
+{
+    auto& registry = detail::external_memories();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::weak_ptr<external_memory>& slot = registry.trackers[allocation];
+    std::shared_ptr<external_memory> tracker = slot.lock();
+    if (!tracker)
+    {
+        tracker = std::make_shared<external_memory>(env, allocation);
+        slot = tracker;
+    }
+    return tracker;
+}
+
+// Tells V8 that `allocation` now holds `bytes`, `tracker` is the wrapper's
+// share of its tracker and follows the wrapper to a new allocation. A null
+// allocation drops the share.
+inline void report_external_memory(Napi::Env env, std::shared_ptr<external_memory>& tracker,
+                                   void const* allocation, std::size_t bytes)
+{
+    if (!allocation)
+    {
+        tracker.reset();
+        return;
+    }
+    if (!tracker || tracker->allocation() != allocation) tracker = share_external_memory(env, allocation);
+    tracker->update(bytes);
+}
+
 inline void params_to_object(Napi::Env env, Napi::Object& params, std::string const& key, mapnik::value_holder const& val)
 {
     params.Set(key, mapnik::util::apply_visitor(value_converter(env), val));
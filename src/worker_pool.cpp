@@ -0,0 +1,464 @@
+#include "worker_pool.hpp"
+#include "instance_data.hpp"
+#include "tracing.hpp"
+
+// stl
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <typeinfo>
+#include <utility>
+
+namespace node_mapnik {
+
+namespace {
+
+thread_local thread_pool* current_pool = nullptr;
+
+} // namespace
+
+thread_pool::thread_pool(std::size_t threads, std::size_t queues)
+{
+    for (std::size_t i = 0; i < queues; ++i)
+    {
+        queues_.emplace_back(new task_queue);
+    }
+    threads_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back(&thread_pool::run, this, i);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    shutdown();
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+    task_queue& queue = *queues_[next_++ % queues_.size()];
+    {
+        // counted under the queue lock, so take() never decrements a task
+        // that is not counted yet
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        ++queued_;
+    }
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_one();
+}
+
+bool thread_pool::take(std::size_t index, std::function<void()>& task)
+{
+    std::size_t count = queues_.size();
+    // own queue first, then the others in turn; always the oldest task so
+    // stealing keeps the submission order roughly intact
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        task_queue& queue = *queues_[(index + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --queued_;
+        return true;
+    }
+    return false;
+}
+
+thread_pool* thread_pool::current()
+{
+    return current_pool;
+}
+
+void thread_pool::run(std::size_t index)
+{
+    current_pool = this;
+    std::function<void()> task;
+    while (true)
+    {
+        if (take(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}
+
+void thread_pool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto& thread : threads_)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads_.clear();
+}
+
+// Tasks of a task_group not taken by a thread yet, and how many are running.
+// Shared with the helpers submitted to the pool, which may only run once the
+// group is gone and then find nothing left to do.
+struct task_group::state
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::size_t running = 0;
+
+    bool run_one()
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            ++running;
+        }
+        // a packaged_task, its exception goes to the future
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+        }
+        cv.notify_all();
+        return true;
+    }
+};
+
+task_group::task_group()
+    : pool_(thread_pool::current()),
+      state_(std::make_shared<state>()) {}
+
+task_group::~task_group()
+{
+    wait();
+}
+
+std::size_t task_group::threads() const
+{
+    return task_threads();
+}
+
+void task_group::enqueue(std::function<void()> task)
+{
+    if (!pool_)
+    {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->tasks.push_back(std::move(task));
+    }
+    std::shared_ptr<state> shared = state_;
+    pool_->submit([shared]() { shared->run_one(); });
+}
+
+bool task_group::run_one()
+{
+    return state_->run_one();
+}
+
+void task_group::wait()
+{
+    while (state_->run_one())
+    {
+    }
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->cv.wait(lock, [this] { return state_->tasks.empty() && state_->running == 0; });
+}
+
+// The pool set with mapnik.setThreadPool and the threadsafe function its workers
+// complete through. A replaced executor lives on until its last worker completed.
+struct executor
+{
+    std::shared_ptr<thread_pool> pool;
+    Napi::ThreadSafeFunction done;
+    std::size_t threads = 0;
+    std::size_t queues = 0;
+    // only touched on the JS thread
+    std::size_t in_flight = 0;
+    bool retired = false;
+};
+
+namespace {
+
+void retire(std::shared_ptr<executor> const& exec)
+{
+    exec->retired = true;
+    if (exec->in_flight == 0) exec->done.Release();
+    // the threads run what is already queued, joined off the JS thread
+    std::shared_ptr<thread_pool> pool = std::move(exec->pool);
+    std::thread([pool]() { pool->shutdown(); }).detach();
+}
+
+void finished(executor& exec, Napi::Env env)
+{
+    if (--exec.in_flight > 0) return;
+    // an idle pool must not keep the process alive
+    if (exec.retired)
+        exec.done.Release();
+    else
+        exec.done.Unref(env);
+}
+
+char const* const priority_names[] = {"interactive", "batch", "background"};
+
+// How long waiting work of a class gives way to newer work of the classes above
+// it. Work that waited longer than that goes first, so batch and background work
+// still progresses under a steady stream of interactive requests.
+std::chrono::milliseconds const priority_delay[] = {std::chrono::milliseconds(0),
+                                                    std::chrono::milliseconds(1000),
+                                                    std::chrono::milliseconds(10000)};
+
+std::size_t libuv_threads()
+{
+    // the variable libuv sizes its threadpool with
+    char const* size = std::getenv("UV_THREADPOOL_SIZE");
+    long threads = size ? std::strtol(size, nullptr, 10) : 0;
+    if (threads <= 0) threads = 4;
+    return static_cast<std::size_t>(std::min(threads, 1024L));
+}
+
+// The environment shuts down, its pool must not outlive it. Runs as a cleanup
+// hook registered after the threadsafe function of the pool, so before that is
+// finalized, which the instance data finalizer would not be.
+void scheduler_env_cleanup(void* arg)
+{
+    scheduler* sched = static_cast<scheduler*>(arg);
+    if (sched->exec)
+    {
+        retire(sched->exec);
+        sched->exec.reset();
+    }
+}
+
+} // namespace
+
+void scheduler::dispatch()
+{
+    static std::size_t const uv_threads = libuv_threads();
+    std::size_t capacity = exec ? exec->threads : uv_threads;
+    while (running < capacity)
+    {
+        AsyncWorker* next = nullptr;
+        std::size_t next_class = 0;
+        std::chrono::steady_clock::time_point next_due;
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            if (waiting[c].empty()) continue;
+            auto due = waiting[c].front()->queued_at_ + priority_delay[c];
+            if (!next || due < next_due)
+            {
+                next = waiting[c].front();
+                next_class = c;
+                next_due = due;
+            }
+        }
+        if (!next) return;
+        waiting[next_class].pop_front();
+        ++running;
+        next->Start();
+    }
+}
+
+bool parse_priority(Napi::Env env, Napi::Object const& options, worker_priority& priority)
+{
+    if (!options.Has("priority")) return true;
+    Napi::Value priority_opt = options.Get("priority");
+    std::string name = priority_opt.IsString() ? priority_opt.As<Napi::String>().Utf8Value() : std::string();
+    for (std::size_t c = 0; c < 3; ++c)
+    {
+        if (name == priority_names[c])
+        {
+            priority = static_cast<worker_priority>(c);
+            return true;
+        }
+    }
+    Napi::TypeError::New(env, "option 'priority' must be 'interactive', 'batch' or 'background'").ThrowAsJavaScriptException();
+    return false;
+}
+
+void AsyncWorker::Queue()
+{
+    queued_at_ = std::chrono::steady_clock::now();
+    scheduler& sched = instance(Env()).sched;
+    sched.waiting[priority_].push_back(this);
+    sched.dispatch();
+}
+
+void AsyncWorker::Start()
+{
+    std::shared_ptr<executor> exec = instance(Env()).sched.exec;
+    if (!exec)
+    {
+        Napi::AsyncWorker::Queue();
+        return;
+    }
+    if (exec->in_flight++ == 0) exec->done.Ref(Env());
+    exec->pool->submit([this, exec]() {
+        Run();
+        exec->done.BlockingCall(this, [exec](Napi::Env env, Napi::Function, AsyncWorker* worker) {
+            finished(*exec, env);
+            // same as a libuv completion: OnOK or OnError, then Destroy
+            worker->OnWorkComplete(env, napi_ok);
+        });
+    });
+}
+
+void AsyncWorker::OnExecute(Napi::Env env)
+{
+    // libuv threadpool
+    tracing::scope trace(tracing::category_worker, typeid(*this).name(), nullptr, true);
+    Napi::AsyncWorker::OnExecute(env);
+}
+
+void AsyncWorker::Run()
+{
+    tracing::scope trace(tracing::category_worker, typeid(*this).name(), nullptr, true);
+    try
+    {
+        Execute();
+    }
+    catch (std::exception const& ex)
+    {
+        SetError(ex.what());
+    }
+}
+
+void AsyncWorker::OnWorkComplete(Napi::Env env, napi_status status)
+{
+    scheduler& sched = instance(env).sched;
+    if (sched.running > 0) --sched.running;
+    // the next work starts before the callback of this one runs
+    sched.dispatch();
+    if (on_complete_) on_complete_(env);
+    Napi::AsyncWorker::OnWorkComplete(env, status);
+}
+
+/**
+ * **`mapnik.setThreadPool`**
+ *
+ * Run the async work of node-mapnik (rendering, encoding, compositing, queries...)
+ * on its own threads instead of the libuv threadpool, so long renders no longer
+ * hold up `fs` or `dns` work and can use more threads than `UV_THREADPOOL_SIZE`.
+ * Calling it again replaces the pool once the work queued on the previous one is
+ * done; `threads: 0` goes back to the libuv threadpool. Batch work (bulk
+ * transforms, atlases, index builds...) is split over the threads of the pool,
+ * and runs on a single thread without one.
+ *
+ * @name setThreadPool
+ * @param {Object} options
+ * @param {number} [options.threads] number of threads, the number of cores by default
+ * @param {number} [options.queues] number of task queues, one per thread by default.
+ * Idle threads take work from the other queues.
+ * @example
+ * mapnik.setThreadPool({ threads: 8 });
+ */
+Napi::Value set_thread_pool(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "first argument must be an options object, eg. { threads: 8 }").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (options.Has("threads"))
+    {
+        Napi::Value threads_opt = options.Get("threads");
+        if (!threads_opt.IsNumber() || threads_opt.As<Napi::Number>().Int32Value() < 0)
+        {
+            Napi::TypeError::New(env, "option 'threads' must be a non-negative integer").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        threads = static_cast<std::size_t>(threads_opt.As<Napi::Number>().Int32Value());
+    }
+    std::size_t queues = std::max<std::size_t>(1, threads);
+    if (options.Has("queues"))
+    {
+        Napi::Value queues_opt = options.Get("queues");
+        if (!queues_opt.IsNumber() || queues_opt.As<Napi::Number>().Int32Value() <= 0)
+        {
+            Napi::TypeError::New(env, "option 'queues' must be a positive integer").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        queues = static_cast<std::size_t>(queues_opt.As<Napi::Number>().Int32Value());
+    }
+    scheduler& sched = instance(env).sched;
+    if (sched.exec)
+    {
+        retire(sched.exec);
+        sched.exec.reset();
+    }
+    if (threads == 0)
+    {
+        sched.dispatch();
+        return env.Undefined();
+    }
+
+    auto exec = std::make_shared<executor>();
+    exec->pool = std::make_shared<thread_pool>(threads, queues);
+    exec->threads = threads;
+    exec->queues = queues;
+    exec->done = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](Napi::CallbackInfo const&) {}),
+                                               "mapnik.threadPool", 0, 1);
+    exec->done.Unref(env);
+    sched.exec = exec;
+    // moved behind the threadsafe function just created
+    if (sched.cleanup_hook) napi_remove_env_cleanup_hook(env, scheduler_env_cleanup, &sched);
+    napi_add_env_cleanup_hook(env, scheduler_env_cleanup, &sched);
+    sched.cleanup_hook = true;
+    // waiting work may fit on the new pool already
+    sched.dispatch();
+    return env.Undefined();
+}
+
+/**
+ * **`mapnik.threadPool`**
+ *
+ * Describe the pool set with {@link setThreadPool} and the async work of
+ * node-mapnik. Work is started by priority: every async entry point that takes
+ * options accepts `priority: 'interactive'` (the default), `'batch'` or
+ * `'background'`. Waiting batch work goes first once it waited 1s longer than
+ * interactive work, background work after 10s.
+ *
+ * @name threadPool
+ * @returns {Object} `{threads, queues, queued, running, waiting}` where `threads`
+ * is 0 when the libuv threadpool is used, `running` is the work started and not
+ * completed yet, `queued` the part of it still waiting in the pool queues and
+ * `waiting` the work not started yet, by priority
+ */
+Napi::Value thread_pool_info(Napi::CallbackInfo const& info)
+{
+    Napi::Env env = info.Env();
+    scheduler& sched = instance(env).sched;
+    std::shared_ptr<executor> exec = sched.exec;
+    bool active = static_cast<bool>(exec);
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("threads", Napi::Number::New(env, active ? static_cast<double>(exec->threads) : 0));
+    result.Set("queues", Napi::Number::New(env, active ? static_cast<double>(exec->queues) : 0));
+    result.Set("queued", Napi::Number::New(env, active ? static_cast<double>(exec->pool->queued()) : 0));
+    result.Set("running", Napi::Number::New(env, static_cast<double>(sched.running)));
+    Napi::Object waiting = Napi::Object::New(env);
+    for (std::size_t c = 0; c < 3; ++c)
+    {
+        waiting.Set(priority_names[c], Napi::Number::New(env, static_cast<double>(sched.waiting[c].size())));
+    }
+    result.Set("waiting", waiting);
+    return result;
+}
+
+} // namespace node_mapnik
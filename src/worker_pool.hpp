@@ -0,0 +1,207 @@
+#pragma once
+
+#include <napi.h>
+// stl
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace node_mapnik {
+
+// A fixed set of threads with `queues` task queues. Tasks are spread over the
+// queues, every thread drains its own queue first and steals from the others
+// when it runs dry, so a burst on one queue never leaves threads idle.
+class thread_pool
+{
+  public:
+    thread_pool(std::size_t threads, std::size_t queues);
+    ~thread_pool();
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+    void submit(std::function<void()> task);
+    // runs what is still queued, then stops and joins the threads
+    void shutdown();
+    std::size_t threads() const { return threads_.size(); }
+    std::size_t queues() const { return queues_.size(); }
+    std::size_t queued() const { return queued_; }
+    // The pool running the calling thread, null off the pool threads
+    static thread_pool* current();
+
+  private:
+    struct task_queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    void run(std::size_t index);
+    bool take(std::size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_{0};
+    std::atomic<std::size_t> queued_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ = false;
+};
+
+// Threads the sub-tasks of the calling thread can run on, see task_group
+inline std::size_t task_threads()
+{
+    thread_pool* pool = thread_pool::current();
+    return pool ? pool->threads() : 1;
+}
+
+// Sub-tasks of one piece of async work. On a thread of the pool set with
+// mapnik.setThreadPool they are queued for the other threads of that pool, and
+// whatever no thread took yet is run by the thread waiting for it, so work
+// never waits on tasks queued behind it. Elsewhere (the libuv threadpool, the
+// JS thread) every task runs inline when it is added. Either way no more
+// threads run than the pool was given.
+class task_group
+{
+  public:
+    task_group();
+    ~task_group();
+    task_group(task_group const&) = delete;
+    task_group& operator=(task_group const&) = delete;
+
+    // Threads that can work on the group at once, 1 off the pool
+    std::size_t threads() const;
+
+    template <typename Fn>
+    auto run(Fn fn) -> std::future<decltype(fn())>
+    {
+        using result_type = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(fn));
+        std::future<result_type> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // Runs queued tasks until `result` is ready, then returns it
+    template <typename T>
+    T get(std::future<T>& result)
+    {
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!run_one()) result.wait();
+        }
+        return result.get();
+    }
+
+    // Runs the queued tasks and waits until every task ran
+    void wait();
+
+  private:
+    struct state;
+    void enqueue(std::function<void()> task);
+    bool run_one();
+
+    thread_pool* pool_;
+    std::shared_ptr<state> state_;
+};
+
+// Runs fn(0) ... fn(count - 1) as tasks of a task_group, rethrows the first
+// exception once all of them ran
+template <typename Fn>
+void parallel_for(std::size_t count, Fn const& fn)
+{
+    task_group group;
+    std::vector<std::future<void>> results;
+    results.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        results.push_back(group.run([&fn, i]() { fn(i); }));
+    }
+    std::exception_ptr error;
+    for (auto& result : results)
+    {
+        // all of them, even after a failure, so no task outlives `fn`
+        try
+        {
+            group.get(result);
+        }
+        catch (...)
+        {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+// Scheduling classes of async work, most urgent first
+enum worker_priority
+{
+    priority_interactive = 0,
+    priority_batch,
+    priority_background
+};
+
+// Reads the `priority` option ('interactive', 'batch' or 'background') of an
+// async entry point, throws a TypeError and returns false when it is invalid
+bool parse_priority(Napi::Env env, Napi::Object const& options, worker_priority& priority);
+
+// Drop-in base for the async workers of node-mapnik. Queue() hands the worker to
+// a scheduler on the JS thread that keeps as much work running as there are
+// threads, and starts waiting work by priority. Work runs on the pool set up
+// with mapnik.setThreadPool and completes on the JS thread through a threadsafe
+// function; without a pool it runs on the libuv threadpool.
+class AsyncWorker : public Napi::AsyncWorker
+{
+  public:
+    using Napi::AsyncWorker::AsyncWorker;
+    void Queue();
+    void SetPriority(worker_priority priority) { priority_ = priority; }
+    worker_priority Priority() const { return priority_; }
+    // Runs on the JS thread once the work is done, before the callback
+    void OnComplete(std::function<void(Napi::Env)> fn) { on_complete_ = std::move(fn); }
+
+  protected:
+    void OnExecute(Napi::Env env) override;
+    void OnWorkComplete(Napi::Env env, napi_status status) override;
+
+  private:
+    friend struct scheduler;
+    void Start();
+    void Run();
+
+    worker_priority priority_ = priority_interactive;
+    std::chrono::steady_clock::time_point queued_at_;
+    std::function<void(Napi::Env)> on_complete_;
+};
+
+struct executor;
+
+// The work waiting for a thread, by class, the work started and the pool set with
+// mapnik.setThreadPool. One per environment, only used on its JS thread.
+struct scheduler
+{
+    std::deque<AsyncWorker*> waiting[3];
+    std::size_t running = 0;
+    std::shared_ptr<executor> exec;
+    // whether the env cleanup hook retiring `exec` is registered
+    bool cleanup_hook = false;
+
+    scheduler() = default;
+    scheduler(scheduler const&) = delete;
+    scheduler& operator=(scheduler const&) = delete;
+    // keeps as much work started as there are threads to run it, so the
+    // rest waits here where it can be ordered
+    void dispatch();
+};
+
+Napi::Value set_thread_pool(Napi::CallbackInfo const& info);
+Napi::Value thread_pool_info(Napi::CallbackInfo const& info);
+
+} // namespace node_mapnik
@@ -0,0 +1,62 @@
+"use strict";
+
+var test = require('tape');
+var mapnik = require('../');
+var path = require('path');
+
+mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins,'shape.input'));
+mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins,'csv.input'));
+
+test('should warm and bound the marker cache', (assert) => {
+  assert.throws(function() { mapnik.configureCache(); }, /options object/);
+  assert.throws(function() { mapnik.configureCache({ markers: 1 }); }, /'markers' must be an object/);
+  assert.throws(function() { mapnik.configureCache({ markers: { max_bytes: -1 } }); }, /max_bytes/);
+  mapnik.clearCache();
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/data/ünicode_symbols.xml');
+  map.zoomAll();
+  assert.throws(function() { map.warmCache(); }, /callback/);
+  var before = mapnik.cacheStats().markers;
+  map.warmCache(function(err, loaded) {
+    assert.ifError(err);
+    assert.equal(loaded.markers, 1);
+    var stats = mapnik.cacheStats().markers;
+    assert.equal(stats.misses, before.misses + 1);
+    assert.equal(stats.entries, 1);
+    assert.ok(stats.bytes > 0);
+    mapnik.configureCache({ markers: { max_bytes: 1 << 20 } });
+    map.render(new mapnik.Image(256, 256), function(err, im) {
+      assert.ifError(err);
+      stats = mapnik.cacheStats().markers;
+      assert.equal(stats.hits, before.hits + 1);
+      assert.equal(stats.max_bytes, 1 << 20);
+      // too small for the marker: the render still finds it cached, and it
+      // is evicted once the render is done
+      mapnik.configureCache({ markers: { max_bytes: 1 } });
+      map.render(new mapnik.Image(256, 256), function(err, im) {
+        assert.ifError(err);
+        stats = mapnik.cacheStats().markers;
+        assert.equal(stats.hits, before.hits + 2);
+        assert.equal(stats.evictions, before.evictions + 1);
+        assert.equal(stats.entries, 0);
+        mapnik.configureCache({ markers: { max_bytes: 0 } });
+        mapnik.clearCache();
+        assert.equal(mapnik.cacheStats().markers.bytes, 0);
+        // without any budget renders no longer record what they use
+        map.render(new mapnik.Image(256, 256), function(err, im) {
+          assert.ifError(err);
+          stats = mapnik.cacheStats().markers;
+          assert.equal(stats.misses, before.misses + 1);
+          assert.equal(stats.entries, 0);
+          assert.end();
+        });
+      });
+    });
+  });
+});
+
+test('teardown', (assert) => {
+  mapnik.configureCache({ markers: { max_bytes: 0 }, mapped_memory: { max_bytes: 0 } });
+  mapnik.clearCache();
+  assert.end();
+});
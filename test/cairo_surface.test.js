@@ -24,3 +24,68 @@ test('should be initialized properly', (assert) => {
   assert.equal(im.getData(), '');
   assert.end();
 });
+
+test('should validate streaming options', (assert) => {
+  assert.throws(function() { new mapnik.CairoSurface('svg', 256, 256, null); }, /options/);
+  assert.throws(function() { new mapnik.CairoSurface('svg', 256, 256, {fd: -1}); }, /fd/);
+  assert.throws(function() { new mapnik.CairoSurface('svg', 256, 256, {write: 1}); }, /write/);
+  assert.throws(function() { new mapnik.CairoSurface('svg', 256, 256, {write: function() {}, chunk_size: 0}); }, /chunk_size/);
+  assert.throws(function() { new mapnik.CairoSurface('svg', 256, 256, {fd: 1, write: function() {}}); }, /both/);
+  assert.end();
+});
+
+test('should render a map into a surface and stream it', (assert) => {
+  if (!mapnik.supports.cairo) return assert.end();
+  var fs = require('fs');
+  var os = require('os');
+  var path = require('path');
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/stylesheet.xml');
+  map.zoomAll();
+  map.render(new mapnik.CairoSurface('svg', 256, 256), {}, function(err, surface) {
+    assert.ifError(err);
+    var svg = surface.getData();
+    assert.ok(svg.indexOf('<svg') !== -1);
+    var chunks = [];
+    var streamed = new mapnik.CairoSurface('svg', 256, 256, {chunk_size: 1024, write: function(chunk) {
+      assert.ok(Buffer.isBuffer(chunk));
+      chunks.push(Buffer.from(chunk));
+    }});
+    map.render(streamed, {}, function(err, result) {
+      assert.ifError(err);
+      assert.ok(chunks.length > 1);
+      // cairo numbers its surfaces globally, so ids may differ between renders
+      var streamed_svg = Buffer.concat(chunks).toString();
+      assert.ok(streamed_svg.indexOf('</svg>') !== -1);
+      assert.ok(Math.abs(streamed_svg.length - svg.length) < 50);
+      assert.equal(result.getData(), '');
+      var file = path.join(os.tmpdir(), 'mapnik-surface-' + process.pid + '.pdf');
+      var fd = fs.openSync(file, 'w');
+      map.render(new mapnik.CairoSurface('pdf', 256, 256, {fd: fd}), {}, function(err) {
+        fs.closeSync(fd);
+        assert.ifError(err);
+        var pdf = fs.readFileSync(file);
+        fs.unlinkSync(file);
+        assert.equal(pdf.slice(0, 4).toString(), '%PDF');
+        map.render(new mapnik.CairoSurface('pdf', 256, 256), {}, function(err, in_memory) {
+          assert.ifError(err);
+          var data = in_memory.getData();
+          assert.ok(Buffer.isBuffer(data));
+          assert.equal(data.slice(0, 4).toString(), '%PDF');
+          // the document was handed over to the Buffer
+          assert.equal(in_memory.getData().length, 0);
+          var surface = new mapnik.CairoSurface('pdf', 256, 256);
+          map.render(surface, {}, function(err) {
+            assert.ifError(err);
+            assert.end();
+          });
+          assert.throws(function() { surface.getData(); }, /being rendered/);
+          var other = new mapnik.Map(256, 256);
+          other.loadSync('./test/stylesheet.xml');
+          other.zoomAll();
+          assert.throws(function() { other.render(surface, {}, function() {}); }, /being rendered/);
+        });
+      });
+    });
+  });
+});
@@ -240,3 +240,214 @@ test('should validate with raster', (assert) => {
   assert.deepEqual(ds2.parameters(), options);
   assert.end();
 });
+
+test('should create a columnar datasource from typed arrays', (assert) => {
+  var ds = mapnik.MemoryDatasource.fromColumns({
+    x: new Float64Array([0, 10, 20]),
+    y: new Float64Array([0, 10, 20]),
+    ids: new Uint32Array([7, 8, 9]),
+    props: {
+      speed: new Float32Array([1.5, 2.5, 3.5]),
+      count: new Int32Array([1, 2, 3]),
+      name: ['a', 'b', 'c']
+    }
+  });
+  assert.ok(ds instanceof mapnik.Datasource);
+  assert.deepEqual(ds.extent(), [0, 0, 20, 20]);
+  assert.deepEqual(ds.fields(), { speed: 'Number', count: 'Number', name: 'String' });
+  assert.equal(ds.describe().geometry_type, 'point');
+  var fs = ds.featureset({extent: [5, 5, 25, 25]});
+  var features = [];
+  var feature;
+  while ((feature = fs.next())) {
+    features.push(feature);
+  }
+  features.sort(function(a, b) { return a.id() - b.id(); });
+  assert.deepEqual(features.map(function(f) { return f.id(); }), [8, 9]);
+  assert.deepEqual(features[0].attributes(), { speed: 2.5, count: 2, name: 'b' });
+  assert.end();
+});
+
+test('should update rows of a columnar datasource in place', (assert) => {
+  var ds = mapnik.Datasource.fromColumns({
+    x: new Float64Array([0, 10]),
+    y: new Float64Array([0, 10]),
+    props: { name: ['a', 'b'] }
+  });
+  ds.updateColumns(new Uint32Array([0]), {
+    x: new Float64Array([100]),
+    y: new Float64Array([100]),
+    props: { name: ['moved'] }
+  });
+  assert.deepEqual(ds.extent(), [10, 10, 100, 100]);
+  var fs = ds.featureset({extent: [90, 90, 110, 110]});
+  var feature = fs.next();
+  assert.equal(feature.id(), 1);
+  assert.deepEqual(feature.attributes(), { name: 'moved' });
+  assert.notOk(fs.next());
+  assert.throws(function() { ds.updateColumns([5], { props: { name: ['x'] } }); }, /out of range/);
+  assert.throws(function() { ds.updateColumns([0], { props: { other: ['x'] } }); }, /unknown column/);
+  assert.throws(function() {
+    var csv = new mapnik.Datasource({ type: 'csv', inline: 'x,y\n0,0' });
+    csv.updateColumns([0], {});
+  }, /fromColumns/);
+  assert.throws(function() { mapnik.Datasource.fromColumns({ x: [0], y: [0] }); }, /Float64Array/);
+  assert.end();
+});
+
+test('should query a datasource asynchronously in columnar chunks', (assert) => {
+  var ds = new mapnik.Datasource({ type: 'shape', file: './test/data/world_merc.shp' });
+  ds.query({ fields: ['NAME', 'POP2005'], filter: new mapnik.Expression("[ISO2] = 'RU'") }, function(err, result) {
+    assert.ifError(err);
+    assert.equal(result.count, 1);
+    var chunk = result.chunks[0];
+    assert.equal(chunk.ids.length, 1);
+    assert.deepEqual(Object.keys(chunk.fields), ['NAME', 'POP2005']);
+    assert.deepEqual(chunk.fields.NAME, ['Russia']);
+    assert.ok(chunk.fields.POP2005 instanceof Float64Array);
+    assert.equal(chunk.fields.POP2005[0], 143953092);
+    assert.equal(chunk.geometry.offsets.length, 2);
+    assert.equal(chunk.geometry.offsets[1], chunk.geometry.data.length);
+    ds.query({ limit: 10, chunk_size: 4, geometry: false }, function(err, result) {
+      assert.ifError(err);
+      assert.equal(result.count, 10);
+      assert.deepEqual(result.chunks.map(function(c) { return c.ids.length; }), [4, 4, 2]);
+      assert.notOk(result.chunks[0].geometry);
+      assert.deepEqual(result.chunks[0].fields, {});
+      assert.end();
+    });
+  });
+});
+
+test('should stream Datasource.query chunks to on_chunk as they fill', (assert) => {
+  var ds = new mapnik.Datasource({ type: 'shape', file: './test/data/world_merc.shp' });
+  var sizes = [];
+  ds.query({ limit: 10, chunk_size: 4, geometry: false, on_chunk: function(chunk) {
+    sizes.push(chunk.ids.length);
+  } }, function(err, result) {
+    assert.ifError(err);
+    assert.equal(result.count, 10);
+    assert.deepEqual(result.chunks, []);
+    assert.deepEqual(sizes, [4, 4, 2]);
+    ds.query({ chunk_size: 1, geometry: false, on_chunk: function() {
+      throw new Error('stop here');
+    } }, function(err) {
+      assert.ok(err);
+      assert.ok(/stop here/.test(err.message));
+      assert.end();
+    });
+  });
+});
+
+test('should validate Datasource.query arguments', (assert) => {
+  var ds = new mapnik.Datasource({ type: 'shape', file: './test/data/world_merc.shp' });
+  assert.throws(function() { ds.query({}); }, /last argument must be a callback function/);
+  assert.throws(function() { ds.query(null, function() {}); }, /options object/);
+  assert.throws(function() { ds.query({ fields: 'NAME' }, function() {}); }, /fields/);
+  assert.throws(function() { ds.query({ filter: 1 }, function() {}); }, /filter/);
+  assert.throws(function() { ds.query({ limit: -1 }, function() {}); }, /limit/);
+  assert.throws(function() { ds.query({ chunk_size: 0 }, function() {}); }, /chunk_size/);
+  assert.throws(function() { ds.query({ extent: [0, 0] }, function() {}); }, /extent/);
+  assert.throws(function() { ds.query({ on_chunk: true }, function() {}); }, /on_chunk/);
+  assert.end();
+});
+
+test('should summarize a datasource natively with stats', (assert) => {
+  var ds = new mapnik.Datasource({ type: 'shape', file: './test/data/world_merc.shp' });
+  assert.throws(function() { ds.stats({}); }, /last argument must be a callback function/);
+  assert.throws(function() { ds.stats({ fields: 'NAME' }, function() {}); }, /fields/);
+  assert.throws(function() { ds.stats({ sample: 0 }, function() {}); }, /sample/);
+  ds.stats(function(err, stats) {
+    assert.ifError(err);
+    assert.equal(stats.count, 245);
+    assert.equal(stats.sampled, false);
+    var types = Object.keys(stats.geometry_types);
+    assert.equal(types.reduce(function(sum, t) { return sum + stats.geometry_types[t]; }, 0), 245);
+    var extent = ds.extent();
+    stats.extent.forEach(function(v, i) { assert.ok(Math.abs(v - extent[i]) < 1e-6); });
+    assert.deepEqual(Object.keys(stats.fields).sort(), Object.keys(ds.fields()).sort());
+    assert.equal(stats.fields.ISO2.nulls, 0);
+    assert.ok(Math.abs(stats.fields.ISO2.distinct - 245) < 10, 'distinct estimate close to 245');
+    assert.equal(stats.fields.POP2005.max, 1312978855);
+    assert.equal(stats.fields.POP2005.min, 0);
+    assert.equal(typeof stats.fields.NAME.min, 'string');
+    ds.stats({ fields: ['POP2005'], sample: 10 }, function(err, stats) {
+      assert.ifError(err);
+      assert.equal(stats.count, 10);
+      assert.equal(stats.sampled, true);
+      assert.deepEqual(Object.keys(stats.fields), ['POP2005']);
+      assert.end();
+    });
+  });
+});
+
+test('should cache features of a datasource per cell', (assert) => {
+  var ds = new mapnik.Datasource({ type: 'shape', file: './test/data/world_merc.shp' });
+  var cached = new mapnik.CachingDatasource(ds, { quantize_zoom: 2 });
+  assert.ok(cached instanceof mapnik.Datasource);
+  assert.deepEqual(cached.extent(), ds.extent());
+  assert.deepEqual(cached.fields(), ds.fields());
+  assert.deepEqual(cached.parameters(), ds.parameters());
+  function ids(source, extent) {
+    var fs = source.featureset({ extent: extent });
+    var result = [];
+    var feature;
+    while ((feature = fs.next())) {
+      result.push(feature.id());
+    }
+    return result.sort(function(a, b) { return a - b; });
+  }
+  var extent = [-1000000, -1000000, 5000000, 5000000];
+  assert.deepEqual(ids(cached, extent), ids(ds, extent));
+  var stats = cached.cacheStats();
+  assert.equal(stats.hits, 0);
+  assert.ok(stats.misses > 0);
+  assert.equal(stats.cells, stats.misses);
+  assert.deepEqual(ids(cached, extent), ids(ds, extent));
+  assert.equal(cached.cacheStats().hits, stats.misses);
+  assert.throws(function() { ds.cacheStats(); }, /withCache/);
+  assert.throws(function() { mapnik.CachingDatasource({}); }, /mapnik.Datasource/);
+  assert.throws(function() { ds.withCache({ quantize_zoom: 21 }); }, /quantize_zoom/);
+  assert.end();
+});
+
+test('should drop the cache of a columnar datasource updated in place', (assert) => {
+  var ds = mapnik.Datasource.fromColumns({
+    x: new Float64Array([0, 10]),
+    y: new Float64Array([0, 10]),
+    props: { name: ['a', 'b'] }
+  });
+  var cached = ds.withCache({ quantize_zoom: 2 });
+  var fs = cached.featureset({ extent: [-1, -1, 1, 1] });
+  assert.deepEqual(fs.next().attributes(), { name: 'a' });
+  assert.ok(cached.cacheStats().cells > 0);
+  ds.updateColumns(new Uint32Array([0]), {
+    x: new Float64Array([100]),
+    y: new Float64Array([100]),
+    props: { name: ['moved'] }
+  });
+  assert.deepEqual(cached.extent(), [10, 10, 100, 100]);
+  assert.equal(cached.cacheStats().cells, 0);
+  fs = cached.featureset({ extent: [-1, -1, 1, 1] });
+  assert.notOk(fs && fs.next());
+  fs = cached.featureset({ extent: [90, 90, 110, 110] });
+  assert.deepEqual(fs.next().attributes(), { name: 'moved' });
+  assert.notOk(fs.next());
+  assert.end();
+});
+
+test('should return features sharing an id from every cell of a caching datasource', (assert) => {
+  var ds = mapnik.Datasource.fromColumns({
+    x: new Float64Array([-10, 10, 10]),
+    y: new Float64Array([-10, 10, -10]),
+    ids: [7, 7, 8]
+  });
+  var cached = new mapnik.CachingDatasource(ds, { quantize_zoom: 2 });
+  var fs = cached.featureset({ extent: [-20, -20, 20, 20] });
+  var count = 0;
+  while (fs.next()) {
+    ++count;
+  }
+  assert.equal(count, 3);
+  assert.end();
+});
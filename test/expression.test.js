@@ -51,3 +51,49 @@ test('should support evaluation with variables', (assert) => {
   assert.equal(expr.evaluate(feature, options).toString(), 'true');
   assert.end();
 });
+
+test('should evaluate many features at once', (assert) => {
+  var expr = new mapnik.Expression("[integer]*@scale");
+  var features = [];
+  for (var i = 0; i < 10; ++i) {
+    features.push(new mapnik.Feature.fromJSON('{"type":"Feature","id":' + (i + 1) + ',"properties":{"integer":' + i + '},"geometry":null}'));
+  }
+  assert.throws(function() { expr.evaluateMany(features); });
+  assert.throws(function() { expr.evaluateMany(null, function() {}); });
+  assert.throws(function() { expr.evaluateMany([{}], function() {}); });
+  assert.throws(function() { expr.evaluateMany(features, {type:'string'}, function() {}); });
+  assert.throws(function() { expr.evaluateMany(features, {variables:null}, function() {}); });
+  expr.evaluateMany(features, {variables:{scale:2}, type:'number'}, function(err, values, ids) {
+    assert.ifError(err);
+    assert.ok(values instanceof Float64Array);
+    assert.equal(values.length, 10);
+    assert.equal(values[9], 18);
+    assert.equal(ids[9], 10);
+    var filter = new mapnik.Expression("[integer] > 4");
+    filter.evaluateMany(features, {type:'boolean'}, function(err, matches) {
+      assert.ifError(err);
+      assert.ok(matches instanceof Uint8Array);
+      assert.deepEqual(Array.from(matches), [0,0,0,0,0,1,1,1,1,1]);
+      filter.evaluateMany(features, function(err, values) {
+        assert.ifError(err);
+        assert.equal(values[0], false);
+        assert.equal(values[9], true);
+        assert.end();
+      });
+    });
+  });
+});
+
+test('should take over a featureset to evaluate', (assert) => {
+  mapnik.register_datasource(require('path').join(mapnik.settings.paths.input_plugins, 'shape.input'));
+  var ds = new mapnik.Datasource({type: 'shape', file: './test/data/world_merc.shp'});
+  var featureset = ds.featureset();
+  var expr = new mapnik.Expression("[POP2005] > 0");
+  expr.evaluateMany(featureset, {type: 'boolean'}, function(err, matches) {
+    assert.ifError(err);
+    assert.equal(matches.length, 245);
+    assert.end();
+  });
+  // drained on a worker thread, no longer iterable from JS
+  assert.equal(featureset.next(), null);
+});
@@ -382,3 +382,72 @@ test('should round trip a geojson property with an array', (assert) => {
   assert.deepEqual(input.properties, feature.properties);
   assert.end();
 });
+
+test('should serialize many features into one buffer', (assert) => {
+  var json1 = '{"type":"Feature","id":1,"geometry":{"type":"Point","coordinates":[1,2]},"properties":{"name":"one"}}';
+  var json2 = '{"type":"Feature","id":2,"geometry":{"type":"LineString","coordinates":[[0,0],[1,1]]},"properties":{"name":"two"}}';
+  var f1 = mapnik.Feature.fromJSON(json1);
+  var f2 = mapnik.Feature.fromJSON(json2);
+  assert.throws(function() { mapnik.Feature.serializeMany([f1]); });
+  assert.throws(function() { mapnik.Feature.serializeMany(null, function() {}); });
+  assert.throws(function() { mapnik.Feature.serializeMany([f1, {}], function() {}); });
+  assert.throws(function() { mapnik.Feature.serializeMany([f1], {format:'shp'}, function() {}); });
+  assert.throws(function() { mapnik.Feature.serializeMany([f1], {transform:{}}, function() {}); });
+  mapnik.Feature.serializeMany([f1, f2.geometry()], function(err, result) {
+    assert.ifError(err);
+    assert.equal(result.offsets.length, 3);
+    assert.equal(result.offsets[2], result.data.length);
+    var first = result.data.slice(result.offsets[0], result.offsets[1]).toString();
+    var second = result.data.slice(result.offsets[1], result.offsets[2]).toString();
+    assert.equal(first, f1.toJSON());
+    assert.equal(second, f2.geometry().toJSONSync());
+    mapnik.Feature.serializeMany([f1, f2], {format:'wkb'}, function(err, result) {
+      assert.ifError(err);
+      var wkb = result.data.slice(result.offsets[1], result.offsets[2]);
+      assert.deepEqual(wkb, f2.geometry().toWKB());
+      var trans = new mapnik.ProjTransform(new mapnik.Projection('epsg:4326'), new mapnik.Projection('epsg:3857'));
+      mapnik.Feature.serializeMany([f1], {format:'wkt', transform:trans}, function(err, result) {
+        assert.ifError(err);
+        assert.ok(result.data.toString().indexOf('POINT(111319.49') === 0);
+        assert.end();
+      });
+    });
+  });
+});
+
+test('should parse a FeatureCollection in chunks', (assert) => {
+  var features = [];
+  for (var i = 0; i < 1000; ++i) {
+    features.push({type:'Feature', geometry:{type:'Point', coordinates:[i, i / 2]}, properties:{name:'f"}]' + i}});
+  }
+  var collection = Buffer.from(JSON.stringify({type:'FeatureCollection', name:'features', features:features, bbox:[0,0,1,1]}));
+  assert.throws(function() { mapnik.Feature.fromJSONChunk(collection); });
+  assert.throws(function() { mapnik.Feature.fromJSONChunk('foo', function() {}); });
+  var parsed = [];
+  var parser = mapnik.Feature.fromJSONStream();
+  parser.on('data', function(batch) { parsed = parsed.concat(batch); });
+  parser.on('error', function(err) { assert.ifError(err); });
+  parser.on('end', function() {
+    assert.equal(parsed.length, 1000);
+    assert.ok(parsed[0] instanceof mapnik.Feature);
+    assert.deepEqual(parsed[999].attributes(), {name:'f"}]999'});
+    assert.deepEqual(JSON.parse(parsed[10].geometry().toJSONSync()).coordinates, [10, 5]);
+    // ids keep counting across chunks
+    parsed.forEach(function(feature, i) { assert.equal(feature.id(), i + 1); });
+    assert.end();
+  });
+  for (var offset = 0; offset < collection.length; offset += 1000) {
+    parser.write(collection.slice(offset, offset + 1000));
+  }
+  parser.end();
+});
+
+test('should fail to stream truncated GeoJSON', (assert) => {
+  var parser = mapnik.Feature.fromJSONStream();
+  parser.on('data', function() {});
+  parser.on('error', function(err) {
+    assert.ok(err);
+    assert.end();
+  });
+  parser.end(Buffer.from('{"type":"FeatureCollection","features":[{"type":"Feature","geometry":null'));
+});
@@ -143,3 +143,33 @@ test('should not register hidden fonts face-names', function() {
   assert.end();
 });
 */
+
+test('fonts can be registered asynchronously with a face index', (assert) => {
+  var fs = require('fs');
+  var os = require('os');
+  var dir = fs.mkdtempSync(path.join(os.tmpdir(), 'mapnik-fonts-'));
+  var font = path.join(dir, 'DejaVuSerifCondensed-BoldItalic.ttf');
+  var index_file = path.join(dir, 'fonts.idx');
+  fs.writeFileSync(font, fs.readFileSync(path.join(__dirname, 'data', 'map-a', 'DejaVuSerifCondensed-BoldItalic.ttf')));
+  assert.throws(function() { mapnik.registerFonts(dir, {index_file: 1}, function() {}); }, /index_file/);
+  assert.throws(function() { mapnik.registerFonts(dir, {recurse: 1}, function() {}); }, /recurse/);
+  mapnik.registerFonts(dir, {recurse: true, index_file: index_file}, function(err, found) {
+    assert.ifError(err);
+    assert.equal(found, true);
+    assert.ok(mapnik.fonts().indexOf(a) > -1);
+    var lines = fs.readFileSync(index_file, 'utf8').trim().split('\n');
+    assert.equal(lines.length, 1);
+    var fields = lines[0].split('\t');
+    assert.equal(fields[0], font);
+    assert.equal(fields[4], a);
+    // an unchanged file is not probed again: the indexed face name is trusted
+    fields[4] = 'Indexed Face';
+    fs.writeFileSync(index_file, fields.join('\t') + '\n');
+    mapnik.registerFonts(dir, {index_file: index_file}, function(err, found) {
+      assert.ifError(err);
+      assert.equal(found, true);
+      assert.ok(mapnik.fonts().indexOf('Indexed Face') > -1);
+      assert.end();
+    });
+  });
+});
@@ -159,4 +159,114 @@ if (mapnik.supports.grid) {
       assert.end();
     });
   });
+
+  test('should encode subtiles of a metatile grid', (assert) => {
+    var map = new mapnik.Map(64, 64);
+    map.loadSync('./test/stylesheet.xml');
+    map.zoomAll();
+    var grid = new mapnik.Grid(64, 64, {key: '__id__'});
+    map.render(grid, {layer: 0, fields: ['NAME']}, function(err, grid) {
+      assert.ifError(err);
+      assert.throws(function() { grid.encodeTiles({cols: 2, rows: 2}); }, /callback/);
+      assert.throws(function() { grid.encodeTiles({cols: 3, rows: 2}, function() {}); }, /divide/);
+      assert.throws(function() { grid.encodeTiles({cols: 2}, function() {}); }, /integers/);
+      assert.throws(function() { grid.encodeTiles({cols: 2, rows: 2, resolution: 0}, function() {}); }, /zero/);
+      grid.encodeTiles({cols: 2, rows: 2, resolution: 4}, function(err, tiles) {
+        assert.ifError(err);
+        assert.equal(tiles.length, 4);
+        for (var i = 0; i < tiles.length; ++i) {
+          var x = (i % 2) * 32;
+          var y = Math.floor(i / 2) * 32;
+          var expected = grid.view(x, y, 32, 32).encodeSync({resolution: 4});
+          assert.deepEqual(tiles[i], expected);
+        }
+        assert.end();
+      });
+    });
+  });
+
+  test('should encode to a compact binary grid', (assert) => {
+    var map = new mapnik.Map(64, 64);
+    map.loadSync('./test/stylesheet.xml');
+    map.zoomAll();
+    var grid = new mapnik.Grid(64, 64, {key: '__id__'});
+    map.render(grid, {layer: 0, fields: ['NAME']}, function(err, grid) {
+      assert.ifError(err);
+      assert.throws(function() { grid.encodeSync({format: 'json'}); }, /format/);
+      var utf = grid.encodeSync({resolution: 4});
+      var buffer = grid.encodeSync({format: 'binary', resolution: 4});
+      assert.ok(Buffer.isBuffer(buffer));
+      var decoded = mapnik.Grid.decodeBinary(buffer);
+      assert.equal(decoded.width, 16);
+      assert.equal(decoded.height, 16);
+      assert.deepEqual(decoded.keys.slice().sort(), utf.keys.slice().sort());
+      assert.deepEqual(decoded.data, utf.data);
+      // every cell must point at the same key as the UTFGrid character there
+      for (var y = 0; y < decoded.height; ++y) {
+        var row = Array.from(utf.grid[y]);
+        for (var x = 0; x < decoded.width; ++x) {
+          var code = row[x].codePointAt(0);
+          code -= 32;
+          if (code >= 2) code -= 1; // '"' is skipped
+          if (code >= 59) code -= 1; // '\\' is skipped
+          assert.equal(decoded.keys[decoded.cells[y * decoded.width + x]], utf.keys[code]);
+        }
+      }
+      grid.encode({format: 'binary', resolution: 4}, function(err, async_buffer) {
+        assert.ifError(err);
+        assert.ok(async_buffer.equals(buffer));
+        assert.end();
+      });
+    });
+  });
+  test('should fetch grid fields lazily when encoding', (assert) => {
+    var map = new mapnik.Map(64, 64);
+    map.loadSync('./test/stylesheet.xml');
+    map.zoomAll();
+    var eager = new mapnik.Grid(64, 64, {key: '__id__'});
+    map.render(eager, {layer: 0, fields: ['NAME']}, function(err, eager) {
+      assert.ifError(err);
+      assert.throws(function() { map.render(new mapnik.Grid(64, 64), {layer: 0, lazy_fields: 1}, function() {}); }, /lazy_fields/);
+      var input = new mapnik.Grid(64, 64, {key: '__id__'});
+      map.render(input, {layer: 0, fields: ['NAME'], lazy_fields: true}, function(err, lazy) {
+        assert.ifError(err);
+        var expected = eager.encodeSync({resolution: 4});
+        assert.deepEqual(lazy.encodeSync({resolution: 4}), expected);
+        // the grid passed to render resolves the attributes too
+        assert.deepEqual(input.encodeSync({resolution: 4}), expected);
+        assert.deepEqual(lazy.view(0, 0, 32, 32).encodeSync({resolution: 4}),
+                         eager.view(0, 0, 32, 32).encodeSync({resolution: 4}));
+        var binary = mapnik.Grid.decodeBinary(lazy.encodeSync({format: 'binary', resolution: 4}));
+        assert.deepEqual(binary.data, expected.data);
+        lazy.encode({resolution: 4}, function(err, utf) {
+          assert.ifError(err);
+          assert.deepEqual(utf, expected);
+          assert.end();
+        });
+      });
+    });
+  });
+  test('should report painted bounds', (assert) => {
+    assert.equal(new mapnik.Grid(16, 16).paintedBounds(), null);
+    var map = new mapnik.Map(64, 64);
+    map.loadSync('./test/stylesheet.xml');
+    map.zoomAll();
+    map.render(new mapnik.Grid(64, 64, {key: '__id__'}), {layer: 0}, function(err, grid) {
+      assert.ifError(err);
+      var b = grid.paintedBounds();
+      assert.ok(b);
+      assert.ok(b.width > 0 && b.height > 0);
+      assert.ok(b.x + b.width <= 64 && b.y + b.height <= 64);
+      assert.deepEqual(grid.view(b.x, b.y, b.width, b.height).paintedBounds(),
+                       {x: 0, y: 0, width: b.width, height: b.height});
+      if (b.y > 0) {
+        assert.equal(grid.view(0, 0, 64, b.y).paintedBounds(), null);
+        assert.ok(grid.view(0, 0, 64, b.y).isSolidSync());
+      }
+      if (b.x + b.width < 64) {
+        assert.equal(grid.view(b.x + b.width, 0, 64 - b.x - b.width, 64).paintedBounds(), null);
+      }
+      assert.end();
+    });
+  });
 }
@@ -1745,3 +1745,28 @@ test('resizes consistently (sync)', (assert) => {
   }
   assert.end();
 });
+
+test('should report pixels as external memory and free them on dispose', (assert) => {
+  var before = process.memoryUsage().external;
+  var im = new mapnik.Image(1024, 1024);
+  var allocated = process.memoryUsage().external;
+  assert.ok(allocated - before >= 1024 * 1024 * 4);
+  im.dispose();
+  assert.equal(im.width(), 0);
+  assert.equal(im.height(), 0);
+  assert.ok(allocated - process.memoryUsage().external >= 1024 * 1024 * 4);
+  // a second dispose is harmless
+  im.dispose();
+  assert.end();
+});
+
+test('should keep pixels alive for buffer() after dispose', (assert) => {
+  var im = new mapnik.Image(4, 4);
+  im.fill(new mapnik.Color('red'));
+  var buffer = im.buffer();
+  im.dispose();
+  assert.equal(buffer.length, 4 * 4 * 4);
+  assert.equal(buffer[0], 255);
+  assert.equal(buffer[1], 0);
+  assert.end();
+});
@@ -28,3 +28,25 @@ test('set_severity should set mapnik.logger', (assert) => {
   mapnik.Logger.setSeverity(orig_severity);
   assert.end();
 });
+
+test('setSink should fail with bad input', (assert) => {
+  assert.throws(function() { mapnik.Logger.setSink(); }, /function or null/);
+  assert.throws(function() { mapnik.Logger.setSink('stderr'); }, /function or null/);
+  assert.throws(function() { mapnik.Logger.setSink(function() {}, 1); }, /options object/);
+  assert.throws(function() { mapnik.Logger.setSink(function() {}, { buffer_size: 0 }); }, /buffer_size/);
+  assert.throws(function() { mapnik.Logger.setSink(function() {}, { batch_ms: -1 }); }, /batch_ms/);
+  assert.end();
+});
+
+test('setSink should set and remove a sink', (assert) => {
+  mapnik.Logger.setSink(function(records, dropped) {
+    assert.ok(Array.isArray(records));
+    assert.equal(typeof dropped, 'number');
+  }, { buffer_size: 16, batch_ms: 10 });
+  // replacing the sink from the same thread is fine
+  mapnik.Logger.setSink(function() {}, { batch_ms: 10 });
+  // back to stderr
+  mapnik.Logger.setSink(null);
+  mapnik.Logger.setSink(null);
+  assert.end();
+});
@@ -182,6 +182,59 @@ test('should load a stylesheet async', (assert) => {
   });
 });
 
+test('should load a stylesheet with lazy datasources', (assert) => {
+  var map = new mapnik.Map(256, 256);
+  assert.throws(function() { map.load('./test/stylesheet.xml', {lazy_datasources: 1}, function(err, result_map) {}); }, /lazy_datasources/);
+  assert.throws(function() { map.loadSync('./test/stylesheet.xml', {lazy_datasources: 1}); }, /lazy_datasources/);
+  map.load('./test/stylesheet.xml', {lazy_datasources: true}, function(err, result_map) {
+    assert.ifError(err);
+    var layers = result_map.layers();
+    assert.equal(layers.length, 1);
+    assert.equal(layers[0].name, 'world');
+    assert.deepEqual(layers[0].styles, ['style']);
+    assert.equal(layers[0].datasource.parameters().type, 'shape');
+    assert.equal(path.normalize(layers[0].datasource.parameters().file), path.normalize(path.join(process.cwd(), './test/data/world_merc.shp')));
+    result_map.zoomAll();
+    result_map.render(new mapnik.Image(256, 256), function(err, im) {
+      assert.ifError(err);
+      assert.notOk(im.isSolid());
+      assert.end();
+    });
+  });
+});
+
+test('should keep mixed text content when loading lazy datasources', (assert) => {
+  var eager = new mapnik.Map(256, 256);
+  eager.loadSync('./test/data/lazy_text_format.xml');
+  var lazy = new mapnik.Map(256, 256);
+  lazy.loadSync('./test/data/lazy_text_format.xml', {lazy_datasources: true});
+  function symbolizer(map) {
+    return map.toXML().match(/<TextSymbolizer[\s\S]*<\/TextSymbolizer>/)[0];
+  }
+  assert.equal(symbolizer(lazy), symbolizer(eager));
+  assert.equal(lazy.layers()[0].datasource.parameters().type, 'shape');
+  assert.end();
+});
+
+test('should only make the layers of the map lazy', (assert) => {
+  var map = new mapnik.Map(256, 256);
+  // the datasource of the group comes after its nested layer and is not opened
+  map.loadSync('./test/data/lazy_nested_layers.xml', {lazy_datasources: true});
+  assert.equal(map.layers().length, 1);
+  assert.ok(/does_not_exist\.shp$/.test(map.layers()[0].datasource.parameters().file));
+  map.zoomToBox([-20037508, -20037508, 20037508, 20037508]);
+  map.render(new mapnik.Image(256, 256), function(err) {
+    assert.ok(err);
+    var message = err.message;
+    // a failed datasource is not created again, the same error is reported
+    map.render(new mapnik.Image(256, 256), function(err) {
+      assert.ok(err);
+      assert.equal(err.message, message);
+      assert.end();
+    });
+  });
+});
+
 test('should load a stylesheet sync', (assert) => {
   var map = new mapnik.Map(600, 400);
 
@@ -423,3 +476,33 @@ test('should allow access to layers', (assert) => {
   assert.deepEqual(layersBefore, layersAfter);
   assert.end();
 });
+
+test('should render an atlas into one multi-page document', (assert) => {
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/stylesheet.xml');
+  map.zoomAll();
+  var extent = map.extent;
+  var half = [extent[0], extent[1], (extent[0] + extent[2]) / 2, (extent[1] + extent[3]) / 2];
+  var pages = [
+    {extent: extent, width: 256, height: 256},
+    {extent: half, width: 300, height: 200, scale: 2},
+    {extent: extent, width: 256, height: 256}
+  ];
+  if (!mapnik.supports.cairo) return assert.end();
+  assert.throws(function() { map.renderAtlas([], function() {}); }, /pages/);
+  assert.throws(function() { map.renderAtlas([{extent: [0, 0], width: 1, height: 1}], function() {}); }, /extent/);
+  assert.throws(function() { map.renderAtlas(pages, {format: 'png'}, function() {}); }, /format/);
+  assert.throws(function() { map.renderAtlas(pages, {surface: new mapnik.CairoSurface('svg', 1, 1)}, function() {}); }, /format/);
+  map.renderAtlas(pages, {threads: 2}, function(err, surface) {
+    assert.ifError(err);
+    var pdf = surface.getData().toString('latin1');
+    assert.equal(pdf.slice(0, 4), '%PDF');
+    assert.equal(pdf.match(/\/Type\s*\/Page\b/g).length, 3);
+    // one page at a time gives the same document structure
+    map.renderAtlas(pages, {threads: 1}, function(err, serial) {
+      assert.ifError(err);
+      assert.equal(serial.getData().toString('latin1').match(/\/Type\s*\/Page\b/g).length, 3);
+      assert.end();
+    });
+  });
+});
@@ -52,3 +52,38 @@ test('should create a spatial index', (assert) => {
       });
     });
 });
+
+test('should index several files in parallel with buildIndex', (assert) => {
+  var mapnik = require('../');
+  mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins, 'shape.input'));
+  var tmpjson = path.join(tmpdir, 'world_merc.json');
+  var missing = path.join(tmpdir, 'missing.shp');
+  fs.writeFileSync(tmpjson, fs.readFileSync(path.join(__dirname, 'data', 'world_merc.json')));
+  fs.unlinkSync(path.join(tmpdir, 'world_merc.index'));
+  assert.throws(function() { mapnik.buildIndex(tmpshp); }, /last argument must be a callback function/);
+  assert.throws(function() { mapnik.buildIndex(1, function() {}); }, /first argument must be a path or an array of paths/);
+  assert.throws(function() { mapnik.buildIndex(tmpshp, { type: 'gpx' }, function() {}); }, /'type' must be/);
+  var progress = [];
+  mapnik.buildIndex([tmpshp, tmpjson, missing], {
+    progress: function(p) { progress.push(p); }
+  }, function(err, results) {
+    assert.ifError(err);
+    assert.equal(results.length, 3);
+    assert.equal(results[0].index, path.join(tmpdir, 'world_merc.index'));
+    assert.equal(results[0].features, 245);
+    assert.equal(results[1].index, tmpjson + '.index');
+    assert.ok(results[1].features > 0);
+    assert.equal(results[2].index, null);
+    assert.ok(results[2].error);
+    assert.equal(progress.length, 3);
+    assert.deepEqual(progress.map(function(p) { return p.done; }), [1, 2, 3]);
+    assert.ok(fs.existsSync(path.join(tmpdir, 'world_merc.index')));
+    assert.ok(fs.existsSync(tmpjson + '.index'));
+    var ds = new mapnik.Datasource({ type: 'shape', file: tmpshp });
+    var count = 0;
+    var featureset = ds.featureset();
+    while (featureset.next()) ++count;
+    assert.equal(count, 245);
+    assert.end();
+  });
+});
@@ -138,3 +138,71 @@ test('should throw with invalid bbox (3873 -> 4326) backward', (assert) => {
   assert.throws(function() { trans.backward(long_lat_box); });
   assert.end();
 });
+
+test('should forward and backward many coords (4326 -> 3857)', (assert) => {
+  var from = new mapnik.Projection('epsg:4326');
+  var to = new mapnik.Projection('epsg:3857');
+  var trans = new mapnik.ProjTransform(from,to);
+  assert.throws(function() { trans.forwardManySync(); });
+  assert.throws(function() { trans.forwardManySync([1,2]); });
+  assert.throws(function() { trans.forwardManySync(new Float64Array(3)); });
+  assert.throws(function() { trans.forwardManySync(new Float64Array(4), {stride:1}); });
+  assert.throws(function() { trans.forwardMany(new Float64Array(4)); });
+  var coords = new Float64Array([-122.33517, 47.63752, 7, -122.2435, 47.67764, 8]);
+  var merc = trans.forwardManySync(coords, {stride:3, inPlace:false});
+  assert.notEqual(merc, coords);
+  assert.equal(coords[0], -122.33517);
+  var single = trans.forward([-122.33517, 47.63752]);
+  assert.ok(Math.abs(merc[0] - single[0]) < 1e-6);
+  assert.ok(Math.abs(merc[1] - single[1]) < 1e-6);
+  assert.equal(merc[2], 7);
+  assert.equal(merc[5], 8);
+  var back = trans.backwardManySync(merc, {stride:3});
+  assert.equal(back, merc);
+  assert.ok(Math.abs(back[3] - -122.2435) < 1e-6);
+  assert.ok(Math.abs(back[4] - 47.67764) < 1e-6);
+  assert.end();
+});
+
+test('should forward many coords async across threads (4326 -> 3857)', (assert) => {
+  var from = new mapnik.Projection('epsg:4326');
+  var to = new mapnik.Projection('epsg:3857');
+  var trans = new mapnik.ProjTransform(from,to);
+  var count = 100000;
+  var coords = new Float64Array(count * 2);
+  for (var i = 0; i < count; ++i) {
+    coords[i * 2] = -180 + 360 * i / count;
+    coords[i * 2 + 1] = -80 + 160 * i / count;
+  }
+  var expected = trans.forwardManySync(coords, {inPlace:false});
+  trans.forwardMany(coords, function(err, result) {
+    assert.ifError(err);
+    assert.equal(result, coords);
+    assert.deepEqual(Array.from(result.subarray(0, 20)), Array.from(expected.subarray(0, 20)));
+    assert.deepEqual(Array.from(result.subarray(-20)), Array.from(expected.subarray(-20)));
+    assert.end();
+  });
+});
+
+test('should use spherical mercator fast path for many coords (4326 <-> 3857)', (assert) => {
+  var from = new mapnik.Projection('epsg:4326');
+  var to = new mapnik.Projection('epsg:3857');
+  var trans = new mapnik.ProjTransform(from,to);
+  var coords = new Float64Array([-122.33517, 47.63752, 0, 0, 180, 85.0511287798066, -180, -89]);
+  var expected = [-13618288.830508558, 6046761.547468153,
+                  0, 0,
+                  20037508.342789244, 20037508.342789277,
+                  -20037508.342789244, -20037508.342789255];
+  var merc = trans.forwardManySync(coords, {inPlace:false});
+  for (var i = 0; i < expected.length; ++i) {
+    assert.ok(Math.abs(merc[i] - expected[i]) < 1e-3, 'sub-millimeter at index ' + i);
+  }
+  var reverse = new mapnik.ProjTransform(to,from);
+  reverse.forwardMany(merc, function(err, lonlat) {
+    assert.ifError(err);
+    assert.ok(Math.abs(lonlat[0] - -122.33517) < 1e-9);
+    assert.ok(Math.abs(lonlat[1] - 47.63752) < 1e-9);
+    assert.ok(Math.abs(lonlat[7] - -85.0511287798066) < 1e-9, 'latitude is clamped');
+    assert.end();
+  });
+});
@@ -66,3 +66,36 @@ test('should fail some methods with an uninitialized projection', (assert) => {
   assert.throws(function() { wgs84.inverse(long_lat_coords); });
   assert.end();
 });
+
+test('should project many coords', (assert) => {
+  var merc = new mapnik.Projection('epsg:3857');
+  assert.throws(function() { merc.forwardManySync(); });
+  assert.throws(function() { merc.forwardManySync(null); });
+  assert.throws(function() { merc.forwardManySync(new Float64Array(3)); });
+  assert.throws(function() { merc.forwardManySync(new Float64Array(2), {inPlace:null}); });
+  var long_lat_coords = [-122.33517, 47.63752];
+  var coords = new Float64Array(long_lat_coords);
+  var projected = merc.forwardManySync(coords);
+  assert.equal(projected, coords);
+  var single = merc.forward(long_lat_coords);
+  assert.ok(Math.abs(projected[0] - single[0]) < 1e-6);
+  assert.ok(Math.abs(projected[1] - single[1]) < 1e-6);
+  merc.inverseMany(projected, {inPlace:false}, function(err, result) {
+    assert.ifError(err);
+    assert.notEqual(result, projected);
+    assert.ok(Math.abs(result[0] - long_lat_coords[0]) < 1e-6);
+    assert.ok(Math.abs(result[1] - long_lat_coords[1]) < 1e-6);
+    assert.end();
+  });
+});
+
+test('should report the position that cannot be projected', (assert) => {
+  var ortho = new mapnik.Projection('+proj=ortho +lat_0=0 +lon_0=0 +datum=WGS84 +units=m +no_defs');
+  // the antipode is not visible in an orthographic projection
+  assert.throws(function() { ortho.forwardManySync(new Float64Array([0, 0, 180, 0])); }, /index 1/);
+  ortho.forwardMany(new Float64Array([0, 0, 10, 10, 180, 0]), function(err) {
+    assert.ok(err);
+    assert.ok(/index 2/.test(err.message));
+    assert.end();
+  });
+});
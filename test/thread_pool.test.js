@@ -0,0 +1,104 @@
+"use strict";
+
+var test = require('tape');
+var mapnik = require('../');
+var path = require('path');
+
+mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins,'shape.input'));
+
+test('should render on a dedicated thread pool', (assert) => {
+  assert.throws(function() { mapnik.setThreadPool(); }, /options object/);
+  assert.throws(function() { mapnik.setThreadPool({ threads: -1 }); }, /threads/);
+  assert.throws(function() { mapnik.setThreadPool({ queues: 0 }); }, /queues/);
+  mapnik.setThreadPool({ threads: 2, queues: 1 });
+  var info = mapnik.threadPool();
+  assert.equal(info.threads, 2);
+  assert.equal(info.queues, 1);
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/stylesheet.xml');
+  map.zoomAll();
+  var remaining = 4;
+  for (var i = 0; i < 4; ++i) {
+    map.clone().render(new mapnik.Image(256, 256), function(err, im) {
+      assert.ifError(err);
+      im.encode('png', function(err, buffer) {
+        assert.ifError(err);
+        assert.ok(buffer.length > 0);
+        if (--remaining === 0) {
+          assert.equal(mapnik.threadPool().running, 0);
+          // back to the libuv threadpool
+          mapnik.setThreadPool({ threads: 0 });
+          assert.equal(mapnik.threadPool().threads, 0);
+          map.render(new mapnik.Image(256, 256), function(err, im) {
+            assert.ifError(err);
+            assert.end();
+          });
+        }
+      });
+    });
+  }
+  // only as much work starts as there are threads, the rest waits its turn
+  var queued = mapnik.threadPool();
+  assert.equal(queued.running, 2);
+  assert.equal(queued.waiting.interactive, 2);
+});
+
+test('should start waiting work by priority', (assert) => {
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/stylesheet.xml');
+  map.zoomAll();
+  assert.throws(function() { map.render(new mapnik.Image(256, 256), { priority: 'urgent' }, function() {}); }, /priority/);
+  mapnik.setThreadPool({ threads: 1 });
+  var order = [];
+  function done(name) {
+    return function(err) {
+      assert.ifError(err);
+      order.push(name);
+      if (order.length === 3) {
+        // the background render was queued first but started after the interactive one
+        assert.deepEqual(order, ['first', 'interactive', 'background']);
+        mapnik.setThreadPool({ threads: 0 });
+        assert.end();
+      }
+    };
+  }
+  map.clone().render(new mapnik.Image(256, 256), done('first'));
+  map.clone().render(new mapnik.Image(256, 256), { priority: 'background' }, done('background'));
+  map.clone().render(new mapnik.Image(256, 256), { priority: 'interactive' }, done('interactive'));
+  var info = mapnik.threadPool();
+  assert.equal(info.running, 1);
+  assert.equal(info.waiting.background, 1);
+  assert.equal(info.waiting.interactive, 1);
+});
+
+test('should render in several worker threads at once', (assert) => {
+  var Worker = require('worker_threads').Worker;
+  var source = [
+    "var mapnik = require(" + JSON.stringify(path.resolve(__dirname, '..')) + ");",
+    "var path = require('path');",
+    "var parentPort = require('worker_threads').parentPort;",
+    "mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins,'shape.input'));",
+    "var map = new mapnik.Map(256, 256);",
+    "map.loadSync('./test/stylesheet.xml');",
+    "map.zoomAll();",
+    "map.render(new mapnik.Image(256, 256), function(err, im) {",
+    "  if (err) throw err;",
+    "  parentPort.postMessage(im instanceof mapnik.Image && !im.isSolidSync());",
+    "});"
+  ].join('\n');
+  var remaining = 3;
+  for (var i = 0; i < 3; ++i) {
+    var worker = new Worker(source, { eval: true });
+    worker.on('error', assert.ifError);
+    worker.on('message', function(rendered) {
+      assert.ok(rendered);
+      if (--remaining === 0) assert.end();
+    });
+  }
+});
+
+test('teardown', (assert) => {
+  // back to the libuv threadpool for the other test files
+  mapnik.setThreadPool({ threads: 0 });
+  assert.end();
+});
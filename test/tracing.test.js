@@ -0,0 +1,41 @@
+"use strict";
+
+var test = require('tape');
+var mapnik = require('../');
+var path = require('path');
+
+mapnik.register_datasource(path.join(mapnik.settings.paths.input_plugins,'shape.input'));
+
+test('should trace native work', (assert) => {
+  assert.throws(function() { mapnik.tracing.start({ categories: ['pizza'] }); }, /unknown tracing category/);
+  assert.throws(function() { mapnik.tracing.start({ buffer_size: 0 }); }, /buffer_size/);
+  mapnik.tracing.start({ categories: ['worker', 'render', 'encode'] });
+  var map = new mapnik.Map(256, 256);
+  map.loadSync('./test/stylesheet.xml');
+  map.zoomAll();
+  map.render(new mapnik.Image(256, 256), function(err, im) {
+    assert.ifError(err);
+    im.encode('png', function(err, buffer) {
+      assert.ifError(err);
+      var trace = JSON.parse(mapnik.tracing.stop());
+      var events = trace.traceEvents.filter(function(ev) { return ev.ph === 'X'; });
+      var names = events.map(function(ev) { return ev.name; });
+      assert.ok(names.some(function(name) { return /AsyncRender/.test(name); }));
+      assert.ok(names.indexOf('render agg') !== -1);
+      assert.ok(names.indexOf('encode') !== -1);
+      events.forEach(function(ev) {
+        assert.equal(typeof ev.tid, 'number');
+        assert.ok(ev.dur >= 0);
+      });
+      assert.ok(trace.traceEvents.some(function(ev) { return ev.ph === 'M' && ev.name === 'thread_name'; }));
+      // nothing is recorded once stopped
+      assert.equal(JSON.parse(mapnik.tracing.stop()).traceEvents.length, trace.traceEvents.length);
+      assert.end();
+    });
+  });
+});
+
+test('teardown', (assert) => {
+  mapnik.tracing.stop();
+  assert.end();
+});
@@ -4061,3 +4061,16 @@ test('pasted test 23 - testing clipper in mapnik vector tile corrects invalid ge
     assert.end();
   });
 });
+
+test('should free the tile data on dispose', (assert) => {
+  var vtile = new mapnik.VectorTile(9,112,195);
+  vtile.setData(fs.readFileSync('./test/data/vector_tile/tile1.vector.pbf'), function(err) {
+    assert.ifError(err);
+    assert.ok(vtile.getData().length > 0);
+    vtile.dispose();
+    assert.equal(vtile.getData().length, 0);
+    assert.equal(vtile.empty(), true);
+    assert.deepEqual([vtile.z, vtile.x, vtile.y], [9, 112, 195]);
+    assert.end();
+  });
+});